@@ -0,0 +1,130 @@
+#include "SyntheticScene.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+#include <SofaOffscreenCamera/OffscreenCamera.h>
+#include <SofaSimulationGraph/SimpleApi.h>
+#include <sofa/simulation/Simulation.h>
+
+namespace {
+
+/** Indices of the corners of the cell (i, j, k) of a grid of n x n x n cells, in the order of SOFA's hexahedra. */
+std::array<std::size_t, 8> corners_of(std::size_t i, std::size_t j, std::size_t k, std::size_t n) {
+    const auto index = [n](std::size_t x, std::size_t y, std::size_t z) { return x + (n+1) * (y + (n+1) * z); };
+    return {
+        index(i, j, k),   index(i+1, j, k),   index(i+1, j+1, k),   index(i, j+1, k),
+        index(i, j, k+1), index(i+1, j, k+1), index(i+1, j+1, k+1), index(i, j+1, k+1)
+    };
+}
+
+} // namespace
+
+std::string to_string(ElementType type) {
+    return type == ElementType::Tetrahedra ? "tetrahedra" : "hexahedra";
+}
+
+SyntheticScene create_synthetic_scene(const SceneParameters & parameters) {
+    namespace simpleapi = sofa::simpleapi;
+
+    // Each cell of the grid holds one hexahedron or six tetrahedra
+    const std::size_t elements_per_cell = parameters.element_type == ElementType::Tetrahedra ? 6 : 1;
+    const double cells = static_cast<double>(parameters.number_of_elements) / elements_per_cell;
+    const auto n = std::max<std::size_t>(1, static_cast<std::size_t>(std::lround(std::cbrt(cells))));
+
+    std::ostringstream positions, elements, fixed_indices;
+    for (std::size_t z = 0; z <= n; ++z) {
+        for (std::size_t y = 0; y <= n; ++y) {
+            for (std::size_t x = 0; x <= n; ++x) {
+                positions << static_cast<double>(x) / n - 0.5 << ' '
+                          << static_cast<double>(y) / n - 0.5 << ' '
+                          << static_cast<double>(z) / n - 0.5 << ' ';
+                if (x == 0) {
+                    fixed_indices << x + (n+1) * (y + (n+1) * z) << ' ';
+                }
+            }
+        }
+    }
+
+    for (std::size_t k = 0; k < n; ++k) {
+        for (std::size_t j = 0; j < n; ++j) {
+            for (std::size_t i = 0; i < n; ++i) {
+                const auto c = corners_of(i, j, k, n);
+                if (parameters.element_type == ElementType::Hexahedra) {
+                    for (const auto corner : c)
+                        elements << corner << ' ';
+                } else {
+                    // Kuhn subdivision along the diagonal c[0]-c[6], conforming between neighbouring cells
+                    const std::size_t paths[6][2] = {{1, 2}, {1, 5}, {3, 2}, {3, 7}, {4, 5}, {4, 7}};
+                    for (const auto & path : paths)
+                        elements << c[0] << ' ' << c[path[0]] << ' ' << c[path[1]] << ' ' << c[6] << ' ';
+                }
+            }
+        }
+    }
+
+    simpleapi::importPlugin("SofaBaseMechanics");
+    simpleapi::importPlugin("SofaBaseLinearSolver");
+    simpleapi::importPlugin("SofaBoundaryCondition");
+    simpleapi::importPlugin("SofaImplicitOdeSolver");
+    simpleapi::importPlugin("SofaSimpleFem");
+
+    SyntheticScene scene;
+    scene.number_of_elements = n * n * n * elements_per_cell;
+    scene.root = sofa::simulation::getSimulation()->createNewGraph("root");
+    scene.root->setDt(0.01);
+    scene.root->setGravity({0, -9.81, 0});
+
+    simpleapi::createObject(scene.root, "VisualStyle", {{"displayFlags", "showBehavior"}});
+    const bool tetrahedra = parameters.element_type == ElementType::Tetrahedra;
+    auto mesh = simpleapi::createChild(scene.root, "mesh");
+    simpleapi::createObject(mesh, "EulerImplicitSolver", {{"rayleighStiffness", "0.1"}, {"rayleighMass", "0.1"}});
+    simpleapi::createObject(mesh, "CGLinearSolver", {{"iterations", "25"}, {"tolerance", "1e-9"}, {"threshold", "1e-9"}});
+    simpleapi::createObject(mesh, "MeshTopology", {
+        {"position", positions.str()},
+        {tetrahedra ? "tetrahedra" : "hexahedra", elements.str()}
+    });
+    simpleapi::createObject(mesh, "MechanicalObject", {{"name", "mo"}});
+    simpleapi::createObject(mesh, "UniformMass", {{"totalMass", "1"}});
+    simpleapi::createObject(mesh, tetrahedra ? "TetrahedronFEMForceField" : "HexahedronFEMForceField", {
+        {"youngModulus", "5000"}, {"poissonRatio", "0.3"}, {"method", "large"}
+    });
+    simpleapi::createObject(mesh, "FixedConstraint", {{"indices", fixed_indices.str()}});
+
+    constexpr double pi = 3.14159265358979323846;
+    for (std::size_t i = 0; i < parameters.number_of_cameras; ++i) {
+        const double angle = 2 * pi * static_cast<double>(i) / static_cast<double>(parameters.number_of_cameras);
+        std::ostringstream position;
+        position << 3 * std::cos(angle) << " 1 " << 3 * std::sin(angle);
+
+        simpleapi::Dict attributes = {
+            {"name", "camera_" + std::to_string(i)},
+            {"widthViewport", std::to_string(parameters.width)},
+            {"heightViewport", std::to_string(parameters.height)},
+            {"core_profile", parameters.core_profile ? "true" : "false"},
+            {"profile", "true"},
+            {"position", position.str()}, {"lookAt", "0 0 0"},
+            {"zNear", "0.01"}, {"zFar", "100"}, {"computeZClip", "false"}, {"projectionType", "1"}
+        };
+        if (not parameters.archive_filepath.empty()) {
+            attributes["archive_filepath"] = parameters.archive_filepath;
+            attributes["filepath"] = "%s_%i.qoi";
+            attributes["save_frame_after_each_n_steps"] = "1";
+        }
+
+        auto camera = simpleapi::createObject(scene.root, "OffscreenCamera", attributes);
+        auto * offscreen_camera = dynamic_cast<OffscreenCamera *>(camera.get());
+        if (not offscreen_camera) {
+            throw std::runtime_error("The OffscreenCamera component could not be created.");
+        }
+        scene.cameras.push_back(offscreen_camera);
+    }
+
+    sofa::simulation::getSimulation()->init(scene.root.get());
+    sofa::simulation::getSimulation()->initTextures(scene.root.get());
+
+    return scene;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <sofa/simulation/Node.h>
+
+class OffscreenCamera;
+
+/** Volumetric elements of the synthetic meshes. */
+enum class ElementType { Tetrahedra, Hexahedra };
+
+/** Parameters of a synthetic scene. */
+struct SceneParameters {
+    ElementType element_type = ElementType::Hexahedra;
+    std::size_t number_of_elements = 1000; ///< Approximate, the mesh is a cubic grid
+    std::size_t number_of_cameras = 1;
+    unsigned int width = 800;
+    unsigned int height = 600;
+    bool core_profile = false;
+    std::string archive_filepath;          ///< If set, the cameras save a QOI frame after every step into this
+                                           ///< frame archive ('%s' being the name of the camera)
+};
+
+struct SyntheticScene {
+    sofa::simulation::Node::SPtr root;
+    std::vector<OffscreenCamera *> cameras;
+    std::size_t number_of_elements = 0;    ///< Actual number of elements of the mesh
+};
+
+/**
+ * Create and initialize a scene made of a cube of elasticity, fixed on one side and falling under gravity, drawn
+ * through the draw tool by its force field. The cameras are spread on a circle around the cube.
+ */
+SyntheticScene create_synthetic_scene(const SceneParameters & parameters);
+
+std::string to_string(ElementType type);
@@ -0,0 +1,344 @@
+/**
+ * Throughput benchmark of the frame capture of the OffscreenCamera.
+ *
+ * Every combination of the given element types, numbers of elements, numbers of cameras, resolutions, profiles and
+ * output modes is run on a synthetic scene (see SyntheticScene.h). Each configuration reports its
+ * capture rate and the percentiles of the duration of each stage of the capture, measured by the camera's profiler.
+ * The results are written as JSON, see the README for the options.
+ */
+#include "SyntheticScene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <SofaOffscreenCamera/FrameProfiler.h>
+#include <SofaOffscreenCamera/OffscreenCamera.h>
+#include <SofaSimulationGraph/DAGSimulation.h>
+#include <SofaSimulationGraph/init.h>
+#include <sofa/simulation/Simulation.h>
+#include <sofa/type/Vec.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Stage = FrameProfiler::Stage;
+
+struct Resolution {
+    unsigned int width;
+    unsigned int height;
+};
+
+struct Options {
+    std::vector<ElementType> element_types {ElementType::Hexahedra};
+    std::vector<std::size_t> elements {1000, 10000};
+    std::vector<std::size_t> cameras {1, 4};
+    std::vector<Resolution> resolutions {{640, 480}, {1920, 1080}};
+    std::vector<bool> core_profiles {false};
+    std::vector<std::string> outputs {"grab", "bmp", "png", "jpg", "qoi", "archive"};
+    std::size_t frames = 30;
+    std::size_t warmup_frames = 3;
+    std::string output;
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "offscreen_camera_benchmark";
+};
+
+struct StageSummary {
+    double mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+};
+
+struct Result {
+    SceneParameters scene;
+    std::size_t number_of_elements;
+    std::string output;
+    std::size_t frames;
+    double captures_per_second;
+    double steps_per_second;
+    std::map<std::string, StageSummary> stages;
+};
+
+const char * usage = R"(Usage: capture_benchmark [options]
+
+Every option taking a list expects comma-separated values.
+  --element_types=LIST   tetrahedra, hexahedra (default: hexahedra)
+  --elements=LIST        Approximate number of elements of the mesh (default: 1000,10000)
+  --cameras=LIST         Number of cameras in the scene (default: 1,4)
+  --resolutions=LIST     WIDTHxHEIGHT of the frames (default: 640x480,1920x1080)
+  --core_profile=LIST    false, true (default: false)
+  --outputs=LIST         grab (in memory), png, jpg (encoded by the plugin), qoi, any other image format
+                         supported by Qt such as bmp, or archive (QOI frames saved after every step and appended
+                         to a frame archive per camera) (default: grab,bmp,png,jpg,qoi,archive)
+  --frames=N             Number of measured steps per configuration (default: 30)
+  --warmup_frames=N      Number of steps run before measuring (default: 3)
+  --output=FILE          File receiving the JSON results (default: standard output)
+  --directory=DIR        Directory receiving the captured frames (default: a temporary directory)
+)";
+
+std::vector<std::string> split(const std::string & list) {
+    std::vector<std::string> values;
+    std::istringstream stream(list);
+    for (std::string value; std::getline(stream, value, ',');) {
+        if (not value.empty())
+            values.push_back(value);
+    }
+    return values;
+}
+
+template <typename T, typename Parse>
+std::vector<T> parse_list(const std::string & list, Parse parse) {
+    std::vector<T> values;
+    for (const auto & value : split(list))
+        values.push_back(parse(value));
+    return values;
+}
+
+Options parse_options(int argc, char ** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const auto equal = argument.find('=');
+        if (argument.rfind("--", 0) != 0 or equal == std::string::npos) {
+            throw std::invalid_argument("Unknown argument '" + argument + "'.");
+        }
+        const auto name = argument.substr(2, equal - 2);
+        const auto value = argument.substr(equal + 1);
+
+        if (name == "element_types") {
+            options.element_types = parse_list<ElementType>(value, [](const std::string & type) {
+                if (type == "tetrahedra") return ElementType::Tetrahedra;
+                if (type == "hexahedra") return ElementType::Hexahedra;
+                throw std::invalid_argument("Unknown element type '" + type + "'.");
+            });
+        } else if (name == "elements") {
+            options.elements = parse_list<std::size_t>(value, [](const std::string & n) { return std::stoul(n); });
+        } else if (name == "cameras") {
+            options.cameras = parse_list<std::size_t>(value, [](const std::string & n) { return std::stoul(n); });
+        } else if (name == "resolutions") {
+            options.resolutions = parse_list<Resolution>(value, [](const std::string & resolution) {
+                const auto x = resolution.find('x');
+                if (x == std::string::npos)
+                    throw std::invalid_argument("Resolutions are given as WIDTHxHEIGHT, not '" + resolution + "'.");
+                return Resolution {static_cast<unsigned int>(std::stoul(resolution.substr(0, x))),
+                                   static_cast<unsigned int>(std::stoul(resolution.substr(x + 1)))};
+            });
+        } else if (name == "core_profile") {
+            options.core_profiles = parse_list<bool>(value, [](const std::string & b) { return b == "true" or b == "1"; });
+        } else if (name == "outputs") {
+            options.outputs = split(value);
+        } else if (name == "frames") {
+            options.frames = std::stoul(value);
+        } else if (name == "warmup_frames") {
+            options.warmup_frames = std::stoul(value);
+        } else if (name == "output") {
+            options.output = value;
+        } else if (name == "directory") {
+            options.directory = value;
+        } else {
+            throw std::invalid_argument("Unknown option '" + name + "'.");
+        }
+    }
+    return options;
+}
+
+/** Nearest-rank percentile of sorted values. */
+double percentile(const std::vector<double> & sorted_values, double p) {
+    if (sorted_values.empty())
+        return 0;
+    const auto rank = static_cast<std::size_t>(std::ceil(p / 100. * static_cast<double>(sorted_values.size())));
+    return sorted_values[std::clamp<std::size_t>(rank, 1, sorted_values.size()) - 1];
+}
+
+StageSummary summarize(std::vector<double> durations) {
+    StageSummary summary;
+    if (durations.empty())
+        return summary;
+    std::sort(durations.begin(), durations.end());
+    double sum = 0;
+    for (const auto duration : durations)
+        sum += duration;
+    summary.mean = sum / static_cast<double>(durations.size());
+    summary.p50 = percentile(durations, 50);
+    summary.p90 = percentile(durations, 90);
+    summary.p99 = percentile(durations, 99);
+    summary.max = durations.back();
+    return summary;
+}
+
+/** Duration of the last measure of the stage by the profiler of the camera, in milliseconds. */
+double last_duration(OffscreenCamera * camera, Stage stage) {
+    const auto * data = dynamic_cast<const sofa::core::objectmodel::Data<sofa::type::Vec3d> *>(
+        camera->findData(std::string("timing_") + FrameProfiler::name(stage)));
+    return data ? data->getValue()[0] : 0;
+}
+
+void step(SyntheticScene & scene) {
+    auto * simulation = sofa::simulation::getSimulation();
+    simulation->animate(scene.root.get(), scene.root->getDt());
+    simulation->updateVisual(scene.root.get());
+}
+
+/**
+ * Run the given output mode on the scene and measure it. The frames of the archive output are saved by the cameras
+ * themselves at the end of the step, hence their capture time is the duration of the whole step.
+ */
+Result measure(SyntheticScene & scene, const SceneParameters & parameters, const std::string & output,
+               const Options & options) {
+    const bool in_memory = (output == "grab");
+    const bool archive = (output == "archive");
+    const auto capture = [&](std::size_t camera_index) {
+        auto * camera = scene.cameras[camera_index];
+        if (archive) {
+            return;
+        }
+        if (in_memory) {
+            camera->grab_frame();
+        } else {
+            const auto path = options.directory / ("camera_" + std::to_string(camera_index) + "." + output);
+            camera->save_frame(path.string());
+        }
+    };
+
+    for (std::size_t frame = 0; frame < options.warmup_frames; ++frame) {
+        step(scene);
+        for (std::size_t i = 0; i < scene.cameras.size(); ++i)
+            capture(i);
+    }
+
+    std::map<Stage, std::vector<double>> durations;
+    Clock::duration capture_time {};
+    const auto start = Clock::now();
+    for (std::size_t frame = 0; frame < options.frames; ++frame) {
+        const auto step_start = Clock::now();
+        step(scene);
+        if (archive) {
+            capture_time += Clock::now() - step_start;
+        }
+        for (std::size_t i = 0; i < scene.cameras.size(); ++i) {
+            const auto capture_start = Clock::now();
+            capture(i);
+            capture_time += Clock::now() - capture_start;
+
+            for (std::size_t s = 0; s < static_cast<std::size_t>(Stage::Count); ++s) {
+                const auto stage = static_cast<Stage>(s);
+                if (in_memory and (stage == Stage::Encode or stage == Stage::Write))
+                    continue;
+                durations[stage].push_back(last_duration(scene.cameras[i], stage));
+            }
+        }
+    }
+    const std::chrono::duration<double> total_time = Clock::now() - start;
+    const std::chrono::duration<double> total_capture_time = capture_time;
+
+    Result result;
+    result.scene = parameters;
+    result.number_of_elements = scene.number_of_elements;
+    result.output = output;
+    result.frames = options.frames;
+    result.captures_per_second = static_cast<double>(options.frames * scene.cameras.size()) / total_capture_time.count();
+    result.steps_per_second = static_cast<double>(options.frames) / total_time.count();
+    for (const auto & [stage, stage_durations] : durations)
+        result.stages[FrameProfiler::name(stage)] = summarize(stage_durations);
+    return result;
+}
+
+void write_json(std::ostream & stream, const std::vector<Result> & results) {
+    stream << "{\n  \"benchmark\": \"capture\",\n  \"plugin_version\": \"" << SOFAOFFSCREENCAMERA_VERSION << "\",\n"
+           << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto & r = results[i];
+        stream << (i ? "," : "") << "\n    {"
+               << "\"element_type\": \"" << to_string(r.scene.element_type) << "\", "
+               << "\"elements\": " << r.number_of_elements << ", "
+               << "\"cameras\": " << r.scene.number_of_cameras << ", "
+               << "\"width\": " << r.scene.width << ", "
+               << "\"height\": " << r.scene.height << ", "
+               << "\"core_profile\": " << (r.scene.core_profile ? "true" : "false") << ", "
+               << "\"output\": \"" << r.output << "\", "
+               << "\"frames\": " << r.frames << ", "
+               << "\"captures_per_second\": " << r.captures_per_second << ", "
+               << "\"steps_per_second\": " << r.steps_per_second << ", "
+               << "\"stages_ms\": {";
+        bool first = true;
+        for (const auto & [name, s] : r.stages) {
+            stream << (first ? "" : ", ") << "\"" << name << "\": {"
+                   << "\"mean\": " << s.mean << ", \"p50\": " << s.p50 << ", \"p90\": " << s.p90
+                   << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << "}";
+            first = false;
+        }
+        stream << "}}";
+    }
+    stream << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    if (argc > 1 and std::string(argv[1]) == "--help") {
+        std::cout << usage;
+        return 0;
+    }
+
+    Options options;
+    try {
+        options = parse_options(argc, argv);
+    } catch (const std::exception & e) {
+        std::cerr << e.what() << "\n\n" << usage;
+        return 1;
+    }
+    std::filesystem::create_directories(options.directory);
+
+    sofa::simulation::graph::init();
+    sofa::simulation::setSimulation(new sofa::simulation::graph::DAGSimulation());
+
+    std::vector<Result> results;
+    for (const auto element_type : options.element_types)
+    for (const auto number_of_elements : options.elements)
+    for (const auto number_of_cameras : options.cameras)
+    for (const auto & resolution : options.resolutions)
+    for (const auto core_profile : options.core_profiles) {
+        SceneParameters parameters;
+        parameters.element_type = element_type;
+        parameters.number_of_elements = number_of_elements;
+        parameters.number_of_cameras = number_of_cameras;
+        parameters.width = resolution.width;
+        parameters.height = resolution.height;
+        parameters.core_profile = core_profile;
+
+        // The scene is shared by the output modes, they only differ after the frame has been read back. The archive
+        // is opened at the initialization of the cameras, hence it gets a scene of its own.
+        auto scene = create_synthetic_scene(parameters);
+        for (const auto & output : options.outputs) {
+            if (output == "archive") {
+                SceneParameters archive_parameters = parameters;
+                archive_parameters.archive_filepath = (options.directory / "%s.sfa").string();
+                auto archive_scene = create_synthetic_scene(archive_parameters);
+                results.push_back(measure(archive_scene, parameters, output, options));
+                sofa::simulation::getSimulation()->unload(archive_scene.root);
+            } else {
+                results.push_back(measure(scene, parameters, output, options));
+            }
+            const auto & r = results.back();
+            std::cerr << to_string(element_type) << " " << r.number_of_elements << ", " << number_of_cameras
+                      << " camera(s), " << resolution.width << "x" << resolution.height << ", "
+                      << (core_profile ? "core" : "compatibility") << " profile, " << output << ": "
+                      << r.captures_per_second << " captures/s, " << r.steps_per_second << " steps/s\n";
+        }
+        sofa::simulation::getSimulation()->unload(scene.root);
+    }
+
+    if (options.output.empty()) {
+        write_json(std::cout, results);
+    } else {
+        std::ofstream file(options.output);
+        write_json(file, results);
+    }
+
+    sofa::simulation::graph::cleanup();
+    return 0;
+}
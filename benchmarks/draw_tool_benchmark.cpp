@@ -0,0 +1,466 @@
+/**
+ * Microbenchmark of the drawing entry points of the draw tools of the OffscreenCamera.
+ *
+ * Every draw* overload of QtDrawToolGL (or of QtDrawToolGLCore with --core_profile) is run over a sweep of numbers
+ * of primitives, from 10 to 10^6, on an offscreen context. Each iteration draws the primitives with a new draw tool
+ * (as the camera does for every frame), flushes the queued instances and waits for the GPU with glFinish. The output
+ * mimics Google Benchmark, including its JSON format, so that its tools can compare two runs.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <QGuiApplication>
+#include <QMatrix4x4>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+
+#include <SofaOffscreenCamera/BatchRenderer.h>
+#include <SofaOffscreenCamera/GeometryCache.h>
+#include <SofaOffscreenCamera/GlewProxy.h>
+#include <SofaOffscreenCamera/QtDrawToolGL.h>
+#include <SofaOffscreenCamera/QtDrawToolGLCore.h>
+#include <SofaOffscreenCamera/VertexStream.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using sofa::helper::visual::DrawTool;
+using Vector3 = DrawTool::Vector3;
+using Vec2i = DrawTool::Vec2i;
+using Vec3i = DrawTool::Vec3i;
+using Vec3f = DrawTool::Vec3f;
+using RGBAColor = DrawTool::RGBAColor;
+using Quaternion = DrawTool::Quaternion;
+
+/** Inputs of the draw calls, generated for a number of primitives. */
+struct Inputs {
+    std::vector<Vector3> points;       ///< vertices_per_primitive points per primitive, plus two for the strips
+    std::vector<Vector3> normals;      ///< One per point
+    std::vector<RGBAColor> colors;     ///< One per point
+    std::vector<Vector3> face_normals; ///< One per primitive
+    std::vector<float> radii;          ///< One per primitive
+    std::vector<Vec2i> lines;          ///< One per primitive, indexing the points
+    std::vector<Vec3i> triangles;      ///< One per primitive, indexing the points
+};
+
+struct Case {
+    const char * name;
+    std::size_t vertices_per_primitive;
+    std::size_t max_primitives; ///< Largest number of primitives of the sweep, 0 for no limit
+    std::function<void(DrawTool &, const Inputs &, std::size_t)> draw;
+};
+
+struct Options {
+    std::string filter;
+    double min_time = 0.2; ///< Seconds
+    std::size_t max_primitives = 1000000;
+    bool core_profile = false;
+    std::string json;
+};
+
+struct Measure {
+    std::string name;
+    std::size_t iterations;
+    double milliseconds_per_iteration;
+    double primitives_per_second;
+};
+
+const RGBAColor color(0.2f, 0.6f, 0.9f, 1.f);
+const RGBAColor transparent_color(0.9f, 0.4f, 0.1f, 0.5f);
+
+const char * usage = R"(Usage: draw_tool_benchmark [options]
+
+  --filter=TEXT          Only run the cases whose name contains TEXT
+  --min_time=SECONDS     Minimum duration of the measure of a case and size (default: 0.2)
+  --max_primitives=N     Largest number of primitives of the sweeps (default: 1000000)
+  --core_profile         Measure QtDrawToolGLCore on a core-profile context instead of QtDrawToolGL
+  --json=FILE            Also write the results into FILE, in the JSON format of Google Benchmark
+)";
+
+Inputs make_inputs(std::size_t number_of_primitives, std::size_t vertices_per_primitive) {
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> coordinate(-0.9, 0.9);
+    std::uniform_real_distribution<float> channel(0.f, 1.f);
+
+    const auto number_of_points = number_of_primitives * vertices_per_primitive + 2;
+    std::uniform_int_distribution<int> index(0, static_cast<int>(number_of_points) - 1);
+    const auto random_point = [&]() { return Vector3(coordinate(generator), coordinate(generator), coordinate(generator)); };
+    const auto random_normal = [&]() { auto n = random_point(); n.normalize(); return n; };
+
+    Inputs inputs;
+    inputs.points.reserve(number_of_points);
+    inputs.normals.reserve(number_of_points);
+    inputs.colors.reserve(number_of_points);
+    for (std::size_t i = 0; i < number_of_points; ++i) {
+        inputs.points.push_back(random_point());
+        inputs.normals.push_back(random_normal());
+        inputs.colors.emplace_back(channel(generator), channel(generator), channel(generator), 1.f);
+    }
+    for (std::size_t i = 0; i < number_of_primitives; ++i) {
+        inputs.face_normals.push_back(random_normal());
+        inputs.radii.push_back(0.01f);
+        inputs.lines.emplace_back(index(generator), index(generator));
+        inputs.triangles.emplace_back(index(generator), index(generator), index(generator));
+    }
+    return inputs;
+}
+
+/** First count points of the inputs. */
+std::vector<Vector3> slice(const std::vector<Vector3> & points, std::size_t count) {
+    return {points.begin(), points.begin() + static_cast<std::ptrdiff_t>(count)};
+}
+
+std::vector<Case> make_cases() {
+    using I = const Inputs &;
+    using T = DrawTool &;
+    using N = std::size_t;
+    return {
+        // Points
+        {"drawPoint", 1, 0, [](T t, I in, N n) { for (N i = 0; i < n; ++i) t.drawPoint(in.points[i], color); }},
+        {"drawPoint/normal", 1, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawPoint(in.points[i], in.normals[i], color); }},
+        {"drawPoints", 1, 0, [](T t, I in, N n) { t.drawPoints(slice(in.points, n), 2, color); }},
+        {"drawPoints/colors", 1, 0, [](T t, I in, N n) { t.drawPoints(slice(in.points, n), 2, in.colors); }},
+
+        // Lines
+        {"drawLine", 2, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawLine(in.points[2*i], in.points[2*i+1], color); }},
+        {"drawInfiniteLine", 1, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawInfiniteLine(in.points[i], in.normals[i], color); }},
+        {"drawLines", 2, 0, [](T t, I in, N n) { t.drawLines(slice(in.points, 2*n), 1, color); }},
+        {"drawLines/colors", 2, 0, [](T t, I in, N n) { t.drawLines(slice(in.points, 2*n), 1, in.colors); }},
+        {"drawLines/indexed", 2, 0, [](T t, I in, N) { t.drawLines(in.points, in.lines, 1, color); }},
+        {"drawLineStrip", 1, 0, [](T t, I in, N n) { t.drawLineStrip(slice(in.points, n + 1), 1, color); }},
+        {"drawLineLoop", 1, 0, [](T t, I in, N n) { t.drawLineLoop(slice(in.points, n), 1, color); }},
+
+        // Triangles
+        {"drawTriangle/normal", 3, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawTriangle(in.points[3*i], in.points[3*i+1], in.points[3*i+2], in.face_normals[i]); }},
+        {"drawTriangle/color", 3, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawTriangle(in.points[3*i], in.points[3*i+1], in.points[3*i+2], in.face_normals[i], color); }},
+        {"drawTriangle/colors", 3, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawTriangle(in.points[3*i], in.points[3*i+1], in.points[3*i+2], in.face_normals[i],
+                               in.colors[3*i], in.colors[3*i+1], in.colors[3*i+2]); }},
+        {"drawTriangle/normals", 3, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawTriangle(in.points[3*i], in.points[3*i+1], in.points[3*i+2],
+                               in.normals[3*i], in.normals[3*i+1], in.normals[3*i+2],
+                               in.colors[3*i], in.colors[3*i+1], in.colors[3*i+2]); }},
+        {"drawTriangles", 3, 0, [](T t, I in, N n) { t.drawTriangles(slice(in.points, 3*n), color); }},
+        {"drawTriangles/transparent", 3, 0, [](T t, I in, N n) {
+            t.drawTriangles(slice(in.points, 3*n), transparent_color); }},
+        {"drawTriangles/colors", 3, 0, [](T t, I in, N n) { t.drawTriangles(slice(in.points, 3*n), in.colors); }},
+        {"drawTriangles/normal", 3, 0, [](T t, I in, N n) {
+            t.drawTriangles(slice(in.points, 3*n), in.face_normals[0], color); }},
+        {"drawTriangles/indexed", 3, 0, [](T t, I in, N) {
+            t.drawTriangles(in.points, in.triangles, in.face_normals, color); }},
+        {"drawTriangles/indexed_vertex_normals", 3, 0, [](T t, I in, N) {
+            t.drawTriangles(in.points, in.triangles, in.normals, color); }},
+        {"drawTriangles/normals_colors", 3, 0, [](T t, I in, N n) {
+            t.drawTriangles(slice(in.points, 3*n), in.face_normals, in.colors); }},
+        {"drawTriangleStrip", 1, 0, [](T t, I in, N n) {
+            t.drawTriangleStrip(slice(in.points, n + 2), in.normals, color); }},
+        {"drawTriangleFan", 1, 0, [](T t, I in, N n) {
+            t.drawTriangleFan(slice(in.points, n + 2), in.normals, color); }},
+
+        // Quads
+        {"drawQuad/normal", 4, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawQuad(in.points[4*i], in.points[4*i+1], in.points[4*i+2], in.points[4*i+3], in.face_normals[i]); }},
+        {"drawQuad/color", 4, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawQuad(in.points[4*i], in.points[4*i+1], in.points[4*i+2], in.points[4*i+3], in.face_normals[i],
+                           color); }},
+        {"drawQuad/colors", 4, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawQuad(in.points[4*i], in.points[4*i+1], in.points[4*i+2], in.points[4*i+3], in.face_normals[i],
+                           in.colors[4*i], in.colors[4*i+1], in.colors[4*i+2], in.colors[4*i+3]); }},
+        {"drawQuad/normals", 4, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawQuad(in.points[4*i], in.points[4*i+1], in.points[4*i+2], in.points[4*i+3],
+                           in.normals[4*i], in.normals[4*i+1], in.normals[4*i+2], in.normals[4*i+3],
+                           in.colors[4*i], in.colors[4*i+1], in.colors[4*i+2], in.colors[4*i+3]); }},
+        {"drawQuads", 4, 0, [](T t, I in, N n) { t.drawQuads(slice(in.points, 4*n), color); }},
+        {"drawQuads/colors", 4, 0, [](T t, I in, N n) { t.drawQuads(slice(in.points, 4*n), in.colors); }},
+
+        // Volumes
+        {"drawTetrahedron", 4, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawTetrahedron(in.points[4*i], in.points[4*i+1], in.points[4*i+2], in.points[4*i+3], color); }},
+        {"drawTetrahedra", 4, 0, [](T t, I in, N n) { t.drawTetrahedra(slice(in.points, 4*n), color); }},
+        {"drawScaledTetrahedron", 4, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawScaledTetrahedron(in.points[4*i], in.points[4*i+1], in.points[4*i+2], in.points[4*i+3],
+                                        color, 0.8f); }},
+        {"drawScaledTetrahedra", 4, 0, [](T t, I in, N n) {
+            t.drawScaledTetrahedra(slice(in.points, 4*n), color, 0.8f); }},
+        {"drawHexahedron", 8, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) {
+                const Vector3 * p = &in.points[8*i];
+                t.drawHexahedron(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], color);
+            }}},
+        {"drawHexahedra", 8, 0, [](T t, I in, N n) { t.drawHexahedra(slice(in.points, 8*n), color); }},
+        {"drawScaledHexahedra", 8, 0, [](T t, I in, N n) {
+            t.drawScaledHexahedra(slice(in.points, 8*n), color, 0.8f); }},
+
+        // Spheres
+        {"drawSphere", 1, 0, [](T t, I in, N n) { for (N i = 0; i < n; ++i) t.drawSphere(in.points[i], 0.01f); }},
+        {"drawSphere/color", 1, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawSphere(in.points[i], 0.01f, color); }},
+        {"drawSpheres", 1, 0, [](T t, I in, N n) { t.drawSpheres(slice(in.points, n), 0.01f, color); }},
+        {"drawSpheres/radii", 1, 0, [](T t, I in, N n) { t.drawSpheres(slice(in.points, n), in.radii, color); }},
+        {"drawFakeSpheres", 1, 0, [](T t, I in, N n) { t.drawFakeSpheres(slice(in.points, n), 0.01f, color); }},
+        {"drawFakeSpheres/radii", 1, 0, [](T t, I in, N n) {
+            t.drawFakeSpheres(slice(in.points, n), in.radii, color); }},
+
+        // Parametric primitives
+        {"drawArrow", 2, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawArrow(in.points[2*i], in.points[2*i+1], 0.01f, color, 16); }},
+        {"drawArrow/cone_length", 2, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawArrow(in.points[2*i], in.points[2*i+1], 0.01f, 0.05f, color, 16); }},
+        {"drawArrow/cone_radius", 2, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i)
+                t.drawArrow(in.points[2*i], in.points[2*i+1], 0.01f, 0.05f, 0.02f, color, 16); }},
+        {"drawCone", 2, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawCone(in.points[2*i], in.points[2*i+1], 0.02f, 0.01f, color, 16); }},
+        {"drawCylinder", 2, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawCylinder(in.points[2*i], in.points[2*i+1], 0.01f, color, 16); }},
+        {"drawCapsule", 2, 100000, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawCapsule(in.points[2*i], in.points[2*i+1], 0.01f, color, 16); }},
+        {"drawFrame", 1, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawFrame(in.points[i], Quaternion(), Vec3f(0.05f, 0.05f, 0.05f)); }},
+        {"drawFrame/color", 1, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawFrame(in.points[i], Quaternion(), Vec3f(0.05f, 0.05f, 0.05f), color); }},
+        {"drawCube", 1, 100000, [](T t, I, N n) { for (N i = 0; i < n; ++i) t.drawCube(0.01f, color, 16); }},
+        {"drawPlus", 1, 100000, [](T t, I, N n) { for (N i = 0; i < n; ++i) t.drawPlus(0.01f, color, 16); }},
+        {"drawCross", 1, 0, [](T t, I in, N n) { for (N i = 0; i < n; ++i) t.drawCross(in.points[i], 0.02f, color); }},
+        {"drawDisk", 1, 100000, [](T t, I, N n) { for (N i = 0; i < n; ++i) t.drawDisk(0.5f, 0, M_PI, 32, color); }},
+        {"drawCircle", 1, 100000, [](T t, I, N n) { for (N i = 0; i < n; ++i) t.drawCircle(0.5f, 1, 32, color); }},
+        {"drawBoundingBox", 2, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.drawBoundingBox(in.points[2*i], in.points[2*i+1], 1); }},
+
+        // Text
+        {"draw3DText", 1, 100000, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) t.draw3DText(in.points[i], 0.01f, color, "text"); }},
+        {"draw3DText_Indices", 1, 0, [](T t, I in, N n) { t.draw3DText_Indices(slice(in.points, n), 0.01f, color); }},
+        {"writeOverlayText", 1, 100000, [](T t, I, N n) {
+            for (N i = 0; i < n; ++i) t.writeOverlayText(10, 10, 16, color, "text"); }},
+
+        // State changes
+        {"setMaterial", 1, 0, [](T t, I in, N n) {
+            for (N i = 0; i < n; ++i) { t.setMaterial(in.colors[i]); t.resetMaterial(in.colors[i]); } }},
+        {"enableBlending", 1, 0, [](T t, I, N n) {
+            for (N i = 0; i < n; ++i) { t.enableBlending(); t.disableBlending(); } }},
+        {"enableLighting", 1, 0, [](T t, I, N n) {
+            for (N i = 0; i < n; ++i) { t.enableLighting(); t.disableLighting(); } }},
+        {"enablePolygonOffset", 1, 0, [](T t, I, N n) {
+            for (N i = 0; i < n; ++i) { t.enablePolygonOffset(1, 1); t.disablePolygonOffset(); } }},
+        {"saveLastState", 1, 0, [](T t, I, N n) {
+            for (N i = 0; i < n; ++i) { t.saveLastState(); t.restoreLastState(); } }},
+        {"pushMatrix", 1, 0, [](T t, I, N n) {
+            for (N i = 0; i < n; ++i) { t.pushMatrix(); t.translate(0.1f, 0, 0); t.scale(1.1f); t.popMatrix(); } }},
+    };
+}
+
+Options parse_options(int argc, char ** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const auto equal = argument.find('=');
+        const auto name = argument.substr(0, equal);
+        const auto value = equal == std::string::npos ? std::string() : argument.substr(equal + 1);
+        if (name == "--filter") {
+            options.filter = value;
+        } else if (name == "--min_time") {
+            options.min_time = std::stod(value);
+        } else if (name == "--max_primitives") {
+            options.max_primitives = std::stoul(value);
+        } else if (name == "--core_profile") {
+            options.core_profile = true;
+        } else if (name == "--json") {
+            options.json = value;
+        } else {
+            throw std::invalid_argument("Unknown argument '" + argument + "'.");
+        }
+    }
+    return options;
+}
+
+/** Offscreen context and framebuffer, set up as the OffscreenCamera does. */
+class Context {
+public:
+    explicit Context(bool core_profile) {
+        QSurfaceFormat format;
+        format.setRenderableType(QSurfaceFormat::OpenGL);
+        if (core_profile) {
+            format.setProfile(QSurfaceFormat::CoreProfile);
+        } else {
+            format.setProfile(QSurfaceFormat::CompatibilityProfile);
+            format.setOption(QSurfaceFormat::DeprecatedFunctions, true);
+        }
+        format.setVersion(3, 3);
+
+        p_surface.setFormat(format);
+        p_surface.create();
+        p_context.setFormat(format);
+        if (not p_context.create() or not p_context.makeCurrent(&p_surface)) {
+            throw std::runtime_error("Failed to create the OpenGL context.");
+        }
+        p_framebuffer = std::make_unique<QOpenGLFramebufferObject>(800, 600, QOpenGLFramebufferObject::Depth);
+        p_framebuffer->bind();
+        GlewProxy::init();
+
+        glViewport(0, 0, 800, 600);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+        if (not core_profile) {
+            glMatrixMode(GL_PROJECTION);
+            glLoadIdentity();
+            glOrtho(-1, 1, -1, 1, -10, 10);
+            glMatrixMode(GL_MODELVIEW);
+            glLoadIdentity();
+            glEnable(GL_LIGHTING);
+            glEnable(GL_LIGHT0);
+        }
+    }
+
+    ~Context() {
+        p_framebuffer.reset();
+        p_context.doneCurrent();
+    }
+
+    const char * renderer() const { return reinterpret_cast<const char *>(glGetString(GL_RENDERER)); }
+
+private:
+    QOffscreenSurface p_surface;
+    QOpenGLContext p_context;
+    std::unique_ptr<QOpenGLFramebufferObject> p_framebuffer;
+};
+
+/** Draw tools of the measured profile, with the objects they draw into. */
+class Tools {
+public:
+    explicit Tools(bool core_profile) {
+        if (core_profile)
+            p_stream = std::make_unique<sofa::helper::visual::VertexStream>();
+    }
+
+    std::unique_ptr<DrawTool> make_draw_tool() {
+        QMatrix4x4 projection;
+        projection.ortho(-1, 1, -1, 1, -10, 10);
+        if (p_stream)
+            return std::make_unique<sofa::helper::visual::QtDrawToolGLCore>(p_renderer, *p_stream, projection,
+                                                                           QMatrix4x4(), &p_geometry_cache);
+        return std::make_unique<sofa::helper::visual::QtDrawToolGL>(p_renderer, true, &p_geometry_cache);
+    }
+
+    /** Submit everything that has been queued by the draw tool, and wait for the GPU. */
+    void finish() {
+        if (p_stream)
+            p_stream->flush();
+        p_renderer.flush();
+        p_geometry_cache.end_frame();
+        glFinish();
+    }
+
+private:
+    sofa::helper::visual::BatchRenderer p_renderer;
+    sofa::helper::visual::GeometryCache p_geometry_cache;
+    std::unique_ptr<sofa::helper::visual::VertexStream> p_stream;
+};
+
+Measure measure(const Case & c, std::size_t n, Tools & tools, const Options & options) {
+    const auto inputs = make_inputs(n, c.vertices_per_primitive);
+    const auto iteration = [&]() {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        auto draw_tool = tools.make_draw_tool();
+        c.draw(*draw_tool, inputs, n);
+        tools.finish();
+    };
+
+    iteration(); // Warm-up: shader compilation, buffer allocations, ...
+
+    std::size_t iterations = 0;
+    const auto start = Clock::now();
+    std::chrono::duration<double> elapsed {};
+    do {
+        iteration();
+        ++iterations;
+        elapsed = Clock::now() - start;
+    } while (elapsed.count() < options.min_time);
+
+    const double seconds_per_iteration = elapsed.count() / static_cast<double>(iterations);
+    return {std::string(c.name) + "/" + std::to_string(n), iterations, seconds_per_iteration * 1e3,
+            static_cast<double>(n) / seconds_per_iteration};
+}
+
+void write_json(const std::string & filepath, const std::vector<Measure> & measures, const char * renderer,
+                bool core_profile) {
+    std::ofstream file(filepath);
+    file << "{\n  \"context\": {\"executable\": \"draw_tool_benchmark\", \"renderer\": \"" << renderer
+         << "\", \"core_profile\": " << (core_profile ? "true" : "false") << "},\n  \"benchmarks\": [";
+    for (std::size_t i = 0; i < measures.size(); ++i) {
+        const auto & m = measures[i];
+        file << (i ? "," : "") << "\n    {\"name\": \"" << m.name << "\", \"run_type\": \"iteration\", "
+             << "\"iterations\": " << m.iterations << ", \"real_time\": " << m.milliseconds_per_iteration
+             << ", \"cpu_time\": " << m.milliseconds_per_iteration << ", \"time_unit\": \"ms\", "
+             << "\"items_per_second\": " << m.primitives_per_second << "}";
+    }
+    file << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    if (argc > 1 and std::string(argv[1]) == "--help") {
+        std::cout << usage;
+        return 0;
+    }
+
+    Options options;
+    try {
+        options = parse_options(argc, argv);
+    } catch (const std::exception & e) {
+        std::cerr << e.what() << "\n\n" << usage;
+        return 1;
+    }
+
+    QGuiApplication application(argc, argv);
+    Context context(options.core_profile);
+    Tools tools(options.core_profile);
+    std::printf("Renderer: %s (%s profile)\n", context.renderer(), options.core_profile ? "core" : "compatibility");
+    std::printf("%-50s %14s %12s %16s\n", "Benchmark", "Time (ms)", "Iterations", "Primitives/s");
+
+    std::vector<Measure> measures;
+    for (const auto & c : make_cases()) {
+        if (std::string(c.name).find(options.filter) == std::string::npos)
+            continue;
+        const auto max_primitives = c.max_primitives ? std::min(c.max_primitives, options.max_primitives)
+                                                     : options.max_primitives;
+        for (std::size_t n = 10; n <= max_primitives; n *= 10) {
+            measures.push_back(measure(c, n, tools, options));
+            const auto & m = measures.back();
+            std::printf("%-50s %14.4f %12zu %16.4g\n", m.name.c_str(), m.milliseconds_per_iteration, m.iterations,
+                        m.primitives_per_second);
+            std::fflush(stdout);
+        }
+    }
+
+    if (not options.json.empty())
+        write_json(options.json, measures, context.renderer(), options.core_profile);
+
+    return 0;
+}
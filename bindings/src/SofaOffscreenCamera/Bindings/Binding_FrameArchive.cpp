@@ -0,0 +1,29 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <SofaOffscreenCamera/FrameArchive.h>
+
+namespace py = pybind11;
+
+void add_frame_archive_to_module(pybind11::module &m) {
+    py::class_<FrameArchiveEntry> e(m, "FrameArchiveEntry");
+    e.def_readonly("name", &FrameArchiveEntry::name);
+    e.def_readonly("offset", &FrameArchiveEntry::offset);
+    e.def_readonly("size", &FrameArchiveEntry::size);
+    e.def_readonly("step", &FrameArchiveEntry::step);
+    e.def_readonly("time", &FrameArchiveEntry::time);
+    e.def("__repr__", [](const FrameArchiveEntry & entry) {
+        return "FrameArchiveEntry(name='" + entry.name + "', step=" + std::to_string(entry.step)
+               + ", time=" + std::to_string(entry.time) + ", size=" + std::to_string(entry.size) + ")";
+    });
+
+    py::class_<FrameArchiveReader> c(m, "FrameArchive");
+    c.def(py::init<const std::string &>(), py::arg("filepath"));
+    c.def_property_readonly("entries", &FrameArchiveReader::entries);
+    c.def("__len__", [](const FrameArchiveReader & archive) { return archive.entries().size(); });
+    c.def("read", [](FrameArchiveReader & archive, std::size_t index) {
+        return py::bytes(archive.read(index));
+    }, py::arg("index"));
+    c.def("__getitem__", [](FrameArchiveReader & archive, std::size_t index) {
+        return py::bytes(archive.read(index));
+    }, py::arg("index"));
+}
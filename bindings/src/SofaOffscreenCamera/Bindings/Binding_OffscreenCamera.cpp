@@ -1,14 +1,258 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <SofaOffscreenCamera/CaptureWorker.h>
 #include <SofaOffscreenCamera/OffscreenCamera.h>
 #include <SofaPython3/Sofa/Core/Binding_Base.h>
 
 namespace py = pybind11;
 template <typename T> using py_shared_ptr = sofapython3::py_shared_ptr<T>;
 
+namespace {
+
+/**
+ * Python object handed to the threads of the camera, which only touch it with the GIL held. The callback completing a
+ * capture releases the objects it holds, so that the handles can be destroyed on any thread afterwards.
+ */
+using SharedObject = std::shared_ptr<py::object>;
+
+/** Name of the numpy dtype of the given component type, usable without the GIL. */
+const char * dtype_name(ComponentType type) {
+    switch (type) {
+        case ComponentType::UInt8: return "uint8";
+        case ComponentType::UInt16: return "uint16";
+        case ComponentType::Float16: return "float16";
+        case ComponentType::Float32: return "float32";
+    }
+    return "uint8";
+}
+
+py::dtype dtype_of(ComponentType type) {
+    return py::dtype(dtype_name(type));
+}
+
+std::vector<py::ssize_t> shape_of(int width, int height, int channels) {
+    std::vector<py::ssize_t> shape {height, width};
+    if (channels > 1) {
+        shape.push_back(channels);
+    }
+    return shape;
+}
+
+/** Allocate the array receiving the pixels of a frame into array, with the GIL held, and return its data. */
+void * allocate_array(py::object & array, int width, int height, int channels, ComponentType type) {
+    py::array pixels(dtype_of(type), shape_of(width, height, channels));
+    void * data = pixels.mutable_data();
+    array = std::move(pixels);
+    return data;
+}
+
+/**
+ * Array viewing a frame grabbed into a buffer of the camera, which holds the buffer until the array, its views and the
+ * tensors sharing its memory (through __dlpack__) are released. With the GIL held.
+ */
+py::array pooled_array(const OffscreenCamera::PooledFrame & frame) {
+    auto * buffer = new FrameBufferPool::Buffer(frame.pixels);
+    py::capsule owner(buffer, [](void * pointer) { delete static_cast<FrameBufferPool::Buffer *>(pointer); });
+    return py::array(dtype_of(frame.type), shape_of(frame.width, frame.height, frame.channels), frame.pixels->data(),
+                     owner);
+}
+
+/** Subset of the ABI of DLPack (dlpack.h), the tensors exchanged by __dlpack__, used to write frames into them. */
+enum DLDeviceType : std::int32_t { kDLCPU = 1, kDLCUDAHost = 3, kDLCUDAManaged = 13 };
+enum DLDataTypeCode : std::uint8_t { kDLUInt = 1, kDLFloat = 2 };
+struct DLDevice { std::int32_t device_type; std::int32_t device_id; };
+struct DLDataType { std::uint8_t code; std::uint8_t bits; std::uint16_t lanes; };
+struct DLTensor {
+    void * data;
+    DLDevice device;
+    std::int32_t ndim;
+    DLDataType dtype;
+    std::int64_t * shape;
+    std::int64_t * strides; ///< In elements, null for a compact row-major tensor
+    std::uint64_t byte_offset;
+};
+struct DLManagedTensor {
+    DLTensor dl_tensor;
+    void * manager_ctx;
+    void (*deleter)(DLManagedTensor * self);
+};
+
+/** Take the DLPack tensor of an object implementing __dlpack__, to be released by its deleter. With the GIL held. */
+std::unique_ptr<DLManagedTensor, void (*)(DLManagedTensor *)> consume_dlpack(const py::object & tensor) {
+    if (not py::hasattr(tensor, "__dlpack__")) {
+        throw py::type_error("The tensor must implement __dlpack__.");
+    }
+    py::object capsule = tensor.attr("__dlpack__")();
+    auto * managed = static_cast<DLManagedTensor *>(PyCapsule_GetPointer(capsule.ptr(), "dltensor"));
+    if (not managed) {
+        throw py::error_already_set();
+    }
+    // As the protocol requires, the consumer renames the capsule so that it no longer releases the tensor
+    PyCapsule_SetName(capsule.ptr(), "used_dltensor");
+    return {managed, [](DLManagedTensor * self) {
+        if (self->deleter) {
+            self->deleter(self);
+        }
+    }};
+}
+
+/** Why a frame of the given size and type cannot be written into the tensor, empty if it can. Without the GIL. */
+std::string check_tensor(const DLTensor & tensor, int width, int height, int channels, ComponentType type) {
+    const auto device = tensor.device.device_type;
+    if (device != kDLCPU and device != kDLCUDAHost and device != kDLCUDAManaged) {
+        return "The tensor must be in host memory (a CPU, pinned or managed tensor).";
+    }
+
+    DLDataType expected_type {kDLUInt, 8, 1};
+    switch (type) {
+        case ComponentType::UInt8: break;
+        case ComponentType::UInt16: expected_type = {kDLUInt, 16, 1}; break;
+        case ComponentType::Float16: expected_type = {kDLFloat, 16, 1}; break;
+        case ComponentType::Float32: expected_type = {kDLFloat, 32, 1}; break;
+    }
+    if (tensor.dtype.code != expected_type.code or tensor.dtype.bits != expected_type.bits or
+        tensor.dtype.lanes != expected_type.lanes) {
+        return std::string("The dtype of the tensor must be ") + dtype_name(type) + ".";
+    }
+
+    // Frames of a single channel fit either (height, width) or (height, width, 1) tensors
+    const std::vector<std::int64_t> shape(tensor.shape, tensor.shape + tensor.ndim);
+    const bool fits = (shape == std::vector<std::int64_t> {height, width, channels}) or
+                      (channels == 1 and shape == std::vector<std::int64_t> {height, width});
+    if (not fits) {
+        return "The shape of the tensor must be (" + std::to_string(height) + ", " + std::to_string(width) +
+               (channels > 1 ? ", " + std::to_string(channels) : std::string()) + ") for the frame.";
+    }
+
+    if (tensor.strides) {
+        std::int64_t stride = 1;
+        for (auto axis = tensor.ndim - 1; axis >= 0; --axis) {
+            if (tensor.shape[axis] > 1 and tensor.strides[axis] != stride) {
+                return "The tensor must be contiguous.";
+            }
+            stride *= tensor.shape[axis];
+        }
+    }
+    return {};
+}
+
+/** A concurrent.futures.Future, already running, to be completed by complete(). */
+SharedObject make_future() {
+    auto future = std::make_shared<py::object>(py::module::import("concurrent.futures").attr("Future")());
+    future->attr("set_running_or_notify_cancel")();
+    return future;
+}
+
+/** Set the result of the future, or a RuntimeError with the message if it failed, and release it. With the GIL held. */
+void complete(py::object & future, bool succeeded, const py::object & result, const std::string & message) {
+    if (succeeded) {
+        future.attr("set_result")(result);
+    } else {
+        future.attr("set_exception")(py::module::import("builtins").attr("RuntimeError")(message));
+    }
+    future = py::object();
+}
+
+} // namespace
+
 void add_offscreen_camera_to_module(pybind11::module &m) {
     using BaseCamera =  sofa::component::visualmodel::BaseCamera;
 
+    // The tasks completing the asynchronous captures take the GIL: a thread holding it must release it while waiting
+    // for them, including from the native paths reached from python (Sofa.Simulation.reset or unload, or the release
+    // of the last reference to a camera)
+    CaptureWorker::set_wait_guard([]() -> std::shared_ptr<void> {
+        if (not Py_IsInitialized() or not PyGILState_Check()) {
+            return nullptr;
+        }
+        return std::make_shared<py::gil_scoped_release>();
+    });
+
     py::class_< OffscreenCamera, BaseCamera, py_shared_ptr<OffscreenCamera> > c(m, "OffscreenCamera");
     c.def(py::init());
-    c.def("save_frame", &OffscreenCamera::save_frame, py::arg("filepath"));
-}
\ No newline at end of file
+
+    // The GIL is released while rendering, reading back, encoding and writing, and only taken back to allocate arrays
+    c.def("save_frame", &OffscreenCamera::save_frame, py::arg("filepath"), py::call_guard<py::gil_scoped_release>());
+    c.def("grab_frame", [](OffscreenCamera & camera) {
+        // The frame is read back straight into a buffer of the camera, viewed by the array
+        OffscreenCamera::PooledFrame frame;
+        {
+            py::gil_scoped_release release;
+            frame = camera.grab_pooled_frame();
+        }
+        return pooled_array(frame);
+    },
+    "Render the current frame and return it as an array of shape (height, width, channels) in the layout given by "
+    "'pixel_format', or (height, width) for 'gray'. Only the region of interest is returned, if any. The array is of "
+    "uint8, or of float16 or float32 with a floating-point 'color_format'. Its memory belongs to the camera, and is "
+    "reused by a later frame once the array, and the tensors sharing it through __dlpack__, are released.");
+    c.def("grab_frame_into", [](OffscreenCamera & camera, py::object tensor) {
+        // The frame is read back straight into the memory of the tensor, once its size is known to fit
+        auto managed = consume_dlpack(tensor);
+        std::string error;
+        {
+            py::gil_scoped_release release;
+            camera.grab_pixels([&managed, &error](int width, int height, int channels, ComponentType type) -> void * {
+                const auto & target = managed->dl_tensor;
+                error = check_tensor(target, width, height, channels, type);
+                return error.empty() ? static_cast<char *>(target.data) + target.byte_offset : nullptr;
+            });
+        }
+        if (not error.empty()) {
+            throw py::value_error(error);
+        }
+        return tensor;
+    }, py::arg("tensor"),
+    "Render the current frame and write it, as grab_frame returns it, into a writable tensor in host memory (CPU, "
+    "pinned or managed) of any library implementing __dlpack__, such as torch, cupy or numpy, without allocating "
+    "nor copying. The tensor must be contiguous and of the shape and dtype of the frame. Returns the tensor.");
+
+    c.def("save_frame_async", [](OffscreenCamera & camera, const std::string & filepath) {
+        auto future = make_future();
+        py::object result = *future;
+        {
+            py::gil_scoped_release release;
+            camera.save_frame_async(filepath, [future, filepath](bool saved) {
+                py::gil_scoped_acquire acquire;
+                complete(*future, saved, py::str(filepath), "Failed to save the frame '" + filepath + "'.");
+            });
+        }
+        return result;
+    }, py::arg("filepath"),
+    "Render the current frame now, and save it as save_frame does while python goes on. Returns a "
+    "concurrent.futures.Future whose result is the file path once the frame is written (use asyncio.wrap_future to "
+    "await it).");
+    c.def("grab_frame_async", [](OffscreenCamera & camera) {
+        auto future = make_future();
+        auto pixels = std::make_shared<py::object>();
+        py::object result = *future;
+        {
+            py::gil_scoped_release release;
+            camera.grab_pixels_async(
+                [pixels](int width, int height, int channels, ComponentType type) -> void * {
+                    py::gil_scoped_acquire acquire;
+                    try {
+                        return allocate_array(*pixels, width, height, channels, type);
+                    } catch (const py::error_already_set &) {
+                        return nullptr; // The frame is dropped and the future fails
+                    }
+                },
+                [future, pixels](bool grabbed) {
+                    py::gil_scoped_acquire acquire;
+                    complete(*future, grabbed, *pixels, "Failed to read the frame back.");
+                    *pixels = py::object();
+                });
+        }
+        return result;
+    },
+    "Render the current frame now, and read it back as grab_frame does while python goes on. Returns a "
+    "concurrent.futures.Future whose result is the array (use asyncio.wrap_future to await it).");
+
+    c.def("wait_for_pending_frames", &OffscreenCamera::wait_for_pending_frames,
+          py::call_guard<py::gil_scoped_release>());
+}
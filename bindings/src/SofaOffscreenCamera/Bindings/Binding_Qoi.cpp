@@ -0,0 +1,24 @@
+#include <cstring>
+#include <string_view>
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <SofaOffscreenCamera/Qoi.h>
+
+namespace py = pybind11;
+
+void add_qoi_to_module(pybind11::module &m) {
+    m.def("decode_qoi", [](const py::bytes & data) {
+        const std::string_view bytes = data;
+        QoiImage image;
+        {
+            py::gil_scoped_release release;
+            image = qoi_decode(reinterpret_cast<const std::uint8_t *>(bytes.data()), bytes.size());
+        }
+        py::array_t<std::uint8_t> pixels({image.height, image.width, image.channels});
+        std::memcpy(pixels.mutable_data(), image.pixels.data(), image.pixels.size());
+        return pixels;
+    }, py::arg("data"),
+    "Decode a QOI image, such as the frames saved by a camera whose 'filepath' ends with '.qoi', into an array of "
+    "shape (height, width, channels) of 8-bit RGB or RGBA pixels.");
+}
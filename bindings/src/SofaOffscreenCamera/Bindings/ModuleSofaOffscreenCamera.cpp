@@ -1,7 +1,11 @@
 #include <pybind11/pybind11.h>
 
+void add_frame_archive_to_module(pybind11::module &m);
 void add_offscreen_camera_to_module(pybind11::module &m);
+void add_qoi_to_module(pybind11::module &m);
 
 PYBIND11_MODULE(SofaOffscreenCamera, m) {
+    add_frame_archive_to_module(m);
     add_offscreen_camera_to_module(m);
+    add_qoi_to_module(m);
 }
\ No newline at end of file
@@ -0,0 +1,610 @@
+#include "BatchRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QVector2D>
+#include <QVector3D>
+
+#include <sofa/helper/logging/Messaging.h>
+
+namespace sofa::helper::visual {
+
+namespace {
+
+QOpenGLExtraFunctions * gl() {
+    return QOpenGLContext::currentContext()->extraFunctions();
+}
+
+void copy(float * destination, const sofa::type::Vector3 & v, float w) {
+    destination[0] = static_cast<float>(v[0]);
+    destination[1] = static_cast<float>(v[1]);
+    destination[2] = static_cast<float>(v[2]);
+    destination[3] = w;
+}
+
+void copy(float * destination, const sofa::type::RGBAColor & c) {
+    std::copy(c.array(), c.array() + 4, destination);
+}
+
+/** Cosines and sines of the subdivisions of the unit circle, first angle repeated at the end. */
+void unit_circle(int subdivisions, std::vector<float> & cosines, std::vector<float> & sines) {
+    cosines.resize(subdivisions + 1);
+    sines.resize(subdivisions + 1);
+    for (int i = 0; i <= subdivisions; ++i) {
+        const auto theta = static_cast<float>(i * 2.0 * M_PI / subdivisions);
+        cosines[i] = std::cos(theta);
+        sines[i] = std::sin(theta);
+    }
+}
+
+/**
+ * Append a tube of unit radius around the axis, made of two rings at t=0 and t=1, to the given unit mesh whose
+ * vertices are (cos(theta), sin(theta), t, part).
+ */
+void add_tube(const std::vector<float> & cosines, const std::vector<float> & sines, float part,
+              std::vector<float> & vertices, std::vector<unsigned int> & indices) {
+    const auto first = static_cast<unsigned int>(vertices.size() / 4);
+    for (std::size_t i = 0; i < cosines.size(); ++i) {
+        vertices.insert(vertices.end(), {cosines[i], sines[i], 0, part});
+        vertices.insert(vertices.end(), {cosines[i], sines[i], 1, part});
+    }
+    for (unsigned int i = 0; i + 1 < static_cast<unsigned int>(cosines.size()); ++i) {
+        const auto a = first + 2*i;
+        indices.insert(indices.end(), {a, a+1, a+2, a+1, a+3, a+2});
+    }
+}
+
+/** Append a unit disk at the given t to the given unit mesh whose vertices are (cos(theta), sin(theta), t, part). */
+void add_disk(const std::vector<float> & cosines, const std::vector<float> & sines, float t, float part,
+              std::vector<float> & vertices, std::vector<unsigned int> & indices) {
+    const auto center = static_cast<unsigned int>(vertices.size() / 4);
+    vertices.insert(vertices.end(), {0, 0, t, part});
+    for (std::size_t i = 0; i < cosines.size(); ++i) {
+        vertices.insert(vertices.end(), {cosines[i], sines[i], t, part});
+    }
+    for (unsigned int i = 0; i + 1 < static_cast<unsigned int>(cosines.size()); ++i) {
+        indices.insert(indices.end(), {center, center + 1 + i, center + 2 + i});
+    }
+}
+
+} // namespace
+
+BatchRenderer::BatchRenderer()
+: p_cone_program(ShaderLibrary::create(ShaderLibrary::Program::InstancedCone))
+, p_arrow_program(ShaderLibrary::create(ShaderLibrary::Program::InstancedArrow))
+, p_sphere_program(ShaderLibrary::create(ShaderLibrary::Program::SphereImpostor))
+, p_text_program(ShaderLibrary::create(ShaderLibrary::Program::GlyphText))
+, p_label_program(ShaderLibrary::create(ShaderLibrary::Program::IndexLabels))
+{
+    // Instanced attributes (glVertexAttribDivisor) are core since 3.3, an older context may still build the programs
+    const auto version = QOpenGLContext::currentContext()->format().version();
+    p_instancing = version >= qMakePair(3, 3);
+    if (not p_instancing) {
+        msg_warning("BatchRenderer") << "OpenGL " << version.first << "." << version.second << " has no instanced "
+                                     << "attributes, the primitives and the text will be drawn one at a time.";
+    }
+    if (not p_cone_program) {
+        msg_warning("BatchRenderer") << "Cones, cylinders and capsules will be rendered without instancing.";
+    }
+    if (not p_arrow_program) {
+        msg_warning("BatchRenderer") << "Arrows and frames will be rendered without instancing.";
+    }
+    if (not p_sphere_program) {
+        msg_warning("BatchRenderer") << "Spheres will be rendered without instancing.";
+    }
+    if (not p_text_program || not p_label_program) {
+        msg_error("BatchRenderer") << "Text, index labels and overlays will not be rendered.";
+    }
+}
+
+BatchRenderer::~BatchRenderer() = default;
+
+void BatchRenderer::set_state(const BatchRenderer::State & state) {
+    if (state != p_state) {
+        flush_geometry();
+        p_state = state;
+    }
+}
+
+void BatchRenderer::add_cone(const Vector3 & p1, const Vector3 & p2, float radius1, float radius2,
+                             const RGBAColor & color, int subdivisions, bool close_p1, bool close_p2) {
+    if ((p2 - p1).norm2() <= 0) {
+        return;
+    }
+
+    ConeInstance instance {};
+    copy(instance.base, p1, std::fabs(radius1));
+    copy(instance.tip, p2, std::fabs(radius2));
+    copy(instance.color, color);
+    instance.caps = (close_p1 ? 1.f : 0.f) + (close_p2 ? 2.f : 0.f);
+
+    const BatchKey key {std::max(subdivisions, 3), color.a() < 1};
+    p_pending_cones[key].emplace_back(instance);
+    p_has_pending_instances = true;
+    ++p_number_of_instances;
+}
+
+void BatchRenderer::add_arrow(const Vector3 & p1, const Vector3 & p2, float radius, float cone_length,
+                              float cone_radius, const RGBAColor & color, int subdivisions) {
+    if ((p2 - p1).norm2() <= 0) {
+        return;
+    }
+
+    ArrowInstance instance {};
+    copy(instance.tail, p1, std::fabs(radius));
+    copy(instance.head, p2, std::fabs(cone_radius));
+    copy(instance.color, color);
+    instance.cone_length = std::fabs(cone_length);
+
+    const BatchKey key {std::max(subdivisions, 3), color.a() < 1};
+    p_pending_arrows[key].emplace_back(instance);
+    p_has_pending_instances = true;
+    ++p_number_of_instances;
+}
+
+void BatchRenderer::add_spheres(const std::vector<Vector3> & points, const std::vector<float> & radii,
+                                const RGBAColor & color) {
+    if (points.empty() || radii.empty()) {
+        return;
+    }
+
+    const bool one_radius_per_point = (radii.size() == points.size());
+    auto & instances = p_pending_spheres[color.a() < 1 ? 1 : 0];
+    const auto first = instances.size();
+    instances.resize(first + points.size());
+
+    for (std::size_t i = 0; i < points.size(); ++i) {
+        auto & instance = instances[first + i];
+        copy(instance.sphere, points[i], std::fabs(one_radius_per_point ? radii[i] : radii[0]));
+        copy(instance.color, color);
+    }
+
+    p_has_pending_instances = true;
+    p_number_of_instances += points.size();
+}
+
+void BatchRenderer::add_sphere(const Vector3 & center, float radius, const RGBAColor & color) {
+    SphereInstance instance {};
+    copy(instance.sphere, center, std::fabs(radius));
+    copy(instance.color, color);
+    p_pending_spheres[color.a() < 1 ? 1 : 0].emplace_back(instance);
+    p_has_pending_instances = true;
+    ++p_number_of_instances;
+}
+
+void BatchRenderer::add_text(const Vector3 & position, float height, const RGBAColor & color, const char * text) {
+    if (text == nullptr) {
+        return;
+    }
+
+    const QVector3D eye_position = p_state.modelview.map(QVector3D(position[0], position[1], position[2]));
+    const float scale = QVector3D(p_state.modelview.column(0)).length();
+    const float anchor[4] = {eye_position.x(), eye_position.y(), eye_position.z(), height * scale};
+    append_glyphs(anchor, color, text, p_pending_glyphs);
+    p_text_projection = p_state.projection;
+}
+
+void BatchRenderer::add_index_labels(const std::vector<Vector3> & positions, float height, const RGBAColor & color) {
+    const float scale = QVector3D(p_state.modelview.column(0)).length();
+    const auto first = p_pending_labels.size();
+    p_pending_labels.resize(first + positions.size());
+
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+        const auto & p = positions[i];
+        const QVector3D eye_position = p_state.modelview.map(QVector3D(p[0], p[1], p[2]));
+        auto & instance = p_pending_labels[first + i];
+        instance.anchor[0] = eye_position.x();
+        instance.anchor[1] = eye_position.y();
+        instance.anchor[2] = eye_position.z();
+        instance.anchor[3] = height * scale;
+        copy(instance.color, color);
+        instance.index = static_cast<GLuint>(i);
+    }
+
+    p_text_projection = p_state.projection;
+    p_number_of_instances += positions.size();
+}
+
+void BatchRenderer::add_overlay_text(int x, int y, float height, const RGBAColor & color, const char * text) {
+    if (text == nullptr) {
+        return;
+    }
+
+    const float anchor[4] = {static_cast<float>(x), static_cast<float>(y), 0.f, height};
+    append_glyphs(anchor, color, text, p_pending_overlay_glyphs);
+}
+
+void BatchRenderer::append_glyphs(const float anchor[4], const RGBAColor & color, const char * text,
+                                  std::vector<GlyphInstance> & instances) {
+    GlyphInstance instance {};
+    std::copy(anchor, anchor + 4, instance.anchor);
+    copy(instance.color, color);
+
+    int column = 0, line = 0;
+    for (const char * c = text; *c != '\0'; ++c) {
+        if (*c == '\n') {
+            column = 0;
+            ++line;
+            continue;
+        }
+
+        int character = static_cast<unsigned char>(*c);
+        if (character < GlyphAtlas::first_character || character >= GlyphAtlas::first_character + GlyphAtlas::number_of_characters) {
+            character = '?';
+        }
+
+        if (character != ' ') {
+            instance.glyph[0] = static_cast<float>(character);
+            instance.glyph[1] = static_cast<float>(column);
+            instance.glyph[2] = static_cast<float>(line);
+            instances.emplace_back(instance);
+        }
+        ++column;
+    }
+}
+
+void BatchRenderer::flush() {
+    flush_geometry();
+    draw_text();
+}
+
+void BatchRenderer::flush_geometry() {
+    if (not p_has_pending_instances) {
+        return;
+    }
+
+    // Keep the blending state of the caller, the transparent instances are blended without writing into the depth
+    // buffer as it is done by QtDrawToolGL::setMaterial
+    const GLboolean blending_was_enabled = gl()->glIsEnabled(GL_BLEND);
+    GLboolean depth_mask_was_enabled = GL_TRUE;
+    gl()->glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask_was_enabled);
+
+    // Draw all the opaque batches first
+    for (const bool transparent : {false, true}) {
+        if (transparent) {
+            gl()->glEnable(GL_BLEND);
+            gl()->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            gl()->glDepthMask(GL_FALSE);
+        }
+
+        draw_cones(transparent);
+        draw_arrows(transparent);
+        draw_spheres(transparent);
+    }
+
+    if (blending_was_enabled) gl()->glEnable(GL_BLEND);
+    else                      gl()->glDisable(GL_BLEND);
+    gl()->glDepthMask(depth_mask_was_enabled);
+
+    p_pending_cones.clear();
+    p_pending_arrows.clear();
+    for (auto & instances : p_pending_spheres) {
+        instances.clear();
+    }
+    p_has_pending_instances = false;
+}
+
+void BatchRenderer::draw_text() {
+    if (p_pending_glyphs.empty() && p_pending_labels.empty() && p_pending_overlay_glyphs.empty()) {
+        return;
+    }
+
+    if (not p_text_program || not p_label_program) {
+        p_pending_glyphs.clear();
+        p_pending_labels.clear();
+        p_pending_overlay_glyphs.clear();
+        return;
+    }
+
+    // The glyphs are blended on their anti-aliased edges, and must not hide what is drawn behind them afterward
+    const GLboolean blending_was_enabled = gl()->glIsEnabled(GL_BLEND);
+    const GLboolean depth_test_was_enabled = gl()->glIsEnabled(GL_DEPTH_TEST);
+    GLboolean depth_mask_was_enabled = GL_TRUE;
+    gl()->glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask_was_enabled);
+    gl()->glEnable(GL_BLEND);
+    gl()->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl()->glDepthMask(GL_FALSE);
+
+    // Before OpenGL 3.3, draw_instances draws each character with its own draw call, the label index being set as an
+    // integer constant attribute
+    auto & glyphs = atlas();
+    glyphs.texture().bind(0);
+
+    auto bind_text_program = [&glyphs](QOpenGLShaderProgram & program) {
+        program.bind();
+        program.setUniformValue("u_atlas", 0);
+        program.setUniformValue("u_atlas_grid", QVector2D(GlyphAtlas::columns(), GlyphAtlas::rows()));
+        program.setUniformValue("u_aspect_ratio", glyphs.aspect_ratio());
+    };
+
+    if (not p_pending_glyphs.empty()) {
+        bind_text_program(*p_text_program);
+        p_text_program->setUniformValue("u_projection", p_text_projection);
+        p_text_program->setUniformValue("u_overlay", false);
+        draw_instances(glyph_mesh(), p_pending_glyphs);
+        p_text_program->release();
+    }
+
+    if (not p_pending_labels.empty()) {
+        bind_text_program(*p_label_program);
+        p_label_program->setUniformValue("u_projection", p_text_projection);
+        draw_instances(label_mesh(), p_pending_labels);
+        p_label_program->release();
+    }
+
+    if (not p_pending_overlay_glyphs.empty()) {
+        GLint viewport[4];
+        gl()->glGetIntegerv(GL_VIEWPORT, viewport);
+        gl()->glDisable(GL_DEPTH_TEST);
+        bind_text_program(*p_text_program);
+        p_text_program->setUniformValue("u_overlay", true);
+        p_text_program->setUniformValue("u_viewport", QVector2D(viewport[2], viewport[3]));
+        draw_instances(glyph_mesh(), p_pending_overlay_glyphs);
+        p_text_program->release();
+    }
+
+    glyphs.texture().release(0);
+
+    if (blending_was_enabled)   gl()->glEnable(GL_BLEND);
+    else                        gl()->glDisable(GL_BLEND);
+    if (depth_test_was_enabled) gl()->glEnable(GL_DEPTH_TEST);
+    else                        gl()->glDisable(GL_DEPTH_TEST);
+    gl()->glDepthMask(depth_mask_was_enabled);
+
+    p_number_of_instances += p_pending_glyphs.size() + p_pending_overlay_glyphs.size();
+    p_pending_glyphs.clear();
+    p_pending_labels.clear();
+    p_pending_overlay_glyphs.clear();
+}
+
+void BatchRenderer::bind(QOpenGLShaderProgram & program) const {
+    program.bind();
+    program.setUniformValue("u_projection", p_state.projection);
+    program.setUniformValue("u_modelview", p_state.modelview);
+    program.setUniformValue("u_normal_matrix", p_state.modelview.normalMatrix());
+    program.setUniformValue("u_lighting", p_state.lighting);
+}
+
+template <typename Instance>
+void BatchRenderer::draw_instances(Mesh & mesh, const std::vector<Instance> & instances) {
+    QOpenGLVertexArrayObject::Binder binder(&mesh.vao);
+    if (not p_instancing) {
+        for (const auto & instance : instances) {
+            set_instance_attributes(mesh, reinterpret_cast<const char *>(&instance));
+            gl()->glDrawElements(GL_TRIANGLES, mesh.number_of_indices, GL_UNSIGNED_INT, nullptr);
+        }
+        p_number_of_draw_calls += instances.size();
+        return;
+    }
+
+    mesh.instances.bind();
+    mesh.instances.allocate(instances.data(), static_cast<int>(instances.size() * sizeof(Instance)));
+    gl()->glDrawElementsInstanced(GL_TRIANGLES, mesh.number_of_indices, GL_UNSIGNED_INT, nullptr,
+                                  static_cast<GLsizei>(instances.size()));
+    ++p_number_of_draw_calls;
+}
+
+void BatchRenderer::set_instance_attributes(const Mesh & mesh, const char * record) {
+    // The components missing from the record take the same (0, 0, 0, 1) defaults as with an attribute array
+    unsigned int location = ShaderLibrary::Instance0;
+    for (const auto & attribute : mesh.instance_layout) {
+        if (attribute.type == GL_FLOAT) {
+            GLfloat value[4] = {0, 0, 0, 1};
+            std::memcpy(value, record + attribute.offset, attribute.size * sizeof(GLfloat));
+            gl()->glVertexAttrib4fv(location, value);
+        } else {
+            GLuint value[4] = {0, 0, 0, 1};
+            std::memcpy(value, record + attribute.offset, attribute.size * sizeof(GLuint));
+            gl()->glVertexAttribI4uiv(location, value);
+        }
+        ++location;
+    }
+}
+
+void BatchRenderer::draw_cones(bool transparent) {
+    if (not p_cone_program) {
+        return;
+    }
+
+    bool bound = false;
+    for (auto & [key, instances] : p_pending_cones) {
+        if (key.second != transparent || instances.empty())
+            continue;
+
+        if (not bound) {
+            bind(*p_cone_program);
+            bound = true;
+        }
+        draw_instances(cone_mesh(key.first), instances);
+    }
+
+    if (bound) {
+        p_cone_program->release();
+    }
+}
+
+void BatchRenderer::draw_arrows(bool transparent) {
+    if (not p_arrow_program) {
+        return;
+    }
+
+    bool bound = false;
+    for (auto & [key, instances] : p_pending_arrows) {
+        if (key.second != transparent || instances.empty())
+            continue;
+
+        if (not bound) {
+            bind(*p_arrow_program);
+            bound = true;
+        }
+        draw_instances(arrow_mesh(key.first), instances);
+    }
+
+    if (bound) {
+        p_arrow_program->release();
+    }
+}
+
+void BatchRenderer::draw_spheres(bool transparent) {
+    const auto & instances = p_pending_spheres[transparent ? 1 : 0];
+    if (not p_sphere_program || instances.empty()) {
+        return;
+    }
+
+    bind(*p_sphere_program);
+    p_sphere_program->setUniformValue("u_perspective", p_state.projection(3, 3) == 0.f);
+    draw_instances(sphere_mesh(), instances);
+    p_sphere_program->release();
+}
+
+std::unique_ptr<BatchRenderer::Mesh> BatchRenderer::create_mesh(
+    const std::vector<float> & vertices, const std::vector<unsigned int> & indices, int instance_stride,
+    const std::vector<InstanceAttribute> & instance_layout) const {
+    auto mesh = std::make_unique<Mesh>();
+    mesh->number_of_indices = static_cast<int>(indices.size());
+    mesh->instance_layout = instance_layout;
+    mesh->vao.create();
+    {
+        QOpenGLVertexArrayObject::Binder binder(&mesh->vao);
+
+        mesh->vertices.create();
+        mesh->vertices.bind();
+        mesh->vertices.allocate(vertices.data(), static_cast<int>(vertices.size() * sizeof(float)));
+        gl()->glEnableVertexAttribArray(ShaderLibrary::Vertex);
+        gl()->glVertexAttribPointer(ShaderLibrary::Vertex, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        mesh->indices.create();
+        mesh->indices.bind();
+        mesh->indices.allocate(indices.data(), static_cast<int>(indices.size() * sizeof(unsigned int)));
+
+        // Without instanced attributes, the instance attributes are set as constants before each draw call instead
+        if (p_instancing) {
+            mesh->instances.create();
+            mesh->instances.setUsagePattern(QOpenGLBuffer::StreamDraw);
+            mesh->instances.bind();
+            unsigned int location = ShaderLibrary::Instance0;
+            for (const auto & attribute : instance_layout) {
+                gl()->glEnableVertexAttribArray(location);
+                if (attribute.type == GL_FLOAT) {
+                    gl()->glVertexAttribPointer(location, attribute.size, GL_FLOAT, GL_FALSE, instance_stride,
+                                                reinterpret_cast<const void *>(attribute.offset));
+                } else {
+                    gl()->glVertexAttribIPointer(location, attribute.size, attribute.type, instance_stride,
+                                                 reinterpret_cast<const void *>(attribute.offset));
+                }
+                gl()->glVertexAttribDivisor(location, 1);
+                ++location;
+            }
+            mesh->instances.release();
+        }
+    }
+    mesh->vertices.release();
+
+    return mesh;
+}
+
+BatchRenderer::Mesh & BatchRenderer::cone_mesh(int subdivisions) {
+    auto & mesh = p_cone_meshes[subdivisions];
+    if (mesh) {
+        return *mesh;
+    }
+
+    // Unit cone: each vertex is (cos(theta), sin(theta), t, cap) where t is 0 at p1 and 1 at p2, and cap is 1 for
+    // the vertices of the two closing disks. The actual geometry is built by the vertex shader from the instance.
+    std::vector<float> cosines, sines, vertices;
+    std::vector<unsigned int> indices;
+    unit_circle(subdivisions, cosines, sines);
+    add_tube(cosines, sines, 0, vertices, indices);
+    add_disk(cosines, sines, 0, 1, vertices, indices);
+    add_disk(cosines, sines, 1, 1, vertices, indices);
+
+    mesh = create_mesh(vertices, indices, sizeof(ConeInstance), {
+        {4, offsetof(ConeInstance, base)},
+        {4, offsetof(ConeInstance, tip)},
+        {4, offsetof(ConeInstance, color)},
+        {1, offsetof(ConeInstance, caps)}
+    });
+    return *mesh;
+}
+
+BatchRenderer::Mesh & BatchRenderer::arrow_mesh(int subdivisions) {
+    auto & mesh = p_arrow_meshes[subdivisions];
+    if (mesh) {
+        return *mesh;
+    }
+
+    // Unit arrow: each vertex is (cos(theta), sin(theta), t, part) where part is 0 for the shaft, 1 for the disk
+    // closing the tail, 2 for the cone and 3 for the base of the cone (see the instanced arrow vertex shader).
+    std::vector<float> cosines, sines, vertices;
+    std::vector<unsigned int> indices;
+    unit_circle(subdivisions, cosines, sines);
+    add_tube(cosines, sines, 0, vertices, indices);
+    add_disk(cosines, sines, 0, 1, vertices, indices);
+    add_tube(cosines, sines, 2, vertices, indices);
+    add_disk(cosines, sines, 0, 3, vertices, indices);
+
+    mesh = create_mesh(vertices, indices, sizeof(ArrowInstance), {
+        {4, offsetof(ArrowInstance, tail)},
+        {4, offsetof(ArrowInstance, head)},
+        {4, offsetof(ArrowInstance, color)},
+        {1, offsetof(ArrowInstance, cone_length)}
+    });
+    return *mesh;
+}
+
+BatchRenderer::Mesh & BatchRenderer::sphere_mesh() {
+    if (not p_sphere_mesh) {
+        // Unit quad, expanded around the sphere by the vertex shader
+        p_sphere_mesh = create_mesh(
+            {-1, -1, 0, 0,   1, -1, 0, 0,   1, 1, 0, 0,   -1, 1, 0, 0},
+            {0, 1, 2, 0, 2, 3},
+            sizeof(SphereInstance), {
+                {4, offsetof(SphereInstance, sphere)},
+                {4, offsetof(SphereInstance, color)}
+            });
+    }
+    return *p_sphere_mesh;
+}
+
+BatchRenderer::Mesh & BatchRenderer::glyph_mesh() {
+    if (not p_glyph_mesh) {
+        p_glyph_mesh = create_mesh(
+            {-1, -1, 0, 0,   1, -1, 0, 0,   1, 1, 0, 0,   -1, 1, 0, 0},
+            {0, 1, 2, 0, 2, 3},
+            sizeof(GlyphInstance), {
+                {4, offsetof(GlyphInstance, anchor)},
+                {4, offsetof(GlyphInstance, color)},
+                {3, offsetof(GlyphInstance, glyph)}
+            });
+    }
+    return *p_glyph_mesh;
+}
+
+BatchRenderer::Mesh & BatchRenderer::label_mesh() {
+    if (not p_label_mesh) {
+        p_label_mesh = create_mesh(
+            {-1, -1, 0, 0,   1, -1, 0, 0,   1, 1, 0, 0,   -1, 1, 0, 0},
+            {0, 1, 2, 0, 2, 3},
+            sizeof(LabelInstance), {
+                {4, offsetof(LabelInstance, anchor)},
+                {4, offsetof(LabelInstance, color)},
+                {1, offsetof(LabelInstance, index), GL_UNSIGNED_INT}
+            });
+    }
+    return *p_label_mesh;
+}
+
+GlyphAtlas & BatchRenderer::atlas() {
+    // Rasterizing the font takes a few milliseconds, only do it for cameras that actually draw text
+    if (not p_atlas) {
+        p_atlas = std::make_unique<GlyphAtlas>();
+    }
+    return *p_atlas;
+}
+
+} // namespace sofa::helper::visual
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <QMatrix4x4>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+
+#include <sofa/type/RGBAColor.h>
+#include <sofa/type/Vec.h>
+
+#include "GlyphAtlas.h"
+#include "ShaderLibrary.h"
+
+namespace sofa::helper::visual {
+
+/**
+ * Instanced renderer of the parametric primitives of the draw tool (cones, cylinders, spheres, arrows, ...) and of
+ * its text.
+ *
+ * The unit mesh of each primitive is generated once per subdivision count and kept on the GPU for the lifetime of
+ * the renderer. Every draw call only appends a small per-instance record (end points, radii, color) to a pending
+ * batch, and all the instances sharing the same transformation and lighting state are submitted with a single
+ * instanced draw call when the batch is flushed.
+ *
+ * Text is drawn from a glyph atlas rasterized once. Since the labels are transformed into eye space when they are
+ * added, a change of state does not flush them: all the labels of a frame are drawn together with one instanced
+ * draw call for the characters, one for the index labels and one for the overlays.
+ *
+ * Instanced attributes require OpenGL 3.3. On an older context, the batches are still sorted the same way but each
+ * instance is drawn with a draw call of its own: every character of the text and every index label then costs one
+ * draw call, which the text cannot avoid since it has no immediate-mode fallback in the draw tools.
+ *
+ * The renderer owns OpenGL objects: it must be created and destroyed while the OpenGL context it will be used with
+ * is current. It is meant to live as long as its camera, so the unit meshes survive from one frame to the next.
+ */
+class BatchRenderer {
+public:
+    using Vector3 = sofa::type::Vector3;
+    using RGBAColor = sofa::type::RGBAColor;
+
+    /**
+     * Render state captured when instances are added. Instances are only batched together when they share the
+     * same state, any change of state flushes the pending instances first.
+     */
+    struct State {
+        QMatrix4x4 projection;
+        QMatrix4x4 modelview;
+        bool lighting = true;
+
+        bool operator==(const State & other) const {
+            return lighting == other.lighting && modelview == other.modelview && projection == other.projection;
+        }
+        bool operator!=(const State & other) const { return not (*this == other); }
+    };
+
+    BatchRenderer();
+    ~BatchRenderer();
+
+    /**
+     * Set the render state of the instances added hereafter. Pending instances are flushed if the state changed.
+     */
+    void set_state(const State & state);
+
+    /**
+     * Whether the cones are rendered as instances, false if the context is older than OpenGL 3.3 or if their program
+     * could not be built. Without instanced attributes, the cones added anyway are drawn with one draw call each, and
+     * they are dropped if their program could not be built. The compatibility draw tool rather draws them by itself.
+     */
+    bool has_cone_instancing() const { return p_instancing and p_cone_program; }
+
+    /** Whether the arrows are rendered as instances, see has_cone_instancing. */
+    bool has_arrow_instancing() const { return p_instancing and p_arrow_program; }
+
+    /** Whether the spheres are rendered as instances, see has_cone_instancing. */
+    bool has_sphere_instancing() const { return p_instancing and p_sphere_program; }
+
+    /**
+     * Add a (possibly truncated) cone going from p1 to p2. The ends of the cone are closed with a disk when their
+     * respective flag is set.
+     */
+    void add_cone(const Vector3 & p1, const Vector3 & p2, float radius1, float radius2, const RGBAColor & color,
+                  int subdivisions, bool close_p1, bool close_p2);
+
+    /**
+     * Add an arrow going from p1 to p2, made of a cylindrical shaft of the given radius and a cone of the given
+     * length and base radius ending at p2.
+     */
+    void add_arrow(const Vector3 & p1, const Vector3 & p2, float radius, float cone_length, float cone_radius,
+                   const RGBAColor & color, int subdivisions);
+
+    /**
+     * Add one sphere per point. The spheres are ray-casted on screen-aligned quads and write their exact depth.
+     * When radii holds one value per point, each sphere gets its own radius, otherwise they all use the first one.
+     */
+    void add_spheres(const std::vector<Vector3> & points, const std::vector<float> & radii, const RGBAColor & color);
+
+    /** Add a single ray-casted sphere. */
+    void add_sphere(const Vector3 & center, float radius, const RGBAColor & color);
+
+    /**
+     * Add a text whose top-left corner is at the given position, facing the eye. The height of a line is in the
+     * same units as the position. Lines are separated by '\n', and characters outside the printable ASCII range are
+     * drawn as '?'.
+     */
+    void add_text(const Vector3 & position, float height, const RGBAColor & color, const char * text);
+
+    /** Add one label per position, centered on the position and showing the index of the position. */
+    void add_index_labels(const std::vector<Vector3> & positions, float height, const RGBAColor & color);
+
+    /**
+     * Add a text overlaid on top of the frame. Its top-left corner is at (x, y) pixels from the top-left corner of
+     * the viewport, and the height of a line is given in pixels.
+     */
+    void add_overlay_text(int x, int y, float height, const RGBAColor & color, const char * text);
+
+    /**
+     * Submit every pending instance to OpenGL. Must be called at the latest before the frame is read back.
+     */
+    void flush();
+
+    /** Number of instances queued since the renderer was created. */
+    std::size_t number_of_instances() const { return p_number_of_instances; }
+
+    /** Number of draw calls submitted since the renderer was created. */
+    std::size_t number_of_draw_calls() const { return p_number_of_draw_calls; }
+
+private:
+    struct ConeInstance {
+        float base[4];  // p1, radius1
+        float tip[4];   // p2, radius2
+        float color[4];
+        float caps;
+    };
+
+    struct ArrowInstance {
+        float tail[4]; // p1, shaft radius
+        float head[4]; // p2, cone radius
+        float color[4];
+        float cone_length;
+    };
+
+    struct SphereInstance {
+        float sphere[4]; // center, radius
+        float color[4];
+    };
+
+    struct GlyphInstance {
+        float anchor[4]; // top-left corner of the text, height of a line
+        float color[4];
+        float glyph[3];  // character, column, line
+    };
+
+    struct LabelInstance {
+        float anchor[4]; // center of the label, height
+        float color[4];
+        GLuint index;    // exact above 2^24, unlike a float
+    };
+
+    /**
+     * Per-instance attribute: number of components, byte offset within the instance record and type of the components.
+     * Integer types are passed to the shader as integers.
+     */
+    struct InstanceAttribute {
+        int size;
+        std::size_t offset;
+        GLenum type = GL_FLOAT;
+    };
+
+    struct Mesh {
+        QOpenGLVertexArrayObject vao;
+        QOpenGLBuffer vertices {QOpenGLBuffer::VertexBuffer};
+        QOpenGLBuffer indices {QOpenGLBuffer::IndexBuffer};
+        QOpenGLBuffer instances {QOpenGLBuffer::VertexBuffer};
+        int number_of_indices = 0;
+        std::vector<InstanceAttribute> instance_layout; // Kept to set the attributes one instance at a time
+    };
+
+    /** Key of a pending batch: subdivision count of the unit mesh and whether its instances are transparent. */
+    using BatchKey = std::pair<int, bool>;
+
+    /**
+     * Create the mesh and its instance buffer. Without instanced attributes, the instance buffer is left empty and
+     * the per-instance attributes are set as constant attributes before each draw call instead.
+     */
+    std::unique_ptr<Mesh> create_mesh(const std::vector<float> & vertices,
+                                      const std::vector<unsigned int> & indices,
+                                      int instance_stride,
+                                      const std::vector<InstanceAttribute> & instance_layout) const;
+
+    Mesh & cone_mesh(int subdivisions);
+    Mesh & arrow_mesh(int subdivisions);
+    Mesh & sphere_mesh();
+    Mesh & glyph_mesh();
+    Mesh & label_mesh();
+    GlyphAtlas & atlas();
+
+    /** Append the instances of the characters of the text to the given batch. */
+    static void append_glyphs(const float anchor[4], const RGBAColor & color, const char * text,
+                              std::vector<GlyphInstance> & instances);
+
+    /** Submit the pending geometry (everything but the text) with the current state. */
+    void flush_geometry();
+
+    /** Bind the program and upload the matrices and lighting of the current state. */
+    void bind(QOpenGLShaderProgram & program) const;
+
+    /**
+     * Upload the instances into the mesh's instance buffer and draw them, or draw them one at a time without
+     * instanced attributes.
+     */
+    template <typename Instance>
+    void draw_instances(Mesh & mesh, const std::vector<Instance> & instances);
+
+    /** Set the attributes of the given instance record as constant vertex attributes. */
+    static void set_instance_attributes(const Mesh & mesh, const char * record);
+
+    void draw_cones(bool transparent);
+    void draw_arrows(bool transparent);
+    void draw_spheres(bool transparent);
+    void draw_text();
+
+    State p_state;
+    bool p_instancing = false; ///< Whether the context has instanced attributes (OpenGL 3.3)
+    std::unique_ptr<QOpenGLShaderProgram> p_cone_program;
+    std::unique_ptr<QOpenGLShaderProgram> p_arrow_program;
+    std::unique_ptr<QOpenGLShaderProgram> p_sphere_program;
+    std::unique_ptr<QOpenGLShaderProgram> p_text_program;
+    std::unique_ptr<QOpenGLShaderProgram> p_label_program;
+    std::unique_ptr<GlyphAtlas> p_atlas;
+    std::map<int, std::unique_ptr<Mesh>> p_cone_meshes;
+    std::map<int, std::unique_ptr<Mesh>> p_arrow_meshes;
+    std::unique_ptr<Mesh> p_sphere_mesh;
+    std::unique_ptr<Mesh> p_glyph_mesh;
+    std::unique_ptr<Mesh> p_label_mesh;
+    std::map<BatchKey, std::vector<ConeInstance>> p_pending_cones;
+    std::map<BatchKey, std::vector<ArrowInstance>> p_pending_arrows;
+    std::array<std::vector<SphereInstance>, 2> p_pending_spheres; // Opaque, transparent
+    std::vector<GlyphInstance> p_pending_glyphs;
+    std::vector<GlyphInstance> p_pending_overlay_glyphs;
+    std::vector<LabelInstance> p_pending_labels;
+    QMatrix4x4 p_text_projection;
+    bool p_has_pending_instances = false;
+    std::size_t p_number_of_instances = 0;
+    std::size_t p_number_of_draw_calls = 0;
+};
+
+} // namespace sofa::helper::visual
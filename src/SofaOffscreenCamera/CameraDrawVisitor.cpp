@@ -0,0 +1,25 @@
+#include "CameraDrawVisitor.h"
+#include "FrustumCuller.h"
+#include "QtDrawToolGL.h"
+
+CameraDrawVisitor::CameraDrawVisitor(sofa::core::visual::VisualParams * parameters,
+                                     sofa::helper::visual::QtDrawToolGL * draw_tool, FrustumCuller * culler)
+: Base(parameters)
+, p_draw_tool(draw_tool)
+, p_culler(culler)
+{}
+
+void CameraDrawVisitor::processVisualModel(sofa::simulation::Node * node,
+                                           sofa::core::visual::VisualModel * visual_model) {
+    if (p_culler and not p_culler->visible(visual_model))
+        return;
+    if (p_draw_tool)
+        p_draw_tool->invalidate_state_cache();
+    Base::processVisualModel(node, visual_model);
+}
+
+void CameraDrawVisitor::processObject(sofa::simulation::Node * node, sofa::core::objectmodel::BaseObject * object) {
+    if (p_draw_tool)
+        p_draw_tool->invalidate_state_cache();
+    Base::processObject(node, object);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <sofa/simulation/VisualVisitor.h>
+
+class FrustumCuller;
+namespace sofa::helper::visual { class QtDrawToolGL; }
+
+/**
+ * Visual draw visitor used by the OffscreenCamera to render its frames.
+ *
+ * Visual models and components are free to issue OpenGL calls themselves, bypassing the draw tool. The state cache
+ * of the draw tool is therefore invalidated before drawing each of them, so that redundant calls are only elided
+ * within the drawing of a single component. Visual models outside of the view frustum are skipped, if a culler is
+ * given.
+ */
+class CameraDrawVisitor : public sofa::simulation::VisualDrawVisitor {
+    using Base = sofa::simulation::VisualDrawVisitor;
+public:
+    /**
+     * @param draw_tool Draw tool whose state cache must be invalidated, or nullptr if the draw tool has no cache.
+     * @param culler Frustum culler of the frame, or nullptr to draw every visual model.
+     */
+    CameraDrawVisitor(sofa::core::visual::VisualParams * parameters, sofa::helper::visual::QtDrawToolGL * draw_tool,
+                      FrustumCuller * culler = nullptr);
+
+    void processVisualModel(sofa::simulation::Node * node, sofa::core::visual::VisualModel * visual_model) override;
+    void processObject(sofa::simulation::Node * node, sofa::core::objectmodel::BaseObject * object) override;
+
+    const char * getClassName() const override { return "CameraDrawVisitor"; }
+
+private:
+    sofa::helper::visual::QtDrawToolGL * p_draw_tool;
+    FrustumCuller * p_culler;
+};
@@ -0,0 +1,214 @@
+#include "CameraTrajectory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <sofa/type/Mat.h>
+
+namespace {
+
+using Vec3 = CameraTrajectory::Vec3;
+
+Vec3 lerp(const Vec3 & a, const Vec3 & b, double weight) {
+    return a * (1 - weight) + b * weight;
+}
+
+/**
+ * Cubic Hermite interpolation between p1 (at weight 0) and p2 (at weight 1), with the tangents m1 and m2 scaled to the
+ * duration of the segment.
+ */
+Vec3 hermite(const Vec3 & p1, const Vec3 & m1, const Vec3 & p2, const Vec3 & m2, double weight) {
+    const double w2 = weight * weight;
+    const double w3 = w2 * weight;
+    return p1 * (2 * w3 - 3 * w2 + 1) + m1 * (w3 - 2 * w2 + weight) + p2 * (-2 * w3 + 3 * w2) + m2 * (w3 - w2);
+}
+
+/** Parse the values of a line of a CSV file of keyframes, separated by commas or blanks. False if one is no number. */
+bool parse_values(const std::string & line, std::vector<double> & values) {
+    std::string text = line;
+    std::replace(text.begin(), text.end(), ',', ' ');
+    std::istringstream stream(text);
+    values.clear();
+    std::string token;
+    while (stream >> token) {
+        std::size_t parsed = 0;
+        try {
+            values.push_back(std::stod(token, &parsed));
+        } catch (const std::logic_error &) {
+            return false;
+        }
+        if (parsed != token.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+CameraTrajectory::CameraTrajectory(std::vector<Keyframe> keyframes, bool has_up)
+: p_keyframes(std::move(keyframes))
+, p_has_up(has_up)
+{
+    if (p_keyframes.empty()) {
+        throw std::invalid_argument("The trajectory has no keyframe.");
+    }
+    for (std::size_t i = 0; i < p_keyframes.size(); ++i) {
+        const auto & keyframe = p_keyframes[i];
+        if (i > 0 and not (keyframe.time > p_keyframes[i - 1].time)) {
+            throw std::invalid_argument("The times of the keyframes must be strictly increasing (keyframe " +
+                                        std::to_string(i) + ").");
+        }
+        const Vec3 forward = keyframe.look_at - keyframe.position;
+        if (forward.norm() <= 0) {
+            throw std::invalid_argument("The keyframe " + std::to_string(i) + " looks at its own position.");
+        }
+        if (has_up and sofa::type::cross(forward, keyframe.up).norm() <= 1e-12 * forward.norm() * keyframe.up.norm()) {
+            throw std::invalid_argument("The keyframe " + std::to_string(i) + " looks along its up vector.");
+        }
+    }
+}
+
+CameraTrajectory::Pose CameraTrajectory::pose_at(double time, Interpolation interpolation) const {
+    const auto pose_of = [this](const Keyframe & keyframe) -> Pose {
+        return {keyframe.position, keyframe.look_at,
+                p_has_up ? std::optional<Vec3>(keyframe.up) : std::nullopt};
+    };
+    if (time <= p_keyframes.front().time) {
+        return pose_of(p_keyframes.front());
+    }
+    if (time >= p_keyframes.back().time) {
+        return pose_of(p_keyframes.back());
+    }
+
+    // Segment [k1, k2] holding the time
+    const auto next = std::upper_bound(p_keyframes.begin(), p_keyframes.end(), time,
+                                       [](double t, const Keyframe & keyframe) { return t < keyframe.time; });
+    const auto i = static_cast<std::size_t>(next - p_keyframes.begin()) - 1;
+    const Keyframe & k1 = p_keyframes[i];
+    const Keyframe & k2 = p_keyframes[i + 1];
+    const double duration = k2.time - k1.time;
+    const double weight = (time - k1.time) / duration;
+
+    Pose pose;
+    switch (interpolation) {
+        case Interpolation::Linear: {
+            pose = {lerp(k1.position, k2.position, weight), lerp(k1.look_at, k2.look_at, weight), std::nullopt};
+            break;
+        }
+        case Interpolation::CatmullRom: {
+            // The tangent at a keyframe is the slope between its neighbours, which handles unevenly spaced keyframes.
+            // The first and last keyframes use the slope of their only segment.
+            const Keyframe & k0 = p_keyframes[i > 0 ? i - 1 : i];
+            const Keyframe & k3 = p_keyframes[std::min(i + 2, p_keyframes.size() - 1)];
+            const auto tangent = [](const Keyframe & before, const Keyframe & after, const Vec3 Keyframe::*member) {
+                return (after.*member - before.*member) / (after.time - before.time);
+            };
+            const auto spline = [&](const Vec3 Keyframe::*member) {
+                return hermite(k1.*member, tangent(k0, k2, member) * duration, k2.*member,
+                               tangent(k1, k3, member) * duration, weight);
+            };
+            pose = {spline(&Keyframe::position), spline(&Keyframe::look_at), std::nullopt};
+            break;
+        }
+        case Interpolation::Slerp: {
+            // Without up vectors, the keyframes are oriented with the y axis up, as BaseCamera does
+            const Vec3 up1 = p_has_up ? k1.up : Vec3(0, 1, 0);
+            const Vec3 up2 = p_has_up ? k2.up : Vec3(0, 1, 0);
+            Quat rotation;
+            rotation.slerp(orientation(k1.position, k1.look_at, up1), orientation(k2.position, k2.look_at, up2),
+                           weight);
+            const double distance = (1 - weight) * (k1.look_at - k1.position).norm() +
+                                    weight * (k2.look_at - k2.position).norm();
+            const Vec3 position = lerp(k1.position, k2.position, weight);
+            pose = {position, position + rotation.rotate(Vec3(0, 0, -1)) * distance, std::nullopt};
+            if (p_has_up) {
+                pose.up = rotation.rotate(Vec3(0, 1, 0));
+            }
+            return pose;
+        }
+    }
+
+    if (p_has_up) {
+        pose.up = lerp(k1.up, k2.up, weight);
+    }
+    return pose;
+}
+
+std::vector<CameraTrajectory::Keyframe> CameraTrajectory::read_csv(const std::string & filepath, bool & has_up) {
+    std::ifstream file(filepath);
+    if (not file) {
+        throw std::runtime_error("Failed to open the trajectory file '" + filepath + "'.");
+    }
+
+    std::vector<Keyframe> keyframes;
+    std::vector<double> values;
+    std::size_t columns = 0;
+    std::string line;
+    for (std::size_t line_number = 1; std::getline(file, line); ++line_number) {
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos or line[first] == '#') {
+            continue;
+        }
+
+        const std::string location = "'" + filepath + "' (line " + std::to_string(line_number) + ")";
+        if (not parse_values(line, values)) {
+            if (keyframes.empty() and columns == 0) {
+                columns = std::string::npos; // Header, only allowed before the first keyframe
+                continue;
+            }
+            throw std::runtime_error("Invalid number in the trajectory file " + location + ".");
+        }
+        if (values.size() != 7 and values.size() != 10) {
+            throw std::runtime_error("Expected 7 or 10 values per keyframe in the trajectory file " + location + ".");
+        }
+        if (not keyframes.empty() and values.size() != columns) {
+            throw std::runtime_error("Either all the keyframes or none have an up vector in the trajectory file " +
+                                     location + ".");
+        }
+        columns = values.size();
+
+        Keyframe keyframe;
+        keyframe.time = values[0];
+        keyframe.position = Vec3(values[1], values[2], values[3]);
+        keyframe.look_at = Vec3(values[4], values[5], values[6]);
+        if (columns == 10) {
+            keyframe.up = Vec3(values[7], values[8], values[9]);
+        }
+        keyframes.push_back(keyframe);
+    }
+
+    if (keyframes.empty()) {
+        throw std::runtime_error("The trajectory file '" + filepath + "' has no keyframe.");
+    }
+    has_up = columns == 10;
+    return keyframes;
+}
+
+CameraTrajectory::Quat CameraTrajectory::orientation(const Vec3 & position, const Vec3 & look_at, const Vec3 & up) {
+    // Columns of the rotation: the axes of the camera in world coordinates
+    const Vec3 z = (position - look_at).normalized();
+    Vec3 x = sofa::type::cross(up, z);
+    if (x.norm() <= 1e-12 * up.norm()) {
+        // Looking along the up vector, as the keyframes without up vectors looking straight down or up: the -z axis of
+        // the world (or its x axis when looking along z) is taken as up instead, which keeps the orientation defined
+        const Vec3 fallback = std::abs(z[2]) < 0.5 ? Vec3(0, 0, -1) : Vec3(1, 0, 0);
+        x = sofa::type::cross(fallback, z);
+    }
+    x.normalize();
+    const Vec3 y = sofa::type::cross(z, x);
+
+    sofa::type::Mat3x3d rotation;
+    for (int row = 0; row < 3; ++row) {
+        rotation[row][0] = x[row];
+        rotation[row][1] = y[row];
+        rotation[row][2] = z[row];
+    }
+    Quat quaternion;
+    quaternion.fromMatrix(rotation);
+    return quaternion;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sofa/type/Quat.h>
+#include <sofa/type/Vec.h>
+
+/**
+ * Path of a camera through keyframes of its position, look-at point and (optionally) up vector at given simulated
+ * times, played back by an OffscreenCamera so that long camera moves are rendered without any script in the loop.
+ *
+ * Before the first keyframe and after the last one, the camera stays at the pose of the keyframe. In between, the pose
+ * is interpolated following one of the Interpolation modes.
+ */
+class CameraTrajectory {
+public:
+    using Vec3 = sofa::type::Vec3d;
+    using Quat = sofa::type::Quat<double>;
+
+    /** Interpolation between the keyframes, in the order of the options of 'trajectory_interpolation'. */
+    enum class Interpolation {
+        Linear,     ///< Position, look-at point and up vector interpolated linearly
+        CatmullRom, ///< Position and look-at point on Catmull-Rom splines through the keyframes, up vector linearly
+        Slerp       ///< Orientation interpolated spherically, position and distance to the look-at point linearly. Without
+                    ///< up vectors, the keyframes are oriented with the y axis up (see orientation)
+    };
+
+    struct Keyframe {
+        double time = 0; ///< Simulated time
+        Vec3 position;
+        Vec3 look_at;
+        Vec3 up {0, 1, 0};
+    };
+
+    struct Pose {
+        Vec3 position;
+        Vec3 look_at;
+        std::optional<Vec3> up; ///< None if the keyframes have no up vector, the camera then keeps its own
+    };
+
+    /**
+     * @param keyframes Keyframes in increasing order of time, at least one.
+     * @param has_up Whether the up vectors of the keyframes are given, the up vector of the camera is kept otherwise.
+     * @throws std::invalid_argument If the keyframes are not in strictly increasing order of time, or if a keyframe
+     *                               looks at its own position or along its up vector (with has_up).
+     */
+    CameraTrajectory(std::vector<Keyframe> keyframes, bool has_up);
+
+    const std::vector<Keyframe> & keyframes() const { return p_keyframes; }
+
+    bool has_up() const { return p_has_up; }
+
+    /** Pose of the camera at the given simulated time. */
+    Pose pose_at(double time, Interpolation interpolation) const;
+
+    /**
+     * Read keyframes from a CSV file: one keyframe per line, as 'time, position, look-at point' (7 values) or 'time,
+     * position, look-at point, up vector' (10 values), the values being separated by commas or blanks. Empty lines and
+     * lines starting with '#' are skipped, as well as a header line of column names.
+     *
+     * @param has_up Set to whether the keyframes of the file have up vectors (all of them or none).
+     * @throws std::runtime_error If the file cannot be read or is malformed.
+     */
+    static std::vector<Keyframe> read_csv(const std::string & filepath, bool & has_up);
+
+    /**
+     * Orientation of a camera at the given position, looking at the given point with the given up vector, following
+     * the conventions of BaseCamera (looking down its -z axis, y axis up). When looking along the up vector, the -z
+     * axis of the world is taken as up instead (its x axis when also looking along z).
+     */
+    static Quat orientation(const Vec3 & position, const Vec3 & look_at, const Vec3 & up);
+
+private:
+    std::vector<Keyframe> p_keyframes;
+    bool p_has_up;
+};
@@ -0,0 +1,115 @@
+#include "CaptureWorker.h"
+
+#include <exception>
+#include <utility>
+
+#include <sofa/helper/logging/Messaging.h>
+
+CaptureWorker::CaptureWorker(QOpenGLContext & share_context)
+: p_owner_thread(QThread::currentThread())
+{
+    // The surface must be created on the thread of the application, the context is then moved to the worker
+    p_surface = std::make_unique<QOffscreenSurface>();
+    p_surface->setFormat(share_context.format());
+    p_surface->create();
+
+    p_context = std::make_unique<QOpenGLContext>();
+    p_context->setFormat(share_context.format());
+    p_context->setShareContext(&share_context);
+    if (not p_context->create()) {
+        msg_error("CaptureWorker") << "Failed to create the OpenGL context of the capture worker, the frames will be "
+                                   << "read back synchronously.";
+        p_context.reset();
+    }
+
+    p_thread.reset(QThread::create([this]() { run(); }));
+    if (p_context) {
+        p_context->moveToThread(p_thread.get());
+    }
+    p_thread->start();
+
+    std::unique_lock<std::mutex> lock(p_mutex);
+    p_condition.wait(lock, [this]() { return p_started; });
+}
+
+CaptureWorker::~CaptureWorker() {
+    {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        p_stopping = true;
+    }
+    p_condition.notify_all();
+    const auto guard = wait_guard() ? wait_guard()() : nullptr;
+    p_thread->wait();
+}
+
+void CaptureWorker::set_wait_guard(WaitGuard guard) {
+    wait_guard() = std::move(guard);
+}
+
+CaptureWorker::WaitGuard & CaptureWorker::wait_guard() {
+    static WaitGuard guard;
+    return guard;
+}
+
+void CaptureWorker::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        p_tasks.push_back(std::move(task));
+    }
+    p_condition.notify_all();
+}
+
+void CaptureWorker::wait() {
+    const auto guard = wait_guard() ? wait_guard()() : nullptr;
+    std::unique_lock<std::mutex> lock(p_mutex);
+    p_condition.wait(lock, [this]() { return p_tasks.empty() and not p_busy; });
+}
+
+void CaptureWorker::run() {
+    const bool has_context = p_context and p_context->makeCurrent(p_surface.get());
+    if (p_context and not has_context) {
+        msg_error("CaptureWorker") << "Failed to make the OpenGL context of the capture worker current, the frames "
+                                   << "will be read back synchronously.";
+    }
+    {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        p_started = true;
+        p_has_context = has_context;
+    }
+    p_condition.notify_all();
+
+    // The tasks still queued when stopping are run before leaving
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(p_mutex);
+            p_condition.wait(lock, [this]() { return p_stopping or not p_tasks.empty(); });
+            if (p_tasks.empty()) {
+                break;
+            }
+            task = std::move(p_tasks.front());
+            p_tasks.pop_front();
+            p_busy = true;
+        }
+
+        try {
+            task();
+        } catch (const std::exception & error) {
+            msg_error("CaptureWorker") << "Asynchronous capture failed: " << error.what();
+        }
+        task = nullptr; // Released before the task is reported as done
+
+        {
+            std::lock_guard<std::mutex> lock(p_mutex);
+            p_busy = false;
+        }
+        p_condition.notify_all();
+    }
+
+    if (p_context) {
+        if (has_context) {
+            p_context->doneCurrent();
+        }
+        p_context->moveToThread(p_owner_thread);
+    }
+}
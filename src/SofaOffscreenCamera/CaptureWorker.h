@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QThread>
+
+/**
+ * Thread finishing the asynchronous captures of an OffscreenCamera (save_frame_async and grab_pixels_async), while
+ * the thread of the camera goes on.
+ *
+ * The frames are rendered and their readback is queued by the camera itself, since the scene is only consistent on its
+ * thread. The tasks posted to the worker then run one at a time, in their order of submission: encoding and writing
+ * the frames, or waiting for the pixel buffers read back by the GPU. The worker owns an OpenGL context shared with the
+ * context of the camera, current while the tasks run, so that they can map the pixel buffers of the camera.
+ */
+class CaptureWorker {
+public:
+    /**
+     * Called by the threads about to block on a worker (in wait() and in the destructor). The object returned is
+     * released once the wait is over. It lets the python bindings release the GIL while a thread waits, since the
+     * tasks completing the asynchronous captures of python take it, whichever path the wait comes from (reset,
+     * cleanup or destruction of the camera).
+     */
+    using WaitGuard = std::function<std::shared_ptr<void>()>;
+
+    /** Set the guard of the waits of every worker, none by default. To be set once, before starting any worker. */
+    static void set_wait_guard(WaitGuard guard);
+
+    /**
+     * Start the thread, and wait until its context is ready (see has_context()).
+     *
+     * @param share_context Context of the camera, whose OpenGL objects are shared with the context of the worker.
+     */
+    explicit CaptureWorker(QOpenGLContext & share_context);
+
+    /** Run the tasks still queued, and join the thread. */
+    ~CaptureWorker();
+
+    CaptureWorker(const CaptureWorker &) = delete;
+    CaptureWorker & operator=(const CaptureWorker &) = delete;
+
+    /** Whether the OpenGL context of the worker is current while the tasks run. */
+    bool has_context() const { return p_has_context; }
+
+    /** Queue a task. Exceptions escaping from the task are reported and dropped. */
+    void post(std::function<void()> task);
+
+    /** Wait for every task posted so far to be done. */
+    void wait();
+
+private:
+    /** Body of the thread. */
+    void run();
+
+    /** The guard set by set_wait_guard, if any. */
+    static WaitGuard & wait_guard();
+
+    QThread * p_owner_thread;
+    std::unique_ptr<QOffscreenSurface> p_surface;
+    std::unique_ptr<QOpenGLContext> p_context;
+    std::unique_ptr<QThread> p_thread;
+
+    // Guarded by p_mutex
+    std::mutex p_mutex;
+    std::condition_variable p_condition;
+    std::deque<std::function<void()>> p_tasks;
+    bool p_started = false;
+    bool p_busy = false; ///< Whether a task is running
+    bool p_stopping = false;
+    bool p_has_context = false;
+};
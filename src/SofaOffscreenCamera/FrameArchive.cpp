@@ -0,0 +1,257 @@
+#include "FrameArchive.h"
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr char header_magic[8] = {'S', 'O', 'F', 'A', 'F', 'R', 'A', 'M'};
+constexpr char record_magic[4] = {'F', 'R', 'A', 'M'};
+constexpr char footer_magic[8] = {'S', 'O', 'F', 'A', 'F', 'I', 'D', 'X'};
+constexpr std::uint32_t version = 1;
+
+constexpr std::size_t header_size = 16;
+constexpr std::size_t record_header_size = 32; // Without the name
+constexpr std::size_t footer_size = 24;
+
+/** Little-endian serialization of the numbers, whatever the byte order of the machine. */
+template <typename T>
+void put(std::vector<char> & bytes, T value) {
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        bytes.push_back(static_cast<char>((static_cast<std::uint64_t>(value) >> (8 * i)) & 0xff));
+    }
+}
+
+void put(std::vector<char> & bytes, double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put(bytes, bits);
+}
+
+void put(std::vector<char> & bytes, const char * data, std::size_t size) {
+    bytes.insert(bytes.end(), data, data + size);
+}
+
+template <typename T>
+T get(const char * bytes) {
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        value |= static_cast<std::uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    }
+    return static_cast<T>(value);
+}
+
+double get_double(const char * bytes) {
+    const auto bits = get<std::uint64_t>(bytes);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+FrameArchiveWriter::~FrameArchiveWriter() {
+    close();
+}
+
+bool FrameArchiveWriter::open(const std::string & filepath) {
+    close();
+
+    p_file.open(filepath, std::ios::binary | std::ios::trunc);
+    if (not p_file.is_open()) {
+        return false;
+    }
+    p_filepath = filepath;
+    p_buffer.reserve(buffer_size);
+    p_size = 0;
+    p_entries.clear();
+
+    std::vector<char> header;
+    put(header, header_magic, sizeof(header_magic));
+    put(header, version);
+    put(header, std::uint32_t(0));
+    write(header.data(), header.size());
+    return true;
+}
+
+bool FrameArchiveWriter::append(const std::string & name, const char * data, std::size_t size, std::uint32_t step,
+                                double time) {
+    if (not is_open()) {
+        return false;
+    }
+
+    std::vector<char> record;
+    put(record, record_magic, sizeof(record_magic));
+    put(record, static_cast<std::uint32_t>(name.size()));
+    put(record, static_cast<std::uint64_t>(size));
+    put(record, step);
+    put(record, std::uint32_t(0));
+    put(record, time);
+    put(record, name.data(), name.size());
+    write(record.data(), record.size());
+
+    p_entries.push_back({name, p_size, size, step, time});
+    write(data, size);
+    return p_file.good();
+}
+
+bool FrameArchiveWriter::close() {
+    if (not is_open()) {
+        return true;
+    }
+
+    const std::uint64_t index_offset = p_size;
+    std::vector<char> index;
+    for (const auto & entry : p_entries) {
+        put(index, entry.offset);
+        put(index, entry.size);
+        put(index, entry.step);
+        put(index, static_cast<std::uint32_t>(entry.name.size()));
+        put(index, entry.time);
+        put(index, entry.name.data(), entry.name.size());
+    }
+    put(index, index_offset);
+    put(index, static_cast<std::uint64_t>(p_entries.size()));
+    put(index, footer_magic, sizeof(footer_magic));
+    write(index.data(), index.size());
+    flush();
+
+    const bool written = p_file.good();
+    p_file.close();
+    p_buffer = std::vector<char>();
+    p_entries.clear();
+    return written and not p_file.fail();
+}
+
+void FrameArchiveWriter::write(const void * data, std::size_t size) {
+    const auto * bytes = static_cast<const char *>(data);
+    if (p_buffer.size() + size > buffer_size) {
+        flush();
+    }
+    if (size >= buffer_size) {
+        p_file.write(bytes, static_cast<std::streamsize>(size));
+    } else {
+        p_buffer.insert(p_buffer.end(), bytes, bytes + size);
+    }
+    p_size += size;
+}
+
+void FrameArchiveWriter::flush() {
+    if (not p_buffer.empty()) {
+        p_file.write(p_buffer.data(), static_cast<std::streamsize>(p_buffer.size()));
+        p_buffer.clear();
+    }
+    p_file.flush();
+}
+
+FrameArchiveReader::FrameArchiveReader(const std::string & filepath)
+: p_filepath(filepath)
+, p_file(filepath, std::ios::binary)
+{
+    if (not p_file.is_open()) {
+        throw std::runtime_error("Failed to open the frame archive '" + filepath + "'.");
+    }
+
+    p_file.seekg(0, std::ios::end);
+    p_file_size = static_cast<std::uint64_t>(p_file.tellg());
+
+    std::array<char, header_size> header;
+    p_file.seekg(0);
+    if (p_file_size < header_size or not p_file.read(header.data(), header.size())
+        or std::memcmp(header.data(), header_magic, sizeof(header_magic)) != 0) {
+        throw std::runtime_error("'" + filepath + "' is not a frame archive.");
+    }
+    if (get<std::uint32_t>(header.data() + 8) > version) {
+        throw std::runtime_error("The frame archive '" + filepath + "' was written by a newer version.");
+    }
+
+    std::array<char, footer_size> footer;
+    if (p_file_size >= header_size + footer_size) {
+        p_file.seekg(static_cast<std::streamoff>(p_file_size - footer_size));
+        p_file.read(footer.data(), footer.size());
+    }
+    if (not p_file or p_file_size < header_size + footer_size
+        or std::memcmp(footer.data() + 16, footer_magic, sizeof(footer_magic)) != 0) {
+        p_file.clear();
+        scan();
+        return;
+    }
+
+    const auto index_offset = get<std::uint64_t>(footer.data());
+    const auto number_of_entries = get<std::uint64_t>(footer.data() + 8);
+    if (index_offset > p_file_size - footer_size) {
+        throw std::runtime_error("The index of the frame archive '" + filepath + "' is corrupted.");
+    }
+    std::vector<char> index(p_file_size - footer_size - index_offset);
+    p_file.seekg(static_cast<std::streamoff>(index_offset));
+    p_file.read(index.data(), static_cast<std::streamsize>(index.size()));
+
+    std::size_t position = 0;
+    for (std::uint64_t i = 0; i < number_of_entries; ++i) {
+        constexpr std::size_t entry_size = 32; // Without the name
+        if (position + entry_size > index.size()) {
+            throw std::runtime_error("The index of the frame archive '" + filepath + "' is corrupted.");
+        }
+        const char * bytes = index.data() + position;
+        FrameArchiveEntry entry;
+        entry.offset = get<std::uint64_t>(bytes);
+        entry.size = get<std::uint64_t>(bytes + 8);
+        entry.step = get<std::uint32_t>(bytes + 16);
+        const auto name_size = get<std::uint32_t>(bytes + 20);
+        entry.time = get_double(bytes + 24);
+        position += entry_size;
+        if (position + name_size > index.size()) {
+            throw std::runtime_error("The index of the frame archive '" + filepath + "' is corrupted.");
+        }
+        entry.name.assign(index.data() + position, name_size);
+        position += name_size;
+        p_entries.push_back(std::move(entry));
+    }
+}
+
+std::string FrameArchiveReader::read(std::size_t index) {
+    if (index >= p_entries.size()) {
+        throw std::out_of_range("The frame archive '" + p_filepath + "' has " + std::to_string(p_entries.size())
+                                + " frames, frame " + std::to_string(index) + " requested.");
+    }
+
+    const auto & entry = p_entries[index];
+    std::string data(entry.size, '\0');
+    p_file.seekg(static_cast<std::streamoff>(entry.offset));
+    if (not p_file.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+        p_file.clear();
+        throw std::runtime_error("Failed to read the frame " + std::to_string(index) + " of the frame archive '"
+                                 + p_filepath + "'.");
+    }
+    return data;
+}
+
+void FrameArchiveReader::scan() {
+    // The last record may be incomplete, it is then ignored
+    std::uint64_t position = header_size;
+    std::array<char, record_header_size> header;
+    while (position + record_header_size <= p_file_size) {
+        p_file.seekg(static_cast<std::streamoff>(position));
+        if (not p_file.read(header.data(), header.size())
+            or std::memcmp(header.data(), record_magic, sizeof(record_magic)) != 0) {
+            break;
+        }
+
+        FrameArchiveEntry entry;
+        const auto name_size = get<std::uint32_t>(header.data() + 4);
+        entry.size = get<std::uint64_t>(header.data() + 8);
+        entry.step = get<std::uint32_t>(header.data() + 16);
+        entry.time = get_double(header.data() + 24);
+        entry.offset = position + record_header_size + name_size;
+        if (entry.offset + entry.size > p_file_size) {
+            break;
+        }
+        entry.name.resize(name_size);
+        p_file.read(entry.name.data(), name_size);
+
+        position = entry.offset + entry.size;
+        p_entries.push_back(std::move(entry));
+    }
+    p_file.clear();
+}
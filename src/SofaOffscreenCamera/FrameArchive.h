@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * Single-file archive of encoded frames, written by the OffscreenCamera instead of one file per frame.
+ *
+ * The archive is a sequence of records, each holding an encoded frame (PNG, JPEG, ... as it would have been written
+ * into its own file) along with its name, step number and simulated time, followed by an index of the records. All
+ * the numbers are stored in little endian:
+ *
+ *     header:  "SOFAFRAM" | u32 version | u32 reserved
+ *     record:  "FRAM" | u32 name size | u64 data size | u32 step | u32 reserved | f64 time | name | data
+ *     index:   one entry per record: u64 data offset | u64 data size | u32 step | u32 name size | f64 time | name
+ *     footer:  u64 index offset | u64 number of entries | "SOFAFIDX"
+ *
+ * The index is written when the archive is closed. An archive left without index (by a crash, for example) is still
+ * readable: its records are then scanned from the start.
+ */
+struct FrameArchiveEntry {
+    std::string name;
+    std::uint64_t offset = 0; ///< Position of the encoded frame in the archive, in bytes
+    std::uint64_t size = 0;   ///< Size of the encoded frame, in bytes
+    std::uint32_t step = 0;
+    double time = 0;
+};
+
+/**
+ * Appends frames to an archive. The writes are buffered, so that the file receives large sequential writes only.
+ */
+class FrameArchiveWriter {
+public:
+    /** Size of the write buffer. Frames larger than the buffer are written directly. */
+    static constexpr std::size_t buffer_size = std::size_t(8) << 20;
+
+    FrameArchiveWriter() = default;
+    ~FrameArchiveWriter();
+    FrameArchiveWriter(const FrameArchiveWriter &) = delete;
+    FrameArchiveWriter & operator=(const FrameArchiveWriter &) = delete;
+
+    /** Create (or truncate) the archive, closing the previous one if any. @return False if it could not be created. */
+    bool open(const std::string & filepath);
+
+    bool is_open() const { return p_file.is_open(); }
+
+    const std::string & filepath() const { return p_filepath; }
+
+    /** Append an encoded frame. @return False if it could not be written. */
+    bool append(const std::string & name, const char * data, std::size_t size, std::uint32_t step, double time);
+
+    /** Write the index and close the archive. Does nothing if it is not open. @return False if it could not be written. */
+    bool close();
+
+private:
+    /** Copy into the buffer, flushing it first if full. */
+    void write(const void * data, std::size_t size);
+
+    /** Write the buffer into the file. */
+    void flush();
+
+    std::string p_filepath;
+    std::ofstream p_file;
+    std::vector<char> p_buffer;
+    std::uint64_t p_size = 0; ///< Size of the archive, including the buffered bytes
+    std::vector<FrameArchiveEntry> p_entries;
+};
+
+/**
+ * Reads the frames of an archive. Errors are reported by throwing std::runtime_error.
+ */
+class FrameArchiveReader {
+public:
+    explicit FrameArchiveReader(const std::string & filepath);
+
+    const std::vector<FrameArchiveEntry> & entries() const { return p_entries; }
+
+    /** Encoded frame of the entry at the given position. */
+    std::string read(std::size_t index);
+
+private:
+    /** Rebuild the index by scanning the records, for archives that were not closed. */
+    void scan();
+
+    std::string p_filepath;
+    std::ifstream p_file;
+    std::uint64_t p_file_size = 0;
+    std::vector<FrameArchiveEntry> p_entries;
+};
@@ -0,0 +1,19 @@
+#include "FrameBufferPool.h"
+
+FrameBufferPool::Buffer FrameBufferPool::acquire(std::size_t size) {
+    std::lock_guard<std::mutex> lock(p_mutex);
+
+    // References are only added by the pool, hence a buffer it holds alone stays free until it is handed out again
+    for (const auto & buffer : p_buffers) {
+        if (buffer.use_count() == 1) {
+            buffer->resize(size);
+            return buffer;
+        }
+    }
+
+    auto buffer = std::make_shared<std::vector<std::uint8_t>>(size);
+    if (p_buffers.size() < p_max_buffers) {
+        p_buffers.push_back(buffer);
+    }
+    return buffer;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Buffers receiving the pixels of the frames grabbed by a camera, such as the arrays returned to python.
+ *
+ * A buffer is handed out again once every reference to it outside of the pool has been released, hence a consumer
+ * never sees the pixels it holds overwritten, while grabbing frames stops allocating memory as soon as the consumers
+ * release the frames as fast as they are grabbed.
+ */
+class FrameBufferPool {
+public:
+    using Buffer = std::shared_ptr<std::vector<std::uint8_t>>;
+
+    /** @param max_buffers Number of buffers kept by the pool, the other ones are freed once released. */
+    explicit FrameBufferPool(std::size_t max_buffers = 4) : p_max_buffers(max_buffers) {}
+
+    /** A buffer of the given size, in bytes, only referenced by the pool and the caller. */
+    Buffer acquire(std::size_t size);
+
+private:
+    std::mutex p_mutex;
+    std::size_t p_max_buffers;
+    std::vector<Buffer> p_buffers;
+};
@@ -0,0 +1,61 @@
+#include "FrameProfiler.h"
+#include "Tracer.h"
+
+#include <algorithm>
+
+FrameProfiler::Scope::Scope(FrameProfiler & profiler, Stage stage)
+: p_profiler(profiler)
+, p_stage(stage)
+, p_active(profiler.enabled())
+, p_traced(Tracer::instance().enabled())
+{
+    if (p_active or p_traced)
+        p_start = std::chrono::steady_clock::now();
+}
+
+FrameProfiler::Scope::~Scope() {
+    if (not p_active and not p_traced)
+        return;
+
+    const auto end = std::chrono::steady_clock::now();
+    if (p_active) {
+        const std::chrono::duration<double, std::milli> duration = end - p_start;
+        p_profiler.record(p_stage, duration.count());
+    }
+    if (p_traced) {
+        Tracer::instance().complete(name(p_stage), p_start, end, p_profiler.p_trace_arguments);
+    }
+}
+
+const char * FrameProfiler::name(Stage stage) {
+    switch (stage) {
+        case Stage::ContextSwitch: return "context_switch";
+        case Stage::PreDraw:       return "pre_draw";
+        case Stage::Traversal:     return "traversal";
+        case Stage::PostDraw:      return "post_draw";
+        case Stage::Gpu:           return "gpu";
+        case Stage::Readback:      return "readback";
+        case Stage::Encode:        return "encode";
+        case Stage::Write:         return "write";
+        default:                   return "unknown";
+    }
+}
+
+void FrameProfiler::record(Stage stage, double milliseconds) {
+    std::lock_guard<std::mutex> lock(p_mutex);
+    auto & statistics = p_statistics[static_cast<std::size_t>(stage)];
+    ++statistics.number_of_measures;
+    statistics.last = milliseconds;
+    statistics.average += (milliseconds - statistics.average) / static_cast<double>(statistics.number_of_measures);
+    statistics.max = std::max(statistics.max, milliseconds);
+}
+
+FrameProfiler::Statistics FrameProfiler::statistics(Stage stage) const {
+    std::lock_guard<std::mutex> lock(p_mutex);
+    return p_statistics[static_cast<std::size_t>(stage)];
+}
+
+void FrameProfiler::reset() {
+    std::lock_guard<std::mutex> lock(p_mutex);
+    p_statistics.fill(Statistics());
+}
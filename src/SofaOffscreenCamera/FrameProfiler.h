@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+/**
+ * Wall-clock timings of the stages of the frame capture of the OffscreenCamera.
+ *
+ * Each stage keeps the duration of its last measure, as well as the average and the maximum over all the measures
+ * since the last reset. When the profiler is disabled, starting and stopping a measure only costs a branch.
+ *
+ * The measures are also recorded as spans by the Tracer when it is enabled, independently of the profiler. They may be
+ * recorded from several threads, such as the one of the CaptureWorker.
+ */
+class FrameProfiler {
+public:
+    enum class Stage {
+        ContextSwitch, ///< Making the context of the camera current and binding its framebuffer
+        PreDraw,       ///< VisualManager::preDrawScene of the visual managers
+        Traversal,     ///< Drawing of the scene graph by the visual managers or the draw visitors
+        PostDraw,      ///< VisualManager::postDrawScene of the visual managers
+        Gpu,           ///< Rendering time on the GPU, measured with a timer query
+        Readback,      ///< Copy of the framebuffer into an image
+        Encode,        ///< Compression of the image in the format of the file
+        Write,         ///< Writing of the compressed image into the file
+        Count
+    };
+
+    struct Statistics {
+        double last = 0;    ///< Duration of the last measure, in milliseconds
+        double average = 0; ///< Average duration, in milliseconds
+        double max = 0;     ///< Maximum duration, in milliseconds
+        std::size_t number_of_measures = 0;
+    };
+
+    /** Measure the wall-clock time spent in a stage during the lifetime of the scope. */
+    class Scope {
+    public:
+        Scope(FrameProfiler & profiler, Stage stage);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope & operator=(const Scope &) = delete;
+
+    private:
+        FrameProfiler & p_profiler;
+        Stage p_stage;
+        bool p_active; ///< Whether the profiler was enabled when the measure started
+        bool p_traced; ///< Whether the tracer was enabled when the measure started
+        std::chrono::steady_clock::time_point p_start;
+    };
+
+    /** Name of the stage, as shown in the traces. */
+    static const char * name(Stage stage);
+
+    bool enabled() const { return p_enabled; }
+    void set_enabled(bool enabled) { p_enabled = enabled; }
+
+    /** Add a measure of the given duration, in milliseconds, to the statistics of the stage. */
+    void record(Stage stage, double milliseconds);
+
+    Statistics statistics(Stage stage) const;
+
+    /** Forget all the measures. */
+    void reset();
+
+    /** Set the arguments recorded with the spans of the stages, see Tracer::complete. */
+    void set_trace_arguments(std::string arguments) { p_trace_arguments = std::move(arguments); }
+
+private:
+    std::atomic<bool> p_enabled {false};
+    std::string p_trace_arguments;
+    mutable std::mutex p_mutex; ///< Guards the statistics
+    std::array<Statistics, static_cast<std::size_t>(Stage::Count)> p_statistics;
+};
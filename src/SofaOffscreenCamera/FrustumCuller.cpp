@@ -0,0 +1,105 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+
+#include <SofaBaseVisual/VisualModelImpl.h>
+#include <sofa/core/visual/VisualModel.h>
+
+void FrustumCuller::begin_frame(const double * projection, const double * modelview) {
+    // Rows of the clip matrix (projection * modelview), whose combinations give the planes of the frustum
+    // (Gribb & Hartmann, "Fast extraction of viewing frustum planes from the world-view-projection matrix")
+    std::array<std::array<double, 4>, 4> rows {};
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            double value = 0;
+            for (int k = 0; k < 4; ++k) {
+                value += projection[4 * k + row] * modelview[4 * column + k];
+            }
+            rows[row][column] = value;
+        }
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int k = 0; k < 4; ++k) {
+            p_planes[2 * axis][k] = rows[3][k] + rows[axis][k];
+            p_planes[2 * axis + 1][k] = rows[3][k] - rows[axis][k];
+        }
+    }
+
+    // The models not visited during the last frame may have been deleted, their address reused by new ones
+    for (auto entry = p_entries.begin(); entry != p_entries.end();) {
+        entry = entry->second.frame == p_frame ? std::next(entry) : p_entries.erase(entry);
+    }
+    ++p_frame;
+    p_statistics = {};
+}
+
+bool FrustumCuller::visible(const sofa::core::visual::VisualModel * visual_model) {
+    auto & entry = p_entries[visual_model];
+    if (entry.frame == p_frame) {
+        return entry.visible;
+    }
+
+    update_box(visual_model, entry);
+    entry.frame = p_frame;
+    entry.visible = not entry.has_box or intersects(entry.box);
+    ++p_statistics.tested;
+    if (not entry.visible) {
+        ++p_statistics.culled;
+    }
+    return entry.visible;
+}
+
+bool FrustumCuller::intersects(const Box & box) const {
+    // The box is outside if its corner furthest along the normal of a plane is behind this plane
+    for (const auto & plane : p_planes) {
+        double distance = plane[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            distance += plane[axis] * (plane[axis] >= 0 ? box.max[axis] : box.min[axis]);
+        }
+        if (distance < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FrustumCuller::update_box(const sofa::core::visual::VisualModel * visual_model, Entry & entry) {
+    const auto * model = dynamic_cast<const sofa::component::visualmodel::VisualModelImpl *>(visual_model);
+    if (not model) {
+        const auto & bounding_box = visual_model->f_bbox.getValue();
+        entry.has_box = bounding_box.isValid();
+        if (entry.has_box) {
+            for (int axis = 0; axis < 3; ++axis) {
+                entry.box.min[axis] = bounding_box.minBBox()[axis];
+                entry.box.max[axis] = bounding_box.maxBBox()[axis];
+            }
+        }
+        return;
+    }
+
+    // Reading the vertices may update them, their counters are compared afterwards
+    const auto & vertices = model->getVertices();
+    const int positions_counter = model->m_positions.getCounter();
+    const int vertices_counter = model->m_vertices2.getCounter();
+    if (positions_counter == entry.positions_counter and vertices_counter == entry.vertices_counter and
+        vertices.size() == entry.vertex_count) {
+        return;
+    }
+    entry.positions_counter = positions_counter;
+    entry.vertices_counter = vertices_counter;
+    entry.vertex_count = vertices.size();
+
+    entry.has_box = not vertices.empty();
+    if (not entry.has_box) {
+        return;
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        entry.box.min[axis] = entry.box.max[axis] = vertices[0][axis];
+    }
+    for (const auto & vertex : vertices) {
+        for (int axis = 0; axis < 3; ++axis) {
+            entry.box.min[axis] = std::min<double>(entry.box.min[axis], vertex[axis]);
+            entry.box.max[axis] = std::max<double>(entry.box.max[axis], vertex[axis]);
+        }
+    }
+}
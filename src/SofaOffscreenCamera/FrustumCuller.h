@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+
+namespace sofa::core::visual { class VisualModel; }
+
+/**
+ * Frustum culling of the visual models drawn by an OffscreenCamera: a visual model whose bounding box lies completely
+ * outside of the view frustum of the camera is skipped by the draw visitors.
+ *
+ * The bounding boxes of the visual models deriving from VisualModelImpl (such as OglModel) are computed from their
+ * vertices, and cached until the vertices change. The other visual models use their bbox data, as computed by SOFA
+ * for the scene graph, and are always drawn when it is not valid. The visibility of a model is decided once per frame,
+ * hence the opaque and transparent passes agree on it.
+ */
+class FrustumCuller {
+public:
+    struct Statistics {
+        unsigned int tested = 0; ///< Visual models tested against the frustum during the frame
+        unsigned int culled = 0; ///< Visual models found outside of the frustum, hence not drawn
+    };
+
+    /**
+     * Start a frame seen through the given OpenGL projection and model-view matrices (column-major). The statistics
+     * are reset, and the boxes of the visual models not seen during the previous frame are forgotten.
+     */
+    void begin_frame(const double * projection, const double * modelview);
+
+    /** Whether the visual model may be visible in the current frame. */
+    bool visible(const sofa::core::visual::VisualModel * visual_model);
+
+    const Statistics & statistics() const { return p_statistics; }
+
+private:
+    struct Box {
+        std::array<double, 3> min {};
+        std::array<double, 3> max {};
+    };
+
+    struct Entry {
+        Box box;
+        bool has_box = false;   ///< False if the box is unknown, the model is then always drawn
+        int positions_counter = -1; ///< Counters of the vertex data the box was computed from (BaseData::getCounter)
+        int vertices_counter = -1;
+        std::size_t vertex_count = 0;
+        unsigned int frame = 0; ///< Last frame the visibility was decided in
+        bool visible = true;
+    };
+
+    /** Whether the box intersects the frustum, conservatively (boxes near a corner of the frustum may be kept). */
+    bool intersects(const Box & box) const;
+
+    /** Update the box of the entry from the bounding box of the visual model, if it changed. */
+    static void update_box(const sofa::core::visual::VisualModel * visual_model, Entry & entry);
+
+    /** Planes (a, b, c, d) of the frustum, whose inside is where a x + b y + c z + d >= 0. */
+    std::array<std::array<double, 4>, 6> p_planes {};
+    std::unordered_map<const sofa::core::visual::VisualModel *, Entry> p_entries;
+    unsigned int p_frame = 0;
+    Statistics p_statistics;
+};
@@ -0,0 +1,199 @@
+#include "GeometryCache.h"
+
+#include <cstring>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+#include <sofa/helper/logging/Messaging.h>
+
+#include "ShaderLibrary.h"
+
+namespace sofa::helper::visual {
+
+namespace {
+
+QOpenGLExtraFunctions * gl() {
+    return QOpenGLContext::currentContext()->extraFunctions();
+}
+
+/** Width of the texture holding the normals of the triangles, its height grows with the number of triangles. */
+constexpr int face_normals_texture_width = 4096;
+
+void copy(const std::vector<sofa::type::Vector3> & vectors, std::vector<float> & destination) {
+    destination.resize(3 * vectors.size());
+    for (std::size_t i = 0; i < vectors.size(); ++i) {
+        destination[3*i+0] = static_cast<float>(vectors[i][0]);
+        destination[3*i+1] = static_cast<float>(vectors[i][1]);
+        destination[3*i+2] = static_cast<float>(vectors[i][2]);
+    }
+}
+
+} // namespace
+
+GeometryCache::GeometryCache()
+: p_program(ShaderLibrary::create(ShaderLibrary::Program::IndexedTriangles))
+{
+    if (not p_program) {
+        msg_error("GeometryCache") << "Indexed triangles will be sent again at every frame.";
+    }
+
+    p_vao.create();
+    QOpenGLVertexArrayObject::Binder binder(&p_vao);
+
+    // The normals take the location following the positions
+    p_positions.create();
+    p_positions.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    p_positions.bind();
+    gl()->glEnableVertexAttribArray(ShaderLibrary::Vertex);
+    gl()->glVertexAttribPointer(ShaderLibrary::Vertex, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+    p_normals.create();
+    p_normals.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    p_normals.bind();
+    gl()->glVertexAttribPointer(ShaderLibrary::Instance0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    p_normals.release();
+
+    gl()->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &p_max_texture_size);
+    gl()->glGenTextures(1, &p_face_normals_texture);
+}
+
+GeometryCache::~GeometryCache() {
+    if (p_face_normals_texture) {
+        gl()->glDeleteTextures(1, &p_face_normals_texture);
+    }
+}
+
+bool GeometryCache::draw(const State & state, const std::vector<Vector3> & points,
+                         const std::vector<Vec3i> & triangles, const std::vector<Vector3> & normals,
+                         const RGBAColor & color) {
+    static_assert(sizeof(Vec3i) == 3 * sizeof(GLuint), "Triangles are uploaded as they are into the index buffer");
+
+    const bool face_normals = (normals.size() == triangles.size());
+    if (not p_program || triangles.empty() || points.empty() || (not face_normals && normals.size() != points.size())) {
+        return false;
+    }
+
+    const auto max_number_of_face_normals = static_cast<std::size_t>(face_normals_texture_width)
+                                          * static_cast<std::size_t>(p_max_texture_size);
+    if (face_normals && (p_max_texture_size < face_normals_texture_width || triangles.size() > max_number_of_face_normals)) {
+        return false;
+    }
+
+    QOpenGLVertexArrayObject::Binder binder(&p_vao);
+
+    // The index buffer binding is part of the state of the vertex array
+    IndexBuffer & indices = index_buffer(triangles);
+    indices.buffer.bind();
+
+    copy(points, p_staging);
+    p_positions.bind();
+    p_positions.allocate(p_staging.data(), static_cast<int>(p_staging.size() * sizeof(float)));
+    p_positions.release();
+
+    GLint active_texture = GL_TEXTURE0;
+    GLint bound_texture = 0;
+    if (face_normals) {
+        gl()->glDisableVertexAttribArray(ShaderLibrary::Instance0);
+        gl()->glGetIntegerv(GL_ACTIVE_TEXTURE, &active_texture);
+        gl()->glActiveTexture(GL_TEXTURE0);
+        gl()->glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound_texture);
+        upload_face_normals(normals);
+    } else {
+        copy(normals, p_staging);
+        p_normals.bind();
+        p_normals.allocate(p_staging.data(), static_cast<int>(p_staging.size() * sizeof(float)));
+        p_normals.release();
+        gl()->glEnableVertexAttribArray(ShaderLibrary::Instance0);
+    }
+
+    p_program->bind();
+    p_program->setUniformValue("u_projection", state.projection);
+    p_program->setUniformValue("u_modelview", state.modelview);
+    p_program->setUniformValue("u_normal_matrix", state.modelview.normalMatrix());
+    p_program->setUniformValue("u_lighting", state.lighting);
+    p_program->setUniformValue("u_color", color[0], color[1], color[2], color[3]);
+    p_program->setUniformValue("u_face_normals", face_normals);
+    p_program->setUniformValue("u_face_normals_texture", 0);
+    p_program->setUniformValue("u_face_normals_width", face_normals_texture_width);
+
+    gl()->glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(3 * triangles.size()), GL_UNSIGNED_INT, nullptr);
+
+    p_program->release();
+    if (face_normals) {
+        gl()->glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(bound_texture));
+        gl()->glActiveTexture(static_cast<GLenum>(active_texture));
+    }
+
+    return true;
+}
+
+void GeometryCache::end_frame() {
+    ++p_frame;
+    for (auto entry = p_index_buffers.begin(); entry != p_index_buffers.end();) {
+        if (p_frame - entry->second->last_used_frame > frames_before_eviction) {
+            entry = p_index_buffers.erase(entry);
+        } else {
+            ++entry;
+        }
+    }
+}
+
+std::uint64_t GeometryCache::fingerprint(const void * data, std::size_t size) {
+    // Multiply-xorshift over 64-bit words, which runs at about the speed of reading the memory
+    const auto * bytes = static_cast<const unsigned char *>(data);
+    std::uint64_t hash = 0xcbf29ce484222325ull ^ size;
+    std::size_t i = 0;
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+GeometryCache::IndexBuffer & GeometryCache::index_buffer(const std::vector<Vec3i> & triangles) {
+    const std::size_t number_of_indices = 3 * triangles.size();
+    const Key key {fingerprint(triangles.data(), number_of_indices * sizeof(GLuint)), number_of_indices};
+
+    auto & index_buffer = p_index_buffers[key];
+    if (index_buffer) {
+        ++p_number_of_hits;
+    } else {
+        index_buffer = std::make_unique<IndexBuffer>();
+        index_buffer->buffer.create();
+        index_buffer->buffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+        index_buffer->buffer.bind();
+        index_buffer->buffer.allocate(triangles.data(), static_cast<int>(number_of_indices * sizeof(GLuint)));
+        ++p_number_of_misses;
+    }
+    index_buffer->last_used_frame = p_frame;
+    return *index_buffer;
+}
+
+void GeometryCache::upload_face_normals(const std::vector<Vector3> & normals) {
+    const auto rows = static_cast<int>((normals.size() + face_normals_texture_width - 1) / face_normals_texture_width);
+    copy(normals, p_staging);
+    p_staging.resize(3 * static_cast<std::size_t>(rows) * face_normals_texture_width, 0.f);
+
+    gl()->glBindTexture(GL_TEXTURE_2D, p_face_normals_texture);
+    gl()->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (rows > p_face_normals_texture_height) {
+        // Grow the texture, it is never shrunk so that meshes of various sizes do not reallocate it at every draw
+        gl()->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        gl()->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        gl()->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, face_normals_texture_width, rows, 0, GL_RGB, GL_FLOAT,
+                           p_staging.data());
+        p_face_normals_texture_width = face_normals_texture_width;
+        p_face_normals_texture_height = rows;
+    } else {
+        gl()->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, face_normals_texture_width, rows, GL_RGB, GL_FLOAT,
+                              p_staging.data());
+    }
+}
+
+} // namespace sofa::helper::visual
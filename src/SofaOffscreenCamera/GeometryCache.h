@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+
+#include <sofa/type/RGBAColor.h>
+#include <sofa/type/Vec.h>
+
+#include "BatchRenderer.h"
+
+namespace sofa::helper::visual {
+
+/**
+ * Cross-frame cache of the index buffers of the indexed triangle sets drawn by the draw tools.
+ *
+ * The topology of most meshes (finite element meshes in particular) never changes, while their positions change at
+ * every step. Hence, the index buffer of a triangle set is uploaded once and kept resident, and only the positions
+ * and normals are streamed when it is drawn. Index buffers are identified by a 64-bit fingerprint of their content
+ * and their size, so that a topology drawn by several components, or drawn again after a change, is found without
+ * any help from the caller. Index buffers that have not been drawn for a few frames are released.
+ *
+ * The cache owns OpenGL objects: it must be created and destroyed while the OpenGL context it will be used with is
+ * current. It is meant to live as long as its camera.
+ */
+class GeometryCache {
+public:
+    using Vector3 = sofa::type::Vector3;
+    using Vec3i = sofa::type::Vec3i;
+    using RGBAColor = sofa::type::RGBAColor;
+    using State = BatchRenderer::State;
+
+    /** Number of frames an index buffer stays resident without being drawn. */
+    static constexpr unsigned int frames_before_eviction = 8;
+
+    GeometryCache();
+    ~GeometryCache();
+
+    /**
+     * Draw the indexed triangles with the current OpenGL blending, depth and polygon states. The normals are given
+     * either one per triangle or one per point, any other number of normals is rejected.
+     *
+     * @return False if the triangles could not be drawn, in which case the caller should draw them by itself.
+     */
+    bool draw(const State & state, const std::vector<Vector3> & points, const std::vector<Vec3i> & triangles,
+              const std::vector<Vector3> & normals, const RGBAColor & color);
+
+    /** Mark the end of a frame, releasing the index buffers unused for the last frames_before_eviction frames. */
+    void end_frame();
+
+    /** Number of draws which found their index buffer resident. */
+    std::size_t number_of_hits() const { return p_number_of_hits; }
+
+    /** Number of draws which had to upload their index buffer. */
+    std::size_t number_of_misses() const { return p_number_of_misses; }
+
+    /** Number of index buffers currently resident. */
+    std::size_t number_of_resident_buffers() const { return p_index_buffers.size(); }
+
+private:
+    /** Content fingerprint and size (in number of indices) of an index buffer. */
+    using Key = std::pair<std::uint64_t, std::size_t>;
+
+    struct IndexBuffer {
+        QOpenGLBuffer buffer {QOpenGLBuffer::IndexBuffer};
+        unsigned int last_used_frame = 0;
+    };
+
+    static std::uint64_t fingerprint(const void * data, std::size_t size);
+
+    /** Find the resident index buffer of the triangles, or upload it. */
+    IndexBuffer & index_buffer(const std::vector<Vec3i> & triangles);
+
+    /** Upload the normals of the triangles into the texture fetched by the fragment shader. */
+    void upload_face_normals(const std::vector<Vector3> & normals);
+
+    std::unique_ptr<QOpenGLShaderProgram> p_program;
+    QOpenGLVertexArrayObject p_vao;
+    QOpenGLBuffer p_positions {QOpenGLBuffer::VertexBuffer};
+    QOpenGLBuffer p_normals {QOpenGLBuffer::VertexBuffer};
+    GLuint p_face_normals_texture = 0;
+    int p_face_normals_texture_width = 0;
+    int p_face_normals_texture_height = 0;
+    int p_max_texture_size = 0;
+    std::vector<float> p_staging;
+    std::map<Key, std::unique_ptr<IndexBuffer>> p_index_buffers;
+    unsigned int p_frame = 0;
+    std::size_t p_number_of_hits = 0;
+    std::size_t p_number_of_misses = 0;
+};
+
+} // namespace sofa::helper::visual
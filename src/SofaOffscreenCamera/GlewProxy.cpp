@@ -1,5 +1,7 @@
 #include "GlewProxy.h"
 #include <GL/glew.h>
 void GlewProxy::init() {
+    // Without it, GLEW queries the extensions with glGetString(GL_EXTENSIONS), which fails on core-profile contexts
+    glewExperimental = GL_TRUE;
     glewInit();
 }
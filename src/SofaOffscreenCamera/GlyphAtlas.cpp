@@ -0,0 +1,43 @@
+#include "GlyphAtlas.h"
+
+#include <QFont>
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QImage>
+#include <QPainter>
+
+namespace sofa::helper::visual {
+
+GlyphAtlas::GlyphAtlas(int pixel_size) {
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setStyleHint(QFont::Monospace);
+    font.setPixelSize(pixel_size);
+    const QFontMetrics metrics(font);
+
+    const int cell_height = metrics.height();
+    const int cell_width = metrics.horizontalAdvance(QLatin1Char('M'));
+    p_aspect_ratio = static_cast<float>(cell_width) / static_cast<float>(cell_height);
+
+    // White glyphs on a transparent background, the color of the text is applied by the shader
+    QImage image(columns() * cell_width, rows() * cell_height, QImage::Format_RGBA8888);
+    image.fill(Qt::transparent);
+    {
+        QPainter painter(&image);
+        painter.setFont(font);
+        painter.setPen(Qt::white);
+        for (int i = 0; i < number_of_characters; ++i) {
+            const int x = (i % columns()) * cell_width;
+            const int y = (i / columns()) * cell_height;
+            painter.drawText(x, y + metrics.ascent(), QString(QChar(first_character + i)));
+        }
+    }
+
+    p_texture = std::make_unique<QOpenGLTexture>(image, QOpenGLTexture::GenerateMipMaps);
+    p_texture->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
+    p_texture->setMagnificationFilter(QOpenGLTexture::Linear);
+    p_texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+}
+
+GlyphAtlas::~GlyphAtlas() = default;
+
+} // namespace sofa::helper::visual
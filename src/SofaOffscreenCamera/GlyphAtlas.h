@@ -0,0 +1,43 @@
+#pragma once
+
+#include <memory>
+
+#include <QOpenGLTexture>
+
+namespace sofa::helper::visual {
+
+/**
+ * Texture holding the printable ASCII characters of a fixed-width font, rasterized once with Qt.
+ *
+ * The characters 32 to 127 are laid out on a grid of columns() x rows() cells of equal size, in increasing order
+ * from the top-left cell, row by row. The first texture row is the top of the first row of cells.
+ */
+class GlyphAtlas {
+public:
+    static constexpr int first_character = 32;
+    static constexpr int number_of_characters = 96;
+
+    /**
+     * Rasterize the font and upload it into a new texture. An OpenGL context must be current.
+     * @param pixel_size Height of a cell, in pixels. Larger sizes give sharper text when magnified.
+     */
+    explicit GlyphAtlas(int pixel_size = 48);
+    ~GlyphAtlas();
+
+    /** Number of cells per row of the atlas. */
+    static constexpr int columns() { return 16; }
+
+    /** Number of rows of cells of the atlas. */
+    static constexpr int rows() { return number_of_characters / columns(); }
+
+    /** Width of a cell divided by its height, which is also the advance of a character for a unit text height. */
+    float aspect_ratio() const { return p_aspect_ratio; }
+
+    QOpenGLTexture & texture() { return *p_texture; }
+
+private:
+    std::unique_ptr<QOpenGLTexture> p_texture;
+    float p_aspect_ratio = 0.5f;
+};
+
+} // namespace sofa::helper::visual
@@ -0,0 +1,122 @@
+#include "ImageDifference.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <QImage>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFAOFFSCREENCAMERA_HAS_SSE2
+#endif
+
+namespace {
+
+/**
+ * Luminance of the blocks of factor x factor pixels of the image, in 1/256th (BT.601 weights). Pixel is the layout of
+ * the pixels of the image, giving the weighted luminance of the pixel x of a line.
+ */
+template <typename Pixel>
+std::vector<std::uint8_t> block_luminance(const QImage & image, int factor) {
+    const int width = (image.width() + factor - 1) / factor;
+    const int height = (image.height() + factor - 1) / factor;
+
+    // Sums of the luminance of the blocks of the current row of blocks
+    std::vector<std::uint32_t> sums(static_cast<std::size_t>(width));
+    std::vector<std::uint8_t> luminance(static_cast<std::size_t>(width) * static_cast<std::size_t>(height));
+    for (int block_y = 0; block_y < height; ++block_y) {
+        std::fill(sums.begin(), sums.end(), 0);
+        const int first_row = block_y * factor;
+        const int last_row = std::min(first_row + factor, image.height());
+        for (int y = first_row; y < last_row; ++y) {
+            const uchar * line = image.constScanLine(y);
+            for (int block_x = 0; block_x < width; ++block_x) {
+                const int last_column = std::min(block_x * factor + factor, image.width());
+                std::uint32_t sum = 0;
+                for (int x = block_x * factor; x < last_column; ++x) {
+                    sum += Pixel::luminance(line, x);
+                }
+                sums[static_cast<std::size_t>(block_x)] += sum;
+            }
+        }
+
+        const int rows = last_row - first_row;
+        for (int block_x = 0; block_x < width; ++block_x) {
+            const int columns = std::min(factor, image.width() - block_x * factor);
+            const auto pixels = static_cast<std::uint32_t>(rows * columns);
+            luminance[static_cast<std::size_t>(block_y) * width + block_x] =
+                static_cast<std::uint8_t>(sums[static_cast<std::size_t>(block_x)] / (256 * pixels));
+        }
+    }
+    return luminance;
+}
+
+/** Bytes in the order R, G, B, A (or X), as read back from the framebuffers. */
+struct Rgba8888 {
+    static std::uint32_t luminance(const uchar * line, int x) {
+        const uchar * p = line + 4 * x;
+        return 77u * p[0] + 150u * p[1] + 29u * p[2];
+    }
+};
+
+/** 16-bit components in the order R, G, B, A (or X), as read back from the floating-point framebuffers. */
+struct Rgba64 {
+    static std::uint32_t luminance(const uchar * line, int x) {
+        const auto * p = reinterpret_cast<const quint16 *>(line) + 4 * x;
+        return 77u * (p[0] >> 8) + 150u * (p[1] >> 8) + 29u * (p[2] >> 8);
+    }
+};
+
+/** 32-bit QRgb values. */
+struct Rgb32 {
+    static std::uint32_t luminance(const uchar * line, int x) {
+        const QRgb p = reinterpret_cast<const QRgb *>(line)[x];
+        return 77u * qRed(p) + 150u * qGreen(p) + 29u * qBlue(p);
+    }
+};
+
+} // namespace
+
+std::vector<std::uint8_t> downsampled_luminance(const QImage & image, int factor) {
+    // The formats of the frames read back are downsampled as they are, the others are converted first
+    switch (image.format()) {
+        case QImage::Format_RGBA8888:
+        case QImage::Format_RGBA8888_Premultiplied:
+        case QImage::Format_RGBX8888:
+            return block_luminance<Rgba8888>(image, factor);
+        case QImage::Format_RGBA64:
+        case QImage::Format_RGBA64_Premultiplied:
+        case QImage::Format_RGBX64:
+            return block_luminance<Rgba64>(image, factor);
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+            return block_luminance<Rgb32>(image, factor);
+        default:
+            return block_luminance<Rgb32>(image.convertToFormat(QImage::Format_RGB32), factor);
+    }
+}
+
+double mean_absolute_difference(const std::uint8_t * a, const std::uint8_t * b, std::size_t size) {
+    if (size == 0)
+        return 0;
+
+    std::uint64_t sum = 0;
+    std::size_t i = 0;
+#ifdef SOFAOFFSCREENCAMERA_HAS_SSE2
+    // _mm_sad_epu8 sums the absolute differences of 8 bytes into each 64-bit half of the register
+    __m128i sums = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(va, vb));
+    }
+    alignas(16) std::uint64_t halves[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(halves), sums);
+    sum = halves[0] + halves[1];
+#endif
+    for (; i < size; ++i) {
+        sum += static_cast<std::uint64_t>(std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i])));
+    }
+    return static_cast<double>(sum) / static_cast<double>(size);
+}
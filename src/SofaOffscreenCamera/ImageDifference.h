@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class QImage;
+
+/**
+ * Luminance of the image averaged over blocks of factor x factor pixels, as one byte per block stored row by row.
+ * The blocks on the right and bottom borders may be partial.
+ */
+std::vector<std::uint8_t> downsampled_luminance(const QImage & image, int factor);
+
+/** Mean of the absolute differences between two arrays of bytes of the given size, in [0, 255]. */
+double mean_absolute_difference(const std::uint8_t * a, const std::uint8_t * b, std::size_t size);
@@ -0,0 +1,409 @@
+#include "ImageEncoders.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <jpeglib.h>
+#include <zlib.h>
+
+namespace {
+
+void check_arguments(int width, int height, int channels) {
+    if (width <= 0 or height <= 0 or (channels != 3 and channels != 4)) {
+        throw std::invalid_argument("Images must have a positive size and 3 or 4 channels.");
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// JPEG
+// ---------------------------------------------------------------------------------------------------------------------
+
+/**
+ * libjpeg reports its errors through a callback that must not return. The callback jumps back into jpeg_encode, which
+ * then releases the compressor and throws. The output buffer lives here rather than on the stack of jpeg_encode, since
+ * it is modified by libjpeg in between the setjmp and the longjmp.
+ */
+struct JpegErrorManager {
+    jpeg_error_mgr manager;
+    std::jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+    unsigned char * buffer = nullptr;
+    unsigned long size = 0;
+};
+
+void jpeg_error_exit(j_common_ptr info) {
+    auto * errors = reinterpret_cast<JpegErrorManager *>(info->err);
+    (*info->err->format_message)(info, errors->message);
+    std::longjmp(errors->jump, 1);
+}
+
+void jpeg_ignore_message(j_common_ptr) {}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// PNG
+// ---------------------------------------------------------------------------------------------------------------------
+
+constexpr std::uint8_t png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+/** Strips are not made smaller than this number of bytes, below which the threads cost more than they save. */
+constexpr std::size_t minimum_strip_size = std::size_t(256) << 10;
+
+void put_u32(std::vector<std::uint8_t> & bytes, std::uint32_t value) {
+    bytes.push_back(static_cast<std::uint8_t>(value >> 24));
+    bytes.push_back(static_cast<std::uint8_t>(value >> 16));
+    bytes.push_back(static_cast<std::uint8_t>(value >> 8));
+    bytes.push_back(static_cast<std::uint8_t>(value));
+}
+
+/** Start a chunk of the given type, whose data is then appended to png. @return The position of the chunk. */
+std::size_t begin_chunk(std::vector<std::uint8_t> & png, const char * type) {
+    const std::size_t start = png.size();
+    put_u32(png, 0); // Size of the data, known at the end of the chunk
+    png.insert(png.end(), type, type + 4);
+    return start;
+}
+
+/** Write the size of the data of the chunk starting at the given position, and append its CRC. */
+void end_chunk(std::vector<std::uint8_t> & png, std::size_t start) {
+    const std::size_t size = png.size() - start - 8;
+    for (int i = 0; i < 4; ++i) {
+        png[start + i] = static_cast<std::uint8_t>(size >> (24 - 8 * i));
+    }
+    const auto crc = crc32(0, png.data() + start + 4, static_cast<uInt>(size + 4));
+    put_u32(png, static_cast<std::uint32_t>(crc));
+}
+
+std::uint8_t paeth_predictor(int a, int b, int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    if (pa <= pb and pa <= pc) {
+        return static_cast<std::uint8_t>(a);
+    }
+    return static_cast<std::uint8_t>(pb <= pc ? b : c);
+}
+
+/**
+ * Filter a row into out, without its leading filter byte. above is the previous row of the image, all zeros for the
+ * first row. bpp is the number of bytes per pixel: the first pixel of the row has no left neighbor.
+ */
+void filter_row(PngFilter filter, const std::uint8_t * row, const std::uint8_t * above, std::size_t size, int bpp,
+                std::uint8_t * out) {
+    const auto first = static_cast<std::size_t>(bpp);
+    switch (filter) {
+        case PngFilter::None:
+        case PngFilter::Adaptive:
+            std::memcpy(out, row, size);
+            break;
+        case PngFilter::Sub:
+            std::memcpy(out, row, first);
+            for (std::size_t i = first; i < size; ++i) {
+                out[i] = static_cast<std::uint8_t>(row[i] - row[i - first]);
+            }
+            break;
+        case PngFilter::Up:
+            for (std::size_t i = 0; i < size; ++i) {
+                out[i] = static_cast<std::uint8_t>(row[i] - above[i]);
+            }
+            break;
+        case PngFilter::Average:
+            for (std::size_t i = 0; i < first; ++i) {
+                out[i] = static_cast<std::uint8_t>(row[i] - (above[i] >> 1));
+            }
+            for (std::size_t i = first; i < size; ++i) {
+                out[i] = static_cast<std::uint8_t>(row[i] - ((row[i - first] + above[i]) >> 1));
+            }
+            break;
+        case PngFilter::Paeth:
+            for (std::size_t i = 0; i < first; ++i) {
+                out[i] = static_cast<std::uint8_t>(row[i] - above[i]);
+            }
+            for (std::size_t i = first; i < size; ++i) {
+                out[i] = static_cast<std::uint8_t>(row[i] - paeth_predictor(row[i - first], above[i], above[i - first]));
+            }
+            break;
+    }
+}
+
+/** Sum of the filtered bytes taken as signed values, the heuristic of libpng to pick the filter of a row. */
+std::size_t filter_cost(const std::uint8_t * filtered, std::size_t size) {
+    std::size_t cost = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        cost += static_cast<std::size_t>(std::abs(static_cast<int>(static_cast<std::int8_t>(filtered[i]))));
+    }
+    return cost;
+}
+
+/** Copy a row of 16-bit samples into out, in the byte order of PNG (most significant byte first). */
+void to_big_endian(const std::uint8_t * row, std::size_t size, std::uint8_t * out) {
+    for (std::size_t i = 0; i < size; i += 2) {
+        std::uint16_t sample;
+        std::memcpy(&sample, row + i, sizeof(sample));
+        out[i] = static_cast<std::uint8_t>(sample >> 8);
+        out[i + 1] = static_cast<std::uint8_t>(sample & 0xff);
+    }
+}
+
+/** A strip of rows, filtered and compressed into a raw deflate stream. */
+struct Strip {
+    int first_row = 0;
+    int end_row = 0;
+    std::vector<std::uint8_t> deflated;
+    uLong adler = 0;        ///< Adler-32 checksum of the filtered rows
+    std::size_t size = 0;   ///< Size of the filtered rows
+    std::exception_ptr error;
+};
+
+void compress_strip(const std::uint8_t * pixels, int width, int channels, std::size_t stride,
+                    const PngOptions & options, bool last, Strip & strip) {
+    const int bpp = channels * options.bit_depth / 8;
+    const std::size_t row_size = static_cast<std::size_t>(width) * static_cast<std::size_t>(bpp);
+    const auto number_of_rows = static_cast<std::size_t>(strip.end_row - strip.first_row);
+    strip.size = number_of_rows * (row_size + 1);
+
+    // Filter the rows, each of them starting with the type of its filter
+    std::vector<std::uint8_t> filtered(strip.size);
+    std::vector<std::uint8_t> candidate;
+    if (options.filter == PngFilter::Adaptive) {
+        candidate.resize(row_size);
+    }
+    std::vector<std::uint8_t> zeros;
+    if (strip.first_row == 0) {
+        zeros.resize(row_size, 0);
+    }
+
+    // 16-bit rows are filtered once swapped into the byte order of PNG, hence the row above is kept swapped as well
+    const bool swap = options.bit_depth == 16;
+    std::vector<std::uint8_t> swapped_row;
+    std::vector<std::uint8_t> swapped_above;
+    if (swap) {
+        swapped_row.resize(row_size);
+        swapped_above.resize(row_size, 0);
+        if (strip.first_row > 0) {
+            to_big_endian(pixels + static_cast<std::size_t>(strip.first_row - 1) * stride, row_size,
+                          swapped_above.data());
+        }
+    }
+
+    for (int y = strip.first_row; y < strip.end_row; ++y) {
+        const std::uint8_t * row = pixels + static_cast<std::size_t>(y) * stride;
+        const std::uint8_t * above = y > 0 ? row - stride : zeros.data();
+        if (swap) {
+            if (y > strip.first_row) {
+                std::swap(swapped_row, swapped_above);
+            }
+            to_big_endian(row, row_size, swapped_row.data());
+            row = swapped_row.data();
+            above = swapped_above.data();
+        }
+        std::uint8_t * out = filtered.data() + static_cast<std::size_t>(y - strip.first_row) * (row_size + 1);
+
+        if (options.filter != PngFilter::Adaptive) {
+            out[0] = static_cast<std::uint8_t>(options.filter);
+            filter_row(options.filter, row, above, row_size, bpp, out + 1);
+            continue;
+        }
+
+        out[0] = static_cast<std::uint8_t>(PngFilter::None);
+        std::memcpy(out + 1, row, row_size);
+        std::size_t best_cost = filter_cost(out + 1, row_size);
+        for (auto filter : {PngFilter::Sub, PngFilter::Up, PngFilter::Average, PngFilter::Paeth}) {
+            filter_row(filter, row, above, row_size, bpp, candidate.data());
+            const std::size_t cost = filter_cost(candidate.data(), row_size);
+            if (cost < best_cost) {
+                best_cost = cost;
+                out[0] = static_cast<std::uint8_t>(filter);
+                std::memcpy(out + 1, candidate.data(), row_size);
+            }
+        }
+    }
+    strip.adler = adler32(adler32(0, Z_NULL, 0), filtered.data(), static_cast<uInt>(strip.size));
+
+    // Raw deflate stream (no zlib header nor checksum), so that the streams of the strips can be concatenated. The
+    // strips before the last one end with a sync flush, which aligns them on a byte boundary without a final block.
+    z_stream stream {};
+    const int strategy = options.filter == PngFilter::None ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+    if (deflateInit2(&stream, options.compression_level, Z_DEFLATED, -15, 8, strategy) != Z_OK) {
+        throw std::runtime_error("Failed to initialize the deflate stream of the PNG image.");
+    }
+    strip.deflated.resize(deflateBound(&stream, static_cast<uLong>(strip.size)) + 16);
+    stream.next_in = filtered.data();
+    stream.avail_in = static_cast<uInt>(strip.size);
+    stream.next_out = strip.deflated.data();
+    stream.avail_out = static_cast<uInt>(strip.deflated.size());
+    const int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    const bool compressed = (last ? status == Z_STREAM_END : status == Z_OK) and stream.avail_in == 0;
+    strip.deflated.resize(strip.deflated.size() - stream.avail_out);
+    deflateEnd(&stream);
+    if (not compressed) {
+        throw std::runtime_error("Failed to compress the PNG image.");
+    }
+}
+
+} // namespace
+
+std::vector<std::uint8_t> jpeg_encode(const std::uint8_t * pixels, int width, int height, int channels,
+                                      std::size_t stride, const JpegOptions & options) {
+    check_arguments(width, height, channels);
+
+    // Rows handed to libjpeg. libjpeg-turbo reads RGBA pixels directly, other versions of libjpeg need RGB ones.
+    std::vector<JSAMPROW> rows(static_cast<std::size_t>(height));
+#ifdef JCS_EXTENSIONS
+    const J_COLOR_SPACE color_space = channels == 4 ? JCS_EXT_RGBA : JCS_RGB;
+    const int input_components = channels;
+    for (int y = 0; y < height; ++y) {
+        rows[y] = const_cast<JSAMPROW>(pixels + static_cast<std::size_t>(y) * stride);
+    }
+#else
+    const J_COLOR_SPACE color_space = JCS_RGB;
+    const int input_components = 3;
+    std::vector<std::uint8_t> rgb;
+    if (channels == 4) {
+        const std::size_t row_size = static_cast<std::size_t>(width) * 3;
+        rgb.resize(row_size * static_cast<std::size_t>(height));
+        for (int y = 0; y < height; ++y) {
+            const std::uint8_t * in = pixels + static_cast<std::size_t>(y) * stride;
+            std::uint8_t * out = rgb.data() + static_cast<std::size_t>(y) * row_size;
+            for (int x = 0; x < width; ++x, in += 4, out += 3) {
+                out[0] = in[0];
+                out[1] = in[1];
+                out[2] = in[2];
+            }
+        }
+    }
+    for (int y = 0; y < height; ++y) {
+        rows[y] = channels == 4 ? rgb.data() + static_cast<std::size_t>(y) * width * 3
+                                : const_cast<JSAMPROW>(pixels + static_cast<std::size_t>(y) * stride);
+    }
+#endif
+
+    jpeg_compress_struct compressor;
+    JpegErrorManager errors;
+    compressor.err = jpeg_std_error(&errors.manager);
+    errors.manager.error_exit = jpeg_error_exit;
+    errors.manager.output_message = jpeg_ignore_message;
+    if (setjmp(errors.jump)) {
+        jpeg_destroy_compress(&compressor);
+        std::free(errors.buffer);
+        throw std::runtime_error(std::string("Failed to encode the JPEG image: ") + errors.message);
+    }
+
+    jpeg_create_compress(&compressor);
+    jpeg_mem_dest(&compressor, &errors.buffer, &errors.size);
+    compressor.image_width = static_cast<JDIMENSION>(width);
+    compressor.image_height = static_cast<JDIMENSION>(height);
+    compressor.input_components = input_components;
+    compressor.in_color_space = color_space;
+    jpeg_set_defaults(&compressor);
+    jpeg_set_quality(&compressor, std::clamp(options.quality, 1, 100), TRUE);
+
+    // The luminance is sampled at every pixel, the chrominance at every pixel for 4:4:4, every two columns for 4:2:2
+    // and every two columns and rows for 4:2:0
+    compressor.comp_info[0].h_samp_factor = options.subsampling == JpegSubsampling::S444 ? 1 : 2;
+    compressor.comp_info[0].v_samp_factor = options.subsampling == JpegSubsampling::S420 ? 2 : 1;
+    for (int i = 1; i < 3; ++i) {
+        compressor.comp_info[i].h_samp_factor = 1;
+        compressor.comp_info[i].v_samp_factor = 1;
+    }
+
+    jpeg_start_compress(&compressor, TRUE);
+    while (compressor.next_scanline < compressor.image_height) {
+        jpeg_write_scanlines(&compressor, rows.data() + compressor.next_scanline,
+                             compressor.image_height - compressor.next_scanline);
+    }
+    jpeg_finish_compress(&compressor);
+    jpeg_destroy_compress(&compressor);
+
+    std::vector<std::uint8_t> jpeg(errors.buffer, errors.buffer + errors.size);
+    std::free(errors.buffer);
+    return jpeg;
+}
+
+std::vector<std::uint8_t> png_encode(const std::uint8_t * pixels, int width, int height, int channels,
+                                     std::size_t stride, const PngOptions & options) {
+    check_arguments(width, height, channels);
+    if (options.compression_level < 0 or options.compression_level > 9) {
+        throw std::invalid_argument("The PNG compression level must be in [0, 9].");
+    }
+    if (options.bit_depth != 8 and options.bit_depth != 16) {
+        throw std::invalid_argument("The PNG bit depth must be 8 or 16.");
+    }
+
+    // Split the rows into strips of at least minimum_strip_size bytes, one per thread at most
+    const int bit_depth = options.bit_depth;
+    const int bpp = channels * bit_depth / 8;
+    const std::size_t row_size = static_cast<std::size_t>(width) * static_cast<std::size_t>(bpp) + 1;
+    const std::size_t image_size = row_size * static_cast<std::size_t>(height);
+    const unsigned int threads = options.threads > 0 ? options.threads
+                                                     : std::max(1u, std::thread::hardware_concurrency());
+    const auto number_of_strips = static_cast<int>(std::clamp<std::size_t>(image_size / minimum_strip_size, 1,
+                                                                            std::min<std::size_t>(threads, height)));
+    std::vector<Strip> strips(static_cast<std::size_t>(number_of_strips));
+    for (int i = 0; i < number_of_strips; ++i) {
+        strips[i].first_row = static_cast<int>(static_cast<long long>(height) * i / number_of_strips);
+        strips[i].end_row = static_cast<int>(static_cast<long long>(height) * (i + 1) / number_of_strips);
+    }
+
+    const auto compress = [&](int i) {
+        try {
+            compress_strip(pixels, width, channels, stride, options, i + 1 == number_of_strips, strips[i]);
+        } catch (...) {
+            strips[i].error = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < number_of_strips; ++i) {
+        workers.emplace_back(compress, i);
+    }
+    compress(0);
+    for (auto & worker : workers) {
+        worker.join();
+    }
+
+    std::size_t compressed_size = 0;
+    uLong adler = adler32(0, Z_NULL, 0);
+    for (const auto & strip : strips) {
+        if (strip.error) {
+            std::rethrow_exception(strip.error);
+        }
+        compressed_size += strip.deflated.size();
+        adler = adler32_combine(adler, strip.adler, static_cast<z_off_t>(strip.size));
+    }
+
+    std::vector<std::uint8_t> png(png_signature, png_signature + sizeof(png_signature));
+    png.reserve(sizeof(png_signature) + 3 * 12 + 13 + 6 + compressed_size); // Three chunks, IHDR and zlib data
+
+    std::size_t chunk = begin_chunk(png, "IHDR");
+    put_u32(png, static_cast<std::uint32_t>(width));
+    put_u32(png, static_cast<std::uint32_t>(height));
+    png.push_back(static_cast<std::uint8_t>(bit_depth)); // Bits per channel
+    png.push_back(channels == 4 ? 6 : 2);               // Color type: RGBA or RGB
+    png.push_back(0);                                   // Deflate compression
+    png.push_back(0);                                   // Adaptive filtering
+    png.push_back(0);                                   // No interlacing
+    end_chunk(png, chunk);
+
+    // The zlib stream of the image data: header (whose second byte hints at the compression level), the deflate
+    // streams of the strips, and the Adler-32 checksum of the filtered rows
+    chunk = begin_chunk(png, "IDAT");
+    const int level = options.compression_level;
+    png.push_back(0x78);
+    png.push_back(level < 2 ? 0x01 : level < 6 ? 0x5e : level == 6 ? 0x9c : 0xda);
+    for (const auto & strip : strips) {
+        png.insert(png.end(), strip.deflated.begin(), strip.deflated.end());
+    }
+    put_u32(png, static_cast<std::uint32_t>(adler));
+    end_chunk(png, chunk);
+
+    end_chunk(png, begin_chunk(png, "IEND"));
+    return png;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Encoders calling libjpeg(-turbo) and zlib directly on 8-bit RGB or RGBA pixels, without going through the image
+ * writer plugins of Qt. Images have 3 (RGB) or 4 (RGBA) channels of one byte each (two for 16-bit PNG images), and
+ * their rows are stride bytes apart. Errors are reported by throwing std::invalid_argument (bad arguments) or
+ * std::runtime_error.
+ */
+
+/** Chroma subsampling of the JPEG images, in the order of the jpeg_chroma_subsampling options of the camera. */
+enum class JpegSubsampling { S420, S422, S444 };
+
+struct JpegOptions {
+    int quality = 90; ///< In [1, 100]
+    JpegSubsampling subsampling = JpegSubsampling::S420;
+};
+
+/** Encode an image as a JPEG. The alpha channel, if any, is dropped. */
+std::vector<std::uint8_t> jpeg_encode(const std::uint8_t * pixels, int width, int height, int channels,
+                                      std::size_t stride, const JpegOptions & options);
+
+/**
+ * Filter applied to the rows of the PNG images, in the order of the png_filter options of the camera. The filters but
+ * Adaptive have the value of their type in the PNG format, Adaptive picks the best of them for every row.
+ */
+enum class PngFilter { None, Sub, Up, Average, Paeth, Adaptive };
+
+struct PngOptions {
+    int compression_level = 6; ///< zlib compression level, in [0, 9]
+    PngFilter filter = PngFilter::Up;
+    unsigned int threads = 0;  ///< Maximum number of threads compressing the image, 0 for one per core
+    int bit_depth = 8;         ///< 8, or 16 for pixels made of std::uint16_t samples (in the byte order of the CPU)
+};
+
+/**
+ * Encode an image as a PNG.
+ *
+ * Large images are split into strips of rows compressed in parallel into independent deflate streams, which are then
+ * concatenated (as pigz does) into the single zlib stream of the image. Each strip starts with an empty dictionary,
+ * which costs a few hundred bytes per strip.
+ */
+std::vector<std::uint8_t> png_encode(const std::uint8_t * pixels, int width, int height, int channels,
+                                     std::size_t stride, const PngOptions & options);
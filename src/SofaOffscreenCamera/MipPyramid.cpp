@@ -0,0 +1,138 @@
+#include "MipPyramid.h"
+
+#include "Readback.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+namespace {
+
+QOpenGLExtraFunctions * gl() {
+    return QOpenGLContext::currentContext()->extraFunctions();
+}
+
+/** Size of the RGBA pixels of an image of the given size, in bytes. */
+std::size_t number_of_bytes(const QSize & size) {
+    return 4 * static_cast<std::size_t>(size.width()) * static_cast<std::size_t>(size.height());
+}
+
+} // namespace
+
+MipPyramid::MipPyramid(const QSize & size, unsigned int levels, GLenum internal_format)
+: p_size(size)
+, p_region_size(size)
+, p_levels(std::min(levels, max_levels(size)))
+{
+    // Every level of the texture is allocated, since the framebuffer must be complete for each of them. The levels
+    // past the last one used are never generated. The texture has the format of the frames, which it is blitted from.
+    gl()->glGenTextures(1, &p_texture);
+    gl()->glBindTexture(GL_TEXTURE_2D, p_texture);
+    for (unsigned int level = 0; level <= p_levels; ++level) {
+        const QSize level_size = MipPyramid::level_size(size, level);
+        gl()->glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), static_cast<GLint>(internal_format),
+                           level_size.width(), level_size.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    gl()->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    gl()->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(p_levels));
+    gl()->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    gl()->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl()->glBindTexture(GL_TEXTURE_2D, 0);
+
+    gl()->glGenFramebuffers(1, &p_framebuffer);
+
+    std::size_t buffer_size = 0;
+    for (unsigned int level = 1; level <= p_levels; ++level) {
+        p_offsets.push_back(buffer_size);
+        buffer_size += number_of_bytes(level_size(size, level));
+    }
+    gl()->glGenBuffers(1, &p_pixel_buffer);
+    gl()->glBindBuffer(GL_PIXEL_PACK_BUFFER, p_pixel_buffer);
+    gl()->glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(std::max<std::size_t>(buffer_size, 4)), nullptr,
+                       GL_STREAM_READ);
+    gl()->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+MipPyramid::~MipPyramid() {
+    gl()->glDeleteBuffers(1, &p_pixel_buffer);
+    gl()->glDeleteFramebuffers(1, &p_framebuffer);
+    gl()->glDeleteTextures(1, &p_texture);
+}
+
+unsigned int MipPyramid::max_levels(const QSize & size) {
+    unsigned int levels = 0;
+    while ((size.width() >> (levels + 1)) > 0 or (size.height() >> (levels + 1)) > 0) {
+        ++levels;
+    }
+    return levels;
+}
+
+QSize MipPyramid::level_size(const QSize & size, unsigned int level) {
+    return {std::max(1, size.width() >> level), std::max(1, size.height() >> level)};
+}
+
+void MipPyramid::downsample(const QOpenGLFramebufferObject & framebuffer, const QRect & region) {
+    GLint bound_framebuffer = 0;
+    gl()->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound_framebuffer);
+
+    // Resolve the region of the frame into the origin of the level 0. The rest of the level is left as is, only the
+    // borders of the levels of a region of odd size may be blended with it.
+    const QRect source = region.isEmpty() ? QRect(QPoint(0, 0), p_size)
+                                          : to_gl_region(p_size, region.intersected(QRect(QPoint(0, 0), p_size)));
+    p_region_size = source.size();
+    gl()->glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer.handle());
+    gl()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, p_framebuffer);
+    gl()->glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, p_texture, 0);
+    gl()->glBlitFramebuffer(source.left(), source.top(), source.left() + source.width(),
+                            source.top() + source.height(), 0, 0, source.width(), source.height(),
+                            GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    gl()->glBindTexture(GL_TEXTURE_2D, p_texture);
+    gl()->glGenerateMipmap(GL_TEXTURE_2D);
+    gl()->glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Queue the readback of the levels into the pixel buffer, which returns without waiting for the GPU
+    gl()->glBindBuffer(GL_PIXEL_PACK_BUFFER, p_pixel_buffer);
+    gl()->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    gl()->glBindFramebuffer(GL_READ_FRAMEBUFFER, p_framebuffer);
+    for (unsigned int level = 1; level <= p_levels; ++level) {
+        const QSize level_size = MipPyramid::level_size(p_region_size, level);
+        gl()->glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, p_texture,
+                                     static_cast<GLint>(level));
+        gl()->glReadPixels(0, 0, level_size.width(), level_size.height(), GL_RGBA, GL_UNSIGNED_BYTE,
+                           reinterpret_cast<void *>(p_offsets[level - 1]));
+    }
+    gl()->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    gl()->glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(bound_framebuffer));
+}
+
+std::vector<QImage> MipPyramid::read() {
+    std::vector<QImage> images;
+    if (p_levels == 0) {
+        return images;
+    }
+
+    gl()->glBindBuffer(GL_PIXEL_PACK_BUFFER, p_pixel_buffer);
+    const std::size_t buffer_size = p_offsets.back() + number_of_bytes(level_size(p_region_size, p_levels));
+    const auto * pixels = static_cast<const uchar *>(
+        gl()->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(buffer_size), GL_MAP_READ_BIT));
+    if (pixels) {
+        for (unsigned int level = 1; level <= p_levels; ++level) {
+            const QSize level_size = MipPyramid::level_size(p_region_size, level);
+            const auto row_size = 4 * static_cast<std::size_t>(level_size.width());
+
+            // OpenGL reads the rows from the bottom up, as the frame read back by the framebuffer object is flipped
+            QImage image(level_size, QImage::Format_RGBA8888_Premultiplied);
+            const uchar * level_pixels = pixels + p_offsets[level - 1];
+            for (int y = 0; y < level_size.height(); ++y) {
+                std::memcpy(image.scanLine(level_size.height() - 1 - y), level_pixels + y * row_size, row_size);
+            }
+            images.push_back(std::move(image));
+        }
+        gl()->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    gl()->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return images;
+}
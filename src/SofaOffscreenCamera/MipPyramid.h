@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <QImage>
+#include <QOpenGLFramebufferObject>
+#include <QRect>
+#include <QSize>
+#include <qopengl.h>
+
+/**
+ * Downsampled copies of the frames of a camera, computed on the GPU.
+ *
+ * The color buffer of the framebuffer of the camera is copied into the first level of a mipmapped texture, whose
+ * other levels are then generated by glGenerateMipmap: level l is 2^l times smaller than the frame in both directions
+ * (rounded down, one pixel at least). The levels are read back asynchronously into a pixel buffer, while the frame
+ * itself is read back, and turned into images once needed.
+ *
+ * The pyramid must be created, used and destroyed while the OpenGL context of the framebuffer is current.
+ */
+class MipPyramid {
+public:
+    /**
+     * @param size Size of the frames, hence of the level 0.
+     * @param levels Number of downsampled levels, clamped to the number of levels of at least one pixel.
+     * @param internal_format Internal format of the color buffer of the frames, which the levels are computed with.
+     *                        They are read back as 8-bit images in any case.
+     */
+    MipPyramid(const QSize & size, unsigned int levels, GLenum internal_format = GL_RGBA8);
+    ~MipPyramid();
+
+    MipPyramid(const MipPyramid &) = delete;
+    MipPyramid & operator=(const MipPyramid &) = delete;
+
+    /** Largest number of downsampled levels of frames of the given size. */
+    static unsigned int max_levels(const QSize & size);
+
+    /** Size of the given level of frames of the given size. */
+    static QSize level_size(const QSize & size, unsigned int level);
+
+    unsigned int levels() const { return p_levels; }
+
+    /**
+     * Downsample a region of the color buffer of the framebuffer (which may be multisampled) into the levels, and
+     * start reading them back. The framebuffer bound is left untouched.
+     *
+     * @param region Region of the frame, in image coordinates (see FrameReadback::read), the whole frame by default.
+     */
+    void downsample(const QOpenGLFramebufferObject & framebuffer, const QRect & region = QRect());
+
+    /**
+     * Wait for the levels of the last downsample to be read back, and return their images, from level 1 to the last
+     * level.
+     */
+    std::vector<QImage> read();
+
+private:
+    QSize p_size;
+    QSize p_region_size; ///< Size of the region of the last downsample, stored at the origin of the level 0
+    unsigned int p_levels;
+    GLuint p_texture = 0;
+    GLuint p_framebuffer = 0;    ///< Bound to a level of the texture at a time
+    GLuint p_pixel_buffer = 0;
+    std::vector<std::size_t> p_offsets; ///< Position of each downsampled level in the pixel buffer
+};
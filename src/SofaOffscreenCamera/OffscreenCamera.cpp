@@ -1,10 +1,37 @@
+#include "BatchRenderer.h"
+#include "CameraDrawVisitor.h"
+#include "CaptureWorker.h"
+#include "GeometryCache.h"
 #include "GlewProxy.h"
+#include "ImageDifference.h"
+#include "ImageEncoders.h"
+#include "MipPyramid.h"
 #include "OffscreenCamera.h"
+#include "Qoi.h"
+#include "Readback.h"
 #include "QtDrawToolGL.h"
+#include "QtDrawToolGLCore.h"
+#include "RecordingDrawTool.h"
+#include "RecordingDrawVisitor.h"
+#include "Tracer.h"
+#include "VertexStream.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <locale>
 #include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <utility>
 
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMatrix4x4>
+
 #include <sofa/version.h>
 #include <sofa/core/ObjectFactory.h>
 #include <sofa/core/visual/VisualParams.h>
@@ -12,6 +39,7 @@
 #include <sofa/defaulttype/SolidTypes.h>
 #include <sofa/simulation/Node.h>
 #include <sofa/simulation/Simulation.h>
+#include <sofa/simulation/UpdateBoundingBoxVisitor.h>
 #include <sofa/simulation/VisualVisitor.h>
 
 #if (defined(SOFA_VERSION) && SOFA_VERSION > 201200)
@@ -20,14 +48,157 @@
 #include <sofa/simulation/AnimateEndEvent.h>
 #include <sofa/simulation/AnimateBeginEvent.h>
 
+namespace {
+
+/** Interpolation of the frames of the simulated-time schedule, in the order of the save_frame_interpolation options. */
+enum class Interpolation { Nearest, Blend };
+
+/** Format of the color buffer of the framebuffers, in the order of the color_format options. */
+enum class ColorFormat { RGBA8, RGBA16F, RGBA32F };
+
+GLenum internal_format(ColorFormat format) {
+    switch (format) {
+        case ColorFormat::RGBA8: return GL_RGBA8;
+        case ColorFormat::RGBA16F: return GL_RGBA16F;
+        case ColorFormat::RGBA32F: return GL_RGBA32F;
+    }
+    return GL_RGBA8;
+}
+
+/** Type of the components of the pixels grabbed from a color buffer of the given format. */
+ComponentType component_type(ColorFormat format) {
+    switch (format) {
+        case ColorFormat::RGBA8: return ComponentType::UInt8;
+        case ColorFormat::RGBA16F: return ComponentType::Float16;
+        case ColorFormat::RGBA32F: return ComponentType::Float32;
+    }
+    return ComponentType::UInt8;
+}
+
+/** Blend the components (of type Component) of the lines of a and b into result, w being the weight of b in 1/256. */
+template <typename Component>
+void blend_lines(const QImage & a, const QImage & b, unsigned int w, QImage & result) {
+    for (int y = 0; y < result.height(); ++y) {
+        const auto * a_line = reinterpret_cast<const Component *>(a.constScanLine(y));
+        const auto * b_line = reinterpret_cast<const Component *>(b.constScanLine(y));
+        auto * line = reinterpret_cast<Component *>(result.scanLine(y));
+        for (int x = 0; x < 4 * result.width(); ++x) {
+            line[x] = static_cast<Component>((a_line[x] * (256 - w) + b_line[x] * w + 128) >> 8);
+        }
+    }
+}
+
+/**
+ * Linear interpolation between two images of the same size, weight being the one of the second image. The images of
+ * a floating-point color buffer are blended with 16 bits per component, the others with 8 bits. Images of different
+ * sizes are not blended: the second one is returned as is.
+ */
+QImage blend(const QImage & first, const QImage & second, double weight) {
+    if (first.size() != second.size()) {
+        return second;
+    }
+    const auto w = static_cast<unsigned int>(std::lround(std::clamp(weight, 0., 1.) * 256));
+    const auto format = first.depth() >= 64 ? QImage::Format_RGBA64 : QImage::Format_RGBA8888;
+    const QImage a = first.convertToFormat(format);
+    const QImage b = second.convertToFormat(format);
+    QImage result(a.size(), format);
+    if (format == QImage::Format_RGBA64) {
+        blend_lines<quint16>(a, b, w, result);
+    } else {
+        blend_lines<uchar>(a, b, w, result);
+    }
+    return result;
+}
+
+/** Field of a CSV file, quoted (with its quotes doubled) if it holds a separator, a quote or a line break. */
+std::string csv_field(const std::string & text) {
+    if (text.find_first_of(",\"\r\n") == std::string::npos) {
+        return text;
+    }
+    std::string field = "\"";
+    for (const char c : text) {
+        field += c;
+        if (c == '"') {
+            field += '"';
+        }
+    }
+    return field + '"';
+}
+
+/** Side, in pixels, of the blocks averaged into the luminance compared by save_frame_change_threshold. */
+constexpr int luminance_block_size = 4;
+
+/**
+ * File path of the given level of a frame saved into filepath. The character set '%l' is replaced by the level, or, if
+ * there is none, the downsampled levels get the suffix '_l<level>' before the extension of the file.
+ */
+std::string level_filepath(std::string filepath, unsigned int level) {
+    const std::string level_number = std::to_string(level);
+    if (filepath.find("%l") == std::string::npos) {
+        if (level > 0) {
+            const auto separator = filepath.find_last_of("/\\");
+            auto extension = filepath.rfind('.');
+            if (extension == std::string::npos or (separator != std::string::npos and extension < separator)) {
+                extension = filepath.size();
+            }
+            filepath.insert(extension, "_l" + level_number);
+        }
+        return filepath;
+    }
+
+    for (auto pos = filepath.find("%l"); pos != std::string::npos; pos = filepath.find("%l", pos)) {
+        filepath.replace(pos, 2, level_number);
+        pos += level_number.size();
+    }
+    return filepath;
+}
+
+/**
+ * Node at the given path: absolute ('/a/b', or '@/a/b' as in links) or relative to the given node ('a/b'). Returns
+ * null if there is none.
+ */
+sofa::simulation::Node * find_node(sofa::simulation::Node * from, std::string path) {
+    if (not path.empty() and path.front() == '@') {
+        path.erase(0, 1);
+    }
+    auto * node = from;
+    if (not path.empty() and path.front() == '/') {
+        node = dynamic_cast<sofa::simulation::Node *>(from->getRoot());
+    }
+
+    std::size_t start = 0;
+    while (node and start < path.size()) {
+        auto end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        const std::string name = path.substr(start, end - start);
+        if (not name.empty() and name != ".") {
+            node = node->getChild(name);
+        }
+        start = end + 1;
+    }
+    return node;
+}
+
+/** Convert a column-major OpenGL matrix into a QMatrix4x4. */
+QMatrix4x4 to_qmatrix(const GLdouble * matrix) {
+    float values[16];
+    std::copy(matrix, matrix + 16, values);
+    return QMatrix4x4(values).transposed(); // QMatrix4x4 is built from row-major values
+}
+
+} // namespace
+
 OffscreenCamera::OffscreenCamera()
 : p_application(nullptr)
 , d_filepath(initData(&d_filepath,
     std::string("screenshot_%s_%i.jpg"),
     "filepath",
-    "Path of the image file. The special character set '%s' and '%i' can be used in the file name to specify the camera "
-    "name and the step number, respectively. Note that the step number will be 0 before the first step of the simulation, "
-    "and i after the ith step has been simulated.",
+    "Path of the image file. The special character set '%s', '%i' and '%t' can be used in the file name to specify the "
+    "camera name, the step number and the simulated time of the frame (with 6 decimals), respectively. Note that the "
+    "step number will be 0 before the first step of the simulation, and i after the ith step has been simulated. With "
+    "'save_frame_fps', '%f' specifies the frame number.",
     true  /*is_displayed_in_gui*/,
     false /*is_read_only*/ ))
 , d_save_frame_before_first_step(initData(&d_save_frame_before_first_step,
@@ -44,6 +215,136 @@ OffscreenCamera::OffscreenCamera()
     "Default to 0",
     true  /*is_displayed_in_gui*/,
     false /*is_read_only*/ ))
+, d_save_frame_fps(initData(&d_save_frame_fps,
+    0.,
+    "save_frame_fps",
+    "Render frames at this rate of simulated time (in frames per simulated second) and save them into 'filepath', "
+    "independently of the time step. The special character set '%f' of the file name is replaced by the number of "
+    "the frame. Set to zero to disable. Default to 0",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_save_frame_interpolation(initData(&d_save_frame_interpolation,
+    sofa::helper::OptionsGroup(2, "nearest", "blend"),
+    "save_frame_interpolation",
+    "How the frames of 'save_frame_fps' falling in between two steps are rendered: 'nearest' renders the step "
+    "nearest in time, 'blend' blends the renderings of the two steps linearly. Default to nearest",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_save_frame_change_threshold(initData(&d_save_frame_change_threshold,
+    0.,
+    "save_frame_change_threshold",
+    "Only save the frames rendered before the first step, after each n steps or at 'save_frame_fps' when they differ "
+    "enough from the last one saved: the mean absolute difference of their luminance (downsampled by 4 in both "
+    "directions, in [0, 1]) must reach this threshold. The frames are still rendered, but not encoded nor written. "
+    "Set to zero to save every frame. Default to 0",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_frame_index_filepath(initData(&d_frame_index_filepath,
+    std::string(),
+    "frame_index_filepath",
+    "CSV file listing the path, step number and simulated time of every frame saved before the first step, after "
+    "each n steps or at 'save_frame_fps', in order to rebuild a video from the frames saved with "
+    "'save_frame_change_threshold'. Default to an empty string (no index)",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_archive_filepath(initData(&d_archive_filepath,
+    std::string(),
+    "archive_filepath",
+    "Append the frames saved before the first step, after each n steps or at 'save_frame_fps' to this single archive "
+    "file, along with an index of their step numbers and simulated times, instead of writing one file per frame. The "
+    "frames are encoded in the format given by the extension of 'filepath', and named after it in the archive. The "
+    "special character set '%s' is replaced by the camera name. Default to an empty string (one file per frame)",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_jpeg_quality(initData(&d_jpeg_quality,
+    static_cast<unsigned int> (90),
+    "jpeg_quality",
+    "Quality of the JPEG frames, from 1 (smallest files) to 100 (best quality). Default to 90",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_jpeg_chroma_subsampling(initData(&d_jpeg_chroma_subsampling,
+    sofa::helper::OptionsGroup(3, "420", "422", "444"),
+    "jpeg_chroma_subsampling",
+    "Subsampling of the colors of the JPEG frames: '420' stores them for every two columns and rows of pixels, '422' "
+    "for every two columns and '444' for every pixel. Default to 420",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_png_compression_level(initData(&d_png_compression_level,
+    static_cast<unsigned int> (6),
+    "png_compression_level",
+    "zlib compression level of the PNG frames, from 0 (no compression, fastest) to 9 (smallest files, slowest). "
+    "Default to 6",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_png_filter(initData(&d_png_filter,
+    sofa::helper::OptionsGroup(6, "none", "sub", "up", "average", "paeth", "adaptive"),
+    "png_filter",
+    "Filter applied to the rows of the PNG frames before their compression. 'adaptive' picks the best filter for "
+    "every row, as most PNG encoders do, which compresses slightly better at about three times the cost of 'up'. "
+    "Default to up",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_encoding_threads(initData(&d_encoding_threads,
+    static_cast<unsigned int> (0),
+    "encoding_threads",
+    "Maximum number of threads compressing a PNG frame, whose rows are then split into strips compressed in "
+    "parallel. Set to zero to use one thread per core. Default to 0",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_mip_levels(initData(&d_mip_levels,
+    static_cast<unsigned int> (0),
+    "mip_levels",
+    "Number of downsampled copies of each frame saved, computed on the GPU from the same rendering: level l is 2^l "
+    "times smaller than the frame in both directions. The special character set '%l' of 'filepath' is replaced by "
+    "the level, 0 being the frame itself. Without it, the downsampled levels are saved next to the frame with the "
+    "suffix '_l' followed by their level. Default to 0",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_roi(initData(&d_roi,
+    sofa::type::Vec4i(0, 0, 0, 0),
+    "roi",
+    "Region of interest of the frames, as the position of its top-left corner (x, y) followed by its width and "
+    "height, in pixels from the top-left corner of the frame. Only this region is rendered, read back and saved, while "
+    "the projection of the camera stays the same. A zero width or height selects the whole frame. Default to 0 0 0 0",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_roi_node(initData(&d_roi_node,
+    std::string(),
+    "roi_node",
+    "Path of a node (such as '/beam' or '@/beam', or relative to the node of the camera) whose bounding box, "
+    "projected at every frame, is used as the region of interest instead of 'roi'. The whole frame is used when the "
+    "bounding box is not entirely in front of the camera or out of view. Default to an empty string (no node)",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_last_roi(initData(&d_last_roi,
+    sofa::type::Vec4i(0, 0, 0, 0),
+    "last_roi",
+    "Region of the frame (x, y, width and height in pixels) rendered for the last frame",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_pixel_format(initData(&d_pixel_format,
+    sofa::helper::OptionsGroup(4, "rgba", "bgra", "rgb", "gray"),
+    "pixel_format",
+    "Layout of the 8-bit pixels of the frames grabbed as arrays (grab_frame from python): 'rgba', 'bgra', 'rgb' or "
+    "'gray' (Rec. 601 luma). The rows are flipped and the pixels converted on the GPU, and read back straight into "
+    "the array. Saved frames are not affected. Default to rgba",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_color_format(initData(&d_color_format,
+    sofa::helper::OptionsGroup(3, "rgba8", "rgba16f", "rgba32f"),
+    "color_format",
+    "Format of the color buffer the frames are rendered into: 'rgba8', or half ('rgba16f') or single-precision "
+    "('rgba32f') floats, which keep more than 8 bits of precision. Floating-point frames are grabbed from python as "
+    "float16 or float32 arrays, and saved as 16-bit images when the format supports it (PNG). Set at init. Default "
+    "to rgba8",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_unchanged_frames_skipped(initData(&d_unchanged_frames_skipped,
+    static_cast<unsigned int> (0),
+    "unchanged_frames_skipped",
+    "Number of frames that were rendered but not saved since they were below 'save_frame_change_threshold'",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
 , d_multisampling(initData(&d_multisampling,
     static_cast<unsigned int> (-1),
     "multisampling",
@@ -51,7 +352,202 @@ OffscreenCamera::OffscreenCamera()
     "Default to -1",
     true  /*is_displayed_in_gui*/,
     false /*is_read_only*/ ))
+, d_core_profile(initData(&d_core_profile,
+    false,
+    "core_profile",
+    "Render with an OpenGL 3.3 core-profile context, drawing everything with buffers and shaders instead of the "
+    "fixed-function pipeline. Visual models such as OglModel are drawn with their vertex normals and diffuse color "
+    "only, and the other components issuing OpenGL calls themselves are not rendered. Default to false",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_pipelined(initData(&d_pipelined,
+    false,
+    "pipelined",
+    "Render the frames saved before the first step, after each n steps or at 'save_frame_fps' on a dedicated render "
+    "thread, while the simulation goes on with the next step. The scene is recorded at the end of the step, and the "
+    "frames are saved in their order of recording. Visual managers are not rendered, and visual models drawing "
+    "themselves with OpenGL (such as OglModel) are rendered with their vertex normals and their diffuse color only: "
+    "their textures, shaders, and the ambient, specular and emissive colors and shininess of their material are "
+    "ignored. Default to false",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_overlay_text(initData(&d_overlay_text,
+    std::string(),
+    "overlay_text",
+    "Text stamped on the top-left corner of every frame. The special character sets '%s', '%i' and '%t' are replaced "
+    "by the camera name, the step number and the simulated time of the frame (with 6 decimals), respectively. Lines "
+    "are separated by '\\n'. "
+    "Default to an empty string (no overlay)",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_overlay_font_size(initData(&d_overlay_font_size,
+    static_cast<unsigned int> (16),
+    "overlay_font_size",
+    "Height of a line of the overlay text, in pixels. Default to 16",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_overlay_color(initData(&d_overlay_color,
+    sofa::type::RGBAColor::white(),
+    "overlay_color",
+    "Color of the overlay text. Default to white",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_cache_gl_state(initData(&d_cache_gl_state,
+    false,
+    "cache_gl_state",
+    "Skip the OpenGL state changes requested to the draw tool that would not change the current state, and only save "
+    "the attribute groups it actually modifies. Only enable it if no component of the scene modifies the OpenGL state "
+    "directly between its calls to the draw tool, as such changes would otherwise leak into the next draws. Default "
+    "to false",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_gl_state_changes_issued(initData(&d_gl_state_changes_issued,
+    static_cast<unsigned int> (0),
+    "gl_state_changes_issued",
+    "Number of OpenGL state changes issued by the draw tool during the last rendered frame",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_gl_state_changes_elided(initData(&d_gl_state_changes_elided,
+    static_cast<unsigned int> (0),
+    "gl_state_changes_elided",
+    "Number of redundant OpenGL state changes skipped by the draw tool during the last rendered frame",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_frustum_culling(initData(&d_frustum_culling,
+    true,
+    "frustum_culling",
+    "Skip the visual models whose bounding box lies completely outside of the view of the camera. The boxes of the "
+    "models deriving from VisualModelImpl (such as OglModel) are computed from their vertices, and cached until they "
+    "move; the other models use their bbox data. Default to true",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_visual_models_tested(initData(&d_visual_models_tested,
+    static_cast<unsigned int> (0),
+    "visual_models_tested",
+    "Number of visual models tested against the view of the camera during the last rendered frame",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_visual_models_culled(initData(&d_visual_models_culled,
+    static_cast<unsigned int> (0),
+    "visual_models_culled",
+    "Number of visual models skipped during the last rendered frame, since outside of the view of the camera",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_profile(initData(&d_profile,
+    false,
+    "profile",
+    "Measure the duration of each stage of the frame capture into the 'timing_*' data. The statistics restart every "
+    "time the profiling is enabled. Default to false",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_timing_context_switch(initData(&d_timing_context_switch,
+    sofa::type::Vec3d(0, 0, 0),
+    "timing_context_switch",
+    "Time spent making the OpenGL context of the camera current, as the last, average and maximum durations in "
+    "milliseconds. Only measured when 'profile' is set",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_timing_pre_draw(initData(&d_timing_pre_draw,
+    sofa::type::Vec3d(0, 0, 0),
+    "timing_pre_draw",
+    "Time spent in the preDrawScene of the visual managers, as the last, average and maximum durations in "
+    "milliseconds. Only measured when 'profile' is set",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_timing_traversal(initData(&d_timing_traversal,
+    sofa::type::Vec3d(0, 0, 0),
+    "timing_traversal",
+    "Time spent drawing the scene graph on the CPU side, as the last, average and maximum durations in milliseconds. "
+    "Only measured when 'profile' is set",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_timing_post_draw(initData(&d_timing_post_draw,
+    sofa::type::Vec3d(0, 0, 0),
+    "timing_post_draw",
+    "Time spent in the postDrawScene of the visual managers, as the last, average and maximum durations in "
+    "milliseconds. Only measured when 'profile' is set",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_timing_gpu(initData(&d_timing_gpu,
+    sofa::type::Vec3d(0, 0, 0),
+    "timing_gpu",
+    "Time spent rendering the frame on the GPU, as the last, average and maximum durations in milliseconds. Only "
+    "measured when 'profile' is set",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_timing_readback(initData(&d_timing_readback,
+    sofa::type::Vec3d(0, 0, 0),
+    "timing_readback",
+    "Time spent copying the frame from the GPU, as the last, average and maximum durations in milliseconds. Only "
+    "measured when 'profile' is set",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_timing_encode(initData(&d_timing_encode,
+    sofa::type::Vec3d(0, 0, 0),
+    "timing_encode",
+    "Time spent compressing the frame into the format of the file, as the last, average and maximum durations in "
+    "milliseconds. Only measured when 'profile' is set",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_timing_write(initData(&d_timing_write,
+    sofa::type::Vec3d(0, 0, 0),
+    "timing_write",
+    "Time spent writing the frame into its file, as the last, average and maximum durations in milliseconds. Only "
+    "measured when 'profile' is set",
+    true  /*is_displayed_in_gui*/,
+    true  /*is_read_only*/ ))
+, d_trace_filepath(initData(&d_trace_filepath,
+    std::string(),
+    "trace_filepath",
+    "Record the stages of the frame captures and the simulation steps of every camera, and write them at exit into "
+    "this file in the Trace Event Format (JSON) of chrome://tracing and Perfetto. The trace is shared by all the "
+    "cameras of the process, only the first file given is used. Default to an empty string (no trace)",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_trajectory_times(initData(&d_trajectory_times,
+    "trajectory_times",
+    "Simulated times of the keyframes of the trajectory of the camera, in increasing order. When given, the camera "
+    "is moved along its trajectory before each frame it saves and at the end of each step, overriding 'position' and "
+    "'lookAt'. Default to none (no trajectory)",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_trajectory_positions(initData(&d_trajectory_positions,
+    "trajectory_positions",
+    "Positions of the camera at the keyframes of 'trajectory_times'",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_trajectory_look_ats(initData(&d_trajectory_look_ats,
+    "trajectory_look_ats",
+    "Points looked at by the camera at the keyframes of 'trajectory_times'",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_trajectory_ups(initData(&d_trajectory_ups,
+    "trajectory_ups",
+    "Up vectors of the camera at the keyframes of 'trajectory_times', to roll it. Default to none (the camera keeps "
+    "its own up vector)",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_trajectory_filepath(initData(&d_trajectory_filepath,
+    std::string(),
+    "trajectory_filepath",
+    "CSV file of the keyframes of the trajectory, read at init into the 'trajectory_*' data: one keyframe per line as "
+    "'time, position, look-at point' or 'time, position, look-at point, up vector'. Lines starting with '#' and a "
+    "header line are skipped. Default to an empty string (keyframes of the data)",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
+, d_trajectory_interpolation(initData(&d_trajectory_interpolation,
+    sofa::helper::OptionsGroup(3, "linear", "catmull_rom", "slerp"),
+    "trajectory_interpolation",
+    "Interpolation between the keyframes of the trajectory: 'linear' moves the position, look-at point and up vector "
+    "along straight lines, 'catmull_rom' moves the position and look-at point along smooth curves through the "
+    "keyframes, and 'slerp' rotates the camera at constant angular speed while its position and distance to the "
+    "look-at point change linearly. Default to linear",
+    true  /*is_displayed_in_gui*/,
+    false /*is_read_only*/ ))
 {
+    d_png_filter.beginEdit()->setSelectedItem(static_cast<unsigned int>(PngFilter::Up));
+    d_png_filter.endEdit();
+
     if (! QCoreApplication::instance()) {
         // In case we are not inside a Qt application (such as with SofaQt),
         // and a previous OffscreenCamera hasn't created it
@@ -62,18 +558,53 @@ OffscreenCamera::OffscreenCamera()
     }
 }
 
+OffscreenCamera::~OffscreenCamera() {
+    wait_for_pending_frames();
+    p_render_thread.reset();
+    p_capture_worker.reset();
+
+    // The instanced meshes of the renderer live in our context, it must be current to release them
+    if ((p_renderer || p_vertex_stream || p_geometry_cache || p_gpu_timer || p_mip_pyramid || p_readback) && p_context
+        && p_context->makeCurrent(p_surface)) {
+        p_readback.reset();
+        p_mip_pyramid.reset();
+        p_renderer.reset();
+        p_vertex_stream.reset();
+        p_geometry_cache.reset();
+        p_gpu_timer.reset();
+        p_context->doneCurrent();
+    }
+}
+
 void OffscreenCamera::init() {
     const auto & width = p_widthViewport.getValue();
     const auto & height = p_heightViewport.getValue();
     const auto & samples = d_multisampling.getValue();
 
+    if (not d_trace_filepath.getValue().empty()) {
+        Tracer::instance().open(d_trace_filepath.getValue());
+    }
+    p_profiler.set_trace_arguments(trace_arguments());
+
+    if (not d_archive_filepath.getValue().empty()) {
+        const auto archive_filepath = expand_placeholders(d_archive_filepath.getValue(), getContext()->getTime());
+        if (not p_archive.open(archive_filepath)) {
+            msg_error() << "Failed to create the frame archive '" << archive_filepath << "', the frames will be "
+                        << "written into their own files.";
+        }
+    }
+
     QSurfaceFormat format;
     format.setSamples(samples);
     format.setRenderableType(QSurfaceFormat::OpenGL);
     format.setSwapBehavior(QSurfaceFormat::DoubleBuffer);
-    format.setProfile(QSurfaceFormat::CompatibilityProfile);
-    format.setOption(QSurfaceFormat::DeprecatedFunctions, true);
-    format.setVersion(3, 2);
+    if (d_core_profile.getValue()) {
+        format.setProfile(QSurfaceFormat::CoreProfile);
+    } else {
+        format.setProfile(QSurfaceFormat::CompatibilityProfile);
+        format.setOption(QSurfaceFormat::DeprecatedFunctions, true);
+    }
+    format.setVersion(3, 3); // Instanced vertex attributes (glVertexAttribDivisor) are core since 3.3
 
     p_surface = new QOffscreenSurface;
     p_surface->create();
@@ -100,6 +631,8 @@ void OffscreenCamera::init() {
     msg_info() << "A new OpenGl context has been created.";
 
     Base::init();
+    load_trajectory();
+    apply_trajectory(getContext()->getTime());
     computeZ();
 
     if (not p_context->makeCurrent(p_surface)) {
@@ -108,7 +641,11 @@ void OffscreenCamera::init() {
     }
     msg_info() << "This new OpenGl context is now the current context.";
 
-    p_framebuffer = new QOpenGLFramebufferObject(width, height, GL_TEXTURE_2D);
+    const auto color_format = static_cast<ColorFormat>(d_color_format.getValue().getSelectedId());
+    QOpenGLFramebufferObjectFormat framebuffer_format;
+    framebuffer_format.setTextureTarget(GL_TEXTURE_2D);
+    framebuffer_format.setInternalTextureFormat(internal_format(color_format));
+    p_framebuffer = new QOpenGLFramebufferObject(width, height, framebuffer_format);
     msg_info() << "Framebuffer created.";
 
     if (not p_framebuffer->bind()) {
@@ -117,6 +654,11 @@ void OffscreenCamera::init() {
 
     GlewProxy::init();
     initGL();
+    p_renderer = std::make_unique<sofa::helper::visual::BatchRenderer>();
+    p_geometry_cache = std::make_unique<sofa::helper::visual::GeometryCache>();
+    if (d_core_profile.getValue()) {
+        p_vertex_stream = std::make_unique<sofa::helper::visual::VertexStream>();
+    }
 
     p_framebuffer->release();
 
@@ -124,10 +666,95 @@ void OffscreenCamera::init() {
     if (previous_context && previous_surface) {
         previous_context->makeCurrent(previous_surface);
     }
+
+    if (d_pipelined.getValue()) {
+        p_render_thread = std::make_unique<RenderThread>(*p_context, QSize(width, height),
+                                                         internal_format(color_format), d_core_profile.getValue(),
+                                                         d_cache_gl_state.getValue(), [this]() { initGL(); });
+        if (p_render_thread->valid()) {
+            p_render_thread->set_trace_arguments(trace_arguments());
+            msg_info() << "Render thread started.";
+        } else {
+            msg_error() << "Failed to start the render thread, the frames will be rendered synchronously.";
+            p_render_thread.reset();
+        }
+    }
 }
 
 QImage OffscreenCamera::grab_frame() {
-    using Transform = sofa::defaulttype::SolidTypes<SReal>::Transform;
+    return render_frame(0).front();
+}
+
+void OffscreenCamera::grab_pixels(const PixelAllocator & allocate) {
+    const auto format = static_cast<PixelFormat>(d_pixel_format.getValue().getSelectedId());
+    const auto type = component_type(static_cast<ColorFormat>(d_color_format.getValue().getSelectedId()));
+    render_frame(0, [&](const QRect & region) {
+        const QRect clipped = FrameReadback::clip_region(p_framebuffer->size(), region);
+        auto * pixels = allocate(clipped.width(), clipped.height(), channels(format), type);
+        if (pixels) {
+            const auto stride = static_cast<std::size_t>(clipped.width() * channels(format)) * component_size(type);
+            p_readback->read(*p_framebuffer, clipped, format, type, pixels, stride);
+        }
+    });
+}
+
+OffscreenCamera::PooledFrame OffscreenCamera::grab_pooled_frame() {
+    PooledFrame frame;
+    grab_pixels([&frame, this](int width, int height, int channels, ComponentType type) {
+        frame = {p_frame_buffers.acquire(static_cast<std::size_t>(width * height * channels) * component_size(type)),
+                 width, height, channels, type};
+        return static_cast<void *>(frame.pixels->data());
+    });
+    return frame;
+}
+
+void OffscreenCamera::grab_pixels_async(PixelAllocator allocate, std::function<void(bool grabbed)> on_grabbed) {
+    Tracer::Scope trace_scope("grab_pixels_async", trace_arguments());
+    auto & worker = capture_worker();
+    if (not worker.has_context()) {
+        bool grabbed = false;
+        grab_pixels([&](int width, int height, int channels, ComponentType type) {
+            void * pixels = allocate(width, height, channels, type);
+            grabbed = pixels != nullptr;
+            return pixels;
+        });
+        on_grabbed(grabbed);
+        return;
+    }
+
+    const auto format = static_cast<PixelFormat>(d_pixel_format.getValue().getSelectedId());
+    const auto type = component_type(static_cast<ColorFormat>(d_color_format.getValue().getSelectedId()));
+    FrameReadback::PendingRead pending;
+    QSize size;
+    render_frame(0, [&](const QRect & region) {
+        size = FrameReadback::clip_region(p_framebuffer->size(), region).size();
+        const auto stride = static_cast<std::size_t>(size.width() * channels(format)) * component_size(type);
+        pending = p_readback->read_async(*p_framebuffer, region, format, type, stride);
+    });
+
+    // The pixel buffer is shared with the context of the worker, which waits for the GPU instead of the camera
+    worker.post([this, pending, size, format, type, allocate = std::move(allocate),
+                 on_grabbed = std::move(on_grabbed)]() mutable {
+        void * pixels = nullptr;
+        try {
+            pixels = allocate(size.width(), size.height(), channels(format), type);
+        } catch (const std::exception & error) {
+            msg_error() << "Failed to allocate the pixels of the frame: " << error.what();
+        }
+        on_grabbed(FrameReadback::finish(pending, pixels));
+    });
+}
+
+std::vector<QImage> OffscreenCamera::render_frame(unsigned int mip_levels,
+                                                  const std::function<void(const QRect & region)> & read_frame) {
+    using Stage = FrameProfiler::Stage;
+    // The frames recorded before are saved first, so that the frames are always saved in their order of rendering.
+    // The asynchronous captures are not waited for, they are independent of the frames rendered from now on.
+    if (p_render_thread) {
+        p_render_thread->wait();
+    }
+
+    Tracer::Scope trace_scope("grab_frame", trace_arguments());
     if (! p_framebuffer) {
         throw std::runtime_error("Framebuffer hasn't been created. Have you run the "
                                  "init() method of the OffscreenCamera component?");
@@ -137,43 +764,64 @@ QImage OffscreenCamera::grab_frame() {
         throw std::runtime_error("No OpenGL context. Have you run the init() method of the "
                                  "OffscreenCamera component?");
     }
+
+    update_profiler();
+
     auto * previous_context = QOpenGLContext::currentContext();
     auto * previous_surface = previous_context ? previous_context->surface() : nullptr;
-    if (not p_context->makeCurrent(p_surface)) {
-        throw std::runtime_error("Failed to swap the surface of OpenGL context.");
+    {
+        FrameProfiler::Scope scope(p_profiler, Stage::ContextSwitch);
+        if (not p_context->makeCurrent(p_surface)) {
+            throw std::runtime_error("Failed to swap the surface of OpenGL context.");
+        }
+
+        if (not p_framebuffer->bind()) {
+            throw std::runtime_error("Failed to bind the OpenGL framebuffer.");
+        }
     }
 
-    if (not p_framebuffer->bind()) {
-        throw std::runtime_error("Failed to bind the OpenGL framebuffer.");
+    // The timer query is created lazily since the profiling can be enabled at any time
+    if (p_profiler.enabled() and not p_gpu_timer) {
+        p_gpu_timer = std::make_unique<QOpenGLTimerQuery>();
+        if (not p_gpu_timer->create()) {
+            msg_warning() << "Timer queries are not supported by the OpenGL context, the GPU time will not be measured.";
+        }
+    }
+    const bool time_gpu = p_profiler.enabled() and p_gpu_timer->isCreated();
+    if (time_gpu) {
+        p_gpu_timer->begin();
     }
 
     const auto & width = p_framebuffer->width();
     const auto & height = p_framebuffer->height();
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClearDepth(1.0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    const bool core_profile = (p_vertex_stream != nullptr);
 
     GLdouble projectionMatrix[16];
-    getOpenGLProjectionMatrix(projectionMatrix);
+    GLdouble modelViewMatrix[16];
+    compute_matrices(projectionMatrix, modelViewMatrix);
     glViewport(0, 0, width, height);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glMultMatrixd(projectionMatrix);
 
-    // We recompute the MVM since sofa doesn't do it unless the "look-at" changed. Hence,
-    // in the case the camera position moved, but not the "look-at", the orientation will
-    // be wrong.
-    const auto currentPos = p_position.getValue();
-    currentLookAt = p_lookAt.getValue();
-    auto currentOrientation = getOrientationFromLookAt(currentPos, currentLookAt);
-    auto world_to_cam = Transform(currentPos, currentOrientation);
-    p_orientation.setValue(currentOrientation);
+    // Only the region of interest is cleared and rasterized, the viewport (hence the projection) stays the same
+    const QRect region = compute_region_of_interest(projectionMatrix, modelViewMatrix);
+    if (not region.isEmpty()) {
+        const QRect gl_region = to_gl_region(p_framebuffer->size(), region);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(gl_region.x(), gl_region.y(), gl_region.width(), gl_region.height());
+    }
 
-    GLdouble modelViewMatrix[16];
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    world_to_cam.inversed().writeOpenGlMatrix(modelViewMatrix);
-    glMultMatrixd(modelViewMatrix);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClearDepth(1.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // The core profile has no matrix stack, the matrices are given to its draw tool instead
+    if (not core_profile) {
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        glMultMatrixd(projectionMatrix);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        glMultMatrixd(modelViewMatrix);
+    }
 
     sofa::core::visual::VisualParams visual_parameters;
     visual_parameters.zNear() = getZNear();
@@ -182,51 +830,146 @@ QImage OffscreenCamera::grab_frame() {
     visual_parameters.setProjectionMatrix(projectionMatrix);
     visual_parameters.setModelViewMatrix(modelViewMatrix);
 
-    glEnable(GL_LIGHTING);
     glEnable(GL_DEPTH_TEST);
-    glShadeModel(GL_SMOOTH);
-    glColor4f(1, 1, 1, 1);
-    glDisable(GL_COLOR_MATERIAL);
+    if (not core_profile) {
+        glEnable(GL_LIGHTING);
+        glShadeModel(GL_SMOOTH);
+        glColor4f(1, 1, 1, 1);
+        glDisable(GL_COLOR_MATERIAL);
+    }
 
     auto * node = dynamic_cast<sofa::simulation::Node*>(getContext());
     auto * root = dynamic_cast<sofa::simulation::Node*>(node->getRoot());
 
-    sofa::helper::visual::QtDrawToolGL draw_tool;
-    visual_parameters.drawTool() = &draw_tool;
+    std::unique_ptr<sofa::helper::visual::DrawTool> draw_tool;
+    sofa::helper::visual::QtDrawToolGL * cached_draw_tool = nullptr; // Draw tool with a state cache, if any
+    if (core_profile) {
+        draw_tool = std::make_unique<sofa::helper::visual::QtDrawToolGLCore>(
+            *p_renderer, *p_vertex_stream, to_qmatrix(projectionMatrix), to_qmatrix(modelViewMatrix),
+            p_geometry_cache.get());
+    } else {
+        auto compatibility_draw_tool = std::make_unique<sofa::helper::visual::QtDrawToolGL>(
+            *p_renderer, d_cache_gl_state.getValue(), p_geometry_cache.get());
+        cached_draw_tool = compatibility_draw_tool.get();
+        draw_tool = std::move(compatibility_draw_tool);
+    }
+    visual_parameters.drawTool() = draw_tool.get();
+
+    // Submit everything that has been queued by the draw tool so far
+    const auto flush = [this]() {
+        if (p_vertex_stream)
+            p_vertex_stream->flush();
+        p_renderer->flush();
+    };
     visual_parameters.setSupported(sofa::core::visual::API_OpenGL);
     visual_parameters.update();
 
     auto root_visual_managers = root->visualManager;
-    for (auto * visual_manager : root_visual_managers) {
-        visual_manager->preDrawScene(&visual_parameters);
+    {
+        FrameProfiler::Scope scope(p_profiler, Stage::PreDraw);
+        for (auto * visual_manager : root_visual_managers) {
+            visual_manager->preDrawScene(&visual_parameters);
+        }
     }
+    std::optional<FrameProfiler::Scope> traversal_scope;
+    traversal_scope.emplace(p_profiler, Stage::Traversal);
     bool rendered = false; // true if a manager did the rendering
     for (auto * visual_manager : root_visual_managers) {
+        if (cached_draw_tool)
+            cached_draw_tool->invalidate_state_cache();
         rendered = visual_manager->drawScene(&visual_parameters);
         if (rendered)
             break;
     }
 
     if (!rendered) {
-        visual_parameters.pass() = sofa::core::visual::VisualParams::Std;
-        sofa::simulation::VisualDrawVisitor act ( &visual_parameters );
-        act.setTags(this->getTags());
-        node->execute ( &act );
+        auto * culler = begin_culling(projectionMatrix, modelViewMatrix);
+        // The visual models drawing themselves with fixed-function calls (such as OglModel) would draw nothing in the
+        // core profile, they are drawn through the draw tool as triangle sets instead, as when they are recorded
+        const auto draw_pass = [&](sofa::core::visual::VisualParams::Pass pass) {
+            visual_parameters.pass() = pass;
+            if (core_profile) {
+                RecordingDrawVisitor act ( &visual_parameters, culler );
+                act.setTags(this->getTags());
+                node->execute ( &act );
+            } else {
+                CameraDrawVisitor act ( &visual_parameters, cached_draw_tool, culler );
+                act.setTags(this->getTags());
+                node->execute ( &act );
+            }
+        };
+        draw_pass(sofa::core::visual::VisualParams::Std);
+        flush();
+        draw_pass(sofa::core::visual::VisualParams::Transparent);
+        publish_culling_statistics(culler);
+    } else {
+        publish_culling_statistics(nullptr); // The visual manager drew the scene its own way
+    }
 
-        visual_parameters.pass() = sofa::core::visual::VisualParams::Transparent;
-        sofa::simulation::VisualDrawVisitor act2 ( &visual_parameters );
-        act2.setTags(this->getTags());
-        node->execute ( &act2 );
+    draw_overlay(*draw_tool);
+    flush();
+    traversal_scope.reset();
+
+    {
+        FrameProfiler::Scope scope(p_profiler, Stage::PostDraw);
+        for (auto visual_manager = root_visual_managers.rbegin(); visual_manager != root_visual_managers.rend(); ++visual_manager) {
+            if (cached_draw_tool)
+                cached_draw_tool->invalidate_state_cache();
+            (*visual_manager)->postDrawScene(&visual_parameters);
+        }
     }
 
-    for (auto visual_manager = root_visual_managers.rbegin(); visual_manager != root_visual_managers.rend(); ++visual_manager) {
-        (*visual_manager)->postDrawScene(&visual_parameters);
+    if (cached_draw_tool) {
+        const auto & state_cache_statistics = cached_draw_tool->state_cache_statistics();
+        d_gl_state_changes_issued.setValue(static_cast<unsigned int>(state_cache_statistics.issued));
+        d_gl_state_changes_elided.setValue(static_cast<unsigned int>(state_cache_statistics.elided));
     }
+    p_geometry_cache->end_frame();
 
     glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
+    glDisable(GL_SCISSOR_TEST);
+    if (not core_profile) {
+        glDisable(GL_LIGHTING);
+    }
+
+    if (time_gpu) {
+        p_gpu_timer->end();
+    }
+    if (p_profiler.enabled()) {
+        // Wait for the GPU here, otherwise the readback would also measure the end of the rendering
+        glFinish();
+    }
 
-    QImage frame = p_framebuffer->toImage();
+    // The downsampled levels are read back asynchronously while the frame is read back
+    std::vector<QImage> frames;
+    {
+        FrameProfiler::Scope scope(p_profiler, Stage::Readback);
+        if (mip_levels > 0) {
+            const unsigned int levels = std::min(mip_levels, MipPyramid::max_levels(p_framebuffer->size()));
+            if (not p_mip_pyramid or p_mip_pyramid->levels() != levels) {
+                p_mip_pyramid = std::make_unique<MipPyramid>(p_framebuffer->size(), levels,
+                                                             p_framebuffer->format().internalTextureFormat());
+            }
+            p_mip_pyramid->downsample(*p_framebuffer, region);
+        }
+        if (not p_readback) {
+            p_readback = std::make_unique<FrameReadback>();
+        }
+        if (read_frame) {
+            read_frame(region);
+            frames.emplace_back();
+        } else {
+            frames.push_back(p_readback->read_image(*p_framebuffer, region));
+        }
+        if (mip_levels > 0) {
+            for (auto & level : p_mip_pyramid->read()) {
+                frames.push_back(std::move(level));
+            }
+        }
+    }
+    if (time_gpu) {
+        p_profiler.record(Stage::Gpu, static_cast<double>(p_gpu_timer->waitForResult()) * 1e-6);
+    }
     p_context->swapBuffers(p_surface);
     if (previous_context && previous_surface) {
         previous_context->makeCurrent(previous_surface);
@@ -236,9 +979,315 @@ QImage OffscreenCamera::grab_frame() {
         throw std::runtime_error("Failed to release the OpenGL framebuffer.");
     }
 
+    publish_timings();
+
+    return frames;
+}
+
+RenderThread::Frame OffscreenCamera::record_frame() {
+    using Stage = FrameProfiler::Stage;
+    Tracer::Scope trace_scope("record_frame", trace_arguments());
+    update_profiler();
+
+    // Components issuing OpenGL calls themselves while being recorded draw into the surface of the camera, which is
+    // never read, rather than into the context of the application
+    auto * previous_context = QOpenGLContext::currentContext();
+    auto * previous_surface = previous_context ? previous_context->surface() : nullptr;
+    {
+        FrameProfiler::Scope scope(p_profiler, Stage::ContextSwitch);
+        if (not p_context->makeCurrent(p_surface)) {
+            throw std::runtime_error("Failed to swap the surface of OpenGL context.");
+        }
+    }
+
+    GLdouble projectionMatrix[16];
+    GLdouble modelViewMatrix[16];
+    compute_matrices(projectionMatrix, modelViewMatrix);
+
+    sofa::core::visual::VisualParams visual_parameters;
+    visual_parameters.zNear() = getZNear();
+    visual_parameters.zFar() = getZFar();
+    visual_parameters.viewport() = sofa::type::fixed_array<int, 4> (0, 0, p_framebuffer->width(), p_framebuffer->height());
+    visual_parameters.setProjectionMatrix(projectionMatrix);
+    visual_parameters.setModelViewMatrix(modelViewMatrix);
+
+    auto recording = p_render_thread->recording();
+    visual_parameters.drawTool() = recording.get();
+    visual_parameters.setSupported(sofa::core::visual::API_OpenGL);
+    visual_parameters.update();
+
+    auto * node = dynamic_cast<sofa::simulation::Node*>(getContext());
+    {
+        FrameProfiler::Scope scope(p_profiler, Stage::Traversal);
+        auto * culler = begin_culling(projectionMatrix, modelViewMatrix);
+        visual_parameters.pass() = sofa::core::visual::VisualParams::Std;
+        RecordingDrawVisitor act ( &visual_parameters, culler );
+        act.setTags(this->getTags());
+        node->execute ( &act );
+        recording->add_flush();
+
+        visual_parameters.pass() = sofa::core::visual::VisualParams::Transparent;
+        RecordingDrawVisitor act2 ( &visual_parameters, culler );
+        act2.setTags(this->getTags());
+        node->execute ( &act2 );
+        publish_culling_statistics(culler);
+
+        draw_overlay(*recording);
+    }
+
+    if (previous_context && previous_surface) {
+        previous_context->makeCurrent(previous_surface);
+    }
+
+    RenderThread::Frame frame;
+    frame.recording = std::move(recording);
+    frame.projection = to_qmatrix(projectionMatrix);
+    frame.modelview = to_qmatrix(modelViewMatrix);
+    frame.region = compute_region_of_interest(projectionMatrix, modelViewMatrix);
     return frame;
 }
 
+void OffscreenCamera::capture_automatic_frames(std::vector<AutomaticFrame> frames) {
+    using Stage = FrameProfiler::Stage;
+    if (frames.empty()) {
+        return;
+    }
+    apply_trajectory(frames.front().time);
+
+    if (not p_render_thread) {
+        p_frame_time = frames.front().time;
+        const auto images = render_frame(d_mip_levels.getValue());
+        p_frame_time.reset();
+        for (const auto & automatic_frame : frames) {
+            save_automatic_frame(images, automatic_frame);
+        }
+        return;
+    }
+
+    p_frame_time = frames.front().time;
+    auto frame = record_frame();
+    p_frame_time.reset();
+    frame.mip_levels = d_mip_levels.getValue();
+    frame.on_rendered = [this, frames = std::move(frames)](const std::vector<QImage> & images, double render_time,
+                                                           double readback_time) {
+        if (images.empty() or images.front().isNull()) {
+            msg_error() << "Failed to render the frame on the render thread.";
+            return;
+        }
+        if (p_profiler.enabled()) {
+            p_profiler.record(Stage::Gpu, render_time);
+            p_profiler.record(Stage::Readback, readback_time);
+        }
+        for (const auto & automatic_frame : frames) {
+            save_automatic_frame(images, automatic_frame);
+        }
+    };
+    p_render_thread->submit(std::move(frame));
+    publish_timings();
+}
+
+void OffscreenCamera::wait_for_pending_frames() {
+    if (p_render_thread) {
+        p_render_thread->wait();
+    }
+    if (p_capture_worker) {
+        p_capture_worker->wait();
+    }
+}
+
+CaptureWorker & OffscreenCamera::capture_worker() {
+    if (not p_context) {
+        throw std::runtime_error("No OpenGL context. Have you run the init() method of the "
+                                 "OffscreenCamera component?");
+    }
+    if (not p_capture_worker) {
+        p_capture_worker = std::make_unique<CaptureWorker>(*p_context);
+    }
+    return *p_capture_worker;
+}
+
+void OffscreenCamera::load_trajectory() {
+    p_trajectory.reset();
+    p_up.reset();
+    try {
+        const auto & filepath = d_trajectory_filepath.getValue();
+        if (not filepath.empty()) {
+            // The keyframes of the file replace the ones of the data, which then show them
+            bool has_up = false;
+            const auto keyframes = CameraTrajectory::read_csv(filepath, has_up);
+            sofa::type::vector<double> times;
+            sofa::type::vector<sofa::type::Vec3d> positions, look_ats, ups;
+            for (const auto & keyframe : keyframes) {
+                times.push_back(keyframe.time);
+                positions.push_back(keyframe.position);
+                look_ats.push_back(keyframe.look_at);
+                if (has_up) {
+                    ups.push_back(keyframe.up);
+                }
+            }
+            d_trajectory_times.setValue(times);
+            d_trajectory_positions.setValue(positions);
+            d_trajectory_look_ats.setValue(look_ats);
+            d_trajectory_ups.setValue(ups);
+        }
+
+        const auto & times = d_trajectory_times.getValue();
+        const auto & positions = d_trajectory_positions.getValue();
+        const auto & look_ats = d_trajectory_look_ats.getValue();
+        const auto & ups = d_trajectory_ups.getValue();
+        if (times.empty()) {
+            return;
+        }
+        if (positions.size() != times.size() or look_ats.size() != times.size() or
+            (not ups.empty() and ups.size() != times.size())) {
+            throw std::invalid_argument("'trajectory_positions', 'trajectory_look_ats' and 'trajectory_ups' (if "
+                                        "given) must have one value per keyframe of 'trajectory_times'.");
+        }
+
+        std::vector<CameraTrajectory::Keyframe> keyframes(times.size());
+        for (std::size_t i = 0; i < times.size(); ++i) {
+            keyframes[i].time = times[i];
+            keyframes[i].position = positions[i];
+            keyframes[i].look_at = look_ats[i];
+            if (not ups.empty()) {
+                keyframes[i].up = ups[i];
+            }
+        }
+        p_trajectory.emplace(std::move(keyframes), not ups.empty());
+        msg_info() << "Camera trajectory of " << times.size() << " keyframes loaded.";
+    } catch (const std::exception & error) {
+        msg_error() << error.what() << " The camera will not follow a trajectory.";
+    }
+}
+
+void OffscreenCamera::apply_trajectory(double time) {
+    if (not p_trajectory) {
+        return;
+    }
+
+    const auto interpolation =
+        static_cast<CameraTrajectory::Interpolation>(d_trajectory_interpolation.getValue().getSelectedId());
+    const auto pose = p_trajectory->pose_at(time, interpolation);
+    p_position.setValue(pose.position);
+    p_lookAt.setValue(pose.look_at);
+    p_up = pose.up;
+}
+
+void OffscreenCamera::update_profiler() {
+    if (d_profile.getValue() and not p_profiler.enabled()) {
+        p_profiler.reset();
+    }
+    p_profiler.set_enabled(d_profile.getValue());
+}
+
+void OffscreenCamera::compute_matrices(double * projection, double * modelview) {
+    using Transform = sofa::defaulttype::SolidTypes<SReal>::Transform;
+    getOpenGLProjectionMatrix(projection);
+
+    // We recompute the MVM since sofa doesn't do it unless the "look-at" changed. Hence,
+    // in the case the camera position moved, but not the "look-at", the orientation will
+    // be wrong.
+    const auto currentPos = p_position.getValue();
+    currentLookAt = p_lookAt.getValue();
+    auto currentOrientation = p_up ? CameraTrajectory::orientation(currentPos, currentLookAt, *p_up)
+                                   : getOrientationFromLookAt(currentPos, currentLookAt);
+    auto world_to_cam = Transform(currentPos, currentOrientation);
+    p_orientation.setValue(currentOrientation);
+
+    world_to_cam.inversed().writeOpenGlMatrix(modelview);
+}
+
+FrustumCuller * OffscreenCamera::begin_culling(const double * projection, const double * modelview) {
+    if (not d_frustum_culling.getValue()) {
+        return nullptr;
+    }
+    p_frustum_culler.begin_frame(projection, modelview);
+    return &p_frustum_culler;
+}
+
+void OffscreenCamera::publish_culling_statistics(const FrustumCuller * culler) {
+    const auto statistics = culler ? culler->statistics() : FrustumCuller::Statistics();
+    d_visual_models_tested.setValue(statistics.tested);
+    d_visual_models_culled.setValue(statistics.culled);
+}
+
+QRect OffscreenCamera::compute_region_of_interest(const double * projection, const double * modelview) {
+    const QRect frame(0, 0, p_framebuffer->width(), p_framebuffer->height());
+    QRect region;
+
+    const auto & roi_node = d_roi_node.getValue();
+    if (roi_node.empty()) {
+        const auto & roi = d_roi.getValue();
+        region = QRect(roi[0], roi[1], roi[2], roi[3]);
+    } else if (auto * node = find_node(dynamic_cast<sofa::simulation::Node *>(getContext()), roi_node)) {
+        p_unresolved_roi_node.clear();
+        sofa::simulation::UpdateBoundingBoxVisitor update_bounding_box(sofa::core::ExecParams::defaultInstance());
+        node->execute(&update_bounding_box);
+        const auto & bounding_box = node->f_bbox.getValue();
+
+        // Project the corners of the bounding box into the frame
+        const auto transform = [](const double * matrix, const double * in, double * out) {
+            for (int row = 0; row < 4; ++row) {
+                out[row] = matrix[row] * in[0] + matrix[4 + row] * in[1] + matrix[8 + row] * in[2]
+                         + matrix[12 + row] * in[3];
+            }
+        };
+        const auto & min = bounding_box.minBBox();
+        const auto & max = bounding_box.maxBBox();
+        double min_x = std::numeric_limits<double>::max(), min_y = min_x;
+        double max_x = std::numeric_limits<double>::lowest(), max_y = max_x;
+        bool in_front = bounding_box.isValid();
+        for (int corner = 0; corner < 8 and in_front; ++corner) {
+            const double world[4] = {(corner & 1) ? max[0] : min[0], (corner & 2) ? max[1] : min[1],
+                                     (corner & 4) ? max[2] : min[2], 1};
+            double eye[4], clip[4];
+            transform(modelview, world, eye);
+            transform(projection, eye, clip);
+            in_front = clip[3] > 0;
+            if (in_front) {
+                const double x = (clip[0] / clip[3] + 1) / 2 * frame.width();
+                const double y = (1 - clip[1] / clip[3]) / 2 * frame.height();
+                min_x = std::min(min_x, x);
+                min_y = std::min(min_y, y);
+                max_x = std::max(max_x, x);
+                max_y = std::max(max_y, y);
+            }
+        }
+        if (in_front) {
+            const auto clamp = [](double value) { return std::clamp(value, -1e6, 1e6); };
+            const auto left = static_cast<int>(std::floor(clamp(min_x)));
+            const auto top = static_cast<int>(std::floor(clamp(min_y)));
+            region = QRect(left, top, static_cast<int>(std::ceil(clamp(max_x))) - left,
+                           static_cast<int>(std::ceil(clamp(max_y))) - top);
+        }
+    } else if (p_unresolved_roi_node != roi_node) {
+        msg_warning() << "No node found at '" << roi_node << "' for 'roi_node', the whole frame is rendered.";
+        p_unresolved_roi_node = roi_node;
+    }
+
+    // A region covering the whole frame is not worth the scissor test and the cropped readback
+    region = region.intersected(frame);
+    if (region == frame) {
+        region = QRect();
+    }
+    const QRect used = region.isEmpty() ? frame : region;
+    d_last_roi.setValue(sofa::type::Vec4i(used.x(), used.y(), used.width(), used.height()));
+    return region;
+}
+
+void OffscreenCamera::draw_overlay(sofa::helper::visual::DrawTool & draw_tool) const {
+    const auto & overlay_text = d_overlay_text.getValue();
+    if (overlay_text.empty()) {
+        return;
+    }
+
+    auto text = expand_placeholders(overlay_text, p_frame_time.value_or(getContext()->getTime()));
+    for (auto pos = text.find("\\n"); pos != std::string::npos; pos = text.find("\\n", pos)) {
+        text.replace(pos, 2, "\n");
+    }
+    draw_tool.writeOverlayText(10, 10, d_overlay_font_size.getValue(), d_overlay_color.getValue(), text.c_str());
+}
+
 void OffscreenCamera::initGL() {
     static GLfloat light_position[] = {-0.7, 0.3, 0, 1};
     static GLfloat specref[]        = {1, 1, 1, 1};
@@ -251,6 +1300,12 @@ void OffscreenCamera::initGL() {
 
     glDepthFunc(GL_LEQUAL);
     glClearDepth(1.0);
+
+    // With the core profile, the light and materials below are reproduced by the shaders of the ShaderLibrary
+    if (d_core_profile.getValue()) {
+        return;
+    }
+
     glEnable(GL_NORMALIZE);
 
     glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
@@ -283,8 +1338,246 @@ void OffscreenCamera::initGL() {
 }
 
 void OffscreenCamera::save_frame(const std::string &filepath) {
-    QImage frame = grab_frame();
-    frame.save(QString::fromStdString(filepath));
+    Tracer::Scope trace_scope("save_frame", trace_arguments());
+    const auto frames = render_frame(d_mip_levels.getValue());
+    for (unsigned int level = 0; level < frames.size(); ++level) {
+        write_frame(frames[level], level_filepath(filepath, level));
+    }
+    publish_timings();
+}
+
+void OffscreenCamera::save_frame_async(const std::string & filepath, std::function<void(bool saved)> on_saved) {
+    Tracer::Scope trace_scope("save_frame_async", trace_arguments());
+    auto & worker = capture_worker();
+    auto frames = render_frame(d_mip_levels.getValue());
+    worker.post([this, frames = std::move(frames), filepath, on_saved = std::move(on_saved)]() {
+        bool saved = true;
+        for (unsigned int level = 0; level < frames.size(); ++level) {
+            saved = write_frame(frames[level], level_filepath(filepath, level)) and saved;
+        }
+        on_saved(saved);
+    });
+}
+
+bool OffscreenCamera::encode_frame(const QImage & frame, const std::string & filepath, QByteArray & encoded_frame) {
+    FrameProfiler::Scope scope(p_profiler, FrameProfiler::Stage::Encode);
+    const auto suffix = QFileInfo(QString::fromStdString(filepath)).suffix().toLower();
+
+    // QOI, JPEG and PNG frames are encoded by our own encoders, directly on the pixels of the frame. The 16-bit frames
+    // of floating-point color buffers are kept as such in PNG files, and reduced to 8 bits otherwise.
+    if (suffix == "qoi" or suffix == "jpg" or suffix == "jpeg" or suffix == "png") {
+        const bool alpha = frame.hasAlphaChannel() and suffix != "jpg" and suffix != "jpeg";
+        const bool deep = suffix == "png" and frame.depth() == 64;
+        const QImage pixels = deep ? frame.convertToFormat(alpha ? QImage::Format_RGBA64 : QImage::Format_RGBX64)
+                                   : frame.convertToFormat(alpha ? QImage::Format_RGBA8888 : QImage::Format_RGB888);
+        const int channels = alpha or deep ? 4 : 3;
+        const auto stride = static_cast<std::size_t>(pixels.bytesPerLine());
+        try {
+            std::vector<std::uint8_t> encoded;
+            if (suffix == "qoi") {
+                encoded = qoi_encode(pixels.constBits(), pixels.width(), pixels.height(), channels, stride);
+            } else if (suffix == "png") {
+                PngOptions options;
+                options.compression_level = static_cast<int>(std::min(d_png_compression_level.getValue(), 9u));
+                options.filter = static_cast<PngFilter>(d_png_filter.getValue().getSelectedId());
+                options.threads = d_encoding_threads.getValue();
+                options.bit_depth = deep ? 16 : 8;
+                encoded = png_encode(pixels.constBits(), pixels.width(), pixels.height(), channels, stride, options);
+            } else {
+                JpegOptions options;
+                options.quality = static_cast<int>(std::clamp(d_jpeg_quality.getValue(), 1u, 100u));
+                const auto subsampling = d_jpeg_chroma_subsampling.getValue().getSelectedId();
+                options.subsampling = static_cast<JpegSubsampling>(subsampling);
+                encoded = jpeg_encode(pixels.constBits(), pixels.width(), pixels.height(), channels, stride, options);
+            }
+            encoded_frame = QByteArray(reinterpret_cast<const char *>(encoded.data()), static_cast<int>(encoded.size()));
+        } catch (const std::exception & error) {
+            msg_error() << "Failed to encode the frame for the file '" << filepath << "': " << error.what();
+            return false;
+        }
+        return true;
+    }
+
+    QBuffer buffer(&encoded_frame);
+    buffer.open(QIODevice::WriteOnly);
+    if (not frame.save(&buffer, suffix.toLatin1().constData())) {
+        msg_error() << "Failed to encode the frame for the file '" << filepath << "'.";
+        return false;
+    }
+    return true;
+}
+
+bool OffscreenCamera::write_frame(const QImage & frame, const std::string & filepath) {
+    using Stage = FrameProfiler::Stage;
+
+    // The image is encoded in memory first so that the encoding and the writing can be timed separately
+    QByteArray encoded_frame;
+    if (not encode_frame(frame, filepath, encoded_frame)) {
+        return false;
+    }
+
+    {
+        FrameProfiler::Scope scope(p_profiler, Stage::Write);
+        QFile file(QString::fromStdString(filepath));
+        if (not file.open(QIODevice::WriteOnly) or file.write(encoded_frame) != encoded_frame.size()) {
+            msg_error() << "Failed to write the frame into the file '" << filepath << "'.";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OffscreenCamera::archive_frame(const QImage & frame, const AutomaticFrame & automatic_frame) {
+    using Stage = FrameProfiler::Stage;
+
+    QByteArray encoded_frame;
+    if (not encode_frame(frame, automatic_frame.filepath, encoded_frame)) {
+        return false;
+    }
+
+    {
+        FrameProfiler::Scope scope(p_profiler, Stage::Write);
+        if (not p_archive.append(automatic_frame.filepath, encoded_frame.constData(),
+                                 static_cast<std::size_t>(encoded_frame.size()), automatic_frame.step,
+                                 automatic_frame.time)) {
+            msg_error() << "Failed to write the frame '" << automatic_frame.filepath << "' into the archive '"
+                        << p_archive.filepath() << "'.";
+            return false;
+        }
+    }
+    return true;
+}
+
+void OffscreenCamera::save_automatic_frame(const std::vector<QImage> & frames, const AutomaticFrame & automatic_frame) {
+    Tracer::Scope trace_scope("save_frame", trace_arguments());
+
+    if (d_save_frame_change_threshold.getValue() > 0) {
+        auto luminance = downsampled_luminance(frames.front(), luminance_block_size);
+        if (luminance.size() == p_last_saved_luminance.size()) {
+            const double difference = mean_absolute_difference(luminance.data(), p_last_saved_luminance.data(),
+                                                                luminance.size()) / 255.;
+            if (difference < d_save_frame_change_threshold.getValue()) {
+                d_unchanged_frames_skipped.setValue(d_unchanged_frames_skipped.getValue() + 1);
+                return;
+            }
+        }
+        p_last_saved_luminance = std::move(luminance);
+    }
+
+    for (unsigned int level = 0; level < frames.size(); ++level) {
+        AutomaticFrame level_frame = automatic_frame;
+        level_frame.filepath = level_filepath(automatic_frame.filepath, level);
+        const bool saved = p_archive.is_open() ? archive_frame(frames[level], level_frame)
+                                               : write_frame(frames[level], level_frame.filepath);
+        publish_timings();
+        if (not saved) {
+            return;
+        }
+    }
+
+    const auto & index_filepath = d_frame_index_filepath.getValue();
+    if (not index_filepath.empty()) {
+        if (not p_frame_index.is_open()) {
+            p_frame_index.open(index_filepath);
+            p_frame_index.precision(12);
+            p_frame_index << "filepath,step,time\n";
+        }
+        p_frame_index << csv_field(level_filepath(automatic_frame.filepath, 0)) << ',' << automatic_frame.step << ','
+                      << automatic_frame.time << std::endl;
+        if (not p_frame_index) {
+            msg_error() << "Failed to write into the frame index '" << index_filepath << "'.";
+        }
+    }
+}
+
+void OffscreenCamera::save_scheduled_frames(double time, double dt) {
+    const double fps = d_save_frame_fps.getValue();
+    if (fps <= 0) {
+        return;
+    }
+
+    // The times of the frames are computed from their number, hence they do not drift over long simulations
+    if (not p_schedule_start_time) {
+        p_schedule_start_time = time;
+    }
+    const auto frame_time = [this, fps](unsigned int frame_number) {
+        return *p_schedule_start_time + static_cast<double>(frame_number) / fps;
+    };
+    const double epsilon = 1e-9 * std::max(1., std::abs(time)); // Round-off of the accumulated time steps
+
+    if (static_cast<Interpolation>(d_save_frame_interpolation.getValue().getSelectedId()) == Interpolation::Nearest) {
+        // A frame is due now if its time has passed, or if it is nearer from now than from the end of the next step
+        std::vector<AutomaticFrame> frames;
+        for (double t = frame_time(p_frame_number); t <= time + epsilon or t - time <= time + dt - t;
+             t = frame_time(p_frame_number)) {
+            frames.push_back({parse_file_path(t), t, p_step_number});
+            ++p_frame_number;
+        }
+        capture_automatic_frames(std::move(frames));
+        return;
+    }
+
+    // Blending needs the previous rendering, hence these frames are always rendered right away
+    std::vector<QImage> frames; // Rendered once, at the first frame due, along with its downsampled levels
+    const auto current_frames = [this, &frames, time]() -> const std::vector<QImage> & {
+        if (frames.empty()) {
+            apply_trajectory(time);
+            p_frame_time = time;
+            frames = render_frame(d_mip_levels.getValue());
+            p_frame_time.reset();
+        }
+        return frames;
+    };
+
+    // The region of interest of 'roi_node' follows the node, hence the frames of two steps may differ in size
+    const auto same_sizes = [this](const std::vector<QImage> & current) {
+        return std::equal(p_previous_frames.begin(), p_previous_frames.end(), current.begin(), current.end(),
+                          [](const QImage & a, const QImage & b) { return a.size() == b.size(); });
+    };
+
+    for (double t = frame_time(p_frame_number); t <= time + epsilon; t = frame_time(p_frame_number)) {
+        const AutomaticFrame automatic_frame {parse_file_path(t), t, p_step_number};
+        if (not same_sizes(current_frames()) or time - p_previous_frame_time <= epsilon) {
+            save_automatic_frame(current_frames(), automatic_frame);
+        } else {
+            const double weight = (t - p_previous_frame_time) / (time - p_previous_frame_time);
+            std::vector<QImage> blended_frames;
+            for (std::size_t level = 0; level < frames.size(); ++level) {
+                blended_frames.push_back(blend(p_previous_frames[level], frames[level], weight));
+            }
+            save_automatic_frame(blended_frames, automatic_frame);
+        }
+        ++p_frame_number;
+    }
+
+    // Keep the current frame if the next one is expected to fall within the next step
+    p_previous_frames.clear();
+    if (frame_time(p_frame_number) <= time + dt + epsilon) {
+        p_previous_frames = current_frames();
+        p_previous_frame_time = time;
+    }
+}
+
+void OffscreenCamera::publish_timings() {
+    using Stage = FrameProfiler::Stage;
+    if (not p_profiler.enabled()) {
+        return;
+    }
+
+    const std::pair<Stage, Data<sofa::type::Vec3d> *> timings[] = {
+        {Stage::ContextSwitch, &d_timing_context_switch},
+        {Stage::PreDraw,       &d_timing_pre_draw},
+        {Stage::Traversal,     &d_timing_traversal},
+        {Stage::PostDraw,      &d_timing_post_draw},
+        {Stage::Gpu,           &d_timing_gpu},
+        {Stage::Readback,      &d_timing_readback},
+        {Stage::Encode,        &d_timing_encode},
+        {Stage::Write,         &d_timing_write},
+    };
+    for (const auto & [stage, data] : timings) {
+        const auto statistics = p_profiler.statistics(stage);
+        data->setValue(sofa::type::Vec3d(statistics.last, statistics.average, statistics.max));
+    }
 }
 
 void OffscreenCamera::handleEvent(sofa::core::objectmodel::Event * ev) {
@@ -303,44 +1596,96 @@ void OffscreenCamera::handleEvent(sofa::core::objectmodel::Event * ev) {
     if (SimulationInitTexturesDoneEvent::checkEventType(ev)) {
         p_textures_have_been_initialized = true;
         if (save_frame_before_first_step) {
-            const auto &filepath = parse_file_path();
-            save_frame(filepath);
+            const double time = getContext()->getTime();
+            capture_automatic_frames({{parse_file_path(time), time, p_step_number}});
         }
+        save_scheduled_frames(getContext()->getTime(), getContext()->getDt());
     } else
 #endif
     if (AnimateBeginEvent::checkEventType(ev)) {
+        // Save the frames rendered during the last step
+        if (p_render_thread) {
+            p_render_thread->collect();
+        }
+
         // This is needed to handle the runSofa's batch "GUI", since it doesn't initialize the OglModel
         if (!p_textures_have_been_initialized) {
             auto * node = dynamic_cast<sofa::simulation::Node*>(getContext());
             auto * root = dynamic_cast<sofa::simulation::Node*>(node->getRoot());
             sofa::simulation::getSimulation()->initTextures(root);
         }
+
+        // The time of the context is only updated after the AnimateEndEvent
+        p_step_start_time = getContext()->getTime();
+        if (not p_schedule_start_time) {
+            save_scheduled_frames(p_step_start_time, getContext()->getDt());
+        }
     } else if (AnimateEndEvent::checkEventType(ev)) {
         ++p_step_number;
+        if (Tracer::instance().enabled()) {
+            Tracer::instance().instant("step", trace_arguments() + ", \"step\": " + std::to_string(p_step_number));
+        }
 
+        const auto dt = static_cast<AnimateEndEvent *>(ev)->getDt();
         if (save_frame_after_each_n_steps > 0 && (p_step_number % save_frame_after_each_n_steps) == 0) {
-            const auto & filepath = parse_file_path();
-            save_frame(filepath);
+            const double time = p_step_start_time + dt;
+            capture_automatic_frames({{parse_file_path(time), time, p_step_number}});
         }
+
+        save_scheduled_frames(p_step_start_time + dt, dt);
+
+        // The frames grabbed from python after the step, and the views of the GUI, see the camera at the end of the step
+        apply_trajectory(p_step_start_time + dt);
+    }
+}
+
+void OffscreenCamera::reset() {
+    wait_for_pending_frames();
+    p_step_number = 0;
+    p_frame_number = 0;
+    p_schedule_start_time.reset();
+    p_previous_frames.clear();
+    p_last_saved_luminance.clear();
+}
+
+void OffscreenCamera::cleanup() {
+    // Join the pipeline at the end of the simulation, so that every frame recorded is saved
+    wait_for_pending_frames();
+    if (p_archive.is_open() and not p_archive.close()) {
+        msg_error() << "Failed to write the index of the frame archive '" << p_archive.filepath() << "'.";
     }
+    Base::cleanup();
+}
+
+std::string OffscreenCamera::trace_arguments() const {
+    return "\"camera\": " + Tracer::quoted(getName());
 }
 
-std::string OffscreenCamera::parse_file_path() const {
-    std::string filepath = d_filepath.getValue();
+std::string OffscreenCamera::parse_file_path(double time) const {
+    return expand_placeholders(d_filepath.getValue(), time);
+}
+
+std::string OffscreenCamera::expand_placeholders(std::string text, double time) const {
+    // Fixed precision, independent of the locale, so that the file names of a schedule sort and parse the same way
+    std::ostringstream formatted_time;
+    formatted_time.imbue(std::locale::classic());
+    formatted_time << std::fixed << std::setprecision(6) << time;
 
     std::vector<std::pair<std::string, std::string>> keys = {
             {"%s", this->getName()},
-            {"%i", std::to_string(p_step_number)}
+            {"%i", std::to_string(p_step_number)},
+            {"%t", formatted_time.str()},
+            {"%f", std::to_string(p_frame_number)}
     };
     for (const auto & k : keys) {
         size_t start_pos = 0;
-        while((start_pos = filepath.find(k.first, start_pos)) != std::string::npos) {
-            filepath.replace(start_pos, k.first.length(), k.second);
+        while((start_pos = text.find(k.first, start_pos)) != std::string::npos) {
+            text.replace(start_pos, k.first.length(), k.second);
             start_pos += k.second.length();
         }
     }
 
-    return filepath;
+    return text;
 }
 
 int OffscreenCameraClass = sofa::core::RegisterObject("Offscreen rendering camera.")
@@ -1,12 +1,36 @@
+#include <cstdint>
+#include <fstream>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <vector>
 
+#include <QByteArray>
 #include <QGuiApplication>
 #include <QOpenGLFramebufferObject>
 #include <QImage>
+#include <QRect>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
+#include <QOpenGLTimerQuery>
 
 #include <SofaBaseVisual/BaseCamera.h>
+#include <sofa/helper/OptionsGroup.h>
+#include <sofa/type/RGBAColor.h>
+#include <sofa/type/Vec.h>
+#include <sofa/type/vector.h>
+
+#include "CameraTrajectory.h"
+#include "FrameArchive.h"
+#include "FrameBufferPool.h"
+#include "FrameProfiler.h"
+#include "FrustumCuller.h"
+#include "Readback.h"
+#include "RenderThread.h"
+
+class CaptureWorker;
+class MipPyramid;
+namespace sofa::helper::visual { class BatchRenderer; class DrawTool; class GeometryCache; class VertexStream; }
 
 class OffscreenCamera : public sofa::component::visualmodel::BaseCamera {
     using Base = sofa::component::visualmodel::BaseCamera;
@@ -15,43 +39,287 @@ class OffscreenCamera : public sofa::component::visualmodel::BaseCamera {
 public:
     SOFA_CLASS(OffscreenCamera, sofa::component::visualmodel::BaseCamera);
 
+    /**
+     * Called by grab_pixels with the width, height, number of channels and type of the components of the frame, once
+     * known. Returns the memory receiving its rows from the top, contiguously (width * channels components each), or
+     * null to drop the frame.
+     */
+    using PixelAllocator = std::function<void *(int width, int height, int channels, ComponentType type)>;
+
+    /** Frame grabbed by grab_pooled_frame, its rows from the top, contiguously. */
+    struct PooledFrame {
+        FrameBufferPool::Buffer pixels;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        ComponentType type = ComponentType::UInt8;
+    };
+
     /**
      * Main constructor of the camera
      */
     OffscreenCamera();
 
+    /**
+     * Release the OpenGL resources owned by the camera
+     */
+    ~OffscreenCamera() override;
+
     /**
      * Render the current frame from the point of view of the camera into an image and return it.
      */
     QImage grab_frame();
 
+    /**
+     * Render the current frame from the point of view of the camera, and read it back in the format given by
+     * 'pixel_format' straight into the memory returned by allocate, without any intermediate image. The rows are
+     * flipped, and the pixels converted, on the GPU. The components are bytes, or half or single-precision floats
+     * following 'color_format'.
+     */
+    void grab_pixels(const PixelAllocator & allocate);
+
+    /**
+     * Render the current frame and read it back as grab_pixels does, into a buffer of the camera. The buffer is reused
+     * by a later grab once every copy of the frame's pixels has been released, and stays valid until then, even after
+     * the camera is destroyed.
+     */
+    PooledFrame grab_pooled_frame();
+
+    /**
+     * Render the current frame as grab_pixels does, but only queue its readback, and return without waiting for the
+     * GPU. The pixels are then copied by the capture worker: allocate and on_grabbed (with false if the pixels could
+     * not be read back) are called from its thread. Without a context for the worker, the pixels are read back
+     * synchronously, and the callbacks called before returning.
+     */
+    void grab_pixels_async(PixelAllocator allocate, std::function<void(bool grabbed)> on_grabbed);
+
     /**
      * Render the current frame and save it into a file. Note that if the filepath contains '%s' and '%i', they will
-     * be replaced by the component's name and the current simulation step number, respectively.
+     * be replaced by the component's name and the current simulation step number, respectively. The downsampled levels
+     * of the frame requested by 'mip_levels' are saved along with it.
      *
      * @param filepath Path to the file where the frame will be saved.
      */
     void save_frame(const std::string & filepath);
 
+    /**
+     * Render the current frame as save_frame does, and return while the frame is encoded and written by the capture
+     * worker. on_saved is then called from the thread of the worker, with false if the frame could not be saved.
+     */
+    void save_frame_async(const std::string & filepath, std::function<void(bool saved)> on_saved);
+
+    /**
+     * Wait until the frames recorded so far in pipelined mode, and the asynchronous captures started so far, have been
+     * rendered and saved (or grabbed).
+     */
+    void wait_for_pending_frames();
+
 private:
+    /** Frame rendered by the camera itself, to be saved once rendered. */
+    struct AutomaticFrame {
+        std::string filepath;
+        double time;        ///< Simulated time of the frame
+        unsigned int step;  ///< Step number of the frame
+    };
+
     void init() final;
-    void reset() final { p_step_number = 0; }
+    void reset() final;
+    void cleanup() final;
     void handleEvent(sofa::core::objectmodel::Event*) final;
     void manageEvent(sofa::core::objectmodel::Event*) final {}
     void initGL();
-    std::string parse_file_path() const;
+    std::string parse_file_path(double time) const;
+
+    /**
+     * Build the trajectory of the camera from the 'trajectory_*' data, after reading its keyframes from
+     * 'trajectory_filepath' if given. Errors are reported, and leave the camera without trajectory.
+     */
+    void load_trajectory();
+
+    /** Move the camera to the pose of its trajectory at the given simulated time, if it has one. */
+    void apply_trajectory(double time);
+
+    /** Enable or disable the frame profiler following 'profile', restarting its statistics when it gets enabled. */
+    void update_profiler();
+
+    /**
+     * Render the current frame from the point of view of the camera, and downsample it into the given number of
+     * levels (see MipPyramid).
+     *
+     * @param read_frame If given, called to read the frame back instead of reading it into an image, with the context
+     *                   of the camera current and the region of the frame rendered (see compute_region_of_interest).
+     * @return The frame followed by its downsampled levels. The frame is a null image when read_frame is given.
+     */
+    std::vector<QImage> render_frame(unsigned int mip_levels,
+                                     const std::function<void(const QRect & region)> & read_frame = {});
+
+    /** The capture worker of the asynchronous captures, started at the first one. */
+    CaptureWorker & capture_worker();
+
+    /** Compute the OpenGL projection and model-view matrices of the camera, as column-major arrays. */
+    void compute_matrices(double * projection, double * modelview);
+
+    /**
+     * Region of the frame to render, read back and save ('roi' or the projected bounding box of 'roi_node'), in image
+     * coordinates, given the OpenGL matrices of the camera. Empty for the whole frame.
+     */
+    QRect compute_region_of_interest(const double * projection, const double * modelview);
+
+    /**
+     * Start the frustum culling of a frame seen through the given OpenGL matrices. Returns the culler to give to the
+     * draw visitors, null if 'frustum_culling' is disabled.
+     */
+    FrustumCuller * begin_culling(const double * projection, const double * modelview);
+
+    /** Copy the statistics of the culler (none if null) into 'visual_models_tested' and 'visual_models_culled'. */
+    void publish_culling_statistics(const FrustumCuller * culler);
+
+    /**
+     * Stamp the overlay text, if any, on the top-left corner of the frame, '%t' being the time of the automatic frame
+     * being rendered or the time of the context otherwise.
+     */
+    void draw_overlay(sofa::helper::visual::DrawTool & draw_tool) const;
+
+    /**
+     * Record the scene as seen from the camera, to be rendered by the render thread of the pipelined mode, into one of
+     * the recordings the render thread reuses from frame to frame. Visual managers are skipped.
+     */
+    RenderThread::Frame record_frame();
+
+    /**
+     * Render the current frame once and save it as each of the given frames: right away, or once rendered by the render
+     * thread in pipelined mode.
+     */
+    void capture_automatic_frames(std::vector<AutomaticFrame> frames);
+
+    /**
+     * Encode the frame in the format given by the extension of the file path.
+     *
+     * @return False if the frame could not be encoded.
+     */
+    bool encode_frame(const QImage & frame, const std::string & filepath, QByteArray & encoded_frame);
+
+    /**
+     * Encode the frame in the format given by the extension of the file path, and write it. The timings are not
+     * published, since the frame may be written by the capture worker.
+     *
+     * @return False if the frame could not be saved.
+     */
+    bool write_frame(const QImage & frame, const std::string & filepath);
+
+    /**
+     * Encode the frame in the format given by the extension of its file path, and append it to the archive under
+     * this path.
+     *
+     * @return False if the frame could not be saved.
+     */
+    bool archive_frame(const QImage & frame, const AutomaticFrame & automatic_frame);
+
+    /**
+     * Save a frame rendered by the camera itself (before the first step, after each n steps or on the simulated-time
+     * schedule) into its file path or the archive, unless it is too close to the last frame saved this way
+     * ('save_frame_change_threshold'). The frame comes first, followed by its downsampled levels ('mip_levels').
+     * The saved frame is then listed in the frame index, with its simulated time and step number.
+     */
+    void save_automatic_frame(const std::vector<QImage> & frames, const AutomaticFrame & automatic_frame);
+
+    /**
+     * Save the frames of the simulated-time schedule ('save_frame_fps') that are due once the state of the scene has
+     * reached the given time. The next step is expected to last dt.
+     */
+    void save_scheduled_frames(double time, double dt);
+
+    /**
+     * Replace the special character sets '%s', '%i', '%t' and '%f' of the text by the camera name, the current step
+     * number, the given simulated time of the frame (with 6 decimals) and the number of the frame in the simulated-time
+     * schedule, respectively.
+     */
+    std::string expand_placeholders(std::string text, double time) const;
+
+    /** Copy the statistics of the frame profiler into the timing Data. */
+    void publish_timings();
+
+    /** Arguments identifying the camera in the events of the Tracer. */
+    std::string trace_arguments() const;
 
     // Data members
     Data<std::string> d_filepath;
     Data<bool> d_save_frame_before_first_step;
     Data<unsigned int> d_save_frame_after_each_n_steps;
+    Data<double> d_save_frame_fps;
+    Data<sofa::helper::OptionsGroup> d_save_frame_interpolation;
+    Data<double> d_save_frame_change_threshold;
+    Data<std::string> d_frame_index_filepath;
+    Data<std::string> d_archive_filepath;
+    Data<unsigned int> d_jpeg_quality;
+    Data<sofa::helper::OptionsGroup> d_jpeg_chroma_subsampling;
+    Data<unsigned int> d_png_compression_level;
+    Data<sofa::helper::OptionsGroup> d_png_filter;
+    Data<unsigned int> d_encoding_threads;
+    Data<unsigned int> d_mip_levels;
+    Data<sofa::type::Vec4i> d_roi;
+    Data<std::string> d_roi_node;
+    Data<sofa::type::Vec4i> d_last_roi;
+    Data<sofa::helper::OptionsGroup> d_pixel_format;
+    Data<sofa::helper::OptionsGroup> d_color_format;
+    Data<unsigned int> d_unchanged_frames_skipped;
     Data<unsigned int> d_multisampling;
+    Data<bool> d_core_profile;
+    Data<bool> d_pipelined;
+    Data<std::string> d_overlay_text;
+    Data<unsigned int> d_overlay_font_size;
+    Data<sofa::type::RGBAColor> d_overlay_color;
+    Data<bool> d_cache_gl_state;
+    Data<unsigned int> d_gl_state_changes_issued;
+    Data<unsigned int> d_gl_state_changes_elided;
+    Data<bool> d_frustum_culling;
+    Data<unsigned int> d_visual_models_tested;
+    Data<unsigned int> d_visual_models_culled;
+    Data<bool> d_profile;
+    Data<sofa::type::Vec3d> d_timing_context_switch;
+    Data<sofa::type::Vec3d> d_timing_pre_draw;
+    Data<sofa::type::Vec3d> d_timing_traversal;
+    Data<sofa::type::Vec3d> d_timing_post_draw;
+    Data<sofa::type::Vec3d> d_timing_gpu;
+    Data<sofa::type::Vec3d> d_timing_readback;
+    Data<sofa::type::Vec3d> d_timing_encode;
+    Data<sofa::type::Vec3d> d_timing_write;
+    Data<std::string> d_trace_filepath;
+    Data<sofa::type::vector<double>> d_trajectory_times;
+    Data<sofa::type::vector<sofa::type::Vec3d>> d_trajectory_positions;
+    Data<sofa::type::vector<sofa::type::Vec3d>> d_trajectory_look_ats;
+    Data<sofa::type::vector<sofa::type::Vec3d>> d_trajectory_ups;
+    Data<std::string> d_trajectory_filepath;
+    Data<sofa::helper::OptionsGroup> d_trajectory_interpolation;
 
     // Private members
     bool p_textures_have_been_initialized = false;
     unsigned int p_step_number = 0;
+    unsigned int p_frame_number = 0;              ///< Next frame of the simulated-time schedule
+    std::optional<double> p_schedule_start_time;  ///< Simulated time of the frame 0 of the schedule
+    double p_step_start_time = 0;
+    std::optional<double> p_frame_time;           ///< Simulated time of the automatic frame being rendered
+    std::vector<QImage> p_previous_frames;         ///< Frame (and its levels) kept to be blended with the next step
+    double p_previous_frame_time = 0;
+    std::vector<std::uint8_t> p_last_saved_luminance; ///< Downsampled luminance of the last automatic frame saved
+    std::string p_unresolved_roi_node;            ///< Last 'roi_node' reported as not found
+    std::optional<CameraTrajectory> p_trajectory;  ///< Only with 'trajectory_times' or 'trajectory_filepath'
+    std::optional<sofa::type::Vec3d> p_up;         ///< Up vector of the camera set by its trajectory, if any
+    std::ofstream p_frame_index;
+    FrameArchiveWriter p_archive;
     std::unique_ptr<QGuiApplication> p_application;
     QOffscreenSurface * p_surface{};
-    QOpenGLFramebufferObject * p_framebuffer;
+    QOpenGLFramebufferObject * p_framebuffer{};
     QOpenGLContext * p_context{};
+    std::unique_ptr<sofa::helper::visual::BatchRenderer> p_renderer;
+    std::unique_ptr<sofa::helper::visual::VertexStream> p_vertex_stream;
+    std::unique_ptr<sofa::helper::visual::GeometryCache> p_geometry_cache;
+    std::unique_ptr<QOpenGLTimerQuery> p_gpu_timer;
+    std::unique_ptr<MipPyramid> p_mip_pyramid;     ///< Only with 'mip_levels'
+    std::unique_ptr<FrameReadback> p_readback;
+    std::unique_ptr<RenderThread> p_render_thread; ///< Only in pipelined mode
+    std::unique_ptr<CaptureWorker> p_capture_worker; ///< Only after an asynchronous capture
+    FrameProfiler p_profiler;
+    FrameBufferPool p_frame_buffers; ///< Buffers of grab_pooled_frame
+    FrustumCuller p_frustum_culler;
 };
@@ -0,0 +1,236 @@
+#include "Qoi.h"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::uint8_t op_index = 0x00;
+constexpr std::uint8_t op_diff  = 0x40;
+constexpr std::uint8_t op_luma  = 0x80;
+constexpr std::uint8_t op_run   = 0xc0;
+constexpr std::uint8_t op_rgb   = 0xfe;
+constexpr std::uint8_t op_rgba  = 0xff;
+constexpr std::uint8_t op_mask  = 0xc0;
+
+constexpr std::size_t header_size = 14;
+constexpr std::uint8_t end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+/** Images larger than this are rejected by the decoder, as in the reference implementation. */
+constexpr std::uint64_t max_number_of_pixels = 400000000;
+
+constexpr std::uint32_t pack(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a) {
+    return std::uint32_t(r) | std::uint32_t(g) << 8 | std::uint32_t(b) << 16 | std::uint32_t(a) << 24;
+}
+
+constexpr std::uint8_t red(std::uint32_t pixel) { return static_cast<std::uint8_t>(pixel); }
+constexpr std::uint8_t green(std::uint32_t pixel) { return static_cast<std::uint8_t>(pixel >> 8); }
+constexpr std::uint8_t blue(std::uint32_t pixel) { return static_cast<std::uint8_t>(pixel >> 16); }
+constexpr std::uint8_t alpha(std::uint32_t pixel) { return static_cast<std::uint8_t>(pixel >> 24); }
+
+constexpr unsigned int pixel_hash(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a) {
+    return (r * 3u + g * 5u + b * 7u + a * 11u) % 64u;
+}
+
+/** Pixel of the decoder. The index of previously seen pixels starts with all its channels at zero. */
+struct Pixel {
+    std::uint8_t r = 0, g = 0, b = 0, a = 0;
+};
+
+void write_u32(std::uint8_t * bytes, std::uint32_t value) {
+    bytes[0] = static_cast<std::uint8_t>(value >> 24);
+    bytes[1] = static_cast<std::uint8_t>(value >> 16);
+    bytes[2] = static_cast<std::uint8_t>(value >> 8);
+    bytes[3] = static_cast<std::uint8_t>(value);
+}
+
+std::uint32_t read_u32(const std::uint8_t * bytes) {
+    return (std::uint32_t(bytes[0]) << 24) | (std::uint32_t(bytes[1]) << 16) | (std::uint32_t(bytes[2]) << 8)
+         | std::uint32_t(bytes[3]);
+}
+
+/**
+ * Encode the pixels as QOI operations into out, and return the end of the operations written. The channels are known
+ * at compile time, so that the pixels are read with a single load.
+ *
+ * Pixels are compared as 32-bit words. Runs of identical pixels, by far the most common case in renderings (think of
+ * the background), are skipped by a tight loop.
+ */
+template <int channels>
+std::uint8_t * encode_pixels(const std::uint8_t * pixels, int width, int height, std::size_t stride,
+                             std::uint8_t * out) {
+    const auto load = [](const std::uint8_t * p) {
+        return pack(p[0], p[1], p[2], channels == 4 ? p[3] : 255);
+    };
+    std::uint32_t index[64] = {};
+    std::uint32_t previous = pack(0, 0, 0, 255);
+    int run = 0;
+    for (int y = 0; y < height; ++y) {
+        const std::uint8_t * p = pixels + static_cast<std::size_t>(y) * stride;
+        for (int x = 0; x < width; ++x, p += channels) {
+            while (x < width and load(p) == previous) {
+                ++run;
+                ++x;
+                p += channels;
+            }
+            for (; run >= 62; run -= 62) {
+                *out++ = static_cast<std::uint8_t>(op_run | 61);
+            }
+            if (x == width) {
+                break;
+            }
+
+            const std::uint32_t pixel = load(p);
+            if (run > 0) {
+                *out++ = static_cast<std::uint8_t>(op_run | (run - 1));
+                run = 0;
+            }
+
+            const std::uint8_t r = p[0], g = p[1], b = p[2], a = channels == 4 ? p[3] : 255;
+            const unsigned int position = pixel_hash(r, g, b, a);
+            if (index[position] == pixel) {
+                *out++ = static_cast<std::uint8_t>(op_index | position);
+            } else {
+                index[position] = pixel;
+                if (a == alpha(previous)) {
+                    const auto dr = static_cast<std::int8_t>(r - red(previous));
+                    const auto dg = static_cast<std::int8_t>(g - green(previous));
+                    const auto db = static_cast<std::int8_t>(b - blue(previous));
+                    const int dr_dg = dr - dg;
+                    const int db_dg = db - dg;
+                    if (dr > -3 and dr < 2 and dg > -3 and dg < 2 and db > -3 and db < 2) {
+                        *out++ = static_cast<std::uint8_t>(op_diff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    } else if (dr_dg > -9 and dr_dg < 8 and dg > -33 and dg < 32 and db_dg > -9 and db_dg < 8) {
+                        *out++ = static_cast<std::uint8_t>(op_luma | (dg + 32));
+                        *out++ = static_cast<std::uint8_t>((dr_dg + 8) << 4 | (db_dg + 8));
+                    } else {
+                        *out++ = op_rgb;
+                        *out++ = r;
+                        *out++ = g;
+                        *out++ = b;
+                    }
+                } else {
+                    *out++ = op_rgba;
+                    *out++ = r;
+                    *out++ = g;
+                    *out++ = b;
+                    *out++ = a;
+                }
+            }
+            previous = pixel;
+        }
+    }
+    if (run > 0) {
+        *out++ = static_cast<std::uint8_t>(op_run | (run - 1));
+    }
+    return out;
+}
+
+} // namespace
+
+std::vector<std::uint8_t> qoi_encode(const std::uint8_t * pixels, int width, int height, int channels,
+                                     std::size_t stride) {
+    if (width <= 0 or height <= 0 or (channels != 3 and channels != 4)) {
+        throw std::invalid_argument("QOI images must have a positive size and 3 or 4 channels.");
+    }
+
+    // Sized for the worst case, where every pixel takes an RGBA operation. It is left uninitialized, so that the pages
+    // that are never written are never touched either.
+    const auto number_of_pixels = static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+    std::unique_ptr<std::uint8_t[]> buffer(new std::uint8_t[header_size + number_of_pixels * (channels + 1)
+                                                            + sizeof(end_marker)]);
+    std::uint8_t * out = buffer.get();
+
+    std::memcpy(out, "qoif", 4);
+    write_u32(out + 4, static_cast<std::uint32_t>(width));
+    write_u32(out + 8, static_cast<std::uint32_t>(height));
+    out[12] = static_cast<std::uint8_t>(channels);
+    out[13] = 0; // sRGB with linear alpha
+    out += header_size;
+
+    out = (channels == 4) ? encode_pixels<4>(pixels, width, height, stride, out)
+                          : encode_pixels<3>(pixels, width, height, stride, out);
+
+    std::memcpy(out, end_marker, sizeof(end_marker));
+    out += sizeof(end_marker);
+    return std::vector<std::uint8_t>(buffer.get(), out);
+}
+
+QoiImage qoi_decode(const std::uint8_t * data, std::size_t size) {
+    if (size < header_size + sizeof(end_marker) or std::memcmp(data, "qoif", 4) != 0) {
+        throw std::runtime_error("The data is not a QOI image.");
+    }
+
+    QoiImage image;
+    const std::uint32_t width = read_u32(data + 4);
+    const std::uint32_t height = read_u32(data + 8);
+    image.channels = data[12];
+    if (width == 0 or height == 0 or (image.channels != 3 and image.channels != 4)
+        or static_cast<std::uint64_t>(width) * height > max_number_of_pixels) {
+        throw std::runtime_error("The header of the QOI image is invalid.");
+    }
+    image.width = static_cast<int>(width);
+    image.height = static_cast<int>(height);
+
+    const std::size_t number_of_pixels = static_cast<std::size_t>(width) * height;
+    image.pixels.resize(number_of_pixels * image.channels);
+    std::uint8_t * out = image.pixels.data();
+
+    const std::uint8_t * in = data + header_size;
+    const std::uint8_t * end = data + size - sizeof(end_marker);
+    Pixel index[64] = {};
+    Pixel pixel;
+    pixel.a = 255;
+    int run = 0;
+    for (std::size_t i = 0; i < number_of_pixels; ++i) {
+        if (run > 0) {
+            --run;
+        } else if (in < end) {
+            const std::uint8_t b1 = *in++;
+            if (b1 == op_rgb) {
+                if (end - in < 3) break;
+                pixel.r = in[0];
+                pixel.g = in[1];
+                pixel.b = in[2];
+                in += 3;
+            } else if (b1 == op_rgba) {
+                if (end - in < 4) break;
+                pixel.r = in[0];
+                pixel.g = in[1];
+                pixel.b = in[2];
+                pixel.a = in[3];
+                in += 4;
+            } else if ((b1 & op_mask) == op_index) {
+                pixel = index[b1];
+            } else if ((b1 & op_mask) == op_diff) {
+                pixel.r = static_cast<std::uint8_t>(pixel.r + ((b1 >> 4) & 0x03) - 2);
+                pixel.g = static_cast<std::uint8_t>(pixel.g + ((b1 >> 2) & 0x03) - 2);
+                pixel.b = static_cast<std::uint8_t>(pixel.b + (b1 & 0x03) - 2);
+            } else if ((b1 & op_mask) == op_luma) {
+                if (end - in < 1) break;
+                const std::uint8_t b2 = *in++;
+                const int dg = (b1 & 0x3f) - 32;
+                pixel.r = static_cast<std::uint8_t>(pixel.r + dg - 8 + ((b2 >> 4) & 0x0f));
+                pixel.g = static_cast<std::uint8_t>(pixel.g + dg);
+                pixel.b = static_cast<std::uint8_t>(pixel.b + dg - 8 + (b2 & 0x0f));
+            } else {
+                run = b1 & 0x3f;
+            }
+            index[pixel_hash(pixel.r, pixel.g, pixel.b, pixel.a)] = pixel;
+        }
+
+        out[0] = pixel.r;
+        out[1] = pixel.g;
+        out[2] = pixel.b;
+        if (image.channels == 4) {
+            out[3] = pixel.a;
+        }
+        out += image.channels;
+    }
+
+    if (out != image.pixels.data() + image.pixels.size()) {
+        throw std::runtime_error("The QOI image is truncated.");
+    }
+    return image;
+}
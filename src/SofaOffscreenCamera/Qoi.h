@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Encoder and decoder of the "Quite OK Image" format (https://qoiformat.org), a lossless image format that compresses
+ * about as well as PNG while being an order of magnitude faster to encode and decode.
+ */
+
+/**
+ * Encode an image with 3 (RGB) or 4 (RGBA) channels of one byte each. Its rows are stride bytes apart.
+ */
+std::vector<std::uint8_t> qoi_encode(const std::uint8_t * pixels, int width, int height, int channels,
+                                     std::size_t stride);
+
+struct QoiImage {
+    int width = 0;
+    int height = 0;
+    int channels = 0;                 ///< 3 (RGB) or 4 (RGBA)
+    std::vector<std::uint8_t> pixels; ///< Rows stored contiguously, without padding
+};
+
+/** Decode an image. Throws std::runtime_error if the data is not a valid QOI image. */
+QoiImage qoi_decode(const std::uint8_t * data, std::size_t size);
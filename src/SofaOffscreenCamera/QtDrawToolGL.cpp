@@ -1,6 +1,9 @@
 #include <sofa/helper/logging/Messaging.h>
 #include "QtDrawToolGL.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace sofa::helper::visual {
 
 //=========
@@ -8,24 +11,19 @@ namespace sofa::helper::visual {
 //=========
 
 void QtDrawToolGL::setMaterial(const Base::RGBAColor &color) {
+    // The current color is also modified by the vertices drawn in between, hence it is not cached
     glColor4f(color[0],color[1],color[2],color[3]);
-    glMaterialfv (GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, &color[0]);
-    static const float emissive[4] = { 0.0f, 0.0f, 0.0f, 0.0f};
-    static const float specular[4] = { 1.0f, 1.0f, 1.0f, 1.0f};
-    glMaterialfv (GL_FRONT_AND_BACK, GL_EMISSION, emissive);
-    glMaterialfv (GL_FRONT_AND_BACK, GL_SPECULAR, specular);
-    glMaterialf  (GL_FRONT_AND_BACK, GL_SHININESS, 20);
-    if (color[3] < 1)
-    {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glDepthMask(0);
-    }
-    else
-    {
-        glDisable(GL_BLEND);
-        glDepthMask(1);
+    if (not elide(p_shadow.material == color)) {
+        save_attributes(GL_LIGHTING_BIT);
+        glMaterialfv (GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, &color[0]);
+        static const float emissive[4] = { 0.0f, 0.0f, 0.0f, 0.0f};
+        static const float specular[4] = { 1.0f, 1.0f, 1.0f, 1.0f};
+        glMaterialfv (GL_FRONT_AND_BACK, GL_EMISSION, emissive);
+        glMaterialfv (GL_FRONT_AND_BACK, GL_SPECULAR, specular);
+        glMaterialf  (GL_FRONT_AND_BACK, GL_SHININESS, 20);
+        p_shadow.material = color;
     }
+    set_transparency(color[3] < 1);
 }
 
 void QtDrawToolGL::resetMaterial(const Base::RGBAColor &color) {
@@ -35,8 +33,7 @@ void QtDrawToolGL::resetMaterial(const Base::RGBAColor &color) {
 }
 
 void QtDrawToolGL::resetMaterial() {
-    glDisable(GL_BLEND);
-    glDepthMask(1);
+    set_transparency(false);
 }
 
 //=======
@@ -89,6 +86,10 @@ void QtDrawToolGL::drawPoints(const std::vector<Vector3> &points, float size, co
 }
 
 void QtDrawToolGL::drawPoints(const std::vector<Vector3> &points, float size, const std::vector<RGBAColor> &color) {
+    // Lighting is disabled, so the color of each point is enough. Blending cannot be toggled between glBegin and
+    // glEnd, it is enabled for all the points if any of them is transparent.
+    const bool transparent = std::any_of(color.begin(), color.end(), [](const RGBAColor & c) { return c[3] < 1; });
+    set_transparency(transparent);
     glPointSize(size);
     if (getLightEnabled())
         disableLighting();
@@ -96,14 +97,14 @@ void QtDrawToolGL::drawPoints(const std::vector<Vector3> &points, float size, co
     {
         for (std::size_t i=0; i<points.size(); ++i)
         {
-            setMaterial(color[i]);
             internalDrawPoint(points[i], color[i]);
-            resetMaterial(color[i]);
         }
     }
     glEnd();
     if (getLightEnabled())
         enableLighting();
+    if (transparent)
+        resetMaterial();
     glPointSize(1);
 }
 
@@ -158,6 +159,9 @@ void QtDrawToolGL::drawLines(const std::vector<Vector3> &points, float size, con
         return drawLines(points, size, RGBAColor::red());
     }
 
+    // Same as for the points, blending is enabled for all the lines if any of them is transparent
+    const bool transparent = std::any_of(colors.begin(), colors.end(), [](const RGBAColor & c) { return c[3] < 1; });
+    set_transparency(transparent);
     glLineWidth(size);
     if (getLightEnabled())
         disableLighting();
@@ -165,14 +169,14 @@ void QtDrawToolGL::drawLines(const std::vector<Vector3> &points, float size, con
     {
         const std::size_t nb_lines = points.size()/2;
         for (std::size_t i=0; i<nb_lines; ++i){
-            setMaterial(colors[i]);
             internalDrawLine(points[2*i],points[2*i+1], colors[i] );
-            resetMaterial(colors[i]);
         }
     }
     glEnd();
     if (getLightEnabled())
         enableLighting();
+    if (transparent)
+        resetMaterial();
     glLineWidth(1);
 }
 
@@ -357,11 +361,23 @@ void QtDrawToolGL::drawTriangles(const std::vector<Vector3> &points, const QtDra
 void QtDrawToolGL::drawTriangles(const std::vector<Vector3> &points, const std::vector<Vec3i> &index,
                                  const std::vector<Vector3> &normal, const QtDrawToolGL::RGBAColor &color) {
     setMaterial(color);
+    if (p_geometry_cache and p_geometry_cache->draw(current_state(), points, index, normal, color)) {
+        resetMaterial(color);
+        return;
+    }
+    // The normals are given either one per triangle or one per point, as for the geometry cache
+    const bool point_normals = (normal.size() != index.size() and normal.size() == points.size());
     glBegin(GL_TRIANGLES);
     {
         const std::size_t nb_triangles = index.size();
         for (std::size_t i=0; i<nb_triangles; ++i) {
-            internalDrawTriangle(points[ index[i][0] ],points[ index[i][1] ],points[ index[i][2] ],normal[i],color);
+            const auto & t = index[i];
+            if (point_normals) {
+                internalDrawTriangle(points[t[0]], points[t[1]], points[t[2]],
+                                     normal[t[0]], normal[t[1]], normal[t[2]], color, color, color);
+            } else {
+                internalDrawTriangle(points[t[0]], points[t[1]], points[t[2]], normal[i], color);
+            }
         }
     } glEnd();
     resetMaterial(color);
@@ -381,8 +397,12 @@ void QtDrawToolGL::drawTriangles(const std::vector<Vector3> &points, const std::
     const std::size_t nbTriangles=points.size()/3;
     bool computeNormals= (normal.size() != nbTriangles);
     if (nbTriangles == 0) return;
-    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
-    glEnable(GL_COLOR_MATERIAL);
+    if (not elide(p_shadow.color_material_parameters)) {
+        save_attributes(GL_LIGHTING_BIT);
+        glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+        p_shadow.color_material_parameters = true;
+    }
+    set_capability(GL_COLOR_MATERIAL, true, p_shadow.color_material);
     setMaterial(color[0]);
     glBegin(GL_TRIANGLES);
     {
@@ -408,7 +428,9 @@ void QtDrawToolGL::drawTriangles(const std::vector<Vector3> &points, const std::
             }
         }
     } glEnd();
-    glDisable(GL_COLOR_MATERIAL);
+    set_capability(GL_COLOR_MATERIAL, false, p_shadow.color_material);
+    // The material took the color of the last vertex
+    p_shadow.material.reset();
     resetMaterial(color[0]);
 }
 
@@ -751,82 +773,94 @@ void QtDrawToolGL::drawScaledHexahedra(const std::vector<Vector3> &points, const
     resetMaterial(color);
 }
 
-//==============
-// MISCELLANEOUS
-//==============
+//========
+// SPHERES
+//========
 
-void
-QtDrawToolGL::drawCone(const QtDrawToolGL::Vector3 &p1, const QtDrawToolGL::Vector3 &p2, float radius1, float radius2,
-                       const QtDrawToolGL::RGBAColor &color, int subd) {
-    Vector3 tmp = p2-p1;
-    setMaterial(color);
-    /* create Vectors p and q, co-planar with the cylinder's cross-sectional disk */
-    Vector3 p=tmp;
-    if (fabs(p[0]) + fabs(p[1]) < 0.00001*tmp.norm())
-        p[0] += 1.0;
-    else
-        p[2] += 1.0;
-    Vector3 q;
-    q = p.cross(tmp);
-    p = tmp.cross(q);
-    /* do the normalization outside the segment loop */
-    p.normalize();
-    q.normalize();
+// Spheres are ray-casted on screen-aligned quads by the batch renderer, hence there is no difference between the
+// tessellated and the "fake" spheres. Without sphere instancing, both are tessellated in immediate mode.
 
-    int i2;
+void QtDrawToolGL::drawSphere(const QtDrawToolGL::Vector3 &p, float radius) {
+    GLfloat current_color[4];
+    glGetFloatv(GL_CURRENT_COLOR, current_color);
+    drawSphere(p, radius, RGBAColor(current_color[0], current_color[1], current_color[2], current_color[3]));
+}
 
-    /* build the cylinder from rectangular subd */
-    std::vector<Vector3> points;
-    std::vector<Vector3> normals;
+void QtDrawToolGL::drawSphere(const QtDrawToolGL::Vector3 &p, float radius, const QtDrawToolGL::RGBAColor &color) {
+    if (not p_renderer.has_sphere_instancing()) {
+        draw_sphere_immediately(p, radius, color);
+        return;
+    }
+    update_batch_state();
+    p_renderer.add_sphere(p, radius, color);
+}
+
+void QtDrawToolGL::drawSpheres(const std::vector<Vector3> &points, const std::vector<float> &radius,
+                               const QtDrawToolGL::RGBAColor &color) {
+    if (not p_renderer.has_sphere_instancing()) {
+        if (radius.empty())
+            return;
+        const bool one_radius_per_point = (radius.size() == points.size());
+        for (std::size_t i = 0; i < points.size(); ++i)
+            draw_sphere_immediately(points[i], one_radius_per_point ? radius[i] : radius[0], color);
+        return;
+    }
+    update_batch_state();
+    p_renderer.add_spheres(points, radius, color);
+}
 
-    std::vector<Vector3> pointsCloseCylinder1;
-    std::vector<Vector3> normalsCloseCylinder1;
-    std::vector<Vector3> pointsCloseCylinder2;
-    std::vector<Vector3> normalsCloseCylinder2;
+void QtDrawToolGL::drawSpheres(const std::vector<Vector3> &points, float radius, const QtDrawToolGL::RGBAColor &color) {
+    drawSpheres(points, std::vector<float> {radius}, color);
+}
 
-    Vector3 dir=p1-p2; dir.normalize();
-    pointsCloseCylinder1.push_back(p1);
-    normalsCloseCylinder1.push_back(dir);
-    pointsCloseCylinder2.push_back(p2);
-    normalsCloseCylinder2.push_back(-dir);
+void QtDrawToolGL::drawFakeSpheres(const std::vector<Vector3> &points, const std::vector<float> &radius,
+                                   const QtDrawToolGL::RGBAColor &color) {
+    drawSpheres(points, radius, color);
+}
 
+void QtDrawToolGL::drawFakeSpheres(const std::vector<Vector3> &points, float radius,
+                                   const QtDrawToolGL::RGBAColor &color) {
+    drawSpheres(points, radius, color);
+}
 
-    for (i2=0 ; i2<=subd ; i2++)
-    {
-        /* sweep out a circle */
-        float theta =  (float)( i2 * 2.0f * M_PI / subd );
-        float st = sin(theta);
-        float ct = cos(theta);
-        /* construct normal */
-        tmp = p*ct+q*st;
-        /* set the normal for the two subseqent points */
-        normals.push_back(tmp);
+//=======
+// ARROWS
+//=======
 
-        /* point on disk 1 */
-        Vector3 w(p1);
-        w += tmp*fabs(radius1);
-        points.push_back(w);
-        pointsCloseCylinder1.push_back(w);
-        normalsCloseCylinder1.push_back(dir);
+void QtDrawToolGL::drawArrow(const QtDrawToolGL::Vector3 &p1, const QtDrawToolGL::Vector3 &p2, float radius,
+                             const QtDrawToolGL::RGBAColor &color, int subd) {
+    // The cone takes the last fifth of the arrow
+    drawArrow(p1, p2, radius, static_cast<float>((p2 - p1).norm() * 0.2), radius * 2.5f, color, subd);
+}
 
-        /* point on disk 2 */
-        w=p2;
-        w += tmp*fabs(radius2);
-        points.push_back(w);
-        pointsCloseCylinder2.push_back(w);
-        normalsCloseCylinder2.push_back(-dir);
-    }
-    pointsCloseCylinder1.push_back(pointsCloseCylinder1[1]);
-    normalsCloseCylinder1.push_back(normalsCloseCylinder1[1]);
-    pointsCloseCylinder2.push_back(pointsCloseCylinder2[1]);
-    normalsCloseCylinder2.push_back(normalsCloseCylinder2[1]);
+void QtDrawToolGL::drawArrow(const QtDrawToolGL::Vector3 &p1, const QtDrawToolGL::Vector3 &p2, float radius,
+                             float coneLength, const QtDrawToolGL::RGBAColor &color, int subd) {
+    drawArrow(p1, p2, radius, coneLength, radius * 2.5f, color, subd);
+}
 
+void QtDrawToolGL::drawArrow(const QtDrawToolGL::Vector3 &p1, const QtDrawToolGL::Vector3 &p2, float radius,
+                             float coneLength, float coneRadius, const QtDrawToolGL::RGBAColor &color, int subd) {
+    if (not p_renderer.has_arrow_instancing()) {
+        draw_arrow_immediately(p1, p2, radius, coneLength, coneRadius, color, subd);
+        return;
+    }
+    update_batch_state();
+    p_renderer.add_arrow(p1, p2, radius, coneLength, coneRadius, color, subd);
+}
 
-    drawTriangleStrip(points, normals,color);
-    if (radius1 > 0) drawTriangleFan(pointsCloseCylinder1, normalsCloseCylinder1,color);
-    if (radius2 > 0) drawTriangleFan(pointsCloseCylinder2, normalsCloseCylinder2,color);
+//==============
+// MISCELLANEOUS
+//==============
 
-    resetMaterial(color);
+void
+QtDrawToolGL::drawCone(const QtDrawToolGL::Vector3 &p1, const QtDrawToolGL::Vector3 &p2, float radius1, float radius2,
+                       const QtDrawToolGL::RGBAColor &color, int subd) {
+    if (not p_renderer.has_cone_instancing()) {
+        draw_cone_immediately(p1, p2, radius1, radius2, color, subd, radius1 > 0, radius2 > 0);
+        return;
+    }
+    update_batch_state();
+    p_renderer.add_cone(p1, p2, radius1, radius2, color, subd, radius1 > 0, radius2 > 0);
 }
 
 void
@@ -871,7 +905,7 @@ QtDrawToolGL::drawDisk(float radius, double from, double to, int resolution, con
 
 void QtDrawToolGL::drawCircle(float radius, float lineThickness, int resolution, const QtDrawToolGL::RGBAColor &color) {
     glLineWidth(lineThickness);
-    glEnable(GL_LINE_SMOOTH);
+    set_capability(GL_LINE_SMOOTH, true, p_shadow.line_smooth);
 
     glBegin(GL_LINE_STRIP);
     {
@@ -887,10 +921,20 @@ void QtDrawToolGL::drawCircle(float radius, float lineThickness, int resolution,
     }
     glEnd();
 
-    glDisable(GL_LINE_SMOOTH);
+    set_capability(GL_LINE_SMOOTH, false, p_shadow.line_smooth);
     glLineWidth(1.0f);
 }
 
+void QtDrawToolGL::drawFrame(const QtDrawToolGL::Vector3 &position, const QtDrawToolGL::Quaternion &orientation,
+                             const QtDrawToolGL::Vec3f &size) {
+    draw_frame_axes(position, orientation, size, RGBAColor::red(), RGBAColor::green(), RGBAColor::blue());
+}
+
+void QtDrawToolGL::drawFrame(const QtDrawToolGL::Vector3 &position, const QtDrawToolGL::Quaternion &orientation,
+                             const QtDrawToolGL::Vec3f &size, const QtDrawToolGL::RGBAColor &color) {
+    draw_frame_axes(position, orientation, size, color, color, color);
+}
+
 void QtDrawToolGL::drawCube(const float &radius, const QtDrawToolGL::RGBAColor &color, const int &subd) {
     // X Axis
     drawCylinder( Vector3(-1.0, -1.0, -1.0), Vector3(1.0, -1.0, -1.0), radius, color, subd);
@@ -916,55 +960,16 @@ void QtDrawToolGL::drawCylinder(const QtDrawToolGL::Vector3 &p1, const QtDrawToo
 
 void QtDrawToolGL::drawCapsule(const QtDrawToolGL::Vector3 &p1, const QtDrawToolGL::Vector3 &p2, float radius,
                                const QtDrawToolGL::RGBAColor &color, int subd) {
-    Vector3 tmp = p2-p1;
-    setMaterial(color);
-    /* create Vectors p and q, co-planar with the capsules's cross-sectional disk */
-    Vector3 p=tmp;
-    if (fabs(p[0]) + fabs(p[1]) < 0.00001*tmp.norm())
-        p[0] += 1.0;
-    else
-        p[2] += 1.0;
-    Vector3 q;
-    q = p.cross(tmp);
-    p = tmp.cross(q);
-    /* do the normalization outside the segment loop */
-    p.normalize();
-    q.normalize();
-
-    int i2;
-    /* build the cylinder part of the capsule from rectangular subd */
-    std::vector<Vector3> points;
-    std::vector<Vector3> normals;
-
-    for (i2=0 ; i2<=subd ; i2++)
-    {
-        /* sweep out a circle */
-        float theta =  (float)( i2 * 2.0f * M_PI / subd );
-        float st = sin(theta);
-        float ct = cos(theta);
-        /* construct normal */
-        tmp = p*ct+q*st;
-        /* set the normal for the two subseqent points */
-        normals.push_back(tmp);
-
-        Vector3 w(p1);
-        w += tmp*fabs(radius);
-        points.push_back(w);
-
-        w=p2;
-        w += tmp*fabs(radius);
-        points.push_back(w);
+    // The cylinder part of the capsule is left open, the two hemispheres are easier drawn as spheres
+    if (p_renderer.has_cone_instancing()) {
+        update_batch_state();
+        p_renderer.add_cone(p1, p2, radius, radius, color, subd, false, false);
+    } else {
+        draw_cone_immediately(p1, p2, radius, radius, color, subd, false, false);
     }
 
-    //we draw here the cylinder part
-    drawTriangleStrip(points, normals,color);
-
-    //now we must draw the two hemispheres
-    //but it's easier to draw spheres...
-    drawSphere(p1,radius);
-    drawSphere(p2,radius);
-
-    resetMaterial(color);
+    drawSphere(p1, radius, color);
+    drawSphere(p2, radius, color);
 }
 
 void QtDrawToolGL::drawCross(const QtDrawToolGL::Vector3 &p, float length, const QtDrawToolGL::RGBAColor &color) {
@@ -1035,6 +1040,29 @@ void QtDrawToolGL::drawBoundingBox(const QtDrawToolGL::Vector3 &min, const QtDra
     glLineWidth(1.0);
 }
 
+//=====
+// TEXT
+//=====
+
+// Text is batched by the renderer over the whole frame and drawn from a glyph atlas
+
+void QtDrawToolGL::draw3DText(const QtDrawToolGL::Vector3 &p, float scale, const QtDrawToolGL::RGBAColor &color,
+                              const char *text) {
+    update_batch_state();
+    p_renderer.add_text(p, scale, color, text);
+}
+
+void QtDrawToolGL::draw3DText_Indices(const std::vector<Vector3> &positions, float scale,
+                                      const QtDrawToolGL::RGBAColor &color) {
+    update_batch_state();
+    p_renderer.add_index_labels(positions, scale, color);
+}
+
+void QtDrawToolGL::writeOverlayText(int x, int y, unsigned fontSize, const QtDrawToolGL::RGBAColor &color,
+                                    const char *text) {
+    p_renderer.add_overlay_text(x, y, static_cast<float>(fontSize), color, text);
+}
+
 //===============
 // TRANSFORMATION
 //===============
@@ -1064,48 +1092,88 @@ void QtDrawToolGL::translate(float x, float y, float z) {
 //=================
 
 void QtDrawToolGL::enablePolygonOffset(float factor, float units) {
-    glEnable(GL_POLYGON_OFFSET_LINE);
-    glPolygonOffset(factor, units);
+    p_renderer.flush();
+    set_capability(GL_POLYGON_OFFSET_LINE, true, p_shadow.polygon_offset);
+    if (not elide(p_shadow.polygon_offset_parameters == std::make_pair(factor, units))) {
+        save_attributes(GL_POLYGON_BIT);
+        glPolygonOffset(factor, units);
+        p_shadow.polygon_offset_parameters = std::make_pair(factor, units);
+    }
 }
 
 void QtDrawToolGL::disablePolygonOffset() {
-    glDisable(GL_POLYGON_OFFSET_LINE);
+    p_renderer.flush();
+    set_capability(GL_POLYGON_OFFSET_LINE, false, p_shadow.polygon_offset);
 }
 
 void QtDrawToolGL::enableBlending() {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    set_capability(GL_BLEND, true, p_shadow.blending);
+    set_alpha_blend_function();
 }
 
 void QtDrawToolGL::disableBlending() {
-    glDisable(GL_BLEND);
+    set_capability(GL_BLEND, false, p_shadow.blending);
 }
 
 void QtDrawToolGL::enableLighting() {
-    glEnable(GL_LIGHTING);
+    set_capability(GL_LIGHTING, true, p_shadow.lighting);
 }
 
 void QtDrawToolGL::disableLighting() {
-    glDisable(GL_LIGHTING);
+    set_capability(GL_LIGHTING, false, p_shadow.lighting);
 }
 
 void QtDrawToolGL::enableDepthTest() {
-    glEnable(GL_DEPTH_TEST);
+    p_renderer.flush();
+    set_capability(GL_DEPTH_TEST, true, p_shadow.depth_test);
 }
 
 void QtDrawToolGL::disableDepthTest() {
-    glDisable(GL_DEPTH_TEST);
+    p_renderer.flush();
+    set_capability(GL_DEPTH_TEST, false, p_shadow.depth_test);
 }
 
 void QtDrawToolGL::saveLastState() {
-    glPushAttrib(GL_ALL_ATTRIB_BITS);
+    p_renderer.flush();
+
+    // The current color, the line width and the point size are modified by about every drawing function, they are
+    // always saved. The other groups are only pushed once the draw tool is about to modify them. This requires up to
+    // five more levels of the attribute stack, everything is saved at once when there is not enough room left.
+    GLbitfield groups = GL_CURRENT_BIT | GL_LINE_BIT | GL_POINT_BIT;
+    GLint depth = 0, max_depth = 0;
+    glGetIntegerv(GL_ATTRIB_STACK_DEPTH, &depth);
+    glGetIntegerv(GL_MAX_ATTRIB_STACK_DEPTH, &max_depth);
+    if (not p_cache_state || max_depth - depth < 6) {
+        groups = GL_ALL_ATTRIB_BITS;
+    }
+    glPushAttrib(groups);
+
+    SavedState saved;
+    saved.shadow = p_shadow;
+    saved.pushed_groups = groups;
+    saved.number_of_pushes = 1;
+    p_saved_states.push_back(saved);
 }
 
 void QtDrawToolGL::restoreLastState() {
-    glPopAttrib();
+    p_renderer.flush();
+    if (p_saved_states.empty()) {
+        // Unbalanced call, let OpenGL report the underflow as it would without the cache
+        glPopAttrib();
+        invalidate_state_cache();
+        return;
+    }
+
+    const SavedState & saved = p_saved_states.back();
+    for (int i = 0; i < saved.number_of_pushes; ++i) {
+        glPopAttrib();
+    }
+    p_shadow = saved.shadow;
+    p_saved_states.pop_back();
 }
 
 void QtDrawToolGL::readPixels(int x, int y, int w, int h, float *rgb, float *z) {
+    p_renderer.flush();
     if(rgb != nullptr && sizeof(*rgb) == 3 * sizeof(float) * w * h)
         glReadPixels(x, y, w, h, GL_RGB, GL_FLOAT, rgb);
 
@@ -1127,23 +1195,252 @@ bool QtDrawToolGL::getLightEnabled() {
 }
 
 void QtDrawToolGL::setPolygonMode(int _mode, bool _wireframe) {
+    p_renderer.flush();
     p_polygon_mode=_mode;
     p_wireframe_enabled=_wireframe;
     if (!p_polygon_mode)
     {
-        if (p_wireframe_enabled) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        else                     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        if (p_wireframe_enabled) set_polygon_mode(GL_FRONT_AND_BACK, GL_LINE);
+        else                     set_polygon_mode(GL_FRONT_AND_BACK, GL_FILL);
     }
     else if (p_polygon_mode == 1)
     {
-        if (p_wireframe_enabled) glPolygonMode(GL_FRONT, GL_LINE);
-        else                     glPolygonMode(GL_FRONT, GL_FILL);
+        if (p_wireframe_enabled) set_polygon_mode(GL_FRONT, GL_LINE);
+        else                     set_polygon_mode(GL_FRONT, GL_FILL);
     }
     else if (p_polygon_mode == 2)
     {
-        if (p_wireframe_enabled) glPolygonMode(GL_BACK, GL_LINE);
-        else                     glPolygonMode(GL_BACK, GL_FILL);
+        if (p_wireframe_enabled) set_polygon_mode(GL_BACK, GL_LINE);
+        else                     set_polygon_mode(GL_BACK, GL_FILL);
+    }
+}
+
+void QtDrawToolGL::invalidate_state_cache() {
+    p_shadow = ShadowState();
+    for (auto & saved : p_saved_states) {
+        saved.shadow = ShadowState();
+    }
+}
+
+//============
+// STATE CACHE
+//============
+
+bool QtDrawToolGL::elide(bool unchanged) {
+    if (p_cache_state && unchanged) {
+        ++p_statistics.elided;
+        return true;
     }
+    ++p_statistics.issued;
+    return false;
+}
+
+void QtDrawToolGL::save_attributes(GLbitfield groups) {
+    if (p_saved_states.empty())
+        return;
+
+    SavedState & saved = p_saved_states.back();
+    const GLbitfield missing_groups = groups & ~saved.pushed_groups;
+    if (missing_groups == 0)
+        return;
+
+    glPushAttrib(missing_groups);
+    saved.pushed_groups |= missing_groups;
+    ++saved.number_of_pushes;
+}
+
+void QtDrawToolGL::set_capability(GLenum capability, bool enabled, Shadow<bool> & shadow) {
+    if (elide(shadow == enabled))
+        return;
+
+    save_attributes(GL_ENABLE_BIT);
+    if (enabled) glEnable(capability);
+    else         glDisable(capability);
+    shadow = enabled;
+}
+
+void QtDrawToolGL::set_depth_mask(bool enabled) {
+    if (elide(p_shadow.depth_mask == enabled))
+        return;
+
+    save_attributes(GL_DEPTH_BUFFER_BIT);
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    p_shadow.depth_mask = enabled;
+}
+
+void QtDrawToolGL::set_alpha_blend_function() {
+    if (elide(p_shadow.alpha_blend_function))
+        return;
+
+    save_attributes(GL_COLOR_BUFFER_BIT);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    p_shadow.alpha_blend_function = true;
+}
+
+void QtDrawToolGL::set_polygon_mode(GLenum face, GLenum mode) {
+    const bool front = (face != GL_BACK);
+    const bool back = (face != GL_FRONT);
+    const bool unchanged = (not front || p_shadow.front_polygon_mode == mode)
+                        && (not back  || p_shadow.back_polygon_mode == mode);
+    if (elide(unchanged))
+        return;
+
+    save_attributes(GL_POLYGON_BIT);
+    glPolygonMode(face, mode);
+    if (front) p_shadow.front_polygon_mode = mode;
+    if (back)  p_shadow.back_polygon_mode = mode;
+}
+
+void QtDrawToolGL::set_transparency(bool transparent) {
+    set_capability(GL_BLEND, transparent, p_shadow.blending);
+    if (transparent)
+        set_alpha_blend_function();
+    set_depth_mask(not transparent);
+}
+
+void QtDrawToolGL::draw_cone_immediately(const QtDrawToolGL::Vector3 &p1, const QtDrawToolGL::Vector3 &p2,
+                                         float radius1, float radius2, const QtDrawToolGL::RGBAColor &color, int subd,
+                                         bool close_p1, bool close_p2) {
+    Vector3 tmp = p2-p1;
+    if (tmp.norm2() <= 0)
+        return;
+    setMaterial(color);
+    /* create Vectors p and q, co-planar with the cylinder's cross-sectional disk */
+    Vector3 p=tmp;
+    if (fabs(p[0]) + fabs(p[1]) < 0.00001*tmp.norm())
+        p[0] += 1.0;
+    else
+        p[2] += 1.0;
+    Vector3 q;
+    q = p.cross(tmp);
+    p = tmp.cross(q);
+    /* do the normalization outside the segment loop */
+    p.normalize();
+    q.normalize();
+
+    /* build the cylinder from rectangular subd */
+    std::vector<Vector3> points;
+    std::vector<Vector3> normals;
+
+    std::vector<Vector3> pointsCloseCylinder1;
+    std::vector<Vector3> normalsCloseCylinder1;
+    std::vector<Vector3> pointsCloseCylinder2;
+    std::vector<Vector3> normalsCloseCylinder2;
+
+    Vector3 dir=p1-p2; dir.normalize();
+    pointsCloseCylinder1.push_back(p1);
+    normalsCloseCylinder1.push_back(dir);
+    pointsCloseCylinder2.push_back(p2);
+    normalsCloseCylinder2.push_back(-dir);
+
+    for (int i2=0 ; i2<=subd ; i2++)
+    {
+        /* sweep out a circle */
+        float theta =  (float)( i2 * 2.0f * M_PI / subd );
+        float st = sin(theta);
+        float ct = cos(theta);
+        /* construct normal */
+        tmp = p*ct+q*st;
+        /* set the normal for the two subseqent points */
+        normals.push_back(tmp);
+
+        /* point on disk 1 */
+        Vector3 w(p1);
+        w += tmp*fabs(radius1);
+        points.push_back(w);
+        pointsCloseCylinder1.push_back(w);
+        normalsCloseCylinder1.push_back(dir);
+
+        /* point on disk 2 */
+        w=p2;
+        w += tmp*fabs(radius2);
+        points.push_back(w);
+        pointsCloseCylinder2.push_back(w);
+        normalsCloseCylinder2.push_back(-dir);
+    }
+    pointsCloseCylinder1.push_back(pointsCloseCylinder1[1]);
+    normalsCloseCylinder1.push_back(normalsCloseCylinder1[1]);
+    pointsCloseCylinder2.push_back(pointsCloseCylinder2[1]);
+    normalsCloseCylinder2.push_back(normalsCloseCylinder2[1]);
+
+    drawTriangleStrip(points, normals,color);
+    if (close_p1) drawTriangleFan(pointsCloseCylinder1, normalsCloseCylinder1,color);
+    if (close_p2) drawTriangleFan(pointsCloseCylinder2, normalsCloseCylinder2,color);
+
+    resetMaterial(color);
+}
+
+void QtDrawToolGL::draw_arrow_immediately(const QtDrawToolGL::Vector3 &p1, const QtDrawToolGL::Vector3 &p2,
+                                          float radius, float cone_length, float cone_radius,
+                                          const QtDrawToolGL::RGBAColor &color, int subd) {
+    const double length = (p2 - p1).norm();
+    if (length <= 0)
+        return;
+
+    // Same split as the instanced arrows: the cone is at most as long as the arrow, the shaft takes the rest
+    const Vector3 split = p2 - (p2 - p1) * (std::min<double>(cone_length, length) / length);
+    draw_cone_immediately(p1, split, radius, radius, color, subd, true, false);
+    draw_cone_immediately(split, p2, cone_radius, 0, color, subd, true, false);
+}
+
+void QtDrawToolGL::draw_sphere_immediately(const QtDrawToolGL::Vector3 &center, float radius,
+                                           const QtDrawToolGL::RGBAColor &color) {
+    // Latitude-longitude tessellation, one triangle strip per band of latitude
+    constexpr int slices = 16;
+    constexpr int stacks = 8;
+    setMaterial(color);
+    for (int i = 0; i < stacks; ++i) {
+        const double band[2] = {M_PI * i / stacks, M_PI * (i + 1) / stacks};
+        glBegin(GL_TRIANGLE_STRIP);
+        for (int j = 0; j <= slices; ++j) {
+            const double phi = 2.0 * M_PI * j / slices;
+            for (const double theta : band) {
+                const Vector3 n(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+                const Vector3 p = center + n * std::fabs(radius);
+                glNormal3d(n[0], n[1], n[2]);
+                glVertex3d(p[0], p[1], p[2]);
+            }
+        }
+        glEnd();
+    }
+    resetMaterial(color);
+}
+
+void QtDrawToolGL::draw_frame_axes(const QtDrawToolGL::Vector3 &position, const QtDrawToolGL::Quaternion &orientation,
+                                   const QtDrawToolGL::Vec3f &size, const QtDrawToolGL::RGBAColor &x_color,
+                                   const QtDrawToolGL::RGBAColor &y_color, const QtDrawToolGL::RGBAColor &z_color) {
+    const RGBAColor * colors[3] = {&x_color, &y_color, &z_color};
+    const bool instancing = p_renderer.has_arrow_instancing();
+    if (instancing)
+        update_batch_state();
+    for (unsigned int i = 0; i < 3; ++i) {
+        if (size[i] <= 0)
+            continue;
+        Vector3 axis(0, 0, 0);
+        axis[i] = size[i];
+        const Vector3 tip = position + orientation.rotate(axis);
+        if (instancing)
+            p_renderer.add_arrow(position, tip, size[i] * 0.05f, size[i] * 0.25f, size[i] * 0.1f, *colors[i], 16);
+        else
+            draw_arrow_immediately(position, tip, size[i] * 0.05f, size[i] * 0.25f, size[i] * 0.1f, *colors[i], 16);
+    }
+}
+
+BatchRenderer::State QtDrawToolGL::current_state() {
+    // The transformation is read back from OpenGL since components may also modify it without the draw tool
+    GLfloat projection[16], modelview[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+
+    BatchRenderer::State state;
+    state.projection = QMatrix4x4(projection).transposed();
+    state.modelview = QMatrix4x4(modelview).transposed();
+    state.lighting = glIsEnabled(GL_LIGHTING);
+    return state;
+}
+
+void QtDrawToolGL::update_batch_state() {
+    p_renderer.set_state(current_state());
 }
 
 } // namespace sofa::core::visual
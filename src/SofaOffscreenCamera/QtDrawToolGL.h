@@ -8,6 +8,13 @@
 #include <QOpenGLFunctions>
 #include <sofa/type/vector.h>
 
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "BatchRenderer.h"
+#include "GeometryCache.h"
+
 namespace sofa::helper::visual {
 class SOFA_CORE_API QtDrawToolGL : public DrawTool {
 public:
@@ -19,7 +26,26 @@ public:
     using Vec2i = Base::Vec2i;
     using Quaternion = Base::Quaternion;
 
-    QtDrawToolGL() : p_opengl_functions(nullptr) {}
+    /** Number of OpenGL state changes requested to the draw tool, split into the issued and the elided ones. */
+    struct StateCacheStatistics {
+        std::size_t issued = 0;
+        std::size_t elided = 0;
+    };
+
+    /**
+     * The parametric primitives (cones, cylinders, capsules, ...) are not drawn immediately but queued as instances
+     * into the given renderer, which must outlive the draw tool. The caller is responsible for flushing the renderer
+     * once the scene has been drawn.
+     *
+     * When cache_state is set, the draw tool keeps a shadow copy of the OpenGL state it modifies (material, lighting,
+     * blending, depth, polygon offset and polygon mode) and skips the calls that would not change it. The shadow
+     * state starts unknown, hence the draw tool is meant to be created anew for every frame.
+     *
+     * When a geometry cache is given, indexed triangle sets are drawn from the index buffers it keeps resident across
+     * frames instead of being sent vertex by vertex.
+     */
+    explicit QtDrawToolGL(BatchRenderer & renderer, bool cache_state = false, GeometryCache * geometry_cache = nullptr)
+        : p_opengl_functions(nullptr), p_renderer(renderer), p_geometry_cache(geometry_cache), p_cache_state(cache_state) {}
 
     void init() override {}
 
@@ -109,19 +135,19 @@ public:
     //========
     // SPHERES
     //========
-    void drawSphere( const Vector3 & /*p*/, float /*radius*/) override {}
-    void drawSphere(const Vector3 & /*p*/, float /*radius*/, const RGBAColor & /*color*/) override {}
-    void drawSpheres (const std::vector<Vector3> & /*points*/, const std::vector<float>& /*radius*/, const RGBAColor& /*color*/) override {}
-    void drawSpheres (const std::vector<Vector3> & /*points*/, float /*radius*/, const RGBAColor& /*color*/) override {}
-    void drawFakeSpheres(const std::vector<Vector3> &/*points*/, const std::vector<float>& /*radius*/, const RGBAColor& /*color*/) override {}
-    void drawFakeSpheres(const std::vector<Vector3> &/*points*/, float /*radius*/, const RGBAColor& /*color*/) override {}
+    void drawSphere(const Vector3 &p, float radius) override;
+    void drawSphere(const Vector3 &p, float radius, const RGBAColor &color) override;
+    void drawSpheres(const std::vector<Vector3> &points, const std::vector<float>& radius, const RGBAColor& color) override;
+    void drawSpheres(const std::vector<Vector3> &points, float radius, const RGBAColor& color) override;
+    void drawFakeSpheres(const std::vector<Vector3> &points, const std::vector<float>& radius, const RGBAColor& color) override;
+    void drawFakeSpheres(const std::vector<Vector3> &points, float radius, const RGBAColor& color) override;
 
     //=======
     // ARROWS
     //=======
-    void drawArrow   (const Vector3& /*p1*/, const Vector3 &/*p2*/, float /*radius*/, const RGBAColor& /*color*/,  int /*subd=16*/) override {}
-    void drawArrow   (const Vector3& /*p1*/, const Vector3 &/*p2*/, float /*radius*/, float /*coneLength*/, const RGBAColor& /*color*/,  int/* subd=16*/) override {}
-    void drawArrow   (const Vector3& /*p1*/, const Vector3 &/*p2*/, float /*radius*/, float /*coneLength*/, float /*coneRadius*/, const RGBAColor& /*color*/,  int /*subd=16*/) override {}
+    void drawArrow   (const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color,  int subd=16) override;
+    void drawArrow   (const Vector3& p1, const Vector3 &p2, float radius, float coneLength, const RGBAColor& color,  int subd=16) override;
+    void drawArrow   (const Vector3& p1, const Vector3 &p2, float radius, float coneLength, float coneRadius, const RGBAColor& color,  int subd=16) override;
 
 
     //==============
@@ -129,8 +155,8 @@ public:
     //==============
     void drawDisk(float radius, double from, double to, int resolution, const RGBAColor& color) override;
     void drawCircle(float radius, float lineThickness, int resolution, const RGBAColor& color) override;
-    void drawFrame(const Vector3& /*position*/, const Quaternion &/*orientation*/, const Vec3f &/*size*/) override {}
-    void drawFrame(const Vector3& /*position*/, const Quaternion &/*orientation*/, const Vec3f &/*size*/, const RGBAColor &/*color*/) override {}
+    void drawFrame(const Vector3& position, const Quaternion &orientation, const Vec3f &size) override;
+    void drawFrame(const Vector3& position, const Quaternion &orientation, const Vec3f &size, const RGBAColor &color) override;
     void drawCone    (const Vector3& p1, const Vector3 &p2, float radius1, float radius2, const RGBAColor& color, int subd) override;
     void drawCube    (const float& radius, const RGBAColor& color, const int& subd) override;
     void drawCylinder(const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color,  int subd) override;
@@ -139,9 +165,9 @@ public:
     void drawPlus    (const float& radius, const RGBAColor& color, const int& subd) override;
     void drawEllipsoid(const Vector3 &/*p*/, const Vector3 &/*radii*/) override {}
     void drawBoundingBox( const Vector3 &min, const Vector3 &max, float size) override;
-    void draw3DText(const Vector3 &/*p*/, float /*scale*/, const RGBAColor &/*color*/, const char* /*text*/) override {}
-    void draw3DText_Indices(const std::vector<Vector3> &/*positions*/, float /*scale*/, const RGBAColor &/*color*/) override {}
-    void writeOverlayText( int /*x*/, int /*y*/, unsigned /*fontSize*/, const RGBAColor &/*color*/, const char* /*text*/ ) override {}
+    void draw3DText(const Vector3 &p, float scale, const RGBAColor &color, const char* text) override;
+    void draw3DText_Indices(const std::vector<Vector3> &positions, float scale, const RGBAColor &color) override;
+    void writeOverlayText( int x, int y, unsigned fontSize, const RGBAColor &color, const char* text ) override;
 
 
     void clear() override {}
@@ -182,11 +208,96 @@ public:
     int getPolygonMode() {return p_polygon_mode;}
     bool getWireFrameEnabled() {return p_wireframe_enabled;}
 
+    /**
+     * Forget everything known about the current OpenGL state. Must be called whenever the state may have been
+     * modified without going through the draw tool, for example by a visual model issuing OpenGL calls itself.
+     */
+    void invalidate_state_cache();
+
+    /** Number of state changes issued and elided since the draw tool was created. */
+    const StateCacheStatistics & state_cache_statistics() const { return p_statistics; }
+
 private:
+    /** Last value given to a piece of OpenGL state through the draw tool, empty while it is unknown. */
+    template <typename T> using Shadow = std::optional<T>;
+
+    struct ShadowState {
+        Shadow<RGBAColor> material; // Ambient and diffuse, the emission, specular and shininess being constant
+        Shadow<bool> lighting;
+        Shadow<bool> blending;
+        bool alpha_blend_function = false; // Whether the blend function is known to be (SRC_ALPHA, ONE_MINUS_SRC_ALPHA)
+        Shadow<bool> depth_mask;
+        Shadow<bool> depth_test;
+        Shadow<bool> polygon_offset;
+        Shadow<std::pair<float, float>> polygon_offset_parameters; // factor, units
+        Shadow<GLenum> front_polygon_mode;
+        Shadow<GLenum> back_polygon_mode;
+        Shadow<bool> color_material;
+        bool color_material_parameters = false; // Whether the color is known to track the ambient and diffuse
+        Shadow<bool> line_smooth;
+    };
+
+    /**
+     * Level of the state stack opened by saveLastState. Only the attribute groups modified by the draw tool since
+     * then are pushed, each push being popped back by restoreLastState.
+     */
+    struct SavedState {
+        ShadowState shadow;
+        GLbitfield pushed_groups = 0;
+        int number_of_pushes = 0;
+    };
+
+    /** Count the state change as elided and return true if it is unchanged and the cache is on, else count it as issued. */
+    bool elide(bool unchanged);
+
+    /** Push the given attribute groups if they have not been pushed since the last call to saveLastState. */
+    void save_attributes(GLbitfield groups);
+
+    void set_capability(GLenum capability, bool enabled, Shadow<bool> & shadow);
+    void set_depth_mask(bool enabled);
+    void set_alpha_blend_function();
+    void set_polygon_mode(GLenum face, GLenum mode);
+
+    /** Enable blending and disable depth writes for transparent colors, the other way around for opaque colors. */
+    void set_transparency(bool transparent);
+
+    /** Read back the current OpenGL matrices and lighting state. */
+    BatchRenderer::State current_state();
+
+    /** Capture the current OpenGL matrices and lighting state as the state of the instances queued hereafter. */
+    void update_batch_state();
+
+    /**
+     * Draw a cone with immediate-mode triangle strips and fans, when the renderer has no cone instancing. Its ends are
+     * closed with a disk when their respective flag is set.
+     */
+    void draw_cone_immediately(const Vector3& p1, const Vector3& p2, float radius1, float radius2,
+                               const RGBAColor& color, int subd, bool close_p1, bool close_p2);
+
+    /**
+     * Draw an arrow as a closed cylindrical shaft and a cone with immediate-mode triangle strips and fans, when the
+     * renderer has no arrow instancing.
+     */
+    void draw_arrow_immediately(const Vector3& p1, const Vector3& p2, float radius, float cone_length,
+                                float cone_radius, const RGBAColor& color, int subd);
+
+    /** Draw a tessellated sphere in immediate mode, when the renderer has no sphere instancing. */
+    void draw_sphere_immediately(const Vector3& center, float radius, const RGBAColor& color);
+
+    /** Draw the three axes of a frame as arrows of the given lengths, the x, y and z axis taking the given colors. */
+    void draw_frame_axes(const Vector3& position, const Quaternion &orientation, const Vec3f &size,
+                         const RGBAColor &x_color, const RGBAColor &y_color, const RGBAColor &z_color);
+
     QOpenGLFunctions * p_opengl_functions;
-    bool p_light_enabled;
-    int  p_polygon_mode;      //0: no cull, 1 front (CULL_CLOCKWISE), 2 back (CULL_ANTICLOCKWISE)
-    bool p_wireframe_enabled;
+    BatchRenderer & p_renderer;
+    GeometryCache * p_geometry_cache;
+    bool p_light_enabled = false;
+    int  p_polygon_mode = 1;      //0: no cull, 1 front (CULL_CLOCKWISE), 2 back (CULL_ANTICLOCKWISE)
+    bool p_wireframe_enabled = false;
+    bool p_cache_state;
+    ShadowState p_shadow;
+    std::vector<SavedState> p_saved_states;
+    StateCacheStatistics p_statistics;
 
 };
 }
\ No newline at end of file
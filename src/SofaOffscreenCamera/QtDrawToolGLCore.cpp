@@ -0,0 +1,891 @@
+#include <sofa/helper/logging/Messaging.h>
+#include "QtDrawToolGLCore.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+namespace sofa::helper::visual {
+
+namespace {
+
+QOpenGLExtraFunctions * gl() {
+    return QOpenGLContext::currentContext()->extraFunctions();
+}
+
+void set_capability(GLenum capability, bool enabled) {
+    if (enabled) gl()->glEnable(capability);
+    else         gl()->glDisable(capability);
+}
+
+} // namespace
+
+QtDrawToolGLCore::QtDrawToolGLCore(BatchRenderer & renderer, VertexStream & stream,
+                                   const QMatrix4x4 & projection, const QMatrix4x4 & modelview,
+                                   GeometryCache * geometry_cache)
+: p_renderer(renderer)
+, p_stream(stream)
+, p_geometry_cache(geometry_cache)
+, p_projection(projection)
+, p_modelview_stack {modelview}
+{}
+
+//=========
+// MATERIAL
+//=========
+
+void QtDrawToolGLCore::setMaterial(const RGBAColor &color) {
+    p_color = color;
+    p_raster.blending = color[3] < 1;
+    p_raster.depth_mask = not p_raster.blending;
+}
+
+void QtDrawToolGLCore::resetMaterial(const RGBAColor &color) {
+    if (color[3] < 1) {
+        resetMaterial();
+    }
+}
+
+void QtDrawToolGLCore::resetMaterial() {
+    p_raster.blending = false;
+    p_raster.depth_mask = true;
+}
+
+//=======
+// POINTS
+//=======
+
+void QtDrawToolGLCore::drawPoint(const Vector3 &p, const RGBAColor &c) {
+    prepare_stream(false);
+    p_stream.add_vertex(Primitive::Points, p, Vector3(0, 0, 1), c);
+}
+
+void QtDrawToolGLCore::drawPoint(const Vector3 &p, const Vector3 &n, const RGBAColor &c) {
+    prepare_stream(p_lighting);
+    p_stream.add_vertex(Primitive::Points, p, n, c);
+}
+
+void QtDrawToolGLCore::drawPoints(const std::vector<Vector3> &points, float size, const RGBAColor &color) {
+    setMaterial(color);
+    p_raster.point_size = size;
+    prepare_stream(false);
+    for (const auto & point : points) {
+        p_stream.add_vertex(Primitive::Points, point, Vector3(0, 0, 1), color);
+    }
+    resetMaterial(color);
+    p_raster.point_size = 1;
+}
+
+void QtDrawToolGLCore::drawPoints(const std::vector<Vector3> &points, float size, const std::vector<RGBAColor> &color) {
+    const bool transparent = std::any_of(color.begin(), color.end(), [](const RGBAColor & c) { return c[3] < 1; });
+    p_raster.blending = transparent;
+    p_raster.depth_mask = not transparent;
+    p_raster.point_size = size;
+    prepare_stream(false);
+    for (std::size_t i=0; i<points.size(); ++i) {
+        p_stream.add_vertex(Primitive::Points, points[i], Vector3(0, 0, 1), color[i]);
+    }
+    resetMaterial();
+    p_raster.point_size = 1;
+}
+
+//======
+// LINES
+//======
+
+// Lines are never lit, as done by QtDrawToolGL which disables the lighting while drawing them
+
+void QtDrawToolGLCore::drawLine(const Vector3 &p1, const Vector3 &p2, const RGBAColor &color) {
+    prepare_stream(false);
+    p_stream.add_vertex(Primitive::Lines, p1, Vector3(0, 0, 1), color);
+    p_stream.add_vertex(Primitive::Lines, p2, Vector3(0, 0, 1), color);
+}
+
+void QtDrawToolGLCore::drawInfiniteLine(const Vector3 &point, const Vector3 &direction, const RGBAColor &color) {
+    prepare_stream(false);
+    p_stream.add_vertex(Primitive::Lines, point, Vector3(0, 0, 1), color);
+    p_stream.add_direction(Primitive::Lines, direction, color);
+}
+
+void QtDrawToolGLCore::drawLines(const std::vector<Vector3> &points, float /*size*/, const RGBAColor &color) {
+    setMaterial(color);
+    prepare_stream(false);
+    const std::size_t nb_lines = points.size()/2;
+    for (std::size_t i=0; i<nb_lines; ++i) {
+        p_stream.add_vertex(Primitive::Lines, points[2*i],   Vector3(0, 0, 1), color);
+        p_stream.add_vertex(Primitive::Lines, points[2*i+1], Vector3(0, 0, 1), color);
+    }
+    resetMaterial(color);
+}
+
+void QtDrawToolGLCore::drawLines(const std::vector<Vector3> &points, float size, const std::vector<RGBAColor> &colors) {
+    if (points.size() != colors.size()*2) {
+        msg_warning("DrawToolGL") << "Sizes mismatch in drawLines method, points.size(): " << points.size() << " should be equal to colors.size()*2: " << colors.size()*2;
+        return drawLines(points, size, RGBAColor::red());
+    }
+
+    const bool transparent = std::any_of(colors.begin(), colors.end(), [](const RGBAColor & c) { return c[3] < 1; });
+    p_raster.blending = transparent;
+    p_raster.depth_mask = not transparent;
+    prepare_stream(false);
+    const std::size_t nb_lines = points.size()/2;
+    for (std::size_t i=0; i<nb_lines; ++i) {
+        p_stream.add_vertex(Primitive::Lines, points[2*i],   Vector3(0, 0, 1), colors[i]);
+        p_stream.add_vertex(Primitive::Lines, points[2*i+1], Vector3(0, 0, 1), colors[i]);
+    }
+    resetMaterial();
+}
+
+void QtDrawToolGLCore::drawLines(const std::vector<Vector3> &points, const std::vector<Vec2i> &index, float /*size*/,
+                                 const RGBAColor &color) {
+    setMaterial(color);
+    prepare_stream(false);
+    for (auto i : index) {
+        p_stream.add_vertex(Primitive::Lines, points[ i[0] ], Vector3(0, 0, 1), color);
+        p_stream.add_vertex(Primitive::Lines, points[ i[1] ], Vector3(0, 0, 1), color);
+    }
+    resetMaterial(color);
+}
+
+void QtDrawToolGLCore::drawLineStrip(const std::vector<Vector3> &points, float /*size*/, const RGBAColor &color) {
+    setMaterial(color);
+    add_line_strip(points, color, false);
+    resetMaterial(color);
+}
+
+void QtDrawToolGLCore::drawLineLoop(const std::vector<Vector3> &points, float /*size*/, const RGBAColor &color) {
+    setMaterial(color);
+    add_line_strip(points, color, true);
+    resetMaterial(color);
+}
+
+void QtDrawToolGLCore::add_line_strip(const std::vector<Vector3> &points, const RGBAColor &color, bool closed) {
+    if (points.size() < 2) return;
+    prepare_stream(false);
+    for (std::size_t i=0; i+1<points.size(); ++i) {
+        p_stream.add_vertex(Primitive::Lines, points[i],   Vector3(0, 0, 1), color);
+        p_stream.add_vertex(Primitive::Lines, points[i+1], Vector3(0, 0, 1), color);
+    }
+    if (closed) {
+        p_stream.add_vertex(Primitive::Lines, points.back(),  Vector3(0, 0, 1), color);
+        p_stream.add_vertex(Primitive::Lines, points.front(), Vector3(0, 0, 1), color);
+    }
+}
+
+//==========
+// TRIANGLES
+//==========
+
+void QtDrawToolGLCore::add_triangle(const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const Vector3 &n,
+                                    const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3) {
+    p_stream.add_vertex(Primitive::Triangles, p1, n, c1);
+    p_stream.add_vertex(Primitive::Triangles, p2, n, c2);
+    p_stream.add_vertex(Primitive::Triangles, p3, n, c3);
+}
+
+void QtDrawToolGLCore::drawTriangle(const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const Vector3 &normal) {
+    prepare_stream(p_lighting);
+    add_triangle(p1, p2, p3, normal, p_color, p_color, p_color);
+}
+
+void QtDrawToolGLCore::drawTriangle(const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const Vector3 &normal,
+                                    const RGBAColor &c) {
+    prepare_stream(p_lighting);
+    add_triangle(p1, p2, p3, normal, c, c, c);
+}
+
+void QtDrawToolGLCore::drawTriangle(const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const Vector3 &normal,
+                                    const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3) {
+    prepare_stream(p_lighting);
+    add_triangle(p1, p2, p3, normal, c1, c2, c3);
+}
+
+void QtDrawToolGLCore::drawTriangle(const Vector3 &p1, const Vector3 &p2, const Vector3 &p3,
+                                    const Vector3 &normal1, const Vector3 &normal2, const Vector3 &normal3,
+                                    const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3) {
+    prepare_stream(p_lighting);
+    p_stream.add_vertex(Primitive::Triangles, p1, normal1, c1);
+    p_stream.add_vertex(Primitive::Triangles, p2, normal2, c2);
+    p_stream.add_vertex(Primitive::Triangles, p3, normal3, c3);
+}
+
+void QtDrawToolGLCore::drawTriangles(const std::vector<Vector3> &points, const RGBAColor &color) {
+    setMaterial(color);
+    prepare_stream(p_lighting);
+    const std::size_t nb_triangles = points.size()/3;
+    for (std::size_t i=0; i<nb_triangles; ++i) {
+        const Vector3& a = points[ 3*i+0 ];
+        const Vector3& b = points[ 3*i+1 ];
+        const Vector3& c = points[ 3*i+2 ];
+        Vector3 n = cross((b-a),(c-a));
+        n.normalize();
+        add_triangle(a, b, c, n, color, color, color);
+    }
+    resetMaterial(color);
+}
+
+void QtDrawToolGLCore::drawTriangles(const std::vector<Vector3> &points, const std::vector<RGBAColor> &color) {
+    std::vector<Vector3> normal;
+    this->drawTriangles(points,normal,color);
+}
+
+void QtDrawToolGLCore::drawTriangles(const std::vector<Vector3> &points, const Vector3 &normal,
+                                     const RGBAColor &color) {
+    setMaterial(color);
+    prepare_stream(p_lighting);
+    const std::size_t nb_triangles = points.size()/3;
+    for (std::size_t i=0; i<nb_triangles; ++i)
+        add_triangle(points[ 3*i+0 ],points[ 3*i+1 ],points[ 3*i+2 ], normal, color, color, color);
+    resetMaterial(color);
+}
+
+void QtDrawToolGLCore::drawTriangles(const std::vector<Vector3> &points, const std::vector<Vec3i> &index,
+                                     const std::vector<Vector3> &normal, const RGBAColor &color) {
+    setMaterial(color);
+    prepare_stream(p_lighting);
+    if (p_geometry_cache) {
+        // The vertices already in the stream are drawn first to keep the drawing order
+        p_stream.flush();
+
+        BatchRenderer::State state;
+        state.projection = p_projection;
+        state.modelview = p_modelview_stack.back();
+        state.lighting = p_lighting;
+        if (p_geometry_cache->draw(state, points, index, normal, color)) {
+            resetMaterial(color);
+            return;
+        }
+    }
+    // The normals are given either one per triangle or one per point, as for the geometry cache
+    const bool point_normals = (normal.size() != index.size() and normal.size() == points.size());
+    const std::size_t nb_triangles = index.size();
+    for (std::size_t i=0; i<nb_triangles; ++i) {
+        const auto & t = index[i];
+        if (point_normals) {
+            for (int j = 0; j < 3; ++j) {
+                p_stream.add_vertex(Primitive::Triangles, points[t[j]], normal[t[j]], color);
+            }
+        } else {
+            add_triangle(points[t[0]], points[t[1]], points[t[2]], normal[i], color, color, color);
+        }
+    }
+    resetMaterial(color);
+}
+
+void QtDrawToolGLCore::drawTriangles(const std::vector<Vector3> &points, const std::vector<Vec3i> &index,
+                                     const std::vector<Vector3> &normal, const std::vector<RGBAColor> &color) {
+    //todo ! (not implemented by QtDrawToolGL either)
+    SOFA_UNUSED(points);
+    SOFA_UNUSED(index);
+    SOFA_UNUSED(normal);
+    SOFA_UNUSED(color);
+}
+
+void QtDrawToolGLCore::drawTriangles(const std::vector<Vector3> &points, const std::vector<Vector3> &normal,
+                                     const std::vector<RGBAColor> &color) {
+    const std::size_t nbTriangles=points.size()/3;
+    const bool computeNormals= (normal.size() != nbTriangles);
+    if (nbTriangles == 0) return;
+    setMaterial(color[0]);
+    prepare_stream(p_lighting);
+    for (std::size_t i=0; i<nbTriangles; ++i) {
+        const Vector3& a = points[ 3*i+0 ];
+        const Vector3& b = points[ 3*i+1 ];
+        const Vector3& c = points[ 3*i+2 ];
+        Vector3 n;
+        if (computeNormals) {
+            n = cross((b-a),(c-a));
+            n.normalize();
+        } else {
+            n = normal[i];
+        }
+        add_triangle(a, b, c, n, color[3*i+0], color[3*i+1], color[3*i+2]);
+    }
+    resetMaterial(color[0]);
+}
+
+void QtDrawToolGLCore::drawTriangleStrip(const std::vector<Vector3> &points, const std::vector<Vector3> &normal,
+                                         const RGBAColor &color) {
+    // Every pair of points of the strip shares the same normal
+    const std::size_t nb_of_points = std::min(points.size(), 2*normal.size());
+    if (nb_of_points < 3) return;
+    setMaterial(color);
+    prepare_stream(p_lighting);
+    for (std::size_t i=0; i+2<nb_of_points; ++i) {
+        // Every other triangle is flipped to keep the orientation of the strip
+        const std::size_t a = (i % 2 == 0) ? i : i+1;
+        const std::size_t b = (i % 2 == 0) ? i+1 : i;
+        const std::size_t c = i+2;
+        p_stream.add_vertex(Primitive::Triangles, points[a], normal[a/2], color);
+        p_stream.add_vertex(Primitive::Triangles, points[b], normal[b/2], color);
+        p_stream.add_vertex(Primitive::Triangles, points[c], normal[c/2], color);
+    }
+    resetMaterial(color);
+}
+
+void QtDrawToolGLCore::drawTriangleFan(const std::vector<Vector3> &points, const std::vector<Vector3> &n,
+                                       const RGBAColor &color) {
+    if (points.size() < 3) return;
+    setMaterial(color);
+    prepare_stream(p_lighting);
+    // The three first points share the first normal
+    const auto normal_of = [&n](std::size_t i) -> const Vector3 & { return n[i < 3 ? 0 : i]; };
+    for (std::size_t i=2; i<points.size(); ++i) {
+        p_stream.add_vertex(Primitive::Triangles, points[0],   normal_of(0),   color);
+        p_stream.add_vertex(Primitive::Triangles, points[i-1], normal_of(i-1), color);
+        p_stream.add_vertex(Primitive::Triangles, points[i],   normal_of(i),   color);
+    }
+    resetMaterial(color);
+}
+
+//======
+// QUADS
+//======
+
+void QtDrawToolGLCore::add_quad(const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const Vector3 &p4,
+                                const Vector3 &n,
+                                const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3, const RGBAColor &c4) {
+    add_triangle(p1, p2, p3, n, c1, c2, c3);
+    add_triangle(p1, p3, p4, n, c1, c3, c4);
+}
+
+void QtDrawToolGLCore::drawQuad(const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const Vector3 &p4,
+                                const Vector3 &normal) {
+    prepare_stream(p_lighting);
+    add_quad(p1, p2, p3, p4, normal, p_color, p_color, p_color, p_color);
+}
+
+void QtDrawToolGLCore::drawQuad(const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const Vector3 &p4,
+                                const Vector3 &normal, const RGBAColor &c) {
+    prepare_stream(p_lighting);
+    add_quad(p1, p2, p3, p4, normal, c, c, c, c);
+}
+
+void QtDrawToolGLCore::drawQuad(const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const Vector3 &p4,
+                                const Vector3 &normal,
+                                const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3, const RGBAColor &c4) {
+    prepare_stream(p_lighting);
+    add_quad(p1, p2, p3, p4, normal, c1, c2, c3, c4);
+}
+
+void QtDrawToolGLCore::drawQuad(const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const Vector3 &p4,
+                                const Vector3 &normal1, const Vector3 &normal2,
+                                const Vector3 &normal3, const Vector3 &normal4,
+                                const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3, const RGBAColor &c4) {
+    prepare_stream(p_lighting);
+    p_stream.add_vertex(Primitive::Triangles, p1, normal1, c1);
+    p_stream.add_vertex(Primitive::Triangles, p2, normal2, c2);
+    p_stream.add_vertex(Primitive::Triangles, p3, normal3, c3);
+    p_stream.add_vertex(Primitive::Triangles, p1, normal1, c1);
+    p_stream.add_vertex(Primitive::Triangles, p3, normal3, c3);
+    p_stream.add_vertex(Primitive::Triangles, p4, normal4, c4);
+}
+
+void QtDrawToolGLCore::drawQuads(const std::vector<Vector3> &points, const RGBAColor &color) {
+    setMaterial(color);
+    prepare_stream(p_lighting);
+    const std::size_t nb_quads = points.size()/4;
+    for (std::size_t i=0; i<nb_quads; ++i) {
+        const Vector3& a = points[ 4*i+0 ];
+        const Vector3& b = points[ 4*i+1 ];
+        const Vector3& c = points[ 4*i+2 ];
+        const Vector3& d = points[ 4*i+3 ];
+        Vector3 n = cross((b-a),(c-a));
+        n.normalize();
+        add_quad(a, b, c, d, n, color, color, color, color);
+    }
+    resetMaterial(color);
+}
+
+void QtDrawToolGLCore::drawQuads(const std::vector<Vector3> &points, const std::vector<RGBAColor> &colors) {
+    prepare_stream(p_lighting);
+    const std::size_t nb_quads = points.size()/4;
+    for (std::size_t i=0; i<nb_quads; ++i) {
+        const Vector3& a = points[ 4*i+0 ];
+        const Vector3& b = points[ 4*i+1 ];
+        const Vector3& c = points[ 4*i+2 ];
+        const Vector3& d = points[ 4*i+3 ];
+
+        RGBAColor average_color;
+        for(int j=0; j < 4; j++) {
+            average_color[j] = (colors[4*i+0][j] + colors[4*i+1][j] + colors[4*i+2][j] + colors[4*i+3][j]) * 0.25f;
+        }
+
+        Vector3 n = cross((b-a),(c-a));
+        n.normalize();
+        add_quad(a, b, c, d, n, average_color, average_color, average_color, average_color);
+    }
+}
+
+//=============
+// TETRAHEDRONS
+//=============
+
+void QtDrawToolGLCore::drawTetrahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3,
+                                       const RGBAColor &color) {
+    drawScaledTetrahedron(p0, p1, p2, p3, color, 1.f);
+}
+
+void QtDrawToolGLCore::drawTetrahedra(const std::vector<Vector3> &points, const RGBAColor &color) {
+    drawScaledTetrahedra(points, color, 1.f);
+}
+
+void QtDrawToolGLCore::drawScaledTetrahedra(const std::vector<Vector3> &points, const RGBAColor &color,
+                                            const float scale) {
+    setMaterial(color);
+    prepare_stream(p_lighting);
+    for (std::size_t i=0; i+3<points.size(); i+=4) {
+        const Vector3& p0 = points[i];
+        const Vector3& p1 = points[i+1];
+        const Vector3& p2 = points[i+2];
+        const Vector3& p3 = points[i+3];
+
+        Vector3 center = (p0 + p1 + p2 + p3) / 4.0;
+
+        Vector3 np0 = ((p0 - center)*scale) + center;
+        Vector3 np1 = ((p1 - center)*scale) + center;
+        Vector3 np2 = ((p2 - center)*scale) + center;
+        Vector3 np3 = ((p3 - center)*scale) + center;
+
+        add_triangle(np0, np1, np2, cross((p1 - p0), (p2 - p0)), color, color, color);
+        add_triangle(np0, np1, np3, cross((p1 - p0), (p3 - p0)), color, color, color);
+        add_triangle(np0, np2, np3, cross((p2 - p0), (p3 - p0)), color, color, color);
+        add_triangle(np1, np2, np3, cross((p2 - p1), (p3 - p1)), color, color, color);
+    }
+    resetMaterial(color);
+}
+
+void QtDrawToolGLCore::drawScaledTetrahedron(const Vector3& p0, const Vector3& p1, const Vector3& p2,
+                                             const Vector3& p3, const RGBAColor& color, const float scale) {
+    drawScaledTetrahedra({p0, p1, p2, p3}, color, scale);
+}
+
+//============
+// HEXAHEDRONS
+//============
+
+void QtDrawToolGLCore::drawHexahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3,
+                                      const Vector3 &p4, const Vector3 &p5, const Vector3 &p6, const Vector3 &p7,
+                                      const RGBAColor &color) {
+    drawScaledHexahedra({p0, p1, p2, p3, p4, p5, p6, p7}, color, 1.f);
+}
+
+void QtDrawToolGLCore::drawHexahedra(const std::vector<Vector3> &points, const RGBAColor &color) {
+    drawScaledHexahedra(points, color, 1.f);
+}
+
+void QtDrawToolGLCore::drawScaledHexahedra(const std::vector<Vector3> &points, const RGBAColor &color,
+                                           const float scale) {
+    setMaterial(color);
+    prepare_stream(p_lighting);
+    for (std::size_t i=0; i+7<points.size(); i+=8) {
+        const Vector3& p0 = points[i];
+        const Vector3& p1 = points[i+1];
+        const Vector3& p2 = points[i+2];
+        const Vector3& p3 = points[i+3];
+        const Vector3& p4 = points[i+4];
+        const Vector3& p5 = points[i+5];
+        const Vector3& p6 = points[i+6];
+        const Vector3& p7 = points[i+7];
+
+        //barycenter
+        Vector3 center = (p0 + p1 + p2 + p3 + p4 + p5 + p6 + p7)/8.0;
+
+        Vector3 np0 = ((p0 - center)*scale) + center;
+        Vector3 np1 = ((p1 - center)*scale) + center;
+        Vector3 np2 = ((p2 - center)*scale) + center;
+        Vector3 np3 = ((p3 - center)*scale) + center;
+        Vector3 np4 = ((p4 - center)*scale) + center;
+        Vector3 np5 = ((p5 - center)*scale) + center;
+        Vector3 np6 = ((p6 - center)*scale) + center;
+        Vector3 np7 = ((p7 - center)*scale) + center;
+
+        add_quad(np0, np1, np2, np3, cross((p1 - p0), (p2 - p0)), color, color, color, color);
+        add_quad(np4, np7, np6, np5, cross((p7 - p5), (p6 - p5)), color, color, color, color);
+        add_quad(np1, np0, np4, np5, cross((p0 - p1), (p4 - p1)), color, color, color, color);
+        add_quad(np1, np5, np6, np2, cross((p5 - p1), (p6 - p1)), color, color, color, color);
+        add_quad(np2, np6, np7, np3, cross((p6 - p2), (p7 - p2)), color, color, color, color);
+        add_quad(np0, np3, np7, np4, cross((p3 - p0), (p7 - p0)), color, color, color, color);
+    }
+    resetMaterial(color);
+}
+
+//========
+// SPHERES
+//========
+
+void QtDrawToolGLCore::drawSphere(const Vector3 &p, float radius) {
+    drawSphere(p, radius, p_color);
+}
+
+void QtDrawToolGLCore::drawSphere(const Vector3 &p, float radius, const RGBAColor &color) {
+    prepare_renderer();
+    p_renderer.add_sphere(p, radius, color);
+}
+
+void QtDrawToolGLCore::drawSpheres(const std::vector<Vector3> &points, const std::vector<float> &radius,
+                                   const RGBAColor &color) {
+    prepare_renderer();
+    p_renderer.add_spheres(points, radius, color);
+}
+
+void QtDrawToolGLCore::drawSpheres(const std::vector<Vector3> &points, float radius, const RGBAColor &color) {
+    drawSpheres(points, std::vector<float> {radius}, color);
+}
+
+void QtDrawToolGLCore::drawFakeSpheres(const std::vector<Vector3> &points, const std::vector<float> &radius,
+                                       const RGBAColor &color) {
+    drawSpheres(points, radius, color);
+}
+
+void QtDrawToolGLCore::drawFakeSpheres(const std::vector<Vector3> &points, float radius, const RGBAColor &color) {
+    drawSpheres(points, radius, color);
+}
+
+//=======
+// ARROWS
+//=======
+
+void QtDrawToolGLCore::drawArrow(const Vector3 &p1, const Vector3 &p2, float radius, const RGBAColor &color,
+                                 int subd) {
+    // The cone takes the last fifth of the arrow
+    drawArrow(p1, p2, radius, static_cast<float>((p2 - p1).norm() * 0.2), radius * 2.5f, color, subd);
+}
+
+void QtDrawToolGLCore::drawArrow(const Vector3 &p1, const Vector3 &p2, float radius, float coneLength,
+                                 const RGBAColor &color, int subd) {
+    drawArrow(p1, p2, radius, coneLength, radius * 2.5f, color, subd);
+}
+
+void QtDrawToolGLCore::drawArrow(const Vector3 &p1, const Vector3 &p2, float radius, float coneLength,
+                                 float coneRadius, const RGBAColor &color, int subd) {
+    prepare_renderer();
+    p_renderer.add_arrow(p1, p2, radius, coneLength, coneRadius, color, subd);
+}
+
+//==============
+// MISCELLANEOUS
+//==============
+
+void QtDrawToolGLCore::drawCone(const Vector3 &p1, const Vector3 &p2, float radius1, float radius2,
+                                const RGBAColor &color, int subd) {
+    prepare_renderer();
+    p_renderer.add_cone(p1, p2, radius1, radius2, color, subd, radius1 > 0, radius2 > 0);
+}
+
+void QtDrawToolGLCore::drawDisk(float radius, double from, double to, int resolution, const RGBAColor &color) {
+    if (from > to)
+        to += 2.0 * M_PI;
+    prepare_stream(p_lighting);
+    const Vector3 normal(0, 0, 1);
+    Vector3 previous;
+    for (int i  = 0 ; i <= resolution ; ++i) {
+        double angle = (double(i) / double(resolution) * 2.0 * M_PI) + from;
+        const bool stop = (angle >= to);
+        if (stop)
+            angle = to;
+        const Vector3 current(radius * std::sin(angle), radius * std::cos(angle), 0.0);
+        add_triangle(Vector3(0, 0, 0), i == 0 ? current : previous, current, normal, color, color, color);
+        if (stop)
+            break;
+        previous = current;
+    }
+}
+
+void QtDrawToolGLCore::drawCircle(float radius, float /*lineThickness*/, int resolution, const RGBAColor &color) {
+    std::vector<Vector3> points;
+    points.reserve(resolution + 1);
+    for (int i  = 0 ; i <= resolution ; ++i) {
+        const double angle = double(i) / double(resolution) * 2.0 * M_PI;
+        points.emplace_back(radius * std::sin(angle), radius * std::cos(angle), 0.0);
+    }
+    add_line_strip(points, color, false);
+}
+
+void QtDrawToolGLCore::drawFrame(const Vector3 &position, const Quaternion &orientation, const Vec3f &size) {
+    draw_frame_axes(position, orientation, size, RGBAColor::red(), RGBAColor::green(), RGBAColor::blue());
+}
+
+void QtDrawToolGLCore::drawFrame(const Vector3 &position, const Quaternion &orientation, const Vec3f &size,
+                                 const RGBAColor &color) {
+    draw_frame_axes(position, orientation, size, color, color, color);
+}
+
+void QtDrawToolGLCore::drawCube(const float &radius, const RGBAColor &color, const int &subd) {
+    for (int axis = 0; axis < 3; ++axis) {
+        for (const double u : {-1.0, 1.0}) {
+            for (const double v : {-1.0, 1.0}) {
+                Vector3 p1, p2;
+                p1[axis] = -1.0; p2[axis] = 1.0;
+                p1[(axis+1)%3] = p2[(axis+1)%3] = u;
+                p1[(axis+2)%3] = p2[(axis+2)%3] = v;
+                drawCylinder(p1, p2, radius, color, subd);
+            }
+        }
+    }
+}
+
+void QtDrawToolGLCore::drawCylinder(const Vector3 &p1, const Vector3 &p2, float radius, const RGBAColor &color,
+                                    int subd) {
+    drawCone(p1, p2, radius, radius, color, subd);
+}
+
+void QtDrawToolGLCore::drawCapsule(const Vector3 &p1, const Vector3 &p2, float radius, const RGBAColor &color,
+                                   int subd) {
+    prepare_renderer();
+    p_renderer.add_cone(p1, p2, radius, radius, color, subd, false, false);
+    p_renderer.add_sphere(p1, radius, color);
+    p_renderer.add_sphere(p2, radius, color);
+}
+
+void QtDrawToolGLCore::drawCross(const Vector3 &p, float length, const RGBAColor &color) {
+    std::vector<Vector3> bounds;
+    for (unsigned int i=0 ; i<3 ; i++) {
+        Vector3 p0 = p;
+        Vector3 p1 = p;
+        p0[i] -= length;
+        p1[i] += length;
+        bounds.push_back(p0);
+        bounds.push_back(p1);
+    }
+    drawLines(bounds, 1, color);
+}
+
+void QtDrawToolGLCore::drawPlus(const float &radius, const RGBAColor &color, const int &subd) {
+    drawCylinder( Vector3(-1.0, 0.0, 0.0), Vector3(1.0, 0.0, 0.0), radius, color, subd);
+    drawCylinder( Vector3(0.0, -1.0, 0.0), Vector3(0.0, 1.0, 0.0), radius, color, subd);
+    drawCylinder( Vector3(0.0, 0.0, -1.0), Vector3(0.0, 0.0, 1.0), radius, color, subd);
+}
+
+void QtDrawToolGLCore::drawBoundingBox(const Vector3 &min, const Vector3 &max, float /*size*/) {
+    const Vector3 corners[8] = {
+        Vector3(min[0], min[1], min[2]), Vector3(max[0], min[1], min[2]),
+        Vector3(max[0], max[1], min[2]), Vector3(min[0], max[1], min[2]),
+        Vector3(min[0], min[1], max[2]), Vector3(max[0], min[1], max[2]),
+        Vector3(max[0], max[1], max[2]), Vector3(min[0], max[1], max[2])
+    };
+    static const int edges[12][2] = {
+        {0, 1}, {2, 3}, {4, 5}, {6, 7}, {0, 3}, {1, 2}, {4, 7}, {5, 6}, {0, 4}, {1, 5}, {2, 6}, {3, 7}
+    };
+    prepare_stream(false);
+    for (const auto & edge : edges) {
+        p_stream.add_vertex(Primitive::Lines, corners[edge[0]], Vector3(0, 0, 1), p_color);
+        p_stream.add_vertex(Primitive::Lines, corners[edge[1]], Vector3(0, 0, 1), p_color);
+    }
+}
+
+//=====
+// TEXT
+//=====
+
+void QtDrawToolGLCore::draw3DText(const Vector3 &p, float scale, const RGBAColor &color, const char *text) {
+    prepare_renderer();
+    p_renderer.add_text(p, scale, color, text);
+}
+
+void QtDrawToolGLCore::draw3DText_Indices(const std::vector<Vector3> &positions, float scale,
+                                          const RGBAColor &color) {
+    prepare_renderer();
+    p_renderer.add_index_labels(positions, scale, color);
+}
+
+void QtDrawToolGLCore::writeOverlayText(int x, int y, unsigned fontSize, const RGBAColor &color, const char *text) {
+    p_renderer.add_overlay_text(x, y, static_cast<float>(fontSize), color, text);
+}
+
+//===============
+// TRANSFORMATION
+//===============
+
+void QtDrawToolGLCore::pushMatrix() {
+    p_modelview_stack.push_back(p_modelview_stack.back());
+}
+
+void QtDrawToolGLCore::popMatrix() {
+    if (p_modelview_stack.size() > 1) {
+        p_modelview_stack.pop_back();
+    }
+}
+
+void QtDrawToolGLCore::multMatrix(float *glTransform) {
+    // OpenGL matrices are column-major, QMatrix4x4 is built from row-major values
+    p_modelview_stack.back() *= QMatrix4x4(glTransform).transposed();
+}
+
+void QtDrawToolGLCore::scale(float s) {
+    p_modelview_stack.back().scale(s);
+}
+
+void QtDrawToolGLCore::translate(float x, float y, float z) {
+    p_modelview_stack.back().translate(x, y, z);
+}
+
+//=================
+// GL MISCELLANEOUS
+//=================
+
+void QtDrawToolGLCore::enablePolygonOffset(float factor, float units) {
+    p_raster.polygon_offset = true;
+    p_raster.polygon_offset_factor = factor;
+    p_raster.polygon_offset_units = units;
+}
+
+void QtDrawToolGLCore::disablePolygonOffset() {
+    p_raster.polygon_offset = false;
+}
+
+void QtDrawToolGLCore::enableBlending() {
+    p_raster.blending = true;
+}
+
+void QtDrawToolGLCore::disableBlending() {
+    p_raster.blending = false;
+}
+
+void QtDrawToolGLCore::enableLighting() {
+    p_lighting = true;
+}
+
+void QtDrawToolGLCore::disableLighting() {
+    p_lighting = false;
+}
+
+void QtDrawToolGLCore::enableDepthTest() {
+    p_raster.depth_test = true;
+}
+
+void QtDrawToolGLCore::disableDepthTest() {
+    p_raster.depth_test = false;
+}
+
+void QtDrawToolGLCore::saveLastState() {
+    p_saved_states.push_back({p_raster, p_lighting, p_color});
+}
+
+void QtDrawToolGLCore::restoreLastState() {
+    if (p_saved_states.empty()) {
+        msg_error("QtDrawToolGLCore") << "restoreLastState called without a matching saveLastState.";
+        return;
+    }
+    const SavedState & saved = p_saved_states.back();
+    p_raster = saved.raster;
+    p_lighting = saved.lighting;
+    p_color = saved.color;
+    p_saved_states.pop_back();
+}
+
+void QtDrawToolGLCore::readPixels(int x, int y, int w, int h, float *rgb, float *z) {
+    apply_raster_state();
+    p_stream.flush();
+    p_renderer.flush();
+    if(rgb != nullptr && sizeof(*rgb) == 3 * sizeof(float) * w * h)
+        gl()->glReadPixels(x, y, w, h, GL_RGB, GL_FLOAT, rgb);
+
+    if(z != nullptr && sizeof(*z) == sizeof(float) * w * h)
+        gl()->glReadPixels(x, y, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, z);
+}
+
+void QtDrawToolGLCore::setLightingEnabled(bool enabled) {
+    p_lighting = enabled;
+    p_light_enabled = enabled;
+}
+
+bool QtDrawToolGLCore::getLightEnabled() {
+    return p_light_enabled;
+}
+
+void QtDrawToolGLCore::setPolygonMode(int _mode, bool _wireframe) {
+    // The core profile only accepts GL_FRONT_AND_BACK, the mode applies to both faces
+    p_polygon_mode = _mode;
+    p_wireframe_enabled = _wireframe;
+    p_raster.wireframe = _wireframe;
+}
+
+void QtDrawToolGLCore::draw_frame_axes(const Vector3 &position, const Quaternion &orientation, const Vec3f &size,
+                                       const RGBAColor &x_color, const RGBAColor &y_color, const RGBAColor &z_color) {
+    const RGBAColor * colors[3] = {&x_color, &y_color, &z_color};
+    prepare_renderer();
+    for (unsigned int i = 0; i < 3; ++i) {
+        if (size[i] <= 0)
+            continue;
+        Vector3 axis(0, 0, 0);
+        axis[i] = size[i];
+        const Vector3 tip = position + orientation.rotate(axis);
+        p_renderer.add_arrow(position, tip, size[i] * 0.05f, size[i] * 0.25f, size[i] * 0.1f, *colors[i], 16);
+    }
+}
+
+//=============
+// RENDER STATE
+//=============
+
+void QtDrawToolGLCore::apply_raster_state() {
+    const RasterState & applied = p_applied_raster;
+    const RasterState & requested = p_raster;
+    const bool known = p_applied_raster_is_known;
+    if (known && requested == applied) {
+        return;
+    }
+
+    // Everything pending was added with the previous state. The instances of the renderer blend and write the depth
+    // by themselves, they only need to be flushed when the other states change.
+    p_stream.flush();
+    if (not known || requested.depth_test != applied.depth_test || requested.polygon_offset != applied.polygon_offset
+        || requested.polygon_offset_factor != applied.polygon_offset_factor
+        || requested.polygon_offset_units != applied.polygon_offset_units || requested.wireframe != applied.wireframe) {
+        p_renderer.flush();
+    }
+
+    if (not known || requested.blending != applied.blending) {
+        set_capability(GL_BLEND, requested.blending);
+        if (requested.blending)
+            gl()->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    if (not known || requested.depth_mask != applied.depth_mask) {
+        gl()->glDepthMask(requested.depth_mask ? GL_TRUE : GL_FALSE);
+    }
+    if (not known || requested.depth_test != applied.depth_test) {
+        set_capability(GL_DEPTH_TEST, requested.depth_test);
+    }
+    if (not known || requested.polygon_offset != applied.polygon_offset) {
+        set_capability(GL_POLYGON_OFFSET_LINE, requested.polygon_offset);
+    }
+    if (not known || requested.polygon_offset_factor != applied.polygon_offset_factor
+        || requested.polygon_offset_units != applied.polygon_offset_units) {
+        gl()->glPolygonOffset(requested.polygon_offset_factor, requested.polygon_offset_units);
+    }
+    // Neither the polygon mode nor the point size are part of the OpenGL ES functions wrapped by Qt
+    if (not known || requested.wireframe != applied.wireframe) {
+        glPolygonMode(GL_FRONT_AND_BACK, requested.wireframe ? GL_LINE : GL_FILL);
+    }
+    if (not known || requested.point_size != applied.point_size) {
+        glPointSize(requested.point_size);
+    }
+
+    p_applied_raster = requested;
+    p_applied_raster_is_known = true;
+}
+
+void QtDrawToolGLCore::prepare_stream(bool lighting) {
+    apply_raster_state();
+
+    BatchRenderer::State state;
+    state.projection = p_projection;
+    state.modelview = p_modelview_stack.back();
+    state.lighting = lighting;
+    p_stream.set_state(state);
+}
+
+void QtDrawToolGLCore::prepare_renderer() {
+    apply_raster_state();
+
+    BatchRenderer::State state;
+    state.projection = p_projection;
+    state.modelview = p_modelview_stack.back();
+    state.lighting = p_lighting;
+    p_renderer.set_state(state);
+}
+
+} // namespace sofa::helper::visual
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <sofa/core/config.h>
+#include <sofa/helper/visual/DrawTool.h>
+#include <sofa/type/Quat.h>
+#include <sofa/type/RGBAColor.h>
+#include <sofa/type/vector.h>
+
+#include <vector>
+
+#include <QMatrix4x4>
+
+#include "BatchRenderer.h"
+#include "GeometryCache.h"
+#include "VertexStream.h"
+
+namespace sofa::helper::visual {
+
+/**
+ * Draw tool for OpenGL core-profile contexts, which only uses buffers and shaders.
+ *
+ * Points, lines and polygons are appended to a VertexStream instead of being sent with glBegin / glEnd, and the
+ * parametric primitives and the text are queued into the BatchRenderer as with QtDrawToolGL. Since there is no
+ * matrix stack in the core profile, the draw tool keeps its own: the projection and modelview matrices of the camera
+ * are given at construction and modified by pushMatrix, multMatrix, ... The lighting and material are the ones of
+ * QtDrawToolGL, reproduced by the shaders of the ShaderLibrary.
+ *
+ * The differences with QtDrawToolGL are that lines are always one pixel wide, and that the polygon mode applies to
+ * both front and back faces.
+ */
+class SOFA_CORE_API QtDrawToolGLCore : public DrawTool {
+public:
+    using Base = DrawTool;
+    using RGBAColor = Base::RGBAColor;
+    using Vec3f = Base::Vec3f;
+    using Vector3 = Base::Vector3;
+    using Vec3i = Base::Vec3i;
+    using Vec2i = Base::Vec2i;
+    using Quaternion = Base::Quaternion;
+
+    /**
+     * Both the renderer and the stream must outlive the draw tool, the caller is responsible for flushing them once
+     * the scene has been drawn. When a geometry cache is given, indexed triangle sets are drawn from the index buffers
+     * it keeps resident across frames instead of being appended to the stream.
+     */
+    QtDrawToolGLCore(BatchRenderer & renderer, VertexStream & stream,
+                     const QMatrix4x4 & projection, const QMatrix4x4 & modelview,
+                     GeometryCache * geometry_cache = nullptr);
+
+    void init() override {}
+
+    //=======
+    // POINTS
+    //=======
+    void drawPoint(const Vector3 &p, const RGBAColor &c) override;
+    void drawPoint(const Vector3 &p, const Vector3 &n, const RGBAColor &c) override;
+    void drawPoints(const std::vector<Vector3> &points, float size,  const RGBAColor& color) override;
+    void drawPoints(const std::vector<Vector3> &points, float size, const std::vector<RGBAColor>& color) override;
+
+    //======
+    // LINES
+    //======
+    void drawLine(const Vector3 &p1, const Vector3 &p2, const RGBAColor& color) override;
+    void drawInfiniteLine(const Vector3 &point, const Vector3 &direction, const RGBAColor& color) override;
+    void drawLines(const std::vector<Vector3> &points, float size, const RGBAColor& color) override;
+    void drawLines(const std::vector<Vector3> &points, float size, const std::vector<RGBAColor>& colors) override;
+    void drawLines(const std::vector<Vector3> &points, const std::vector< Vec2i > &index, float size, const RGBAColor& color) override;
+
+    void drawLineStrip(const std::vector<Vector3> &points, float size, const RGBAColor& color) override;
+    void drawLineLoop(const std::vector<Vector3> &points, float size, const RGBAColor& color) override;
+
+    //==========
+    // TRIANGLES
+    //==========
+    void drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal) override;
+    void drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal, const RGBAColor &c) override;
+    void drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal, const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3) override;
+    void drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal1, const Vector3 &normal2, const Vector3 &normal3, const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3) override;
+
+    void drawTriangles(const std::vector<Vector3> &points, const RGBAColor& color) override;
+    void drawTriangles(const std::vector<Vector3> &points, const std::vector< RGBAColor > &color) override;
+    void drawTriangles(const std::vector<Vector3> &points, const Vector3& normal, const RGBAColor& color) override;
+    void drawTriangles(const std::vector<Vector3> &points,
+                               const std::vector< Vec3i > &index,
+                               const std::vector<Vector3>  &normal,
+                               const RGBAColor& color) override;
+    void drawTriangles(const std::vector<Vector3> &points,
+                               const std::vector< Vec3i > &index,
+                               const std::vector<Vector3>  &normal,
+                               const std::vector<RGBAColor>& color) override;
+    void drawTriangles(const std::vector<Vector3> &points,
+                               const std::vector<Vector3>  &normal,
+                               const std::vector< RGBAColor > &color) override;
+
+    void drawTriangleStrip(const std::vector<Vector3> &points,
+                                   const std::vector<Vector3>  &normal,
+                                   const RGBAColor& color) override;
+
+    void drawTriangleFan(const std::vector<Vector3> &points,
+                                 const std::vector<Vector3>  &normal,
+                                 const RGBAColor& color) override;
+
+    //======
+    // QUADS
+    //======
+    void drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4,
+                  const Vector3 &normal) override;
+    void drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4,
+                  const Vector3 &normal, const RGBAColor &c) override;
+    void drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4,
+                  const Vector3 &normal,
+                  const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3, const RGBAColor &c4) override;
+    void drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4,
+                  const Vector3 &normal1, const Vector3 &normal2, const Vector3 &normal3, const Vector3 &normal4,
+                  const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3, const RGBAColor &c4) override;
+    void drawQuads(const std::vector<Vector3> &points, const RGBAColor& color) override;
+    void drawQuads(const std::vector<Vector3> &points, const std::vector<RGBAColor>& colors) override;
+
+    //=============
+    // TETRAHEDRONS
+    //=============
+    void drawTetrahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const RGBAColor &color) override;
+    void drawTetrahedra(const std::vector<Vector3> &points, const RGBAColor& color) override;
+    void drawScaledTetrahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const RGBAColor &color, const float scale) override;
+    void drawScaledTetrahedra(const std::vector<Vector3> &points, const RGBAColor& color, const float scale) override;
+
+    //============
+    // HEXAHEDRONS
+    //============
+    void drawHexahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3,
+                        const Vector3 &p4, const Vector3 &p5, const Vector3 &p6, const Vector3 &p7, const RGBAColor &color) override;
+    void drawHexahedra(const std::vector<Vector3> &points, const RGBAColor& color) override;
+    void drawScaledHexahedra(const std::vector<Vector3> &points, const RGBAColor& color, const float scale) override;
+
+    //========
+    // SPHERES
+    //========
+    void drawSphere(const Vector3 &p, float radius) override;
+    void drawSphere(const Vector3 &p, float radius, const RGBAColor &color) override;
+    void drawSpheres(const std::vector<Vector3> &points, const std::vector<float>& radius, const RGBAColor& color) override;
+    void drawSpheres(const std::vector<Vector3> &points, float radius, const RGBAColor& color) override;
+    void drawFakeSpheres(const std::vector<Vector3> &points, const std::vector<float>& radius, const RGBAColor& color) override;
+    void drawFakeSpheres(const std::vector<Vector3> &points, float radius, const RGBAColor& color) override;
+
+    //=======
+    // ARROWS
+    //=======
+    void drawArrow   (const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color,  int subd=16) override;
+    void drawArrow   (const Vector3& p1, const Vector3 &p2, float radius, float coneLength, const RGBAColor& color,  int subd=16) override;
+    void drawArrow   (const Vector3& p1, const Vector3 &p2, float radius, float coneLength, float coneRadius, const RGBAColor& color,  int subd=16) override;
+
+
+    //==============
+    // MISCELLANEOUS
+    //==============
+    void drawDisk(float radius, double from, double to, int resolution, const RGBAColor& color) override;
+    void drawCircle(float radius, float lineThickness, int resolution, const RGBAColor& color) override;
+    void drawFrame(const Vector3& position, const Quaternion &orientation, const Vec3f &size) override;
+    void drawFrame(const Vector3& position, const Quaternion &orientation, const Vec3f &size, const RGBAColor &color) override;
+    void drawCone    (const Vector3& p1, const Vector3 &p2, float radius1, float radius2, const RGBAColor& color, int subd) override;
+    void drawCube    (const float& radius, const RGBAColor& color, const int& subd) override;
+    void drawCylinder(const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color,  int subd) override;
+    void drawCapsule(const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color,  int subd) override;
+    void drawCross(const Vector3&p, float length, const RGBAColor& color) override;
+    void drawPlus    (const float& radius, const RGBAColor& color, const int& subd) override;
+    void drawEllipsoid(const Vector3 &/*p*/, const Vector3 &/*radii*/) override {}
+    void drawBoundingBox( const Vector3 &min, const Vector3 &max, float size) override;
+    void draw3DText(const Vector3 &p, float scale, const RGBAColor &color, const char* text) override;
+    void draw3DText_Indices(const std::vector<Vector3> &positions, float scale, const RGBAColor &color) override;
+    void writeOverlayText( int x, int y, unsigned fontSize, const RGBAColor &color, const char* text ) override;
+
+
+    void clear() override {}
+    void setMaterial(const RGBAColor &color) override;
+    void resetMaterial(const RGBAColor &color) override;
+    void resetMaterial() override;
+
+    void pushMatrix() override;
+    void popMatrix() override;
+    void multMatrix(float* glTransform ) override;
+    void scale( float s ) override;
+    void translate(float x, float y, float z) override;
+
+
+    void enablePolygonOffset(float factor, float units) override;
+    void disablePolygonOffset() override;
+
+    void enableBlending() override;
+    void disableBlending() override;
+
+    void enableLighting() override;
+    void disableLighting() override;
+
+    void enableDepthTest() override;
+    void disableDepthTest() override;
+
+    void saveLastState() override;
+    void restoreLastState() override;
+
+    void readPixels(int x, int y, int w, int h, float* rgb, float* z) override;
+
+    void setLightingEnabled(bool enabled) override;
+
+    bool getLightEnabled();
+
+    void setPolygonMode(int _mode, bool _wireframe) override;
+
+    int getPolygonMode() {return p_polygon_mode;}
+    bool getWireFrameEnabled() {return p_wireframe_enabled;}
+
+private:
+    using Primitive = VertexStream::Primitive;
+
+    /** Part of the OpenGL state that is set by the draw tool and applied lazily, before drawing. */
+    struct RasterState {
+        bool blending = false;
+        bool depth_mask = true;
+        bool depth_test = true;
+        bool polygon_offset = false;
+        float polygon_offset_factor = 0;
+        float polygon_offset_units = 0;
+        bool wireframe = false;
+        float point_size = 1;
+
+        bool operator==(const RasterState & other) const {
+            return blending == other.blending && depth_mask == other.depth_mask && depth_test == other.depth_test
+                && polygon_offset == other.polygon_offset && polygon_offset_factor == other.polygon_offset_factor
+                && polygon_offset_units == other.polygon_offset_units && wireframe == other.wireframe
+                && point_size == other.point_size;
+        }
+        bool operator!=(const RasterState & other) const { return not (*this == other); }
+    };
+
+    struct SavedState {
+        RasterState raster;
+        bool lighting;
+        RGBAColor color;
+    };
+
+    /**
+     * Apply the raster state set since the last draw. Pending vertices and instances are flushed first if the state
+     * they will be drawn with is about to change.
+     */
+    void apply_raster_state();
+
+    /** Bring the state of the stream up to date before appending vertices, lit or not. */
+    void prepare_stream(bool lighting);
+
+    /** Bring the state of the renderer up to date before adding instances. */
+    void prepare_renderer();
+
+    void add_triangle(const Vector3 & p1, const Vector3 & p2, const Vector3 & p3, const Vector3 & n,
+                      const RGBAColor & c1, const RGBAColor & c2, const RGBAColor & c3);
+    void add_quad(const Vector3 & p1, const Vector3 & p2, const Vector3 & p3, const Vector3 & p4, const Vector3 & n,
+                  const RGBAColor & c1, const RGBAColor & c2, const RGBAColor & c3, const RGBAColor & c4);
+    void add_line_strip(const std::vector<Vector3> & points, const RGBAColor & color, bool closed);
+
+    /** Draw the three axes of a frame as arrows of the given lengths, the x, y and z axis taking the given colors. */
+    void draw_frame_axes(const Vector3& position, const Quaternion &orientation, const Vec3f &size,
+                         const RGBAColor &x_color, const RGBAColor &y_color, const RGBAColor &z_color);
+
+    BatchRenderer & p_renderer;
+    VertexStream & p_stream;
+    GeometryCache * p_geometry_cache;
+    QMatrix4x4 p_projection;
+    std::vector<QMatrix4x4> p_modelview_stack;
+    RasterState p_raster;
+    RasterState p_applied_raster;
+    bool p_applied_raster_is_known = false;
+    std::vector<SavedState> p_saved_states;
+    RGBAColor p_color = RGBAColor::white();
+    bool p_lighting = true;
+    bool p_light_enabled = false;
+    int  p_polygon_mode = 1;      //0: no cull, 1 front (CULL_CLOCKWISE), 2 back (CULL_ANTICLOCKWISE)
+    bool p_wireframe_enabled = false;
+};
+}
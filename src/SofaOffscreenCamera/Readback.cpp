@@ -0,0 +1,269 @@
+#include "Readback.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+#include <sofa/helper/logging/Messaging.h>
+
+namespace {
+
+QOpenGLExtraFunctions * gl() {
+    return QOpenGLContext::currentContext()->extraFunctions();
+}
+
+// Triangle covering the viewport, whose vertices are generated from their index
+const char * gray_vertex_source = R"(
+#version 150
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+
+// Rec. 601 luma of the pixels of the region, whose rows are flipped
+const char * gray_fragment_source = R"(
+#version 150
+uniform sampler2D u_frame;
+uniform ivec4 u_region;
+out vec4 fragment_color;
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 color = texelFetch(u_frame, ivec2(u_region.x + pixel.x, u_region.y + u_region.w - 1 - pixel.y), 0).rgb;
+    fragment_color = vec4(dot(color, vec3(0.299, 0.587, 0.114)), 0.0, 0.0, 1.0);
+}
+)";
+
+GLenum gl_type(ComponentType type) {
+    switch (type) {
+        case ComponentType::UInt8: return GL_UNSIGNED_BYTE;
+        case ComponentType::UInt16: return GL_UNSIGNED_SHORT;
+        case ComponentType::Float16: return GL_HALF_FLOAT;
+        case ComponentType::Float32: return GL_FLOAT;
+    }
+    return GL_UNSIGNED_BYTE;
+}
+
+GLenum gl_format(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::RGBA: return GL_RGBA;
+        case PixelFormat::BGRA: return GL_BGRA;
+        case PixelFormat::RGB: return GL_RGB;
+        case PixelFormat::Gray: return GL_RED;
+    }
+    return GL_RGBA;
+}
+
+} // namespace
+
+bool is_floating_point(GLenum internal_format) {
+    switch (internal_format) {
+        case GL_RGBA16F:
+        case GL_RGBA32F:
+        case GL_RGB16F:
+        case GL_RGB32F:
+        case GL_R11F_G11F_B10F:
+            return true;
+        default:
+            return false;
+    }
+}
+
+FrameReadback::FrameReadback() {
+    gl()->glGenFramebuffers(1, &p_framebuffer);
+    gl()->glGenVertexArrays(1, &p_vertex_array);
+}
+
+FrameReadback::~FrameReadback() {
+    gl()->glDeleteVertexArrays(1, &p_vertex_array);
+    gl()->glDeleteRenderbuffers(1, &p_gray_buffer);
+    gl()->glDeleteRenderbuffers(1, &p_color_buffer);
+    gl()->glDeleteFramebuffers(1, &p_framebuffer);
+}
+
+QRect FrameReadback::clip_region(const QSize & frame_size, const QRect & region) {
+    const QRect frame(QPoint(0, 0), frame_size);
+    return region.isEmpty() ? frame : region.intersected(frame);
+}
+
+void FrameReadback::allocate(const QSize & size, GLenum internal_format) {
+    if (size == p_size and internal_format == p_internal_format) {
+        return;
+    }
+
+    // The buffers have the size of the whole frame, so that changing regions of interest never reallocate them
+    if (p_color_buffer == 0) {
+        gl()->glGenRenderbuffers(1, &p_color_buffer);
+        gl()->glGenRenderbuffers(1, &p_gray_buffer);
+    }
+    gl()->glBindRenderbuffer(GL_RENDERBUFFER, p_color_buffer);
+    gl()->glRenderbufferStorage(GL_RENDERBUFFER, internal_format, size.width(), size.height());
+    gl()->glBindRenderbuffer(GL_RENDERBUFFER, p_gray_buffer);
+    const GLenum gray_format = not is_floating_point(internal_format) ? GL_R8
+                             : internal_format == GL_RGBA32F or internal_format == GL_RGB32F ? GL_R32F : GL_R16F;
+    gl()->glRenderbufferStorage(GL_RENDERBUFFER, gray_format, size.width(), size.height());
+    gl()->glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    p_size = size;
+    p_internal_format = internal_format;
+}
+
+void FrameReadback::read(const QOpenGLFramebufferObject & framebuffer, const QRect & region, PixelFormat format,
+                         ComponentType type, void * pixels, std::size_t stride) {
+    const QRect clipped = clip_region(framebuffer.size(), region);
+    if (clipped.isEmpty()) {
+        return;
+    }
+
+    GLint bound_framebuffer = 0;
+    gl()->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound_framebuffer);
+    allocate(framebuffer.size(), framebuffer.format().internalTextureFormat());
+
+    const QRect gl_region = to_gl_region(framebuffer.size(), clipped);
+    gl()->glBindFramebuffer(GL_FRAMEBUFFER, p_framebuffer);
+    if (format == PixelFormat::Gray) {
+        gl()->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, p_gray_buffer);
+        convert_to_gray(framebuffer, gl_region);
+    } else {
+        gl()->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, p_color_buffer);
+        flip(framebuffer, gl_region);
+    }
+
+    // The rows are already in order, hence they are read straight into the memory of the consumer
+    gl()->glBindFramebuffer(GL_READ_FRAMEBUFFER, p_framebuffer);
+    gl()->glReadBuffer(GL_COLOR_ATTACHMENT0);
+    gl()->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    const std::size_t pixel_size = static_cast<std::size_t>(channels(format)) * component_size(type);
+    gl()->glPixelStorei(GL_PACK_ROW_LENGTH, static_cast<GLint>(stride / pixel_size));
+    gl()->glReadPixels(0, 0, clipped.width(), clipped.height(), gl_format(format), gl_type(type), pixels);
+    gl()->glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    gl()->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    gl()->glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(bound_framebuffer));
+}
+
+FrameReadback::PendingRead FrameReadback::read_async(const QOpenGLFramebufferObject & framebuffer,
+                                                     const QRect & region, PixelFormat format, ComponentType type,
+                                                     std::size_t stride) {
+    PendingRead pending;
+    pending.size = stride * static_cast<std::size_t>(clip_region(framebuffer.size(), region).height());
+    gl()->glGenBuffers(1, &pending.pixel_buffer);
+    gl()->glBindBuffer(GL_PIXEL_PACK_BUFFER, pending.pixel_buffer);
+    gl()->glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(std::max<std::size_t>(pending.size, 4)), nullptr,
+                       GL_STREAM_READ);
+
+    // With a pixel buffer bound, glReadPixels only queues the copy, the pointer being an offset into the buffer
+    read(framebuffer, region, format, type, nullptr, stride);
+    gl()->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // The fence is flushed here, since the context waiting for it cannot flush the commands of this one
+    pending.fence = gl()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gl()->glFlush();
+    return pending;
+}
+
+bool FrameReadback::finish(PendingRead & pending, void * pixels) {
+    if (pending.fence) {
+        gl()->glClientWaitSync(pending.fence, 0, GL_TIMEOUT_IGNORED);
+        gl()->glDeleteSync(pending.fence);
+        pending.fence = nullptr;
+    }
+
+    bool copied = false;
+    if (pixels and pending.size > 0) {
+        gl()->glBindBuffer(GL_PIXEL_PACK_BUFFER, pending.pixel_buffer);
+        const void * mapped = gl()->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(pending.size),
+                                                     GL_MAP_READ_BIT);
+        if (mapped) {
+            std::memcpy(pixels, mapped, pending.size);
+            gl()->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            copied = true;
+        }
+        gl()->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    gl()->glDeleteBuffers(1, &pending.pixel_buffer);
+    pending.pixel_buffer = 0;
+    return copied;
+}
+
+QImage FrameReadback::read_image(const QOpenGLFramebufferObject & framebuffer, const QRect & region) {
+    const QRect clipped = clip_region(framebuffer.size(), region);
+    if (clipped.isEmpty()) {
+        return QImage();
+    }
+
+    const bool deep = is_floating_point(framebuffer.format().internalTextureFormat());
+    QImage image(clipped.size(), deep ? QImage::Format_RGBA64_Premultiplied : QImage::Format_RGBA8888_Premultiplied);
+    read(framebuffer, clipped, PixelFormat::RGBA, deep ? ComponentType::UInt16 : ComponentType::UInt8, image.bits(),
+         static_cast<std::size_t>(image.bytesPerLine()));
+    return image;
+}
+
+void FrameReadback::flip(const QOpenGLFramebufferObject & framebuffer, const QRect & gl_region) {
+    gl()->glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer.handle());
+    gl()->glBlitFramebuffer(gl_region.left(), gl_region.top(), gl_region.left() + gl_region.width(),
+                            gl_region.top() + gl_region.height(), 0, gl_region.height(), gl_region.width(), 0,
+                            GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+void FrameReadback::convert_to_gray(const QOpenGLFramebufferObject & framebuffer, const QRect & gl_region) {
+    if (not p_gray_program) {
+        p_gray_program = std::make_unique<QOpenGLShaderProgram>();
+        if (not p_gray_program->addShaderFromSourceCode(QOpenGLShader::Vertex, gray_vertex_source)
+            or not p_gray_program->addShaderFromSourceCode(QOpenGLShader::Fragment, gray_fragment_source)
+            or not p_gray_program->link()) {
+            msg_error("FrameReadback") << "Failed to build the luminance pass: "
+                                       << p_gray_program->log().toStdString();
+        }
+    }
+    if (not p_gray_program->isLinked()) {
+        return;
+    }
+
+    // The pass runs in between the rendering of the frame and the next one, whose state must be kept
+    GLint viewport[4];
+    GLint polygon_mode[2];
+    GLint program = 0;
+    GLint vertex_array = 0;
+    GLint active_texture = 0;
+    GLint texture = 0;
+    gl()->glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_POLYGON_MODE, polygon_mode);
+    gl()->glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    gl()->glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertex_array);
+    gl()->glGetIntegerv(GL_ACTIVE_TEXTURE, &active_texture);
+    gl()->glActiveTexture(GL_TEXTURE0);
+    gl()->glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+    const bool blend = gl()->glIsEnabled(GL_BLEND);
+    const bool depth_test = gl()->glIsEnabled(GL_DEPTH_TEST);
+    const bool cull_face = gl()->glIsEnabled(GL_CULL_FACE);
+
+    gl()->glDisable(GL_BLEND);
+    gl()->glDisable(GL_DEPTH_TEST);
+    gl()->glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    gl()->glViewport(0, 0, gl_region.width(), gl_region.height());
+    gl()->glBindTexture(GL_TEXTURE_2D, framebuffer.texture());
+    p_gray_program->bind();
+    p_gray_program->setUniformValue("u_frame", 0);
+    gl()->glUniform4i(p_gray_program->uniformLocation("u_region"), gl_region.x(), gl_region.y(), gl_region.width(),
+                      gl_region.height());
+    gl()->glBindVertexArray(p_vertex_array);
+    gl()->glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    gl()->glBindVertexArray(static_cast<GLuint>(vertex_array));
+    gl()->glUseProgram(static_cast<GLuint>(program));
+    gl()->glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(texture));
+    gl()->glActiveTexture(static_cast<GLenum>(active_texture));
+    gl()->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glPolygonMode(GL_FRONT_AND_BACK, static_cast<GLenum>(polygon_mode[0]));
+    if (blend)
+        gl()->glEnable(GL_BLEND);
+    if (depth_test)
+        gl()->glEnable(GL_DEPTH_TEST);
+    if (cull_face)
+        gl()->glEnable(GL_CULL_FACE);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <QImage>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QRect>
+#include <QSize>
+#include <qopengl.h>
+
+/** Layout of the pixels read back by FrameReadback, in the order of the options of 'pixel_format'. */
+enum class PixelFormat { RGBA, BGRA, RGB, Gray };
+
+/** Type of the components of the pixels read back by FrameReadback. */
+enum class ComponentType { UInt8, UInt16, Float16, Float32 };
+
+/** Number of components of a pixel of the given format. */
+inline int channels(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::RGBA:
+        case PixelFormat::BGRA: return 4;
+        case PixelFormat::RGB: return 3;
+        case PixelFormat::Gray: return 1;
+    }
+    return 4;
+}
+
+/** Number of bytes of a component of the given type. */
+inline std::size_t component_size(ComponentType type) {
+    switch (type) {
+        case ComponentType::UInt8: return 1;
+        case ComponentType::UInt16:
+        case ComponentType::Float16: return 2;
+        case ComponentType::Float32: return 4;
+    }
+    return 1;
+}
+
+/** Whether the given internal format of a color buffer stores floating-point components, such as GL_RGBA16F. */
+bool is_floating_point(GLenum internal_format);
+
+/**
+ * Readback of the frames of a camera into memory, with their first row at the top and in the pixel format of their
+ * consumer.
+ *
+ * QOpenGLFramebufferObject::toImage reads the rows from the bottom up, flips them and converts the pixels on the CPU.
+ * Here, the region read is first copied into an intermediate framebuffer by a blit with an inverted destination
+ * rectangle, or by a small draw pass computing the luminance for the gray format, so that glReadPixels returns the
+ * rows in order and in the requested format, straight into the memory of the consumer.
+ *
+ * The readback must be created, used and destroyed while the OpenGL context of the framebuffer is current, and the
+ * scissor test must be disabled while reading.
+ */
+class FrameReadback {
+public:
+    /** Readback queued into a pixel buffer by read_async. */
+    struct PendingRead {
+        GLuint pixel_buffer = 0;
+        GLsync fence = nullptr;
+        std::size_t size = 0; ///< Size of the pixels read, in bytes
+    };
+
+    FrameReadback();
+    ~FrameReadback();
+
+    FrameReadback(const FrameReadback &) = delete;
+    FrameReadback & operator=(const FrameReadback &) = delete;
+
+    /**
+     * Read a region of the color buffer of the framebuffer (which must not be multisampled). The framebuffer bound is
+     * left untouched. The components are converted by OpenGL into the given type: floating-point color buffers keep
+     * their precision and range when read as floats, and are clamped to [0, 1] otherwise.
+     *
+     * @param region Region to read, in image coordinates (origin at the top-left corner of the frame), clipped to the
+     *               framebuffer. The whole frame when empty.
+     * @param pixels Memory receiving the rows of the region from the top, each of them stride bytes apart.
+     * @param stride Size of a row in memory, a multiple of the size of a pixel of the format.
+     */
+    void read(const QOpenGLFramebufferObject & framebuffer, const QRect & region, PixelFormat format,
+              ComponentType type, void * pixels, std::size_t stride);
+
+    /**
+     * Queue the readback of a region of the color buffer of the framebuffer into a new pixel buffer, see read, and
+     * return without waiting for the GPU. The rows are stride bytes apart in the pixel buffer.
+     */
+    PendingRead read_async(const QOpenGLFramebufferObject & framebuffer, const QRect & region, PixelFormat format,
+                           ComponentType type, std::size_t stride);
+
+    /**
+     * Wait for the GPU to be done with a readback queued by read_async, copy its pixels into memory (unless pixels is
+     * null), and release its pixel buffer. May be called from another context than the one of read_async, as long as
+     * it shares its objects.
+     *
+     * @return False if the pixels could not be copied.
+     */
+    static bool finish(PendingRead & pending, void * pixels);
+
+    /**
+     * Read a region of the color buffer of the framebuffer into an RGBA image, see read: an 8-bit image for 8-bit
+     * color buffers, a 16-bit one (Format_RGBA64_Premultiplied) for floating-point ones.
+     */
+    QImage read_image(const QOpenGLFramebufferObject & framebuffer, const QRect & region);
+
+    /** Region actually read for the given region of a frame of the given size, see read. */
+    static QRect clip_region(const QSize & frame_size, const QRect & region);
+
+private:
+    /**
+     * Allocate the intermediate color buffers for frames of the given size and internal format, if they are not
+     * already. They have the precision of the frames, since a blit cannot convert floats into normalized integers.
+     */
+    void allocate(const QSize & size, GLenum internal_format);
+
+    /** Copy the region of the framebuffer into the bottom-left corner of the bound color buffer, upside down. */
+    void flip(const QOpenGLFramebufferObject & framebuffer, const QRect & gl_region);
+
+    /** Draw the luminance of the region of the framebuffer into the bottom-left corner of the gray color buffer. */
+    void convert_to_gray(const QOpenGLFramebufferObject & framebuffer, const QRect & gl_region);
+
+    QSize p_size;
+    GLenum p_internal_format = 0;
+    GLuint p_framebuffer = 0;
+    GLuint p_color_buffer = 0; ///< RGBA renderbuffer, target of the flips
+    GLuint p_gray_buffer = 0;  ///< Single-channel renderbuffer, target of the luminance pass
+    GLuint p_vertex_array = 0; ///< Empty, the luminance pass generates its vertices
+    std::unique_ptr<QOpenGLShaderProgram> p_gray_program; ///< Created at the first gray readback
+};
+
+/** Convert a region in image coordinates into OpenGL window coordinates (origin at the bottom-left corner). */
+inline QRect to_gl_region(const QSize & frame_size, const QRect & region) {
+    return {region.x(), frame_size.height() - region.y() - region.height(), region.width(), region.height()};
+}
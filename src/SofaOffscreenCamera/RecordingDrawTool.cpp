@@ -0,0 +1,369 @@
+#include "RecordingDrawTool.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+
+namespace sofa::helper::visual {
+
+void RecordingDrawTool::drawPoint(const Vector3 &p, const RGBAColor &c) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawPoint(p, c); });
+}
+
+void RecordingDrawTool::drawPoint(const Vector3 &p, const Vector3 &n, const RGBAColor &c) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawPoint(p, n, c); });
+}
+
+void RecordingDrawTool::drawPoints(const std::vector<Vector3> &points, float size, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawPoints(*points, size, color); });
+}
+
+void RecordingDrawTool::drawPoints(const std::vector<Vector3> &points, float size, const std::vector<RGBAColor>& color) {
+    p_commands.emplace_back([=, points = store(points), color = store(color)](DrawTool & tool) { tool.drawPoints(*points, size, *color); });
+}
+
+void RecordingDrawTool::drawLine(const Vector3 &p1, const Vector3 &p2, const RGBAColor& color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawLine(p1, p2, color); });
+}
+
+void RecordingDrawTool::drawInfiniteLine(const Vector3 &point, const Vector3 &direction, const RGBAColor& color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawInfiniteLine(point, direction, color); });
+}
+
+void RecordingDrawTool::drawLines(const std::vector<Vector3> &points, float size, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawLines(*points, size, color); });
+}
+
+void RecordingDrawTool::drawLines(const std::vector<Vector3> &points, float size, const std::vector<RGBAColor>& colors) {
+    p_commands.emplace_back([=, points = store(points), colors = store(colors)](DrawTool & tool) { tool.drawLines(*points, size, *colors); });
+}
+
+void RecordingDrawTool::drawLines(const std::vector<Vector3> &points, const std::vector< Vec2i > &index, float size, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points), index = store(index)](DrawTool & tool) { tool.drawLines(*points, *index, size, color); });
+}
+
+void RecordingDrawTool::drawLineStrip(const std::vector<Vector3> &points, float size, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawLineStrip(*points, size, color); });
+}
+
+void RecordingDrawTool::drawLineLoop(const std::vector<Vector3> &points, float size, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawLineLoop(*points, size, color); });
+}
+
+void RecordingDrawTool::drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawTriangle(p1, p2, p3, normal); });
+}
+
+void RecordingDrawTool::drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal, const RGBAColor &c) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawTriangle(p1, p2, p3, normal, c); });
+}
+
+void RecordingDrawTool::drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal, const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawTriangle(p1, p2, p3, normal, c1, c2, c3); });
+}
+
+void RecordingDrawTool::drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal1, const Vector3 &normal2, const Vector3 &normal3, const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawTriangle(p1, p2, p3, normal1, normal2, normal3, c1, c2, c3); });
+}
+
+void RecordingDrawTool::drawTriangles(const std::vector<Vector3> &points, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawTriangles(*points, color); });
+}
+
+void RecordingDrawTool::drawTriangles(const std::vector<Vector3> &points, const std::vector< RGBAColor > &color) {
+    p_commands.emplace_back([=, points = store(points), color = store(color)](DrawTool & tool) { tool.drawTriangles(*points, *color); });
+}
+
+void RecordingDrawTool::drawTriangles(const std::vector<Vector3> &points, const Vector3& normal, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawTriangles(*points, normal, color); });
+}
+
+void RecordingDrawTool::drawTriangles(const std::vector<Vector3> &points, const std::vector< Vec3i > &index, const std::vector<Vector3> &normal, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points), index = store(index), normal = store(normal)](DrawTool & tool) { tool.drawTriangles(*points, *index, *normal, color); });
+}
+
+void RecordingDrawTool::drawTriangles(const std::vector<Vector3> &points, const std::vector< Vec3i > &index, const std::vector<Vector3> &normal, const std::vector<RGBAColor>& color) {
+    p_commands.emplace_back([=, points = store(points), index = store(index), normal = store(normal), color = store(color)](DrawTool & tool) { tool.drawTriangles(*points, *index, *normal, *color); });
+}
+
+void RecordingDrawTool::drawTriangles(const std::vector<Vector3> &points, const std::vector<Vector3> &normal, const std::vector< RGBAColor > &color) {
+    p_commands.emplace_back([=, points = store(points), normal = store(normal), color = store(color)](DrawTool & tool) { tool.drawTriangles(*points, *normal, *color); });
+}
+
+void RecordingDrawTool::drawTriangleStrip(const std::vector<Vector3> &points, const std::vector<Vector3> &normal, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points), normal = store(normal)](DrawTool & tool) { tool.drawTriangleStrip(*points, *normal, color); });
+}
+
+void RecordingDrawTool::drawTriangleFan(const std::vector<Vector3> &points, const std::vector<Vector3> &normal, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points), normal = store(normal)](DrawTool & tool) { tool.drawTriangleFan(*points, *normal, color); });
+}
+
+void RecordingDrawTool::drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4, const Vector3 &normal) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawQuad(p1, p2, p3, p4, normal); });
+}
+
+void RecordingDrawTool::drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4, const Vector3 &normal, const RGBAColor &c) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawQuad(p1, p2, p3, p4, normal, c); });
+}
+
+void RecordingDrawTool::drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4, const Vector3 &normal, const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3, const RGBAColor &c4) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawQuad(p1, p2, p3, p4, normal, c1, c2, c3, c4); });
+}
+
+void RecordingDrawTool::drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4, const Vector3 &normal1, const Vector3 &normal2, const Vector3 &normal3, const Vector3 &normal4, const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3, const RGBAColor &c4) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawQuad(p1, p2, p3, p4, normal1, normal2, normal3, normal4, c1, c2, c3, c4); });
+}
+
+void RecordingDrawTool::drawQuads(const std::vector<Vector3> &points, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawQuads(*points, color); });
+}
+
+void RecordingDrawTool::drawQuads(const std::vector<Vector3> &points, const std::vector<RGBAColor>& colors) {
+    p_commands.emplace_back([=, points = store(points), colors = store(colors)](DrawTool & tool) { tool.drawQuads(*points, *colors); });
+}
+
+void RecordingDrawTool::drawTetrahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const RGBAColor &color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawTetrahedron(p0, p1, p2, p3, color); });
+}
+
+void RecordingDrawTool::drawTetrahedra(const std::vector<Vector3> &points, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawTetrahedra(*points, color); });
+}
+
+void RecordingDrawTool::drawScaledTetrahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const RGBAColor &color, const float scale) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawScaledTetrahedron(p0, p1, p2, p3, color, scale); });
+}
+
+void RecordingDrawTool::drawScaledTetrahedra(const std::vector<Vector3> &points, const RGBAColor& color, const float scale) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawScaledTetrahedra(*points, color, scale); });
+}
+
+void RecordingDrawTool::drawHexahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const Vector3 &p4, const Vector3 &p5, const Vector3 &p6, const Vector3 &p7, const RGBAColor &color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawHexahedron(p0, p1, p2, p3, p4, p5, p6, p7, color); });
+}
+
+void RecordingDrawTool::drawHexahedra(const std::vector<Vector3> &points, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawHexahedra(*points, color); });
+}
+
+void RecordingDrawTool::drawScaledHexahedra(const std::vector<Vector3> &points, const RGBAColor& color, const float scale) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawScaledHexahedra(*points, color, scale); });
+}
+
+void RecordingDrawTool::drawSphere(const Vector3 &p, float radius) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawSphere(p, radius); });
+}
+
+void RecordingDrawTool::drawSphere(const Vector3 &p, float radius, const RGBAColor &color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawSphere(p, radius, color); });
+}
+
+void RecordingDrawTool::drawSpheres(const std::vector<Vector3> &points, const std::vector<float>& radius, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points), radius = store(radius)](DrawTool & tool) { tool.drawSpheres(*points, *radius, color); });
+}
+
+void RecordingDrawTool::drawSpheres(const std::vector<Vector3> &points, float radius, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawSpheres(*points, radius, color); });
+}
+
+void RecordingDrawTool::drawFakeSpheres(const std::vector<Vector3> &points, const std::vector<float>& radius, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points), radius = store(radius)](DrawTool & tool) { tool.drawFakeSpheres(*points, *radius, color); });
+}
+
+void RecordingDrawTool::drawFakeSpheres(const std::vector<Vector3> &points, float radius, const RGBAColor& color) {
+    p_commands.emplace_back([=, points = store(points)](DrawTool & tool) { tool.drawFakeSpheres(*points, radius, color); });
+}
+
+void RecordingDrawTool::drawArrow(const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color, int subd) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawArrow(p1, p2, radius, color, subd); });
+}
+
+void RecordingDrawTool::drawArrow(const Vector3& p1, const Vector3 &p2, float radius, float coneLength, const RGBAColor& color, int subd) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawArrow(p1, p2, radius, coneLength, color, subd); });
+}
+
+void RecordingDrawTool::drawArrow(const Vector3& p1, const Vector3 &p2, float radius, float coneLength, float coneRadius, const RGBAColor& color, int subd) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawArrow(p1, p2, radius, coneLength, coneRadius, color, subd); });
+}
+
+void RecordingDrawTool::drawDisk(float radius, double from, double to, int resolution, const RGBAColor& color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawDisk(radius, from, to, resolution, color); });
+}
+
+void RecordingDrawTool::drawCircle(float radius, float lineThickness, int resolution, const RGBAColor& color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawCircle(radius, lineThickness, resolution, color); });
+}
+
+void RecordingDrawTool::drawFrame(const Vector3& position, const Quaternion &orientation, const Vec3f &size) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawFrame(position, orientation, size); });
+}
+
+void RecordingDrawTool::drawFrame(const Vector3& position, const Quaternion &orientation, const Vec3f &size, const RGBAColor &color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawFrame(position, orientation, size, color); });
+}
+
+void RecordingDrawTool::drawCone(const Vector3& p1, const Vector3 &p2, float radius1, float radius2, const RGBAColor& color, int subd) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawCone(p1, p2, radius1, radius2, color, subd); });
+}
+
+void RecordingDrawTool::drawCube(const float& radius, const RGBAColor& color, const int& subd) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawCube(radius, color, subd); });
+}
+
+void RecordingDrawTool::drawCylinder(const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color, int subd) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawCylinder(p1, p2, radius, color, subd); });
+}
+
+void RecordingDrawTool::drawCapsule(const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color, int subd) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawCapsule(p1, p2, radius, color, subd); });
+}
+
+void RecordingDrawTool::drawCross(const Vector3&p, float length, const RGBAColor& color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawCross(p, length, color); });
+}
+
+void RecordingDrawTool::drawPlus(const float& radius, const RGBAColor& color, const int& subd) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawPlus(radius, color, subd); });
+}
+
+void RecordingDrawTool::drawEllipsoid(const Vector3 &p, const Vector3 &radii) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawEllipsoid(p, radii); });
+}
+
+void RecordingDrawTool::drawBoundingBox(const Vector3 &min, const Vector3 &max, float size) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.drawBoundingBox(min, max, size); });
+}
+
+void RecordingDrawTool::draw3DText(const Vector3 &p, float scale, const RGBAColor &color, const char* text) {
+    p_commands.emplace_back([=, copied_text = std::string(text)](DrawTool & tool) { tool.draw3DText(p, scale, color, copied_text.c_str()); });
+}
+
+void RecordingDrawTool::draw3DText_Indices(const std::vector<Vector3> &positions, float scale, const RGBAColor &color) {
+    p_commands.emplace_back([=, positions = store(positions)](DrawTool & tool) { tool.draw3DText_Indices(*positions, scale, color); });
+}
+
+void RecordingDrawTool::writeOverlayText(int x, int y, unsigned fontSize, const RGBAColor &color, const char* text) {
+    p_commands.emplace_back([=, copied_text = std::string(text)](DrawTool & tool) { tool.writeOverlayText(x, y, fontSize, color, copied_text.c_str()); });
+}
+
+void RecordingDrawTool::clear() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.clear(); });
+}
+
+void RecordingDrawTool::setMaterial(const RGBAColor &color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.setMaterial(color); });
+}
+
+void RecordingDrawTool::resetMaterial(const RGBAColor &color) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.resetMaterial(color); });
+}
+
+void RecordingDrawTool::resetMaterial() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.resetMaterial(); });
+}
+
+void RecordingDrawTool::pushMatrix() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.pushMatrix(); });
+}
+
+void RecordingDrawTool::popMatrix() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.popMatrix(); });
+}
+
+void RecordingDrawTool::multMatrix(float* glTransform) {
+    std::array<float, 16> transform;
+    std::copy(glTransform, glTransform + 16, transform.begin());
+    p_commands.emplace_back([transform](DrawTool & tool) mutable { tool.multMatrix(transform.data()); });
+}
+
+void RecordingDrawTool::scale(float s) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.scale(s); });
+}
+
+void RecordingDrawTool::translate(float x, float y, float z) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.translate(x, y, z); });
+}
+
+void RecordingDrawTool::enablePolygonOffset(float factor, float units) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.enablePolygonOffset(factor, units); });
+}
+
+void RecordingDrawTool::disablePolygonOffset() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.disablePolygonOffset(); });
+}
+
+void RecordingDrawTool::enableBlending() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.enableBlending(); });
+}
+
+void RecordingDrawTool::disableBlending() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.disableBlending(); });
+}
+
+void RecordingDrawTool::enableLighting() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.enableLighting(); });
+}
+
+void RecordingDrawTool::disableLighting() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.disableLighting(); });
+}
+
+void RecordingDrawTool::enableDepthTest() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.enableDepthTest(); });
+}
+
+void RecordingDrawTool::disableDepthTest() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.disableDepthTest(); });
+}
+
+void RecordingDrawTool::saveLastState() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.saveLastState(); });
+}
+
+void RecordingDrawTool::restoreLastState() {
+    p_commands.emplace_back([](DrawTool & tool) { tool.restoreLastState(); });
+}
+
+void RecordingDrawTool::readPixels(int /*x*/, int /*y*/, int /*w*/, int /*h*/, float* /*rgb*/, float* /*z*/) {
+    // Nothing can be read back while recording, the frame is rendered later on
+}
+
+void RecordingDrawTool::setLightingEnabled(bool enabled) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.setLightingEnabled(enabled); });
+}
+
+void RecordingDrawTool::setPolygonMode(int _mode, bool _wireframe) {
+    p_commands.emplace_back([=](DrawTool & tool) { tool.setPolygonMode(_mode, _wireframe); });
+}
+
+template <typename T>
+const std::vector<T> * RecordingDrawTool::store(const std::vector<T> & values) {
+    auto & pool = std::get<VectorPool<T>>(p_pools);
+    if (pool.used == pool.vectors.size()) {
+        pool.vectors.emplace_back();
+    }
+    auto & stored = pool.vectors[pool.used++];
+    stored.assign(values.begin(), values.end());
+    return &stored;
+}
+
+void RecordingDrawTool::reset() {
+    p_commands.clear();
+    std::apply([](auto & ... pools) { ((pools.used = 0), ...); }, p_pools);
+}
+
+void RecordingDrawTool::add_flush() {
+    p_commands.emplace_back();
+}
+
+void RecordingDrawTool::replay(DrawTool & draw_tool, const std::function<void()> & flush) const {
+    for (const auto & command : p_commands) {
+        if (command) {
+            command(draw_tool);
+        } else {
+            flush();
+        }
+    }
+}
+
+} // namespace sofa::helper::visual
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <sofa/helper/visual/DrawTool.h>
+#include <sofa/type/Quat.h>
+#include <sofa/type/RGBAColor.h>
+
+#include <deque>
+#include <functional>
+#include <tuple>
+#include <vector>
+
+namespace sofa::helper::visual {
+
+/**
+ * Draw tool recording the calls it receives into a list of commands, to be replayed later on by another draw tool.
+ *
+ * The arguments of every call are copied, hence the recording holds a snapshot of the drawn geometry that stays valid
+ * while the scene goes on changing. The geometry is copied into vectors the recording keeps from one frame to the next:
+ * once reset, a recording records the next frame without allocating, as long as the scene draws about as much. It is used by the pipelined mode of the OffscreenCamera, where the scene is drawn
+ * into a recording on the simulation thread, and the recording is replayed on the render thread. Nothing can be read
+ * back while recording: readPixels leaves its buffers untouched.
+ */
+class RecordingDrawTool : public DrawTool {
+public:
+    using Base = DrawTool;
+    using RGBAColor = Base::RGBAColor;
+    using Vec3f = Base::Vec3f;
+    using Vector3 = Base::Vector3;
+    using Vec3i = Base::Vec3i;
+    using Vec2i = Base::Vec2i;
+    using Quaternion = Base::Quaternion;
+
+    /** A recorded call, or a flush point if empty. */
+    using Command = std::function<void(DrawTool &)>;
+
+    void init() override {}
+
+    //=======
+    // POINTS
+    //=======
+    void drawPoint(const Vector3 &p, const RGBAColor &c) override;
+    void drawPoint(const Vector3 &p, const Vector3 &n, const RGBAColor &c) override;
+    void drawPoints(const std::vector<Vector3> &points, float size,  const RGBAColor& color) override;
+    void drawPoints(const std::vector<Vector3> &points, float size, const std::vector<RGBAColor>& color) override;
+
+    //======
+    // LINES
+    //======
+    void drawLine(const Vector3 &p1, const Vector3 &p2, const RGBAColor& color) override;
+    void drawInfiniteLine(const Vector3 &point, const Vector3 &direction, const RGBAColor& color) override;
+    void drawLines(const std::vector<Vector3> &points, float size, const RGBAColor& color) override;
+    void drawLines(const std::vector<Vector3> &points, float size, const std::vector<RGBAColor>& colors) override;
+    void drawLines(const std::vector<Vector3> &points, const std::vector< Vec2i > &index, float size, const RGBAColor& color) override;
+
+    void drawLineStrip(const std::vector<Vector3> &points, float size, const RGBAColor& color) override;
+    void drawLineLoop(const std::vector<Vector3> &points, float size, const RGBAColor& color) override;
+
+    //==========
+    // TRIANGLES
+    //==========
+    void drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal) override;
+    void drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal, const RGBAColor &c) override;
+    void drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal, const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3) override;
+    void drawTriangle(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3, const Vector3 &normal1, const Vector3 &normal2, const Vector3 &normal3, const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3) override;
+
+    void drawTriangles(const std::vector<Vector3> &points, const RGBAColor& color) override;
+    void drawTriangles(const std::vector<Vector3> &points, const std::vector< RGBAColor > &color) override;
+    void drawTriangles(const std::vector<Vector3> &points, const Vector3& normal, const RGBAColor& color) override;
+    void drawTriangles(const std::vector<Vector3> &points,
+                               const std::vector< Vec3i > &index,
+                               const std::vector<Vector3>  &normal,
+                               const RGBAColor& color) override;
+    void drawTriangles(const std::vector<Vector3> &points,
+                               const std::vector< Vec3i > &index,
+                               const std::vector<Vector3>  &normal,
+                               const std::vector<RGBAColor>& color) override;
+    void drawTriangles(const std::vector<Vector3> &points,
+                               const std::vector<Vector3>  &normal,
+                               const std::vector< RGBAColor > &color) override;
+
+    void drawTriangleStrip(const std::vector<Vector3> &points,
+                                   const std::vector<Vector3>  &normal,
+                                   const RGBAColor& color) override;
+
+    void drawTriangleFan(const std::vector<Vector3> &points,
+                                 const std::vector<Vector3>  &normal,
+                                 const RGBAColor& color) override;
+
+    //======
+    // QUADS
+    //======
+    void drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4,
+                  const Vector3 &normal) override;
+    void drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4,
+                  const Vector3 &normal, const RGBAColor &c) override;
+    void drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4,
+                  const Vector3 &normal,
+                  const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3, const RGBAColor &c4) override;
+    void drawQuad(const Vector3 &p1,const Vector3 &p2,const Vector3 &p3,const Vector3 &p4,
+                  const Vector3 &normal1, const Vector3 &normal2, const Vector3 &normal3, const Vector3 &normal4,
+                  const RGBAColor &c1, const RGBAColor &c2, const RGBAColor &c3, const RGBAColor &c4) override;
+    void drawQuads(const std::vector<Vector3> &points, const RGBAColor& color) override;
+    void drawQuads(const std::vector<Vector3> &points, const std::vector<RGBAColor>& colors) override;
+
+    //=============
+    // TETRAHEDRONS
+    //=============
+    void drawTetrahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const RGBAColor &color) override;
+    void drawTetrahedra(const std::vector<Vector3> &points, const RGBAColor& color) override;
+    void drawScaledTetrahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3, const RGBAColor &color, const float scale) override;
+    void drawScaledTetrahedra(const std::vector<Vector3> &points, const RGBAColor& color, const float scale) override;
+
+    //============
+    // HEXAHEDRONS
+    //============
+    void drawHexahedron(const Vector3 &p0, const Vector3 &p1, const Vector3 &p2, const Vector3 &p3,
+                        const Vector3 &p4, const Vector3 &p5, const Vector3 &p6, const Vector3 &p7, const RGBAColor &color) override;
+    void drawHexahedra(const std::vector<Vector3> &points, const RGBAColor& color) override;
+    void drawScaledHexahedra(const std::vector<Vector3> &points, const RGBAColor& color, const float scale) override;
+
+    //========
+    // SPHERES
+    //========
+    void drawSphere(const Vector3 &p, float radius) override;
+    void drawSphere(const Vector3 &p, float radius, const RGBAColor &color) override;
+    void drawSpheres(const std::vector<Vector3> &points, const std::vector<float>& radius, const RGBAColor& color) override;
+    void drawSpheres(const std::vector<Vector3> &points, float radius, const RGBAColor& color) override;
+    void drawFakeSpheres(const std::vector<Vector3> &points, const std::vector<float>& radius, const RGBAColor& color) override;
+    void drawFakeSpheres(const std::vector<Vector3> &points, float radius, const RGBAColor& color) override;
+
+    //=======
+    // ARROWS
+    //=======
+    void drawArrow   (const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color,  int subd=16) override;
+    void drawArrow   (const Vector3& p1, const Vector3 &p2, float radius, float coneLength, const RGBAColor& color,  int subd=16) override;
+    void drawArrow   (const Vector3& p1, const Vector3 &p2, float radius, float coneLength, float coneRadius, const RGBAColor& color,  int subd=16) override;
+
+
+    //==============
+    // MISCELLANEOUS
+    //==============
+    void drawDisk(float radius, double from, double to, int resolution, const RGBAColor& color) override;
+    void drawCircle(float radius, float lineThickness, int resolution, const RGBAColor& color) override;
+    void drawFrame(const Vector3& position, const Quaternion &orientation, const Vec3f &size) override;
+    void drawFrame(const Vector3& position, const Quaternion &orientation, const Vec3f &size, const RGBAColor &color) override;
+    void drawCone    (const Vector3& p1, const Vector3 &p2, float radius1, float radius2, const RGBAColor& color, int subd) override;
+    void drawCube    (const float& radius, const RGBAColor& color, const int& subd) override;
+    void drawCylinder(const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color,  int subd) override;
+    void drawCapsule(const Vector3& p1, const Vector3 &p2, float radius, const RGBAColor& color,  int subd) override;
+    void drawCross(const Vector3&p, float length, const RGBAColor& color) override;
+    void drawPlus    (const float& radius, const RGBAColor& color, const int& subd) override;
+    void drawEllipsoid(const Vector3 &p, const Vector3 &radii) override;
+    void drawBoundingBox( const Vector3 &min, const Vector3 &max, float size) override;
+    void draw3DText(const Vector3 &p, float scale, const RGBAColor &color, const char* text) override;
+    void draw3DText_Indices(const std::vector<Vector3> &positions, float scale, const RGBAColor &color) override;
+    void writeOverlayText( int x, int y, unsigned fontSize, const RGBAColor &color, const char* text ) override;
+
+
+    void clear() override;
+    void setMaterial(const RGBAColor &color) override;
+    void resetMaterial(const RGBAColor &color) override;
+    void resetMaterial() override;
+
+    void pushMatrix() override;
+    void popMatrix() override;
+    void multMatrix(float* glTransform ) override;
+    void scale( float s ) override;
+    void translate(float x, float y, float z) override;
+
+
+    void enablePolygonOffset(float factor, float units) override;
+    void disablePolygonOffset() override;
+
+    void enableBlending() override;
+    void disableBlending() override;
+
+    void enableLighting() override;
+    void disableLighting() override;
+
+    void enableDepthTest() override;
+    void disableDepthTest() override;
+
+    void saveLastState() override;
+    void restoreLastState() override;
+
+    void readPixels(int x, int y, int w, int h, float* rgb, float* z) override;
+
+    void setLightingEnabled(bool enabled) override;
+
+    void setPolygonMode(int _mode, bool _wireframe) override;
+
+    /**
+     * Record a point where the replaying draw tool must submit everything it has queued so far, such as the end of the
+     * opaque pass before the transparent one.
+     */
+    void add_flush();
+
+    /** Replay the recorded calls into the draw tool, calling flush at every flush point. */
+    void replay(DrawTool & draw_tool, const std::function<void()> & flush) const;
+
+    /** Number of recorded calls and flush points. */
+    std::size_t number_of_commands() const { return p_commands.size(); }
+
+    /** Forget the recorded calls, keeping the storage of their arguments to record the next frame. */
+    void reset();
+
+private:
+    /** Vectors of one type of argument, kept with their capacity from one frame to the next. */
+    template <typename T>
+    struct VectorPool {
+        std::deque<std::vector<T>> vectors; ///< A deque keeps its elements in place when it grows
+        std::size_t used = 0;
+    };
+
+    /** Copy the values into the next vector of the pool of their type, to be drawn by a command. */
+    template <typename T>
+    const std::vector<T> * store(const std::vector<T> & values);
+
+    std::vector<Command> p_commands;
+    std::tuple<VectorPool<Vector3>, VectorPool<RGBAColor>, VectorPool<Vec3i>, VectorPool<Vec2i>, VectorPool<float>>
+        p_pools;
+};
+
+} // namespace sofa::helper::visual
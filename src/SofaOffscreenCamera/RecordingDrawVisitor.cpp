@@ -0,0 +1,90 @@
+#include "RecordingDrawVisitor.h"
+#include "FrustumCuller.h"
+
+#include <vector>
+
+#include <SofaBaseVisual/VisualModelImpl.h>
+#include <sofa/core/visual/VisualParams.h>
+#include <sofa/helper/visual/DrawTool.h>
+
+RecordingDrawVisitor::RecordingDrawVisitor(sofa::core::visual::VisualParams * parameters, FrustumCuller * culler)
+: Base(parameters)
+, p_culler(culler)
+{}
+
+void RecordingDrawVisitor::processVisualModel(sofa::simulation::Node * node,
+                                              sofa::core::visual::VisualModel * visual_model) {
+    using DrawTool = sofa::helper::visual::DrawTool;
+    using VisualParams = sofa::core::visual::VisualParams;
+
+    if (p_culler and not p_culler->visible(visual_model)) {
+        return;
+    }
+
+    auto * model = dynamic_cast<sofa::component::visualmodel::VisualModelImpl *>(visual_model);
+    if (not model) {
+        Base::processVisualModel(node, visual_model);
+        return;
+    }
+
+    if (not model->d_enable.getValue()) {
+        return;
+    }
+
+    const auto & diffuse = model->material.getValue().diffuse;
+    const bool transparent = diffuse[3] < 1;
+    if (transparent != (vparams->pass() == VisualParams::Transparent)) {
+        return;
+    }
+
+    const auto & vertices = model->getVertices();
+    const auto & triangles = model->getTriangles();
+    const auto & quads = model->getQuads();
+
+    std::vector<DrawTool::Vector3> points;
+    points.reserve(vertices.size());
+    for (const auto & vertex : vertices) {
+        points.emplace_back(vertex[0], vertex[1], vertex[2]);
+    }
+
+    std::vector<DrawTool::Vec3i> indices;
+    indices.reserve(triangles.size() + 2 * quads.size());
+    for (const auto & triangle : triangles) {
+        indices.emplace_back(triangle[0], triangle[1], triangle[2]);
+    }
+    for (const auto & quad : quads) {
+        indices.emplace_back(quad[0], quad[1], quad[2]);
+        indices.emplace_back(quad[0], quad[2], quad[3]);
+    }
+    if (indices.empty()) {
+        return;
+    }
+
+    // The vertex normals of the model give it the same smooth shading as when it draws itself. The draw tools tell
+    // them apart from the normals of the triangles by their number, hence the normals of the triangles are computed
+    // instead if both numbers are equal (or if the model has no normals).
+    std::vector<DrawTool::Vector3> normals;
+    const auto & vertex_normals = model->getVnormals();
+    if (vertex_normals.size() == points.size() and points.size() != indices.size()) {
+        normals.reserve(vertex_normals.size());
+        for (const auto & normal : vertex_normals) {
+            normals.emplace_back(normal[0], normal[1], normal[2]);
+        }
+    } else {
+        normals.reserve(indices.size());
+        for (const auto & triangle : indices) {
+            const auto & a = points[triangle[0]];
+            const auto & b = points[triangle[1]];
+            const auto & c = points[triangle[2]];
+            auto normal = cross(b - a, c - a);
+            const auto norm = normal.norm();
+            if (norm > 0) {
+                normal /= norm;
+            }
+            normals.push_back(normal);
+        }
+    }
+
+    const DrawTool::RGBAColor color(diffuse[0], diffuse[1], diffuse[2], diffuse[3]);
+    vparams->drawTool()->drawTriangles(points, indices, normals, color);
+}
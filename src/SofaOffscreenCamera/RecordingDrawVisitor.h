@@ -0,0 +1,30 @@
+#pragma once
+
+#include <sofa/simulation/VisualVisitor.h>
+
+class FrustumCuller;
+
+/**
+ * Visual draw visitor recording the scene for the pipelined mode of the OffscreenCamera, and drawing it with the
+ * core-profile draw tool.
+ *
+ * The components drawing through the draw tool of the visual parameters (a RecordingDrawTool or a QtDrawToolGLCore)
+ * draw as they are. Visual models deriving from VisualModelImpl (such as OglModel) draw themselves with their own
+ * fixed-function OpenGL calls, which can neither be recorded nor issued in a core profile. Their current vertices,
+ * vertex normals, triangles and quads are copied instead, and drawn through the draw tool as a smooth-shaded indexed
+ * triangle set of their diffuse color, in the opaque or in the transparent pass following the alpha of this color. Their textures, shaders and the other colors of their
+ * material are not recorded. Visual models outside of the view frustum are not recorded, if a culler is given.
+ */
+class RecordingDrawVisitor : public sofa::simulation::VisualDrawVisitor {
+    using Base = sofa::simulation::VisualDrawVisitor;
+public:
+    /** @param culler Frustum culler of the frame, or nullptr to record every visual model. */
+    explicit RecordingDrawVisitor(sofa::core::visual::VisualParams * parameters, FrustumCuller * culler = nullptr);
+
+    void processVisualModel(sofa::simulation::Node * node, sofa::core::visual::VisualModel * visual_model) override;
+
+    const char * getClassName() const override { return "RecordingDrawVisitor"; }
+
+private:
+    FrustumCuller * p_culler;
+};
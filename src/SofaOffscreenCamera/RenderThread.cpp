@@ -0,0 +1,265 @@
+#include "RenderThread.h"
+
+#include "BatchRenderer.h"
+#include "GeometryCache.h"
+#include "GlewProxy.h"
+#include "MipPyramid.h"
+#include "QtDrawToolGL.h"
+#include "QtDrawToolGLCore.h"
+#include "Readback.h"
+#include "RecordingDrawTool.h"
+#include "Tracer.h"
+#include "VertexStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include <sofa/helper/logging/Messaging.h>
+
+RenderThread::RenderThread(QOpenGLContext & share_context, const QSize & size, GLenum internal_format,
+                           bool core_profile, bool cache_gl_state, std::function<void()> init_gl)
+: p_size(size)
+, p_internal_format(internal_format)
+, p_core_profile(core_profile)
+, p_cache_gl_state(cache_gl_state)
+, p_init_gl(std::move(init_gl))
+, p_owner_thread(QThread::currentThread())
+{
+    p_surface = std::make_unique<QOffscreenSurface>();
+    p_surface->setFormat(share_context.format());
+    p_surface->create();
+
+    p_context = std::make_unique<QOpenGLContext>();
+    p_context->setFormat(share_context.format());
+    p_context->setShareContext(&share_context);
+    if (not p_context->create()) {
+        msg_error("RenderThread") << "Failed to create the OpenGL context of the render thread.";
+        p_status = Status::Failed;
+        return;
+    }
+
+    // The context can only be made current on the thread it belongs to
+    p_thread.reset(QThread::create([this]() { run(); }));
+    p_context->moveToThread(p_thread.get());
+    p_thread->start();
+
+    std::unique_lock<std::mutex> lock(p_mutex);
+    p_condition.wait(lock, [this]() { return p_status != Status::Starting; });
+}
+
+RenderThread::~RenderThread() {
+    if (not p_thread) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        p_stopping = true;
+    }
+    p_condition.notify_all();
+    p_thread->wait();
+}
+
+void RenderThread::submit(Frame frame) {
+    for (;;) {
+        collect();
+        std::unique_lock<std::mutex> lock(p_mutex);
+        if (p_jobs.size() < max_pending_frames) {
+            p_jobs.push_back(Job {std::move(frame)});
+            break;
+        }
+        p_condition.wait(lock, [this]() { return p_jobs.front().rendered; });
+    }
+    p_condition.notify_all();
+}
+
+void RenderThread::collect() {
+    for (;;) {
+        std::unique_lock<std::mutex> lock(p_mutex);
+        if (p_jobs.empty() or not p_jobs.front().rendered) {
+            return;
+        }
+        Job job = std::move(p_jobs.front());
+        p_jobs.pop_front();
+        --p_next_job;
+        lock.unlock();
+
+        // Called without the lock, since the callback is free to submit another frame
+        if (job.frame.on_rendered) {
+            job.frame.on_rendered(job.images, job.render_time, job.readback_time);
+        }
+        if (job.frame.recording) {
+            p_free_recordings.push_back(std::move(job.frame.recording));
+        }
+    }
+}
+
+std::shared_ptr<sofa::helper::visual::RecordingDrawTool> RenderThread::recording() {
+    collect();
+    if (p_free_recordings.empty()) {
+        return std::make_shared<sofa::helper::visual::RecordingDrawTool>();
+    }
+    auto recording = std::move(p_free_recordings.back());
+    p_free_recordings.pop_back();
+    recording->reset();
+    return recording;
+}
+
+void RenderThread::wait() {
+    for (;;) {
+        collect();
+        std::unique_lock<std::mutex> lock(p_mutex);
+        if (p_jobs.empty()) {
+            return;
+        }
+        p_condition.wait(lock, [this]() { return p_jobs.front().rendered; });
+    }
+}
+
+void RenderThread::run() {
+    bool ready = p_context->makeCurrent(p_surface.get());
+    if (ready) {
+        QOpenGLFramebufferObjectFormat format;
+        format.setTextureTarget(GL_TEXTURE_2D);
+        format.setInternalTextureFormat(p_internal_format);
+        p_framebuffer = std::make_unique<QOpenGLFramebufferObject>(p_size, format);
+        ready = p_framebuffer->bind();
+    }
+    if (ready) {
+        GlewProxy::init();
+        if (p_init_gl) {
+            p_init_gl();
+        }
+        p_renderer = std::make_unique<sofa::helper::visual::BatchRenderer>();
+        p_geometry_cache = std::make_unique<sofa::helper::visual::GeometryCache>();
+        if (p_core_profile) {
+            p_vertex_stream = std::make_unique<sofa::helper::visual::VertexStream>();
+        }
+    } else {
+        msg_error("RenderThread") << "Failed to set the OpenGL context and framebuffer of the render thread up.";
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        p_status = ready ? Status::Running : Status::Failed;
+    }
+    p_condition.notify_all();
+
+    // The frames still queued when stopping are rendered before leaving
+    while (ready) {
+        Job * job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(p_mutex);
+            p_condition.wait(lock, [this]() { return p_stopping or p_next_job < p_jobs.size(); });
+            if (p_next_job == p_jobs.size()) {
+                break;
+            }
+            // Only the jobs already rendered are removed from the queue, hence this one stays where it is
+            job = &p_jobs[p_next_job];
+        }
+
+        render(*job);
+
+        {
+            std::lock_guard<std::mutex> lock(p_mutex);
+            job->rendered = true;
+            ++p_next_job;
+        }
+        p_condition.notify_all();
+    }
+
+    // The OpenGL objects must be released while the context is current
+    p_readback.reset();
+    p_mip_pyramid.reset();
+    p_geometry_cache.reset();
+    p_vertex_stream.reset();
+    p_renderer.reset();
+    p_framebuffer.reset();
+    p_context->doneCurrent();
+    p_context->moveToThread(p_owner_thread);
+}
+
+void RenderThread::render(Job & job) {
+    using Clock = std::chrono::steady_clock;
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    Tracer::Scope trace_scope("render", p_trace_arguments);
+    const auto start = Clock::now();
+
+    const QRect & region = job.frame.region;
+    if (not region.isEmpty()) {
+        const QRect gl_region = to_gl_region(p_size, region);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(gl_region.x(), gl_region.y(), gl_region.width(), gl_region.height());
+    }
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClearDepth(1.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(0, 0, p_size.width(), p_size.height());
+
+    // The core profile has no matrix stack, the matrices are given to its draw tool instead
+    if (not p_core_profile) {
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(job.frame.projection.constData());
+        glMatrixMode(GL_MODELVIEW);
+        glLoadMatrixf(job.frame.modelview.constData());
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    if (not p_core_profile) {
+        glEnable(GL_LIGHTING);
+        glShadeModel(GL_SMOOTH);
+        glColor4f(1, 1, 1, 1);
+        glDisable(GL_COLOR_MATERIAL);
+    }
+
+    std::unique_ptr<sofa::helper::visual::DrawTool> draw_tool;
+    if (p_core_profile) {
+        draw_tool = std::make_unique<sofa::helper::visual::QtDrawToolGLCore>(
+            *p_renderer, *p_vertex_stream, job.frame.projection, job.frame.modelview, p_geometry_cache.get());
+    } else {
+        draw_tool = std::make_unique<sofa::helper::visual::QtDrawToolGL>(
+            *p_renderer, p_cache_gl_state, p_geometry_cache.get());
+    }
+
+    const auto flush = [this]() {
+        if (p_vertex_stream)
+            p_vertex_stream->flush();
+        p_renderer->flush();
+    };
+    job.frame.recording->replay(*draw_tool, flush);
+    flush();
+    p_geometry_cache->end_frame();
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_SCISSOR_TEST);
+    if (not p_core_profile) {
+        glDisable(GL_LIGHTING);
+    }
+
+    // Wait for the GPU here, otherwise the readback would also measure the end of the rendering
+    glFinish();
+    const auto rendered = Clock::now();
+    {
+        Tracer::Scope readback_scope("readback", p_trace_arguments);
+        const unsigned int mip_levels = std::min(job.frame.mip_levels, MipPyramid::max_levels(p_size));
+        if (mip_levels > 0) {
+            if (not p_mip_pyramid or p_mip_pyramid->levels() != mip_levels) {
+                p_mip_pyramid = std::make_unique<MipPyramid>(p_size, mip_levels, p_internal_format);
+            }
+            p_mip_pyramid->downsample(*p_framebuffer, region);
+        }
+        if (not p_readback) {
+            p_readback = std::make_unique<FrameReadback>();
+        }
+        job.images.push_back(p_readback->read_image(*p_framebuffer, region));
+        if (mip_levels > 0) {
+            for (auto & level : p_mip_pyramid->read()) {
+                job.images.push_back(std::move(level));
+            }
+        }
+    }
+
+    job.render_time = Milliseconds(rendered - start).count();
+    job.readback_time = Milliseconds(Clock::now() - rendered).count();
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <QImage>
+#include <QMatrix4x4>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QRect>
+#include <QSize>
+#include <QThread>
+
+class FrameReadback;
+class MipPyramid;
+namespace sofa::helper::visual { class BatchRenderer; class GeometryCache; class RecordingDrawTool; class VertexStream; }
+
+/**
+ * Thread rendering the frames recorded by an OffscreenCamera in its pipelined mode.
+ *
+ * The thread owns an OpenGL context shared with the context of the camera, a framebuffer of the size of the camera's,
+ * and its own renderer, vertex stream and geometry cache. Frames are submitted with the recording of the scene and the
+ * matrices of the camera. They are rendered and read back one at a time, in their order of submission, while the
+ * submitting thread goes on. The rendered images are handed back to the submitting thread by collect(), in the same
+ * order. At most max_pending_frames frames are pending (submitted but not collected yet): submitting one more blocks
+ * until the oldest one has been rendered and collected.
+ */
+class RenderThread {
+public:
+    /** Number of frames that can be pending before submit() blocks. */
+    static constexpr std::size_t max_pending_frames = 2;
+
+    struct Frame {
+        std::shared_ptr<sofa::helper::visual::RecordingDrawTool> recording; ///< See recording()
+        QMatrix4x4 projection;
+        QMatrix4x4 modelview;
+        unsigned int mip_levels = 0; ///< Number of downsampled levels of the frame to render, see MipPyramid
+        QRect region;                ///< Region of the frame to render and read back, empty for the whole frame
+
+        /**
+         * Called by collect() with the rendered image followed by its downsampled levels, none if the frame could not
+         * be rendered, and the durations of its rendering (waiting for the GPU) and of its readback, in milliseconds.
+         */
+        std::function<void(const std::vector<QImage> & images, double render_time, double readback_time)> on_rendered;
+    };
+
+    /**
+     * Start the thread, and wait until its context and framebuffer are ready (see valid()).
+     *
+     * @param share_context Context of the camera, whose OpenGL objects are shared with the context of the thread.
+     * @param internal_format Internal format of the color buffer of the framebuffer, as the camera's.
+     * @param init_gl Called on the thread once its context is current, to set its fixed OpenGL state up.
+     */
+    RenderThread(QOpenGLContext & share_context, const QSize & size, GLenum internal_format, bool core_profile,
+                 bool cache_gl_state, std::function<void()> init_gl);
+
+    /** Render the frames still pending, and join the thread. Their images are not collected. */
+    ~RenderThread();
+
+    RenderThread(const RenderThread &) = delete;
+    RenderThread & operator=(const RenderThread &) = delete;
+
+    /** Whether the thread is running, false if its OpenGL context or framebuffer could not be created. */
+    bool valid() const { return p_status == Status::Running; }
+
+    /** Queue a frame to be rendered, blocking while max_pending_frames frames are pending. */
+    void submit(Frame frame);
+
+    /**
+     * Hand the images rendered so far back, in their order of submission, without waiting for the others. The
+     * recordings of these frames are kept to be reused by recording().
+     */
+    void collect();
+
+    /**
+     * Empty recording to record the next frame into: the recording of a frame collected before, reset with its
+     * storage kept, or a new one if every recording is still in use. The recordings are thus reused from one frame to
+     * the next, at most max_pending_frames + 1 being allocated.
+     */
+    std::shared_ptr<sofa::helper::visual::RecordingDrawTool> recording();
+
+    /** Wait for every frame submitted to be rendered, and collect them. */
+    void wait();
+
+    /** Set the arguments recorded with the spans of the rendering, see Tracer::complete. */
+    void set_trace_arguments(std::string arguments) { p_trace_arguments = std::move(arguments); }
+
+private:
+    enum class Status { Starting, Running, Failed };
+
+    struct Job {
+        Frame frame;
+        std::vector<QImage> images;
+        double render_time = 0;
+        double readback_time = 0;
+        bool rendered = false;
+    };
+
+    /** Body of the thread. */
+    void run();
+
+    /** Render the frame of the job into its image, on the thread. */
+    void render(Job & job);
+
+    QSize p_size;
+    GLenum p_internal_format;
+    bool p_core_profile;
+    bool p_cache_gl_state;
+    std::function<void()> p_init_gl;
+    std::string p_trace_arguments;
+    QThread * p_owner_thread;
+    std::unique_ptr<QOffscreenSurface> p_surface;
+    std::unique_ptr<QOpenGLContext> p_context;
+    std::unique_ptr<QThread> p_thread;
+    std::vector<std::shared_ptr<sofa::helper::visual::RecordingDrawTool>> p_free_recordings; ///< Collected frames'
+
+    // Guarded by p_mutex. The jobs rendered but not collected yet are at the front of the queue, followed by the job
+    // being rendered (at index p_next_job), if any, and by the ones waiting to be rendered.
+    std::mutex p_mutex;
+    std::condition_variable p_condition;
+    std::deque<Job> p_jobs;
+    std::size_t p_next_job = 0;
+    Status p_status = Status::Starting;
+    bool p_stopping = false;
+
+    // Only used by the thread
+    std::unique_ptr<QOpenGLFramebufferObject> p_framebuffer;
+    std::unique_ptr<sofa::helper::visual::BatchRenderer> p_renderer;
+    std::unique_ptr<sofa::helper::visual::VertexStream> p_vertex_stream;
+    std::unique_ptr<sofa::helper::visual::GeometryCache> p_geometry_cache;
+    std::unique_ptr<MipPyramid> p_mip_pyramid;
+    std::unique_ptr<FrameReadback> p_readback;
+};
@@ -0,0 +1,515 @@
+#include "ShaderLibrary.h"
+
+#include <string>
+#include <vector>
+
+#include <sofa/helper/logging/Messaging.h>
+
+namespace sofa::helper::visual {
+
+namespace {
+
+const char * version_header = R"(
+#version 150
+)";
+
+// Reproduces the fixed-function GL_LIGHT0 set up in OffscreenCamera::initGL() and the material set by
+// QtDrawToolGL::setMaterial() : positional light in eye space, non-local viewer, no light model
+// ambient, ambient and diffuse reflectance tracking the color, white specular with a shininess of 20.
+const char * lighting_source = R"(
+uniform bool u_lighting;
+
+const vec4  light_position = vec4(-0.7, 0.3, 0.0, 1.0);
+const vec3  light_ambient  = vec3(0.5, 0.5, 0.5);
+const vec3  light_diffuse  = vec3(0.9, 0.9, 0.9);
+const vec3  light_specular = vec3(1.0, 1.0, 1.0);
+const float shininess      = 20.0;
+
+vec4 shade(vec3 position, vec3 normal, vec4 color)
+{
+    if (!u_lighting)
+        return color;
+
+    vec3 n = normalize(normal);
+    vec3 l = normalize(light_position.xyz - position * light_position.w);
+    float n_dot_l = max(dot(n, l), 0.0);
+
+    vec3 c = color.rgb * light_ambient + color.rgb * light_diffuse * n_dot_l;
+    if (n_dot_l > 0.0) {
+        vec3 h = normalize(l + vec3(0.0, 0.0, 1.0));
+        c += light_specular * pow(max(dot(n, h), 0.0), shininess);
+    }
+    return vec4(clamp(c, 0.0, 1.0), color.a);
+}
+)";
+
+// Same construction of the cross-sectional basis than the one that was done on the CPU by the
+// immediate-mode implementation of QtDrawToolGL::drawCone, so that the facets stay at the same place.
+const char * frame_source = R"(
+void cross_section_basis(vec3 axis, out vec3 u, out vec3 v)
+{
+    vec3 p = axis;
+    if (abs(p.x) + abs(p.y) < 0.00001 * length(axis))
+        p.x += 1.0;
+    else
+        p.z += 1.0;
+    vec3 q = cross(p, axis);
+    p = cross(axis, q);
+    u = normalize(p);
+    v = normalize(q);
+}
+)";
+
+const char * instanced_cone_vertex_source = R"(
+uniform mat4 u_projection;
+uniform mat4 u_modelview;
+uniform mat3 u_normal_matrix;
+
+in vec4  a_vertex; // (cos(theta), sin(theta), t, 1 if the vertex belongs to an end cap)
+in vec4  i_base;   // (p1, radius1)
+in vec4  i_tip;    // (p2, radius2)
+in vec4  i_color;
+in float i_caps;   // bit 0: close the cone at p1, bit 1: close the cone at p2
+
+out vec4 v_color;
+
+void main()
+{
+    vec3 axis = i_tip.xyz - i_base.xyz;
+    vec3 u, v;
+    cross_section_basis(axis, u, v);
+
+    float t = a_vertex.z;
+    vec3 radial = u * a_vertex.x + v * a_vertex.y;
+    float radius = mix(i_base.w, i_tip.w, t);
+    vec3 normal = radial;
+
+    if (a_vertex.w > 0.5) {
+        bool closed = (t < 0.5) ? (mod(i_caps, 2.0) >= 1.0) : (i_caps >= 2.0);
+        normal = (t < 0.5 ? -1.0 : 1.0) * normalize(axis);
+        if (!closed)
+            radius = 0.0;
+    }
+
+    vec4 position = u_modelview * vec4(mix(i_base.xyz, i_tip.xyz, t) + radial * radius, 1.0);
+    v_color = shade(position.xyz, u_normal_matrix * normal, i_color);
+    gl_Position = u_projection * position;
+}
+)";
+
+const char * instanced_arrow_vertex_source = R"(
+uniform mat4 u_projection;
+uniform mat4 u_modelview;
+uniform mat3 u_normal_matrix;
+
+in vec4  a_vertex;      // (cos(theta), sin(theta), t, part) where part is one of the constants below
+in vec4  i_tail;        // (p1, shaft radius)
+in vec4  i_head;        // (p2, cone radius)
+in vec4  i_color;
+in float i_cone_length;
+
+const float SHAFT = 0.0;
+const float SHAFT_CAP = 1.0;
+const float CONE = 2.0;
+const float CONE_CAP = 3.0;
+
+out vec4 v_color;
+
+void main()
+{
+    vec3 axis = i_head.xyz - i_tail.xyz;
+    float length_of_arrow = length(axis);
+    vec3 direction = axis / length_of_arrow;
+    vec3 u, v;
+    cross_section_basis(axis, u, v);
+
+    float cone_length = min(i_cone_length, length_of_arrow);
+    vec3 split = i_head.xyz - direction * cone_length;
+
+    float t = a_vertex.z;
+    float part = a_vertex.w;
+    vec3 radial = u * a_vertex.x + v * a_vertex.y;
+
+    vec3 position;
+    vec3 normal;
+    if (part < SHAFT_CAP - 0.5) {
+        position = mix(i_tail.xyz, split, t) + radial * i_tail.w;
+        normal = radial;
+    } else if (part < CONE - 0.5) {
+        position = i_tail.xyz + radial * i_tail.w;
+        normal = -direction;
+    } else if (part < CONE_CAP - 0.5) {
+        position = mix(split, i_head.xyz, t) + radial * i_head.w * (1.0 - t);
+        normal = radial * cone_length + direction * i_head.w;
+    } else {
+        position = split + radial * i_head.w;
+        normal = -direction;
+    }
+
+    vec4 eye_position = u_modelview * vec4(position, 1.0);
+    v_color = shade(eye_position.xyz, u_normal_matrix * normal, i_color);
+    gl_Position = u_projection * eye_position;
+}
+)";
+
+// Each sphere is drawn as a quad facing the eye, large enough to cover the silhouette of the sphere: under a
+// perspective projection, the quad is orthogonal to the line of sight through the center and its half-size is the
+// radius of the tangent cone at the center's distance. The fragment shader then ray-casts the actual sphere.
+const char * sphere_impostor_vertex_source = R"(
+uniform mat4 u_projection;
+uniform mat4 u_modelview;
+uniform bool u_perspective;
+
+in vec4 a_vertex; // Corner of the unit quad
+in vec4 i_sphere; // (center, radius)
+in vec4 i_color;
+
+flat out vec3  v_center;
+flat out float v_radius;
+flat out vec4  v_color;
+out vec3 v_position;
+
+void main()
+{
+    vec3 center = (u_modelview * vec4(i_sphere.xyz, 1.0)).xyz;
+    float radius = i_sphere.w * length(u_modelview[0].xyz);
+
+    vec3 w = vec3(0.0, 0.0, 1.0);
+    float half_size = radius;
+    if (u_perspective) {
+        float distance = length(center);
+        // The eye is inside the sphere, nothing sensible can be seen
+        half_size = distance > radius ? radius * distance / sqrt(distance * distance - radius * radius) : 0.0;
+        w = -center / max(distance, 1e-20);
+    }
+    vec3 u = normalize(abs(w.y) < 0.99 ? cross(vec3(0.0, 1.0, 0.0), w) : cross(vec3(1.0, 0.0, 0.0), w));
+    vec3 v = cross(w, u);
+
+    v_center = center;
+    v_radius = radius;
+    v_color = i_color;
+    v_position = center + (u * a_vertex.x + v * a_vertex.y) * half_size;
+    gl_Position = u_projection * vec4(v_position, 1.0);
+}
+)";
+
+const char * sphere_impostor_fragment_source = R"(
+uniform mat4 u_projection;
+uniform bool u_perspective;
+
+flat in vec3  v_center;
+flat in float v_radius;
+flat in vec4  v_color;
+in vec3 v_position;
+
+out vec4 f_color;
+
+void main()
+{
+    vec3 origin    = u_perspective ? vec3(0.0) : vec3(v_position.xy, 0.0);
+    vec3 direction = u_perspective ? normalize(v_position) : vec3(0.0, 0.0, -1.0);
+
+    vec3 oc = origin - v_center;
+    float b = dot(direction, oc);
+    float discriminant = b * b - (dot(oc, oc) - v_radius * v_radius);
+    if (discriminant < 0.0)
+        discard;
+
+    vec3 hit = origin + (-b - sqrt(discriminant)) * direction;
+    f_color = shade(hit, (hit - v_center) / v_radius, v_color);
+
+    vec4 clip = u_projection * vec4(hit, 1.0);
+    float depth = clip.z / clip.w;
+    gl_FragDepth = 0.5 * (gl_DepthRange.diff * depth + gl_DepthRange.near + gl_DepthRange.far);
+}
+)";
+
+// Atlas lookups shared by the text programs, see GlyphAtlas for the layout of the characters
+const char * glyph_atlas_source = R"(
+uniform sampler2D u_atlas;
+uniform vec2  u_atlas_grid;   // Number of columns and rows of cells in the atlas
+uniform float u_aspect_ratio; // Width of a cell divided by its height
+
+// Texture coordinates of a point of the cell of the given character, local being (0,0) at the bottom-left
+// corner of the cell and (1,1) at its top-right corner
+vec2 glyph_uv(float character, vec2 local)
+{
+    float cell = character - 32.0;
+    vec2 origin = vec2(mod(cell, u_atlas_grid.x), floor(cell / u_atlas_grid.x));
+    return (origin + vec2(local.x, 1.0 - local.y)) / u_atlas_grid;
+}
+)";
+
+const char * glyph_text_vertex_source = R"(
+uniform mat4 u_projection;
+uniform bool u_overlay;
+uniform vec2 u_viewport; // Size of the viewport, in pixels
+
+in vec4 a_vertex; // Corner of the unit quad
+in vec4 i_anchor; // (top-left corner of the text, height of a line). For overlays, the corner is in pixels from
+                  // the top-left corner of the viewport, otherwise it is in eye space
+in vec4 i_color;
+in vec3 i_glyph;  // (character, column, line)
+
+out vec2 v_uv;
+flat out vec4 v_color;
+
+void main()
+{
+    vec2 corner = a_vertex.xy * 0.5 + 0.5;
+    float height = i_anchor.w;
+    vec2 offset = vec2((i_glyph.y + corner.x) * u_aspect_ratio, corner.y - 1.0 - i_glyph.z) * height;
+
+    if (u_overlay) {
+        vec2 pixel = i_anchor.xy + vec2(offset.x, -offset.y);
+        gl_Position = vec4(2.0 * pixel.x / u_viewport.x - 1.0, 1.0 - 2.0 * pixel.y / u_viewport.y, 0.0, 1.0);
+    } else {
+        gl_Position = u_projection * vec4(i_anchor.xyz + vec3(offset, 0.0), 1.0);
+    }
+
+    v_uv = glyph_uv(i_glyph.x, corner);
+    v_color = i_color;
+}
+)";
+
+const char * glyph_text_fragment_source = R"(
+in vec2 v_uv;
+flat in vec4 v_color;
+
+out vec4 f_color;
+
+void main()
+{
+    float alpha = texture(u_atlas, v_uv).a * v_color.a;
+    if (alpha < 0.01)
+        discard;
+    f_color = vec4(v_color.rgb, alpha);
+}
+)";
+
+// One instance per label: the quad is as wide as the number of digits of the index, and the fragment shader picks
+// the digit of the cell it falls in, so that no per-label work is done on the CPU.
+const char * index_labels_vertex_source = R"(
+uniform mat4 u_projection;
+
+in vec4  a_vertex; // Corner of the unit quad
+in vec4  i_anchor; // (center of the label in eye space, height of the label)
+in vec4  i_color;
+in uint  i_index;
+
+flat out uint v_index;
+flat out uint v_digits;
+flat out vec4 v_color;
+out vec2 v_local; // (position in number of digits from the left, position in the height from the bottom)
+
+void main()
+{
+    uint index = i_index;
+    uint digits = 1u;
+    for (uint power = 10u; digits < 10u && index >= power; power *= 10u)
+        ++digits;
+
+    vec2 corner = a_vertex.xy * 0.5 + 0.5;
+    float height = i_anchor.w;
+    float width = float(digits) * u_aspect_ratio * height;
+    gl_Position = u_projection * vec4(i_anchor.xyz + vec3((corner.x - 0.5) * width, (corner.y - 0.5) * height, 0.0), 1.0);
+
+    v_index = index;
+    v_digits = digits;
+    v_color = i_color;
+    v_local = vec2(corner.x * float(digits), corner.y);
+}
+)";
+
+const char * index_labels_fragment_source = R"(
+flat in uint v_index;
+flat in uint v_digits;
+flat in vec4 v_color;
+in vec2 v_local;
+
+out vec4 f_color;
+
+void main()
+{
+    uint cell = min(uint(v_local.x), v_digits - 1u);
+    uint power = 1u;
+    for (uint k = cell + 1u; k < v_digits; ++k)
+        power *= 10u;
+    float digit = float((v_index / power) % 10u);
+
+    // The gradients are taken on the continuous coordinates to avoid selecting a coarse mip level at the digit seams
+    vec2 uv = glyph_uv(48.0 + digit, vec2(fract(v_local.x), v_local.y));
+    vec2 continuous_uv = v_local / u_atlas_grid;
+    float alpha = textureGrad(u_atlas, uv, dFdx(continuous_uv), dFdy(continuous_uv)).a * v_color.a;
+    if (alpha < 0.01)
+        discard;
+    f_color = vec4(v_color.rgb, alpha);
+}
+)";
+
+// Replacement of the fixed-function pipeline for the vertices streamed by the core-profile draw tool, shaded per
+// vertex as with glShadeModel(GL_SMOOTH).
+const char * vertex_stream_vertex_source = R"(
+uniform mat4 u_projection;
+uniform mat4 u_modelview;
+uniform mat3 u_normal_matrix;
+
+in vec4 a_position; // w is 0 for the points at infinity of the infinite lines
+in vec3 a_normal;
+in vec4 a_color;
+
+out vec4 v_color;
+
+void main()
+{
+    vec4 position = u_modelview * a_position;
+    v_color = shade(position.xyz, u_normal_matrix * a_normal, a_color);
+    gl_Position = u_projection * position;
+}
+)";
+
+// Indexed triangles of the geometry cache. Their normals are given either per vertex, or per triangle in a float
+// texture of u_face_normals_width texels per row fetched with the index of the primitive.
+const char * indexed_triangles_vertex_source = R"(
+uniform mat4 u_projection;
+uniform mat4 u_modelview;
+
+in vec3 a_position;
+in vec3 a_normal;
+
+out vec3 v_position;
+out vec3 v_normal;
+
+void main()
+{
+    vec4 position = u_modelview * vec4(a_position, 1.0);
+    v_position = position.xyz;
+    v_normal = a_normal;
+    gl_Position = u_projection * position;
+}
+)";
+
+const char * indexed_triangles_fragment_source = R"(
+uniform mat3 u_normal_matrix;
+uniform vec4 u_color;
+uniform bool u_face_normals;
+uniform sampler2D u_face_normals_texture;
+uniform int u_face_normals_width;
+
+in vec3 v_position;
+in vec3 v_normal;
+
+out vec4 f_color;
+
+void main()
+{
+    vec3 normal = v_normal;
+    if (u_face_normals) {
+        ivec2 texel = ivec2(gl_PrimitiveID % u_face_normals_width, gl_PrimitiveID / u_face_normals_width);
+        normal = texelFetch(u_face_normals_texture, texel, 0).xyz;
+    }
+    f_color = shade(v_position, u_normal_matrix * normal, u_color);
+}
+)";
+
+const char * color_fragment_source = R"(
+in vec4 v_color;
+out vec4 f_color;
+
+void main()
+{
+    f_color = v_color;
+}
+)";
+
+struct ProgramSources {
+    std::vector<const char *> vertex;
+    std::vector<const char *> fragment;
+    std::vector<const char *> attributes; // Attribute names, in AttributeLocation order
+};
+
+ProgramSources sources_of(ShaderLibrary::Program program) {
+    switch (program) {
+        case ShaderLibrary::Program::InstancedCone:
+            return {
+                {lighting_source, frame_source, instanced_cone_vertex_source},
+                {color_fragment_source},
+                {"a_vertex", "i_base", "i_tip", "i_color", "i_caps"}
+            };
+        case ShaderLibrary::Program::InstancedArrow:
+            return {
+                {lighting_source, frame_source, instanced_arrow_vertex_source},
+                {color_fragment_source},
+                {"a_vertex", "i_tail", "i_head", "i_color", "i_cone_length"}
+            };
+        case ShaderLibrary::Program::GlyphText:
+            return {
+                {glyph_atlas_source, glyph_text_vertex_source},
+                {glyph_atlas_source, glyph_text_fragment_source},
+                {"a_vertex", "i_anchor", "i_color", "i_glyph"}
+            };
+        case ShaderLibrary::Program::IndexLabels:
+            return {
+                {glyph_atlas_source, index_labels_vertex_source},
+                {glyph_atlas_source, index_labels_fragment_source},
+                {"a_vertex", "i_anchor", "i_color", "i_index"}
+            };
+        case ShaderLibrary::Program::SphereImpostor:
+            return {
+                {sphere_impostor_vertex_source},
+                {lighting_source, sphere_impostor_fragment_source},
+                {"a_vertex", "i_sphere", "i_color"}
+            };
+        case ShaderLibrary::Program::IndexedTriangles:
+            return {
+                {indexed_triangles_vertex_source},
+                {lighting_source, indexed_triangles_fragment_source},
+                {"a_position", "a_normal"}
+            };
+        case ShaderLibrary::Program::VertexStream:
+            return {
+                {lighting_source, vertex_stream_vertex_source},
+                {color_fragment_source},
+                {"a_position", "a_normal", "a_color"}
+            };
+    }
+    return {};
+}
+
+std::string concatenate(const std::vector<const char *> & chunks) {
+    std::string source = version_header;
+    for (const auto * chunk : chunks) {
+        source += chunk;
+    }
+    return source;
+}
+
+} // namespace
+
+std::unique_ptr<QOpenGLShaderProgram> ShaderLibrary::create(ShaderLibrary::Program program) {
+    const auto sources = sources_of(program);
+    auto shader_program = std::make_unique<QOpenGLShaderProgram>();
+
+    if (not shader_program->addShaderFromSourceCode(QOpenGLShader::Vertex, concatenate(sources.vertex).c_str())) {
+        msg_error("ShaderLibrary") << "Failed to compile the vertex shader: " << shader_program->log().toStdString();
+        return nullptr;
+    }
+
+    if (not shader_program->addShaderFromSourceCode(QOpenGLShader::Fragment, concatenate(sources.fragment).c_str())) {
+        msg_error("ShaderLibrary") << "Failed to compile the fragment shader: " << shader_program->log().toStdString();
+        return nullptr;
+    }
+
+    for (std::size_t location = 0; location < sources.attributes.size(); ++location) {
+        shader_program->bindAttributeLocation(sources.attributes[location], static_cast<int>(location));
+    }
+
+    if (not shader_program->link()) {
+        msg_error("ShaderLibrary") << "Failed to link the shader program: " << shader_program->log().toStdString();
+        return nullptr;
+    }
+
+    return shader_program;
+}
+
+} // namespace sofa::helper::visual
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+
+#include <QOpenGLShaderProgram>
+
+namespace sofa::helper::visual {
+
+/**
+ * Small collection of GLSL programs used by the draw tools to render their instanced primitives, text, cached
+ * indexed meshes and, with the core profile, the vertices that would otherwise go through the fixed-function
+ * pipeline.
+ *
+ * Every lit program shades its fragments with the same light and material model than the one set up by
+ * OffscreenCamera::initGL(), so that instanced primitives cannot be told apart from the ones drawn
+ * with the fixed-function pipeline.
+ */
+class ShaderLibrary {
+public:
+    enum class Program {
+        InstancedCone,
+        InstancedArrow,
+        SphereImpostor,
+        GlyphText,
+        IndexLabels,
+        IndexedTriangles,
+        VertexStream
+    };
+
+    /**
+     * Vertex attribute locations shared by all programs. The per-vertex attribute of the unit mesh is
+     * always bound to location 0, and the per-instance attributes follow in the order they are
+     * declared in the vertex shader.
+     */
+    enum AttributeLocation : unsigned int {
+        Vertex = 0,
+        Instance0 = 1,
+        Instance1 = 2,
+        Instance2 = 3,
+        Instance3 = 4
+    };
+
+    /**
+     * Compile and link the given program. Returns nullptr (and log the compilation errors) on failure.
+     */
+    static std::unique_ptr<QOpenGLShaderProgram> create(Program program);
+};
+
+} // namespace sofa::helper::visual
@@ -0,0 +1,134 @@
+#include "Tracer.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include <sofa/helper/logging/Messaging.h>
+
+Tracer::Scope::Scope(const char * name, std::string arguments)
+: p_name(name)
+, p_arguments(std::move(arguments))
+, p_active(Tracer::instance().enabled())
+{
+    if (p_active)
+        p_start = Clock::now();
+}
+
+Tracer::Scope::~Scope() {
+    if (p_active)
+        Tracer::instance().complete(p_name, p_start, Clock::now(), std::move(p_arguments));
+}
+
+Tracer & Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer()
+: p_creation(Clock::now())
+{}
+
+Tracer::~Tracer() {
+    flush();
+}
+
+void Tracer::open(const std::string & filepath) {
+    std::lock_guard<std::mutex> lock(p_mutex);
+    if (p_filepath.empty()) {
+        p_filepath = filepath;
+        p_enabled.store(true, std::memory_order_relaxed);
+    } else if (p_filepath != filepath) {
+        msg_warning("Tracer") << "The events are already traced into '" << p_filepath << "', '" << filepath
+                              << "' is ignored.";
+    }
+}
+
+void Tracer::complete(const char * name, Clock::time_point start, Clock::time_point end, std::string arguments) {
+    if (not enabled())
+        return;
+    const double timestamp = microseconds_since_creation(start);
+    buffer_of_this_thread().events.push_back({
+        name, 'X', timestamp, microseconds_since_creation(end) - timestamp, std::move(arguments)
+    });
+}
+
+void Tracer::instant(const char * name, std::string arguments) {
+    if (not enabled())
+        return;
+    buffer_of_this_thread().events.push_back({
+        name, 'i', microseconds_since_creation(Clock::now()), 0, std::move(arguments)
+    });
+}
+
+void Tracer::flush() {
+    std::lock_guard<std::mutex> lock(p_mutex);
+    if (p_filepath.empty())
+        return;
+
+    std::ofstream file(p_filepath);
+    if (not file) {
+        msg_error("Tracer") << "Failed to open the trace file '" << p_filepath << "'.";
+        return;
+    }
+
+    char number[64];
+    const auto write_number = [&](double value) {
+        std::snprintf(number, sizeof(number), "%.3f", value);
+        file << number;
+    };
+
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    file << R"({"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "SofaOffscreenCamera"}})";
+    for (const auto & buffer : p_buffers) {
+        for (const auto & event : buffer->events) {
+            file << ",\n{\"name\": " << quoted(event.name) << ", \"cat\": \"capture\", \"ph\": \"" << event.phase
+                 << "\", \"pid\": 1, \"tid\": " << buffer->id << ", \"ts\": ";
+            write_number(event.timestamp);
+            if (event.phase == 'X') {
+                file << ", \"dur\": ";
+                write_number(event.duration);
+            } else {
+                file << ", \"s\": \"t\"";
+            }
+            file << ", \"args\": {" << event.arguments << "}}";
+        }
+    }
+    file << "\n]}\n";
+}
+
+std::string Tracer::quoted(const std::string & text) {
+    std::string result = "\"";
+    for (const char c : text) {
+        switch (c) {
+            case '"':  result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    result += escaped;
+                } else {
+                    result += c;
+                }
+        }
+    }
+    return result + "\"";
+}
+
+Tracer::ThreadBuffer & Tracer::buffer_of_this_thread() {
+    // The buffers belong to the tracer so that the events of the threads which have ended are still written
+    thread_local ThreadBuffer * buffer = nullptr;
+    if (not buffer) {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        p_buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = p_buffers.back().get();
+        buffer->id = p_buffers.size();
+    }
+    return *buffer;
+}
+
+double Tracer::microseconds_since_creation(Clock::time_point time) const {
+    return std::chrono::duration<double, std::micro>(time - p_creation).count();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Process-wide recorder of trace events, written at exit into a JSON file in the Trace Event Format understood by
+ * chrome://tracing and Perfetto.
+ *
+ * Every thread appends its events into its own buffer, hence recording an event never takes a lock (the mutex is
+ * only taken the first time a thread records an event, to register its buffer). Recording is opt-in: until a file
+ * has been opened, recording an event only costs a relaxed atomic load.
+ */
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** Record the span of the lifetime of the scope as a complete event. */
+    class Scope {
+    public:
+        Scope(const char * name, std::string arguments = {});
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope & operator=(const Scope &) = delete;
+
+    private:
+        const char * p_name;
+        std::string p_arguments;
+        bool p_active;
+        Clock::time_point p_start;
+    };
+
+    static Tracer & instance();
+
+    /**
+     * Start recording the events, which will be written into the given file at exit. The file of the first call is
+     * kept, the calls with another file are ignored with a warning.
+     */
+    void open(const std::string & filepath);
+
+    bool enabled() const { return p_enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Record a complete event (a span) of the calling thread.
+     *
+     * @param name Name of the event, it must outlive the tracer (typically a string literal).
+     * @param arguments Comma-separated JSON members shown with the event, such as "\"camera\": \"front\"".
+     */
+    void complete(const char * name, Clock::time_point start, Clock::time_point end, std::string arguments = {});
+
+    /** Record an instant event of the calling thread. See complete for the parameters. */
+    void instant(const char * name, std::string arguments = {});
+
+    /** Write all the events recorded so far. Threads must not record events while the trace is written. */
+    void flush();
+
+    /** Quote and escape a string as a JSON string. */
+    static std::string quoted(const std::string & text);
+
+private:
+    struct Event {
+        const char * name;
+        char phase;
+        double timestamp; ///< Microseconds since the creation of the tracer
+        double duration;  ///< Microseconds, complete events only
+        std::string arguments;
+    };
+
+    struct ThreadBuffer {
+        std::size_t id;
+        std::vector<Event> events;
+    };
+
+    Tracer();
+    ~Tracer();
+
+    ThreadBuffer & buffer_of_this_thread();
+    double microseconds_since_creation(Clock::time_point time) const;
+
+    std::atomic<bool> p_enabled {false};
+    Clock::time_point p_creation;
+    std::mutex p_mutex;
+    std::string p_filepath;
+    std::vector<std::unique_ptr<ThreadBuffer>> p_buffers;
+};
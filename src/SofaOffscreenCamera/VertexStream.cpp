@@ -0,0 +1,112 @@
+#include "VertexStream.h"
+
+#include <cstddef>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+#include <sofa/helper/logging/Messaging.h>
+
+#include "ShaderLibrary.h"
+
+namespace sofa::helper::visual {
+
+namespace {
+
+QOpenGLExtraFunctions * gl() {
+    return QOpenGLContext::currentContext()->extraFunctions();
+}
+
+} // namespace
+
+VertexStream::VertexStream()
+: p_program(ShaderLibrary::create(ShaderLibrary::Program::VertexStream))
+{
+    if (not p_program) {
+        msg_error("VertexStream") << "Points, lines and polygons will not be rendered.";
+    }
+
+    p_vao.create();
+    QOpenGLVertexArrayObject::Binder binder(&p_vao);
+    p_buffer.create();
+    p_buffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    p_buffer.bind();
+
+    // The stream has no per-instance attributes, the normal and the color take the locations following the vertex
+    const auto stride = static_cast<GLsizei>(sizeof(Vertex));
+    gl()->glEnableVertexAttribArray(ShaderLibrary::Vertex);
+    gl()->glVertexAttribPointer(ShaderLibrary::Vertex, 4, GL_FLOAT, GL_FALSE, stride,
+                                reinterpret_cast<const void *>(offsetof(Vertex, position)));
+    gl()->glEnableVertexAttribArray(ShaderLibrary::Instance0);
+    gl()->glVertexAttribPointer(ShaderLibrary::Instance0, 3, GL_FLOAT, GL_FALSE, stride,
+                                reinterpret_cast<const void *>(offsetof(Vertex, normal)));
+    gl()->glEnableVertexAttribArray(ShaderLibrary::Instance1);
+    gl()->glVertexAttribPointer(ShaderLibrary::Instance1, 4, GL_FLOAT, GL_FALSE, stride,
+                                reinterpret_cast<const void *>(offsetof(Vertex, color)));
+    p_buffer.release();
+}
+
+VertexStream::~VertexStream() = default;
+
+void VertexStream::set_state(const VertexStream::State & state) {
+    if (state != p_state) {
+        flush();
+        p_state = state;
+    }
+}
+
+void VertexStream::add_vertex(Primitive primitive, const Vector3 & position, const Vector3 & normal,
+                              const RGBAColor & color) {
+    const auto * c = color.array();
+    p_pending[static_cast<std::size_t>(primitive)].push_back({
+        {static_cast<float>(position[0]), static_cast<float>(position[1]), static_cast<float>(position[2]), 1.f},
+        {static_cast<float>(normal[0]), static_cast<float>(normal[1]), static_cast<float>(normal[2])},
+        {c[0], c[1], c[2], c[3]}
+    });
+}
+
+void VertexStream::add_direction(Primitive primitive, const Vector3 & direction, const RGBAColor & color) {
+    const auto * c = color.array();
+    p_pending[static_cast<std::size_t>(primitive)].push_back({
+        {static_cast<float>(direction[0]), static_cast<float>(direction[1]), static_cast<float>(direction[2]), 0.f},
+        {0.f, 0.f, 0.f},
+        {c[0], c[1], c[2], c[3]}
+    });
+}
+
+void VertexStream::flush() {
+    static constexpr GLenum modes[3] = {GL_POINTS, GL_LINES, GL_TRIANGLES};
+
+    bool program_is_bound = false;
+    for (std::size_t i = 0; i < p_pending.size(); ++i) {
+        auto & vertices = p_pending[i];
+        if (vertices.empty() || not p_program) {
+            vertices.clear();
+            continue;
+        }
+
+        if (not program_is_bound) {
+            p_program->bind();
+            p_program->setUniformValue("u_projection", p_state.projection);
+            p_program->setUniformValue("u_modelview", p_state.modelview);
+            p_program->setUniformValue("u_normal_matrix", p_state.modelview.normalMatrix());
+            p_program->setUniformValue("u_lighting", p_state.lighting);
+            program_is_bound = true;
+        }
+
+        QOpenGLVertexArrayObject::Binder binder(&p_vao);
+        p_buffer.bind();
+        p_buffer.allocate(vertices.data(), static_cast<int>(vertices.size() * sizeof(Vertex)));
+        gl()->glDrawArrays(modes[i], 0, static_cast<GLsizei>(vertices.size()));
+        p_buffer.release();
+        ++p_number_of_draw_calls;
+
+        vertices.clear();
+    }
+
+    if (program_is_bound) {
+        p_program->release();
+    }
+}
+
+} // namespace sofa::helper::visual
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+
+#include <sofa/type/RGBAColor.h>
+#include <sofa/type/Vec.h>
+
+#include "BatchRenderer.h"
+
+namespace sofa::helper::visual {
+
+/**
+ * Replacement of the immediate mode (glBegin / glVertex / glEnd) for the core profile.
+ *
+ * Vertices are appended to one of three pending lists (points, lines or triangles), strips, loops, fans and quads
+ * being expanded by the caller. Every pending vertex sharing the same transformation and lighting state is uploaded
+ * into a single buffer and drawn with one call per kind of primitive when the stream is flushed, using the OpenGL
+ * state (blending, depth, polygon mode, ...) current at that time. The caller must therefore flush the stream
+ * before modifying that state.
+ *
+ * The stream owns OpenGL objects: it must be created and destroyed while the OpenGL context it will be used with
+ * is current.
+ */
+class VertexStream {
+public:
+    using Vector3 = sofa::type::Vector3;
+    using RGBAColor = sofa::type::RGBAColor;
+    using State = BatchRenderer::State;
+
+    enum class Primitive {
+        Points = 0,
+        Lines = 1,
+        Triangles = 2
+    };
+
+    VertexStream();
+    ~VertexStream();
+
+    /**
+     * Set the transformation and lighting state of the vertices added hereafter. Pending vertices are flushed if the
+     * state changed.
+     */
+    void set_state(const State & state);
+
+    /** Append a vertex to the pending list of the given kind of primitive. */
+    void add_vertex(Primitive primitive, const Vector3 & position, const Vector3 & normal, const RGBAColor & color);
+
+    /** Append a vertex at infinity in the given direction, as with glVertex4d(x, y, z, 0). */
+    void add_direction(Primitive primitive, const Vector3 & direction, const RGBAColor & color);
+
+    /** Draw every pending vertex. */
+    void flush();
+
+    /** Number of draw calls submitted since the stream was created. */
+    std::size_t number_of_draw_calls() const { return p_number_of_draw_calls; }
+
+private:
+    struct Vertex {
+        float position[4];
+        float normal[3];
+        float color[4];
+    };
+
+    State p_state;
+    std::unique_ptr<QOpenGLShaderProgram> p_program;
+    QOpenGLVertexArrayObject p_vao;
+    QOpenGLBuffer p_buffer {QOpenGLBuffer::VertexBuffer};
+    std::array<std::vector<Vertex>, 3> p_pending;
+    std::size_t p_number_of_draw_calls = 0;
+};
+
+} // namespace sofa::helper::visual